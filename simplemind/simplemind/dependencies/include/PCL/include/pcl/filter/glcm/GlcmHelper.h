@@ -51,6 +51,24 @@ namespace pcl
 				return glcm;
 			}
 			
+            /**
+             * Returns the bin width used by dynamic quantization for values in [minValue, maxValue] (see ComputeFromIteratorWithDynamicQuantization).
+             */
+            static double GetStepSize(double minValue, double maxValue, unsigned numGraylevels, bool useOldBinCounting = false)
+            {
+                if (useOldBinCounting) return (maxValue - minValue) / numGraylevels;
+                return (maxValue - minValue + 1) / numGraylevels;
+            }
+
+            /**
+             * Returns the bin of value with dynamic quantization, clamped to the last bin (see ComputeFromIteratorWithDynamicQuantization).
+             */
+            static unsigned GetBinNumber(double value, double minValue, double step, unsigned numGraylevels)
+            {
+                unsigned bin = static_cast<unsigned>(std::floor((value-minValue)/step));
+                return bin>=numGraylevels?numGraylevels-1:bin;
+            }
+
 		    template <class ImagePointerType, class IteratorType>
 			static GrayLevelCooccurrenceMatrix& ComputeFromIteratorWithDynamicQuantization(GrayLevelCooccurrenceMatrix& glcm, const ImagePointerType& image, IteratorType& iter, const PointIndexObject& offset)
             {
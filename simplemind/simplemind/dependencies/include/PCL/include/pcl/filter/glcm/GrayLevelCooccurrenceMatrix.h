@@ -72,6 +72,17 @@ namespace pcl
 				}
 			}
 
+			/// Undoes add(row, col)
+			void remove(unsigned row, unsigned col)
+			{
+				--m_Matrix(row,col);
+				--m_Num;
+				if (m_Symmetric) {
+					--m_Matrix(col,row);
+					--m_Num;
+				}
+			}
+
 			double operator()(unsigned row, unsigned col) const
 			{
 				return m_Matrix(row, col);
@@ -8,6 +8,7 @@
 #include <pcl/filter/glcm/GlcmFeatures.h>
 #include <pcl/filter/glcm/GlcmHelper.h>
 #include <pcl/filter/glcm/GrayLevelCooccurrenceMatrix.h>
+#include <pcl/filter/glcm/SlidingWindowGlcm.h>
 #include <pcl/geometry/Region3D.h>
 
 #include <iostream>
@@ -336,30 +337,45 @@ namespace pcl
                 // Reset results vector
                 m_results.clear();
 
-                // Loop through vector of offsets
-                for (auto iter = m_pointOffsets.begin(); iter != m_pointOffsets.end(); iter++)
+                if (m_incremental && m_image->getRegion().contain(m_imageIterator.getRegion()))
                 {
-                    Point3D<int> pointOffset = *iter;
-                    //cout << "Processing offset " << pointOffset << endl;
-
-                    // Use GlcmHelper to create GLCM
-                    glcm.clear();
-                    offset = GlcmHelper::GetOffset(pointOffset, m_image);
-
-                    glcm = GlcmHelper::ComputeFromIteratorWithDynamicQuantization<typename T_InputImageType::ConstantPointer, ImageWindowIteratorWithPoint>
-                        (glcm, 
-                         m_image, 
-                         m_imageIterator, 
-                         offset, 
-                         [&](const pcl::Point3D<int>& point, long index)->bool {
-                             return m_imageIterator.getRegion().contain(point);
-                         },
-                         d_useOldBinCounting);
-                    //cout << glcm.getMatrix() << endl << endl;
-                    //cout << glcm.getNormalizedMatrix() << endl;
-
-                    // Compute GLCM features and add to results vector
-                    m_results.push_back(GlcmFeatures(glcm));
+                    // Update the GLCMs of the previous window, or compute them if the window did not slide by one voxel
+                    m_slidingGlcm.update(m_imageIterator.getRegion());
+                    for (int o = 0; o < m_pointOffsets.size(); o++)
+                        m_results.push_back(GlcmFeatures(m_slidingGlcm.getGlcm(o)));
+                }
+                else
+                {
+                    m_slidingGlcm.reset();
+                    // Named, since the helper takes the check function by non-const reference
+                    auto checkFunc = [&](const pcl::Point3D<int> &point, long index)->bool
+                    {
+                        return m_imageIterator.getRegion().contain(point);
+                    };
+
+                    // Loop through vector of offsets
+                    for (auto iter = m_pointOffsets.begin(); iter != m_pointOffsets.end(); iter++)
+                    {
+                        Point3D<int> pointOffset = *iter;
+                        //cout << "Processing offset " << pointOffset << endl;
+
+                        // Use GlcmHelper to create GLCM
+                        glcm.clear();
+                        offset = GlcmHelper::GetOffset(pointOffset, m_image);
+
+                        glcm = GlcmHelper::ComputeFromIteratorWithDynamicQuantization<typename T_InputImageType::ConstantPointer, ImageWindowIteratorWithPoint>
+                            (glcm, 
+                             m_image, 
+                             m_imageIterator, 
+                             offset, 
+                             checkFunc,
+                             d_useOldBinCounting);
+                        //cout << glcm.getMatrix() << endl << endl;
+                        //cout << glcm.getNormalizedMatrix() << endl;
+
+                        // Compute GLCM features and add to results vector
+                        m_results.push_back(GlcmFeatures(glcm));
+                    }
                 }
 //elapsed1 += clock.toc().getClock();
 
@@ -451,6 +467,20 @@ namespace pcl
                 return m_resultsAggregate[featureIndex].range;
             }
 
+            /**
+             * Enables or disables the incremental mode.
+             * In incremental mode, applying the filter one voxel after the previous point along x (as when a row is traversed
+             * in raster order) updates the GLCMs from the slabs entering and leaving the window instead of building them
+             * from the whole window (see SlidingWindowGlcm). The results are the same as without the incremental mode.
+             * Windows that do not lie within the image are always computed from the whole window.
+             * See also PointFilterRowHelper::ApplyByRows.
+             */
+            void setIncremental(bool incremental)
+            {
+                m_incremental = incremental;
+                m_slidingGlcm.reset();
+            }
+
             /**
              * Debug method to force old bin counting method.
              *
@@ -460,6 +490,7 @@ namespace pcl
             void debug_useOldBinCounting()
             {
                 d_useOldBinCounting = true;
+                m_slidingGlcm.debug_useOldBinCounting();
             }
             /////////////////////////////////////////////////////////////////////////////////
 
@@ -477,6 +508,10 @@ namespace pcl
             ImageWindowIteratorWithPoint                    m_imageIterator;
             //Region3D<int>                                   m_safeRegion;
 
+            // Incremental mode
+            bool                                            m_incremental;
+            SlidingWindowGlcm<typename T_InputImageType::ConstantPointer> m_slidingGlcm;
+
             // Results
             std::vector<GlcmFeatures>                       m_results;
             std::vector<GlcmAggregateStruct>                m_resultsAggregate;
@@ -490,6 +525,7 @@ namespace pcl
             PointGlcmFilter()
             {
                 d_useOldBinCounting = false;
+                m_incremental = false;
             }
 
             void initialize(const typename T_InputImageType::ConstantPointer &image, const Region3D<int> &region, const std::vector<Point3D<int>> offsets, int numGraylevels)
@@ -501,6 +537,7 @@ namespace pcl
 
                 m_boundaryHandler.setImage(m_image);
                 m_imageIterator.setImage(m_image, m_region);
+                m_slidingGlcm.initialize(m_image, m_pointOffsets, m_numGraylevels);
 
                 // Define safe region of image
                 //m_safeRegion.set(m_image->getMinPoint() - m_region.getMinPoint(),
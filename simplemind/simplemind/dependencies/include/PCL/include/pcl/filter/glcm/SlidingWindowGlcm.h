@@ -0,0 +1,205 @@
+#ifndef PCL_SLIDING_WINDOW_GLCM
+#define PCL_SLIDING_WINDOW_GLCM
+
+#include <pcl/filter/glcm/GlcmHelper.h>
+#include <pcl/filter/glcm/GrayLevelCooccurrenceMatrix.h>
+#include <pcl/geometry/Region3D.h>
+
+#include <map>
+#include <vector>
+
+namespace pcl
+{
+    namespace filter
+    {
+        /**
+         * Maintains the symmetric GLCMs (one per offset, with dynamic quantization) of a window sliding through an image.
+         *
+         * When the window moves by one voxel along x, only the pairs with a voxel in the leaving slab (lowest x of the old window)
+         * or in the entering slab (highest x of the new window) are removed or added, so a step costs time proportional to the
+         * size of a slab instead of the volume of the window.
+         * The values of the window are kept as counts; when its minimum or maximum value changes, the bins change and the GLCMs
+         * are computed from the whole window.
+         *
+         * The GLCMs are identical to those of GlcmHelper::ComputeFromIteratorWithDynamicQuantization.
+         * The window must lie within the image.
+         */
+        template <class ImagePointerType>
+        class SlidingWindowGlcm
+        {
+        public:
+            SlidingWindowGlcm()
+            {
+                m_valid = false;
+                m_useOldBinCounting = false;
+            }
+
+            void initialize(const ImagePointerType &image, const std::vector<Point3D<int>> &offsets, int numGraylevels)
+            {
+                m_image = image;
+                m_offsets.clear();
+                for (auto iter = offsets.begin(); iter != offsets.end(); iter++)
+                    m_offsets.push_back(GlcmHelper::GetOffset(*iter, image));
+                m_numGraylevels = numGraylevels;
+                m_glcms.assign(offsets.size(), GrayLevelCooccurrenceMatrix(numGraylevels, true));
+                m_valid = false;
+            }
+
+            /**
+             * Moves the window to the given region.
+             * The GLCMs are updated incrementally if the region is the previous one shifted by one voxel along x,
+             * and computed from the whole window otherwise.
+             */
+            void update(const Region3D<int> &window)
+            {
+                Point3D<int> step(1, 0, 0);
+                if (m_valid && window.getMinPoint()==m_window.getMinPoint()+step && window.getMaxPoint()==m_window.getMaxPoint()+step) slide(window);
+                else compute(window);
+            }
+
+            /**
+             * Forgets the current window, so that the next update computes the GLCMs from the whole window.
+             */
+            void reset()
+            {
+                m_valid = false;
+            }
+
+            /**
+             * Returns the GLCM of the current window for the specified offset.
+             */
+            const GrayLevelCooccurrenceMatrix& getGlcm(int offsetIndex) const
+            {
+                return m_glcms[offsetIndex];
+            }
+
+            /**
+             * See PointGlcmFilter::debug_useOldBinCounting.
+             */
+            void debug_useOldBinCounting()
+            {
+                m_useOldBinCounting = true;
+                m_valid = false;
+            }
+
+        protected:
+            ImagePointerType                        m_image;
+            std::vector<PointIndexObject>           m_offsets;
+            int                                     m_numGraylevels;
+            bool                                    m_useOldBinCounting;
+
+            // State of the current window
+            bool                                    m_valid;
+            Region3D<int>                           m_window;
+            std::map<double, long>                  m_values;       // Number of voxels of the window with each value
+            std::vector<GrayLevelCooccurrenceMatrix> m_glcms;
+            double                                  m_minValue, m_maxValue, m_step;
+
+            unsigned getBin(long index) const
+            {
+                return GlcmHelper::GetBinNumber(m_image->get(index), m_minValue, m_step, m_numGraylevels);
+            }
+
+            void updateValues(const Region3D<int> &window, int x, long change)
+            {
+                const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                {
+                    double value = m_image->get(m_image->toIndex(x, y, z));
+                    long &count = m_values[value];
+                    count += change;
+                    if (count==0) m_values.erase(value);
+                }
+            }
+
+            void compute(const Region3D<int> &window)
+            {
+                m_window = window;
+                m_values.clear();
+                for (int x = window.getMinPoint().x(); x <= window.getMaxPoint().x(); x++) updateValues(window, x, 1);
+                computeGlcms();
+                m_valid = true;
+            }
+
+            /**
+             * Computes the GLCMs of the current window from scratch with the bins of its range of values.
+             */
+            void computeGlcms()
+            {
+                m_minValue = m_values.begin()->first;
+                m_maxValue = m_values.rbegin()->first;
+                m_step = GlcmHelper::GetStepSize(m_minValue, m_maxValue, m_numGraylevels, m_useOldBinCounting);
+                for (int o = 0; o < m_offsets.size(); o++) m_glcms[o].clear();
+
+                const Point3D<int> &minp = m_window.getMinPoint(), &maxp = m_window.getMaxPoint();
+                for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                {
+                    long index = m_image->toIndex(minp.x(), y, z);
+                    for (Point3D<int> p(minp.x(), y, z); p.x() <= maxp.x(); p.x()++, index++)
+                    {
+                        unsigned bin = getBin(index);
+                        for (int o = 0; o < m_offsets.size(); o++)
+                        {
+                            if (m_window.contain(p + m_offsets[o].point)) m_glcms[o].add(bin, getBin(index + m_offsets[o].index));
+                        }
+                    }
+                }
+            }
+
+            void slide(const Region3D<int> &window)
+            {
+                const Region3D<int> oldWindow = m_window;
+                int leavingX = oldWindow.getMinPoint().x(), enteringX = window.getMaxPoint().x();
+
+                updateValues(oldWindow, leavingX, -1);
+                updateValues(window, enteringX, 1);
+                m_window = window;
+
+                // The bins only stay the same if the range of values does
+                if (m_values.begin()->first!=m_minValue || m_values.rbegin()->first!=m_maxValue)
+                {
+                    computeGlcms();
+                    return;
+                }
+                updateSlabPairs(oldWindow, leavingX, false);
+                updateSlabPairs(window, enteringX, true);
+            }
+
+            /**
+             * Adds (or removes) every pair of window with a voxel in the slab at x.
+             */
+            void updateSlabPairs(const Region3D<int> &window, int x, bool add)
+            {
+                const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                {
+                    Point3D<int> p(x, y, z);
+                    long index = m_image->toIndex(p);
+                    unsigned bin = getBin(index);
+                    for (int o = 0; o < m_offsets.size(); o++)
+                    {
+                        const PointIndexObject &offset = m_offsets[o];
+                        GrayLevelCooccurrenceMatrix &glcm = m_glcms[o];
+
+                        // Pairs with both voxels in the slab are counted from their first voxel only
+                        if (window.contain(p + offset.point))
+                        {
+                            unsigned neighborBin = getBin(index + offset.index);
+                            if (add) glcm.add(bin, neighborBin);
+                            else glcm.remove(bin, neighborBin);
+                        }
+                        Point3D<int> q = p - offset.point;
+                        if (q.x()!=x && window.contain(q))
+                        {
+                            unsigned neighborBin = getBin(index - offset.index);
+                            if (add) glcm.add(neighborBin, bin);
+                            else glcm.remove(neighborBin, bin);
+                        }
+                    }
+                }
+            }
+        };
+    }
+}
+
+#endif
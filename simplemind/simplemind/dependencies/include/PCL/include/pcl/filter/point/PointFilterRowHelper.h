@@ -0,0 +1,68 @@
+#ifndef PCL_POINT_FILTER_ROW_HELPER
+#define PCL_POINT_FILTER_ROW_HELPER
+
+#include <pcl/geometry/Region3D.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace pcl
+{
+	namespace filter
+	{
+
+		class PointFilterRowHelper
+		{
+		public:
+			/**
+			 * Applies a point filter at every point of region, row by row along x, with the rows split over numThreads threads.
+			 *
+			 * Within a row each point follows the previous one along x, so that filters in incremental mode
+			 * (e.g. PointGlcmFilter::setIncremental) only update their window from one point to the next.
+			 *
+			 * Parameters:
+			 *   - region -- Points at which to apply the filter
+			 *   - createFilter -- Called once per thread; returns a new filter (e.g. the Pointer returned by PointGlcmFilter::New)
+			 *   - store -- Called as store(filter, point) after the filter is applied at point, typically to write its results
+			 *              to output images; it is called from the worker threads, each point once
+			 *   - numThreads -- Number of threads
+			 */
+			template <class CreateFilter, class StoreFunc>
+			static void ApplyByRows(const Region3D<int>& region, CreateFilter createFilter, StoreFunc store, int numThreads=1)
+			{
+				const Point3D<int> &minp = region.getMinPoint(), &maxp = region.getMaxPoint();
+				long num_y = maxp.y()-minp.y()+1, num_rows = num_y*(maxp.z()-minp.z()+1);
+				if (maxp.x()<minp.x() || num_rows<=0) return;
+
+				auto apply_rows = [&](long begin, long end) {
+					auto filter = createFilter();
+					for (long r=begin; r<end; ++r) {
+						int y = minp.y() + r%num_y, z = minp.z() + r/num_y;
+						for (int x=minp.x(); x<=maxp.x(); ++x) {
+							Point3D<int> p(x, y, z);
+							filter->apply(p);
+							store(filter, p);
+						}
+					}
+				};
+
+				int num_threads = std::max<int>(1, std::min<long>(numThreads, num_rows));
+				if (num_threads==1) {
+					apply_rows(0, num_rows);
+					return;
+				}
+				std::vector<std::thread> workers;
+				for (int t=0; t<num_threads; ++t) {
+					long begin = num_rows*t/num_threads,
+						end = num_rows*(t+1)/num_threads;
+					workers.push_back(std::thread(apply_rows, begin, end));
+				}
+				for (auto w=workers.begin(); w!=workers.end(); ++w) w->join();
+			}
+		};
+
+	}
+}
+
+#endif
@@ -8,9 +8,12 @@
 #include <pcl/filter/glcm/GlcmFeatures.h>
 #include <pcl/filter/glcm/GlcmHelper.h>
 #include <pcl/filter/glcm/GrayLevelCooccurrenceMatrix.h>
+#include <pcl/filter/glcm/SlidingWindowGlcm.h>
+#include <pcl/filter/point/PointFilterRowHelper.h>
 #include <pcl/filter/rlm/RlmFeatures.h>
 #include <pcl/filter/rlm/RlmHelper.h>
 #include <pcl/filter/rlm/RunLengthMatrix.h>
+#include <pcl/filter/rlm/SlidingWindowRlm.h>
 #include <pcl/geometry/Region3D.h>
 
 #include <iostream>
@@ -201,7 +204,7 @@ namespace pcl
                  */
                 bool isGlcm() const
                 {
-                    return getFeatureIndex() >= GLCM_CONTRAST && getFeatureIndex() <= GLCM_MAX_CORRELATION_COEFFICIENT;
+                    return getBaseFeatureIndex() >= GLCM_CONTRAST && getBaseFeatureIndex() <= GLCM_MAX_CORRELATION_COEFFICIENT;
                 }
 
                 /**
@@ -210,7 +213,7 @@ namespace pcl
                  */
                 bool isRlm() const
                 {
-                    return getFeatureIndex() >= RLM_SHORT_RUN_EMPHASIS && getFeatureIndex() <= RLM_RUN_PERCENTAGE;
+                    return getBaseFeatureIndex() >= RLM_SHORT_RUN_EMPHASIS && getBaseFeatureIndex() <= RLM_RUN_PERCENTAGE;
                 }
 
                 /**
@@ -365,6 +368,40 @@ namespace pcl
                 obj->initialize(image, region, offsets, numGraylevels);
                 return obj;
             }
+
+            /**
+             * Computes one image per feature holding the value of the feature at every point of outputRegion.
+             * The points are visited row by row on numThreads threads with filters in incremental mode (see setIncremental
+             * and PointFilterRowHelper::ApplyByRows), so each window is updated from the previous one along x.
+             * Parameters:
+             *   - image, region, offsets, numGraylevels -- See New
+             *   - outputRegion -- Points at which to compute the features (the region of the output images)
+             *   - features -- Features to compute
+             *   - mask -- Optional mask (see provideImageMask); with a mask the matrices are computed from the whole window at every point
+             *   - numThreads -- Number of threads
+             */
+            template <class T_OutputImageType>
+            static std::vector<typename T_OutputImageType::Pointer> ComputeFeatureImages(const typename T_InputImageType::ConstantPointer &image, const Region3D<int> &region, const std::vector<Point3D<int>> &offsets, int numGraylevels,
+                const Region3D<int> &outputRegion, const std::vector<FeatureIndex> &features, const ImageMaskType::ConstantPointer &mask = ImageMaskType::ConstantPointer(), int numThreads = 1)
+            {
+                std::vector<typename T_OutputImageType::Pointer> outputs;
+                for (int f = 0; f < features.size(); f++)
+                    outputs.push_back(T_OutputImageType::New(outputRegion.getMinPoint(), outputRegion.getMaxPoint(), image->getSpacing(), image->getOrigin(), image->getOrientationMatrix()));
+
+                auto createFilter = [&]()
+                {
+                    Pointer filter = New(image, region, offsets, numGraylevels);
+                    if (mask) filter->provideImageMask(mask);
+                    filter->setIncremental(true);
+                    return filter;
+                };
+                auto store = [&](const Pointer &filter, const Point3D<int> &point)
+                {
+                    for (int f = 0; f < features.size(); f++) outputs[f]->set(point, filter->getResult(features[f]));
+                };
+                PointFilterRowHelper::ApplyByRows(outputRegion, createFilter, store, numThreads);
+                return outputs;
+            }
             /////////////////////////////////////////////////////////////////////////////////
 
 
@@ -377,7 +414,7 @@ namespace pcl
 
             bool hasImageMask() const
             {
-                return m_mask;
+                return m_mask.get()!=NULL;
             }
 
             template <class T_IteratorType>
@@ -403,6 +440,27 @@ namespace pcl
             {
                 if (isPreviousIndex(index)) return;
 
+                // Reset results vectors
+                m_glcmResults.clear();
+                m_rlmResults.clear();
+
+                m_imageIterator.setWindowOrigin(point, index);
+                if (m_incremental && !hasImageMask() && m_image->getRegion().contain(m_imageIterator.getRegion()))
+                {
+                    // Update the matrices of the previous window, or compute them if the window did not slide by one voxel
+                    m_slidingGlcm.update(m_imageIterator.getRegion());
+                    m_slidingRlm.update(m_imageIterator.getRegion());
+                    for (int o = 0; o < m_pointOffsets.size(); o++)
+                    {
+                        m_glcmResults.push_back(GlcmFeatures(m_slidingGlcm.getGlcm(o)));
+                        m_rlmResults.push_back(RlmFeatures(m_slidingRlm.getRlm(o)));
+                    }
+                    computeAggregateResults();
+                    return;
+                }
+                m_slidingGlcm.reset();
+                m_slidingRlm.reset();
+
                 // Obtain image window
                 ImageIntType::Pointer window = buildImageWindowWithDynamicQuantization(point, index, m_numGraylevels);
 
@@ -410,10 +468,6 @@ namespace pcl
                 GrayLevelCooccurrenceMatrix glcm(m_numGraylevels, true);
                 RunLengthMatrix rlm;
 
-                // Reset results vectors
-                m_glcmResults.clear();
-                m_rlmResults.clear();
-
                 // Point checker
                 auto pointCheckerNull = [this](const PointIntType &p, long index)->bool
                 {
@@ -530,6 +584,21 @@ namespace pcl
                 return m_resultsAggregate[featureIndex].range;
             }
 
+            /**
+             * Enables or disables the incremental mode.
+             * In incremental mode, applying the filter one voxel after the previous point along x (as when a row is traversed
+             * in raster order) updates the GLCMs and RLMs from the slabs entering and leaving the window instead of building them
+             * from the whole window (see SlidingWindowGlcm and SlidingWindowRlm). The results are the same as without the incremental mode.
+             * Windows that do not lie within the image, and all windows if a mask is provided, are computed from the whole window.
+             * See also ComputeFeatureImages.
+             */
+            void setIncremental(bool incremental)
+            {
+                m_incremental = incremental;
+                m_slidingGlcm.reset();
+                m_slidingRlm.reset();
+            }
+
             /**
              * Debug method to force old bin counting method.
              *
@@ -539,6 +608,8 @@ namespace pcl
             void debug_useOldBinCounting()
             {
                 d_useOldBinCounting = true;
+                m_slidingGlcm.debug_useOldBinCounting();
+                m_slidingRlm.debug_useOldBinCounting();
             }
             /////////////////////////////////////////////////////////////////////////////////
 
@@ -559,6 +630,11 @@ namespace pcl
             ImageMaskType::ConstantPointer                  m_mask;                 // Optional mask for image access (e.g. lung roi)
             MaskBoundaryHandlerType                         m_boundaryHandlerMask;
 
+            // Incremental mode
+            bool                                            m_incremental;
+            SlidingWindowGlcm<typename T_InputImageType::ConstantPointer> m_slidingGlcm;
+            SlidingWindowRlm<typename T_InputImageType::ConstantPointer>  m_slidingRlm;
+
             // Results
             std::vector<GlcmFeatures>                       m_glcmResults;
             std::vector<RlmFeatures>                        m_rlmResults;
@@ -573,6 +649,7 @@ namespace pcl
             PointGlcmRlmFilter()
             {
                 d_useOldBinCounting = false;
+                m_incremental = false;
             }
 
             void initialize(const typename T_InputImageType::ConstantPointer &image, const Region3D<int> &region, const std::vector<Point3D<int>> offsets, int numGraylevels)
@@ -584,6 +661,8 @@ namespace pcl
 
                 m_boundaryHandler.setImage(m_image);
                 m_imageIterator.setImage(m_image, m_region);
+                m_slidingGlcm.initialize(m_image, m_pointOffsets, m_numGraylevels);
+                m_slidingRlm.initialize(m_image, m_pointOffsets, m_numGraylevels);
 
                 // Define safe region of image
                 //m_safeRegion.set(m_image->getMinPoint() - m_region.getMinPoint(),
@@ -8,6 +8,7 @@
 #include <pcl/filter/rlm/RlmFeatures.h>
 #include <pcl/filter/rlm/RlmHelper.h>
 #include <pcl/filter/rlm/RunLengthMatrix.h>
+#include <pcl/filter/rlm/SlidingWindowRlm.h>
 #include <pcl/geometry/Region3D.h>
 
 #include <iostream>
@@ -320,28 +321,42 @@ namespace pcl
                 // Reset results vector
                 m_results.clear();
 
-                // Loop through vector of offsets
-                for (auto iter = m_pointOffsets.begin(); iter != m_pointOffsets.end(); iter++)
+                if (m_incremental && m_image->getRegion().contain(m_imageIterator.getRegion()))
                 {
-                    Point3D<int> pointOffset = *iter;
-                    //cout << "Processing offset " << pointOffset << endl;
-
-                    // Use RlmHelper to create RLM
-                    rlm.clear();
-                    offset = RlmHelper::GetOffset(pointOffset, m_image);
-                    rlm = RlmHelper::ComputeFromIteratorWithDynamicQuantization<typename T_InputImageType::ConstantPointer, ImageWindowIteratorWithPoint>
-                        (m_image,
-                         m_numGraylevels, 
-                         m_imageIterator, 
-                         offset, 
-                         [&](const pcl::Point3D<int> &point, int index)
-                         {
-                             return m_imageIterator.getRegion().contain(point);
-                         },
-                         d_useOldBinCounting);
-
-                    // Compute RLM features and add to results vector
-                    m_results.push_back(RlmFeatures(rlm));
+                    // Update the RLMs of the previous window, or compute them if the window did not slide by one voxel
+                    m_slidingRlm.update(m_imageIterator.getRegion());
+                    for (int o = 0; o < m_pointOffsets.size(); o++)
+                        m_results.push_back(RlmFeatures(m_slidingRlm.getRlm(o)));
+                }
+                else
+                {
+                    m_slidingRlm.reset();
+                    // Named, since the helper takes the check function by non-const reference
+                    auto checkFunc = [&](const pcl::Point3D<int> &point, long index)
+                    {
+                        return m_imageIterator.getRegion().contain(point);
+                    };
+
+                    // Loop through vector of offsets
+                    for (auto iter = m_pointOffsets.begin(); iter != m_pointOffsets.end(); iter++)
+                    {
+                        Point3D<int> pointOffset = *iter;
+                        //cout << "Processing offset " << pointOffset << endl;
+
+                        // Use RlmHelper to create RLM
+                        rlm.clear();
+                        offset = RlmHelper::GetOffset(pointOffset, m_image);
+                        rlm = RlmHelper::ComputeFromIteratorWithDynamicQuantization<typename T_InputImageType::ConstantPointer, ImageWindowIteratorWithPoint>
+                            (m_image,
+                             m_numGraylevels, 
+                             m_imageIterator, 
+                             offset, 
+                             checkFunc,
+                             d_useOldBinCounting);
+
+                        // Compute RLM features and add to results vector
+                        m_results.push_back(RlmFeatures(rlm));
+                    }
                 }
 //elapsed += clock.toc().getClock();
 
@@ -426,6 +441,20 @@ namespace pcl
                 return m_resultsAggregate[featureIndex].range;
             }
 
+            /**
+             * Enables or disables the incremental mode.
+             * In incremental mode, applying the filter one voxel after the previous point along x (as when a row is traversed
+             * in raster order) updates the RLMs from the slabs entering and leaving the window instead of building them
+             * from the whole window (see SlidingWindowRlm). The results are the same as without the incremental mode.
+             * Windows that do not lie within the image are always computed from the whole window.
+             * See also PointFilterRowHelper::ApplyByRows.
+             */
+            void setIncremental(bool incremental)
+            {
+                m_incremental = incremental;
+                m_slidingRlm.reset();
+            }
+
             /**
              * Debug method to force old bin counting method.
              *
@@ -435,6 +464,7 @@ namespace pcl
             void debug_useOldBinCounting()
             {
                 d_useOldBinCounting = true;
+                m_slidingRlm.debug_useOldBinCounting();
             }
             /////////////////////////////////////////////////////////////////////////////////
 
@@ -452,6 +482,10 @@ namespace pcl
             ImageWindowIteratorWithPoint                    m_imageIterator;
             //Region3D<int>                                   m_safeRegion;
 
+            // Incremental mode
+            bool                                            m_incremental;
+            SlidingWindowRlm<typename T_InputImageType::ConstantPointer> m_slidingRlm;
+
             // Results
             std::vector<RlmFeatures>                        m_results;
             std::vector<RlmAggregateStruct>                 m_resultsAggregate;
@@ -465,6 +499,7 @@ namespace pcl
             PointRlmFilter()
             {
                 d_useOldBinCounting = false;
+                m_incremental = false;
             }
 
             void initialize(const typename T_InputImageType::ConstantPointer &image, const Region3D<int> &region, const std::vector<Point3D<int>> offsets, int numGraylevels)
@@ -476,6 +511,7 @@ namespace pcl
 
                 m_boundaryHandler.setImage(m_image);
                 m_imageIterator.setImage(m_image, m_region);
+                m_slidingRlm.initialize(m_image, m_pointOffsets, m_numGraylevels);
 
                 // Define safe region of image
                 //m_safeRegion.set(m_image->getMinPoint() - m_region.getMinPoint(),
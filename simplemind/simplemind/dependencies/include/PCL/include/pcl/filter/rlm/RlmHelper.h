@@ -86,7 +86,7 @@ namespace pcl
                     int runLength;
 
                     // If the current voxel has not already been visited and it falls within the image
-                    if (!visited->get(iterPoint) && image->contain(iterPoint))
+                    if (image->contain(iterPoint) && !visited->get(iterPoint))
                     {
                         // Mark the voxel as having been visited
                         visited->set(iterPoint, true);
@@ -101,7 +101,7 @@ namespace pcl
                         // Step forwards
                         nextPoint.point = iter.getPoint() + offset.getPoint();
                         nextPoint.index = iter.getIndex() + offset.getIndex();
-                        while (checkFunc(nextPoint.point, nextPoint.index))         // Is it necessary to also check whether nextPoint falls within image bounds? Safety vs speed
+                        while (image->contain(nextPoint.point) && checkFunc(nextPoint.point, nextPoint.index))     // The window may extend past the image
                         {
                             nextValue = image->get(nextPoint.point);                // Determine value/bin of next point. Is it faster/better to pass nextPoint.index instead?
                             nextBin = getBinNumber(nextValue, minValue, maxValue, numGraylevels, useOldBinCounting);
@@ -118,7 +118,7 @@ namespace pcl
                         // Step backwards
                         nextPoint.point = iter.getPoint() - offset.getPoint();
                         nextPoint.index = iter.getIndex() - offset.getIndex();
-                        while (checkFunc(nextPoint.point, nextPoint.index))         // Is it necessary to also check whether nextPoint falls within image bounds? Safety vs speed
+                        while (image->contain(nextPoint.point) && checkFunc(nextPoint.point, nextPoint.index))     // The window may extend past the image
                         {
                             nextValue = image->get(nextPoint.point);                // Determine value/bin of next point. Is it faster/better to pass nextPoint.index instead?
                             nextBin = getBinNumber(nextValue, minValue, maxValue, numGraylevels, useOldBinCounting);
@@ -261,6 +261,14 @@ namespace pcl
                 return rlm;
 			}
 
+            /**
+             * Returns the bin of value with dynamic quantization (see ComputeFromIteratorWithDynamicQuantization).
+             */
+            static unsigned int GetBinNumber(double value, double minValue, double maxValue, int numBins, bool useOldBinCounting = false)
+            {
+                return getBinNumber(value, minValue, maxValue, numBins, useOldBinCounting);
+            }
+
         protected:
             struct BinRunLengthStruct
             {
@@ -0,0 +1,295 @@
+#ifndef PCL_SLIDING_WINDOW_RLM
+#define PCL_SLIDING_WINDOW_RLM
+
+#include <pcl/filter/rlm/RlmHelper.h>
+#include <pcl/filter/rlm/RunLengthMatrix.h>
+#include <pcl/geometry/PointHash.h>
+#include <pcl/geometry/Region3D.h>
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace pcl
+{
+    namespace filter
+    {
+        /**
+         * Maintains the RLMs (one per offset, with dynamic quantization) of a window sliding through an image.
+         *
+         * The voxels of the window lie on chains p, p+offset, p+2*offset, ... and the runs are the maximal segments of a chain
+         * with the same bin. When the window moves by one voxel along x:
+         *   - offsets with a nonzero x component: each voxel of the leaving slab is the first voxel of its chain and each voxel of
+         *     the entering slab the last one, so only the first and last runs of the chains change. The runs of each chain are kept.
+         *   - offsets within the yz plane: the chains lie within slabs, so the runs of the leaving slab are removed and those of the
+         *     entering slab are added.
+         * A step therefore costs time proportional to the size of a slab instead of the volume of the window.
+         * When the minimum or maximum value of the window changes, the bins change and the runs are computed from the whole window.
+         *
+         * The RLMs are identical to those of RlmHelper::ComputeFromIteratorWithDynamicQuantization.
+         * The window must lie within the image.
+         */
+        template <class ImagePointerType>
+        class SlidingWindowRlm
+        {
+        public:
+            SlidingWindowRlm()
+            {
+                m_valid = false;
+                m_useOldBinCounting = false;
+            }
+
+            void initialize(const ImagePointerType &image, const std::vector<Point3D<int>> &offsets, int numGraylevels)
+            {
+                m_image = image;
+                m_numGraylevels = numGraylevels;
+                m_states.clear();
+                for (auto iter = offsets.begin(); iter != offsets.end(); iter++)
+                {
+                    // Runs do not depend on the direction of the offset, so chains are always followed towards increasing x
+                    const Point3D<int> &d = *iter;
+                    bool forward = d.x()>0 || (d.x()==0 && (d.y()>0 || (d.y()==0 && d.z()>0)));
+                    m_states.push_back(OffsetState(RlmHelper::GetOffset(forward ? d : Point3D<int>(-d.x(), -d.y(), -d.z()), image)));
+                }
+                m_valid = false;
+            }
+
+            /**
+             * Moves the window to the given region.
+             * The RLMs are updated incrementally if the region is the previous one shifted by one voxel along x,
+             * and computed from the whole window otherwise.
+             */
+            void update(const Region3D<int> &window)
+            {
+                Point3D<int> step(1, 0, 0);
+                if (m_valid && window.getMinPoint()==m_window.getMinPoint()+step && window.getMaxPoint()==m_window.getMaxPoint()+step) slide(window);
+                else compute(window);
+            }
+
+            /**
+             * Forgets the current window, so that the next update computes the RLMs from the whole window.
+             */
+            void reset()
+            {
+                m_valid = false;
+            }
+
+            /**
+             * Returns the RLM of the current window for the specified offset.
+             * As with RlmHelper, the number of columns is one plus the longest run.
+             */
+            RunLengthMatrix getRlm(int offsetIndex) const
+            {
+                const vnl_matrix<double> &counts = m_states[offsetIndex].counts;
+                int maxRunLength = counts.cols() - 1;
+                while (maxRunLength > 0 && counts.get_column(maxRunLength).is_zero()) maxRunLength--;
+
+                RunLengthMatrix rlm;
+                rlm.setSize(m_numGraylevels, maxRunLength);
+                rlm.getMatrix() = counts.extract(counts.rows(), maxRunLength + 1);
+                return rlm;
+            }
+
+            /**
+             * See PointRlmFilter::debug_useOldBinCounting.
+             */
+            void debug_useOldBinCounting()
+            {
+                m_useOldBinCounting = true;
+                m_valid = false;
+            }
+
+        protected:
+            struct Run
+            {
+                int bin;
+                int length;
+
+                Run(int b, int l)
+                {
+                    bin = b;
+                    length = l;
+                }
+            };
+
+            typedef std::deque<Run>                                         Chain;
+            typedef std::unordered_map<Point3D<int>, Chain, PointHash>      ChainMap;
+
+            struct OffsetState
+            {
+                PointIndexObject direction;     // Offset with a positive x component, or in the yz plane
+                ChainMap chains;                // Runs of each chain, by chain key (only for a positive x component)
+                vnl_matrix<double> counts;      // Number of runs by bin and length, with enough columns for the longest possible run
+
+                OffsetState(const PointIndexObject &d)
+                {
+                    direction = d;
+                }
+            };
+
+            ImagePointerType                        m_image;
+            int                                     m_numGraylevels;
+            bool                                    m_useOldBinCounting;
+
+            // State of the current window
+            bool                                    m_valid;
+            Region3D<int>                           m_window;
+            std::map<double, long>                  m_values;       // Number of voxels of the window with each value
+            std::vector<OffsetState>                m_states;
+            double                                  m_minValue, m_maxValue;
+
+            int getBin(long index) const
+            {
+                return RlmHelper::GetBinNumber(m_image->get(index), m_minValue, m_maxValue, m_numGraylevels, m_useOldBinCounting);
+            }
+
+            /**
+             * Returns the point of the chain through p with 0 <= x < direction.x(), which identifies the chain.
+             */
+            static Point3D<int> getChainKey(const Point3D<int> &p, const Point3D<int> &direction)
+            {
+                int dx = direction.x();
+                int k = p.x()>=0 ? p.x()/dx : -((dx-1-p.x())/dx);
+                return Point3D<int>(p.x() - k*dx, p.y() - k*direction.y(), p.z() - k*direction.z());
+            }
+
+            void updateValues(const Region3D<int> &window, int x, long change)
+            {
+                const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                {
+                    double value = m_image->get(m_image->toIndex(x, y, z));
+                    long &count = m_values[value];
+                    count += change;
+                    if (count==0) m_values.erase(value);
+                }
+            }
+
+            void compute(const Region3D<int> &window)
+            {
+                m_window = window;
+                m_values.clear();
+                const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                for (int x = minp.x(); x <= maxp.x(); x++) updateValues(window, x, 1);
+                computeRuns();
+                m_valid = true;
+            }
+
+            /**
+             * Computes the runs of the current window from scratch with the bins of its range of values.
+             */
+            void computeRuns()
+            {
+                m_minValue = m_values.begin()->first;
+                m_maxValue = m_values.rbegin()->first;
+
+                const Point3D<int> &minp = m_window.getMinPoint(), &maxp = m_window.getMaxPoint();
+                Point3D<int> size = maxp - minp;
+                int maxChainLength = std::max(size.x(), std::max(size.y(), size.z())) + 1;
+
+                for (auto state = m_states.begin(); state != m_states.end(); state++)
+                {
+                    state->counts.set_size(m_numGraylevels, maxChainLength + 1);
+                    state->counts.fill(0);
+                    state->chains.clear();
+                    for (int x = minp.x(); x <= maxp.x(); x++) addSlabChains(*state, m_window, x, 1, state->direction.point.x()>0);
+                }
+            }
+
+            /**
+             * Adds (or removes) the runs of the chains of window that start in the slab at x.
+             * If store is true, the runs are also kept by chain.
+             */
+            void addSlabChains(OffsetState &state, const Region3D<int> &window, int x, int change, bool store)
+            {
+                const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                const PointIndexObject &d = state.direction;
+                for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                {
+                    Point3D<int> p(x, y, z);
+                    if (window.contain(p - d.point)) continue;
+
+                    Chain *chain = store ? &state.chains[getChainKey(p, d.point)] : NULL;
+                    long index = m_image->toIndex(p);
+                    int bin = getBin(index), length = 1;
+                    for (p += d.point, index += d.index; window.contain(p); p += d.point, index += d.index)
+                    {
+                        int nextBin = getBin(index);
+                        if (nextBin==bin)
+                        {
+                            length++;
+                            continue;
+                        }
+                        state.counts(bin, length) += change;
+                        if (chain) chain->push_back(Run(bin, length));
+                        bin = nextBin;
+                        length = 1;
+                    }
+                    state.counts(bin, length) += change;
+                    if (chain) chain->push_back(Run(bin, length));
+                }
+            }
+
+            void slide(const Region3D<int> &window)
+            {
+                const Region3D<int> oldWindow = m_window;
+                int leavingX = oldWindow.getMinPoint().x(), enteringX = window.getMaxPoint().x();
+
+                updateValues(oldWindow, leavingX, -1);
+                updateValues(window, enteringX, 1);
+                m_window = window;
+
+                // The bins only stay the same if the range of values does
+                if (m_values.begin()->first!=m_minValue || m_values.rbegin()->first!=m_maxValue)
+                {
+                    computeRuns();
+                    return;
+                }
+
+                for (auto state = m_states.begin(); state != m_states.end(); state++)
+                {
+                    if (state->direction.point.x()==0)
+                    {
+                        addSlabChains(*state, oldWindow, leavingX, -1, false);
+                        addSlabChains(*state, window, enteringX, 1, false);
+                        continue;
+                    }
+
+                    const Point3D<int> &minp = window.getMinPoint(), &maxp = window.getMaxPoint();
+                    for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                    {
+                        // The leaving voxel shortens the first run of its chain
+                        Point3D<int> leaving(leavingX, y, z);
+                        typename ChainMap::iterator chain = state->chains.find(getChainKey(leaving, state->direction.point));
+                        Run &first = chain->second.front();
+                        state->counts(first.bin, first.length)--;
+                        if (--first.length > 0) state->counts(first.bin, first.length)++;
+                        else chain->second.pop_front();
+                        if (chain->second.empty()) state->chains.erase(chain);
+                    }
+                    for (int z = minp.z(); z <= maxp.z(); z++) for (int y = minp.y(); y <= maxp.y(); y++)
+                    {
+                        // The entering voxel extends the last run of its chain or starts a new one
+                        Point3D<int> entering(enteringX, y, z);
+                        Chain &chain = state->chains[getChainKey(entering, state->direction.point)];
+                        int bin = getBin(m_image->toIndex(entering));
+                        if (!chain.empty() && chain.back().bin==bin)
+                        {
+                            Run &last = chain.back();
+                            state->counts(bin, last.length)--;
+                            state->counts(bin, ++last.length)++;
+                        }
+                        else
+                        {
+                            chain.push_back(Run(bin, 1));
+                            state->counts(bin, 1)++;
+                        }
+                    }
+                }
+            }
+        };
+    }
+}
+
+#endif
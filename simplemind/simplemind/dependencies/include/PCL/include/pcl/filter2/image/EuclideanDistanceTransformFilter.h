@@ -8,6 +8,8 @@
 #include <pcl/math.h>
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <boost/numeric/conversion/bounds.hpp>
+#include <thread>
+#include <vector>
 
 namespace pcl
 {
@@ -16,6 +18,8 @@ namespace pcl
 		/**
 			Reference: C. R. Maurer, Jr., R. Qi, and V. Raghavan, "A Linear Time Algorithm for Computing Exact Euclidean Distance Transforms of Binary Images in Arbitrary Dimensions", IEEE - Transactions on Pattern Analysis and Machine Intelligence, 25(2): 265-270, 2003. 
 			Note: Foreground is where input is larger than 0
+			Note: The 1D voronoi passes along each dimension are independent per line and are split over setNumberOfThreads() threads
+			Note: With setNumberOfDimensions(2) only the x and y passes are applied, giving the 2D distance transform of each slice
 		**/
 		template <class BoundaryType, class OutputImageType>
 		class EuclideanDistanceTransformFilter: public ImageFilterBase
@@ -23,10 +27,12 @@ namespace pcl
 		public:
 			typedef typename OutputImageType::IoValueType OutputValueType;
 			
-			static typename OutputImageType::Pointer Compute(const BoundaryType& input, bool is_signed, bool use_square_distance, bool use_spacing, const Region3D<int>& output_region=Region3D<int>().reset())
+			static typename OutputImageType::Pointer Compute(const BoundaryType& input, bool is_signed, bool use_square_distance, bool use_spacing, const Region3D<int>& output_region=Region3D<int>().reset(), int num_threads=1, int num_dimensions=3)
 			{
 				EuclideanDistanceTransformFilter filter;
 				filter.setOutputRegion(output_region);
+				filter.setNumberOfThreads(num_threads);
+				filter.setNumberOfDimensions(num_dimensions);
 				filter.setIsSigned(is_signed);
 				filter.setUseSquareDistance(use_square_distance);
 				filter.setUseSpacing(use_spacing);
@@ -36,7 +42,21 @@ namespace pcl
 			}
 
 
-			EuclideanDistanceTransformFilter() {}
+			EuclideanDistanceTransformFilter() 
+			{
+				m_NumberOfThreads = 1;
+				m_NumberOfDimensions = 3;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
+
+			void setNumberOfDimensions(int num)
+			{
+				m_NumberOfDimensions = num<1 ? 1 : (num>3 ? 3 : num);
+			}
 
 			void setUseSpacing(bool en)
 			{
@@ -70,15 +90,30 @@ namespace pcl
 
 				//Actual computation
 				const int dimension = 3;
-				for (int d=0; d<dimension; ++d) {
+				for (int d=0; d<m_NumberOfDimensions; ++d) {
 					int cur_dim[dimension-1];
 					for (int c=0, i=0; i<dimension; ++i) if (i!=d) {
 						cur_dim[c] = i+1;
 						++c;
 					}
 					ImageIterator iter(m_Output, ImageIterator::Axis(cur_dim[0]), ImageIterator::Axis(cur_dim[1]));
-					pcl_ForIterator(iter) {
-						voronoi(d, iter);
+					if (m_NumberOfThreads<=1) {
+						pcl_ForIterator(iter) {
+							voronoi(d, iter);
+						}
+					} else {
+						std::vector<long> line_start;
+						pcl_ForIterator(iter) line_start.push_back(iter);
+						int num_threads = std::min<int>(m_NumberOfThreads, line_start.size());
+						std::vector<std::thread> workers;
+						for (int t=0; t<num_threads; ++t) {
+							size_t begin = line_start.size()*t/num_threads,
+								end = line_start.size()*(t+1)/num_threads;
+							workers.push_back(std::thread([this, d, begin, end, &line_start]() {
+								for (size_t i=begin; i<end; ++i) voronoi(d, line_start[i]);
+							}));
+						}
+						pcl_ForEach(workers, w) w->join();
 					}
 				}
 
@@ -129,6 +164,8 @@ namespace pcl
 			bool m_UseSpacing;
 			bool m_UseSquareDistance;
 			bool m_IsSigned;
+			int m_NumberOfThreads;
+			int m_NumberOfDimensions;
 
 			inline bool remove( OutputValueType d1, OutputValueType d2, OutputValueType df, OutputValueType x1, OutputValueType x2, OutputValueType xf )
 			{
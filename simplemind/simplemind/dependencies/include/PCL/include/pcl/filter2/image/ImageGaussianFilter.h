@@ -4,17 +4,23 @@
 #include <pcl/misc/GaussKernel1DGenerator.h>
 #include <pcl/filter2/image/ImageFilterBase.h>
 #include <pcl/filter2/image/ImageSeparableFilter.h>
+#include <pcl/filter2/image/ImageLineFilterHelper.h>
 
 namespace pcl
 {
 	namespace filter2
 	{
 
+		/**
+			Note: The passes are split over setNumberOfThreads() threads (see ImageSeparableFilter)
+			Note: With setRecursiveMinimumSigma(s), s>0, axes whose sigma (in voxels) is at least s use the recursive Gaussian of ImageRecursiveGaussianLineFilter,
+			whose cost does not depend on sigma, instead of a kernel truncated to the max kernel width
+		**/
 		template <class BoundaryType, class OutputImageType>
 		class ImageGaussianFilter: public ImageFilterBase
 		{
 		public:
-			static typename OutputImageType::Pointer Compute(const BoundaryType& input, double sigmax, double sigmay, double sigmaz, bool use_image_spacing, int max_kernel_width, double cutoff, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset())
+			static typename OutputImageType::Pointer Compute(const BoundaryType& input, double sigmax, double sigmay, double sigmaz, bool use_image_spacing, int max_kernel_width, double cutoff, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset(), int num_threads=1)
 			{
 				ImageGaussianFilter filter;
 				filter.setInput(input);
@@ -23,17 +29,19 @@ namespace pcl
 				filter.setMaxKernelWidth(max_kernel_width);
 				filter.setKernelCutoff(cutoff);
 				filter.setOutputRegion(output_region);
+				filter.setNumberOfThreads(num_threads);
 				filter.update();
 				return filter.getOutput();
 			}
 
-			static typename OutputImageType::Pointer Compute(const BoundaryType& input, double sigmax, double sigmay, double sigmaz, bool use_image_spacing, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset())
+			static typename OutputImageType::Pointer Compute(const BoundaryType& input, double sigmax, double sigmay, double sigmaz, bool use_image_spacing, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset(), int num_threads=1)
 			{
 				ImageGaussianFilter filter;
 				filter.setInput(input);
 				filter.setSigma(sigmax, sigmay, sigmaz);
 				filter.setUseImageSpacing(use_image_spacing);
 				filter.setOutputRegion(output_region);
+				filter.setNumberOfThreads(num_threads);
 				filter.update();
 				return filter.getOutput();
 			}
@@ -45,6 +53,19 @@ namespace pcl
 				m_UseImageSpacing = true;
 				m_MaxKernelWidth = 33;
 				m_KernelCutoff = 0.0001;
+				m_NumberOfThreads = 1;
+				m_RecursiveMinimumSigma = 0;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
+
+			//0 disables the recursive Gaussian
+			void setRecursiveMinimumSigma(double sigma)
+			{
+				m_RecursiveMinimumSigma = sigma;
 			}
 
 			void setInput(const BoundaryType& input)
@@ -90,6 +111,19 @@ namespace pcl
 					}
 				}
 
+				bool use_recursive = false;
+				if (m_RecursiveMinimumSigma>0 && this->m_OutputRegion.empty()) {
+					for (int i=0; i<3; i++) if (sigma[i]>=m_RecursiveMinimumSigma) use_recursive = true;
+				}
+				if (use_recursive) {
+					m_Output.reset();
+					for (int i=0; i<3; i++) if (sigma[i]>0) {
+						if (!m_Output) applyAxis(m_Input, i, sigma[i]);
+						else applyAxis(ZeroFluxBoundary<OutputImageType>(m_Output), i, sigma[i]);
+					}
+					return;
+				}
+
 				//Computing the kernel
 				std::vector<misc::GaussianKernel1DGenerator::KernelType::Pointer> kernels;
 				kernels.reserve(3);
@@ -99,7 +133,7 @@ namespace pcl
 				}
 				
 				//Actual processing
-				m_Output = ImageSeparableFilter<BoundaryType, misc::GaussianKernel1DGenerator::KernelType, OutputImageType>::Compute(m_Input, kernels, this->m_OutputRegion);
+				m_Output = ImageSeparableFilter<BoundaryType, misc::GaussianKernel1DGenerator::KernelType, OutputImageType>::Compute(m_Input, kernels, this->m_OutputRegion, m_NumberOfThreads);
 			}
 
 			typename OutputImageType::Pointer getOutput()
@@ -114,6 +148,22 @@ namespace pcl
 			bool m_UseImageSpacing;
 			double m_KernelCutoff;
 			int m_MaxKernelWidth;
+			int m_NumberOfThreads;
+			double m_RecursiveMinimumSigma;
+
+			template <class InputBoundaryType>
+			void applyAxis(const InputBoundaryType& input, int axis, double sigma)
+			{
+				typename OutputImageType::Pointer output = OutputImageType::New(input.getImage());
+				if (sigma>=m_RecursiveMinimumSigma) {
+					ImageLineFilterHelper::Apply(input, output, axis, ImageRecursiveGaussianLineFilter(sigma), m_NumberOfThreads);
+				} else {
+					misc::GaussianKernel1DGenerator kernel_gen;
+					ImageKernelLineFilter line_filter(kernel_gen.getKernel((misc::GaussianKernel1DGenerator::Axis) axis, sigma, m_KernelCutoff, (m_MaxKernelWidth-1)/2), axis);
+					ImageLineFilterHelper::Apply(input, output, axis, line_filter, m_NumberOfThreads);
+				}
+				m_Output = output;
+			}
 		};
 
 	}
@@ -0,0 +1,439 @@
+#ifndef PCL2_IMAGE_HESSIAN_FILTER
+#define PCL2_IMAGE_HESSIAN_FILTER
+
+#include <pcl/misc/GaussKernel1DGenerator.h>
+#include <pcl/filter2/image/ImageFilterBase.h>
+#include <pcl/filter2/image/ImageLineFilterHelper.h>
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/constant.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace pcl
+{
+	namespace filter2
+	{
+
+		/**
+			Second derivatives (the six elements of the Hessian) of a whole image, smoothed by a Gaussian of standard deviation sigma.
+			Each derivative is a central difference (as DerivativeKernelGenerator, so with sigma<=0 and without spacing the results are those of PointHessianFilter)
+			of the smoothed image; the kernels are folded into one 1D kernel per axis and order.
+			The separable passes are shared: the x pass gives the smoothed image and its first and second differences along x, the y pass turns them into the 6
+			products needed, and the z pass completes the 6 derivatives (15 line passes with ImageLineFilterHelper, split over setNumberOfThreads() threads).
+			Note: With setUseImageSpacing(true) (default) sigma is in physical units and the derivatives are per squared physical unit
+		**/
+		template <class BoundaryType, class OutputImageType>
+		class ImageHessianFilter: public ImageFilterBase
+		{
+		public:
+			enum
+			{
+				D_XX = 0,
+				D_YY = 1,
+				D_ZZ = 2,
+				D_XY = 3,
+				D_XZ = 4,
+				D_YZ = 5
+			};
+
+			ImageHessianFilter()
+			{
+				m_Sigma = 1;
+				m_UseImageSpacing = true;
+				m_MaxKernelWidth = 33;
+				m_KernelCutoff = 0.0001;
+				m_NumberOfThreads = 1;
+			}
+
+			void setInput(const BoundaryType& input)
+			{
+				m_Input = input;
+			}
+
+			void setSigma(double sigma)
+			{
+				m_Sigma = sigma;
+			}
+
+			void setUseImageSpacing(bool stat)
+			{
+				m_UseImageSpacing = stat;
+			}
+
+			void setMaxKernelWidth(int width)
+			{
+				m_MaxKernelWidth = width;
+			}
+
+			void setKernelCutoff(double cutoff)
+			{
+				m_KernelCutoff = cutoff;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
+
+			void update()
+			{
+				if (!this->m_OutputRegion.empty()) pcl_ThrowException(Exception(), "ImageHessianFilter computes the whole image, the output region must not be set");
+
+				//Kernels of order 0, 1 and 2 along x, y and z (filter[3*axis+order])
+				std::vector<ImageKernelLineFilter> filter;
+				filter.reserve(9);
+				for (int axis=0; axis<3; ++axis) {
+					double spacing = m_UseImageSpacing ? m_Input.getImage()->getSpacing()[axis] : 1;
+					std::vector<double> weights[3];
+					int margin = getKernels(m_Sigma/spacing, weights);
+					for (int i=0; i<weights[1].size(); ++i) weights[1][i] /= spacing;
+					for (int i=0; i<weights[2].size(); ++i) weights[2][i] /= spacing*spacing;
+					filter.push_back(ImageKernelLineFilter(weights[0], margin-1));
+					filter.push_back(ImageKernelLineFilter(weights[1], margin));
+					filter.push_back(ImageKernelLineFilter(weights[2], margin));
+				}
+
+				//x pass
+				typename OutputImageType::Pointer x[3];
+				for (int i=0; i<3; ++i) x[i] = pass(m_Input, 0, filter[i]);
+
+				//y pass (smoothed along x and y, x then y order)
+				typename OutputImageType::Pointer x0y0 = pass(ZeroFluxBoundary<OutputImageType>(x[0]), 1, filter[3]),
+					x0y1 = pass(ZeroFluxBoundary<OutputImageType>(x[0]), 1, filter[4]),
+					x0y2 = pass(ZeroFluxBoundary<OutputImageType>(x[0]), 1, filter[5]);
+				x[0].reset();
+				typename OutputImageType::Pointer x1y0 = pass(ZeroFluxBoundary<OutputImageType>(x[1]), 1, filter[3]),
+					x1y1 = pass(ZeroFluxBoundary<OutputImageType>(x[1]), 1, filter[4]);
+				x[1].reset();
+				typename OutputImageType::Pointer x2y0 = pass(ZeroFluxBoundary<OutputImageType>(x[2]), 1, filter[3]);
+				x[2].reset();
+
+				//z pass
+				m_Output[D_XX] = pass(ZeroFluxBoundary<OutputImageType>(x2y0), 2, filter[6]);
+				m_Output[D_YY] = pass(ZeroFluxBoundary<OutputImageType>(x0y2), 2, filter[6]);
+				m_Output[D_ZZ] = pass(ZeroFluxBoundary<OutputImageType>(x0y0), 2, filter[8]);
+				m_Output[D_XY] = pass(ZeroFluxBoundary<OutputImageType>(x1y1), 2, filter[6]);
+				m_Output[D_XZ] = pass(ZeroFluxBoundary<OutputImageType>(x1y0), 2, filter[7]);
+				m_Output[D_YZ] = pass(ZeroFluxBoundary<OutputImageType>(x0y1), 2, filter[7]);
+			}
+
+			typename OutputImageType::Pointer getOutput(int i)
+			{
+				return m_Output[i];
+			}
+
+		protected:
+			BoundaryType m_Input;
+			typename OutputImageType::Pointer m_Output[6];
+			double m_Sigma;
+			bool m_UseImageSpacing;
+			double m_KernelCutoff;
+			int m_MaxKernelWidth;
+			int m_NumberOfThreads;
+
+			template <class InputBoundaryType>
+			typename OutputImageType::Pointer pass(const InputBoundaryType& input, int axis, const ImageKernelLineFilter& filter)
+			{
+				typename OutputImageType::Pointer output = OutputImageType::New(input.getImage());
+				ImageLineFilterHelper::Apply(input, output, axis, filter, m_NumberOfThreads);
+				return output;
+			}
+
+			//Sets the weights of the smoothing kernel (offsets -margin+1 to margin-1) and of the first and second differences of the smoothed image (offsets -margin to margin), returns margin
+			int getKernels(double sigma, std::vector<double>* weights)
+			{
+				std::vector<double> gauss(1, 1);
+				if (sigma>0) {
+					misc::GaussianKernel1DGenerator kernel_gen;
+					misc::GaussianKernel1DGenerator::KernelType::Pointer kernel = kernel_gen.getKernel(misc::GaussianKernel1DGenerator::X, sigma, m_KernelCutoff, (m_MaxKernelWidth-1)/2);
+					gauss.clear();
+					for (int i=kernel->getMinPoint().x(); i<=kernel->getMaxPoint().x(); ++i) gauss.push_back(kernel->get(i,0,0));
+				}
+				int margin = (int)gauss.size()/2 + 1;
+				//Smoothing kernel padded with two zeros on each side, so that g(o) is at padded[o+margin+1]
+				std::vector<double> padded(2*margin+3, 0);
+				std::copy(gauss.begin(), gauss.end(), padded.begin()+2);
+				weights[0] = gauss;
+				weights[1].assign(2*margin+1, 0);
+				weights[2].assign(2*margin+1, 0);
+				for (int i=0; i<2*margin+1; ++i) {
+					//Offset i-margin: g(o-1) at padded[i], g(o) at padded[i+1], g(o+1) at padded[i+2]
+					weights[1][i] = (padded[i]-padded[i+2])/2;
+					weights[2][i] = padded[i] - 2*padded[i+1] + padded[i+2];
+				}
+				return margin;
+			}
+		};
+
+
+		/**
+			Shape measures from the eigenvalues of the Hessian (e.g. from ImageHessianFilter) at each voxel, |l1|<=|l2|<=|l3|:
+			- Plateness: sheetness of Descoteaux et al. (MICCAI 2005), exp(-Ra^2/2a^2) (1-exp(-Rc^2/2b^2)) (1-exp(-S^2/2c^2)), where Ra = |l2|/|l3|, Rc = |2|l3|-|l2|-|l1||/|l3|
+			- Vesselness: vesselness of Frangi et al. (MICCAI 1998), (1-exp(-Ra^2/2a^2)) exp(-Rb^2/2b^2) (1-exp(-S^2/2c^2)), where Rb = |l1|/sqrt(|l2 l3|)
+			- Blobness: (1-exp(-Rb^2/2b^2)) (1-exp(-S^2/2c^2))
+			- PlanePlateness: sum over the xy, xz and yz planes of the 2D line measure of the in-plane Hessian, exp(-Rb^2/2b^2) (1-exp(-S^2/2c^2)) where Rb = |l1|/|l2|,
+			  as plates cross each plane as lines (0 to 3)
+			S is the Frobenius norm of the Hessian (of the 2D Hessian for PlanePlateness); a, b and c are set by setAlpha, setBeta and setStructureness.
+			c defaults to half the largest norm in the image: of the 3D Hessian for the 3D measures, and of the 2D Hessian of each plane orientation
+			for PlanePlateness (one c per plane orientation, rather than the c of the 3D Hessian).
+			The measures are 0 where the structure has the wrong polarity (bright structures have negative eigenvalues, see setBrightObject).
+			Note: The eigenvalues are computed in closed form (trigonometric solution of the characteristic cubic) on blocks of voxels, split over setNumberOfThreads() threads
+			Note: The six Hessian images must have the same region
+		**/
+		template <class HessianImageType, class OutputImageType>
+		class ImageHessianShapeFilter: public ImageFilterBase
+		{
+		public:
+			enum
+			{
+				Plateness = 1,
+				Vesselness = 2,
+				Blobness = 4,
+				PlanePlateness = 8
+			};
+
+			ImageHessianShapeFilter()
+			{
+				m_Measures = Plateness|Vesselness|Blobness;
+				m_Alpha = 0.5;
+				m_Beta = 0.5;
+				m_Structureness = 0;
+				m_BrightObject = true;
+				m_NumberOfThreads = 1;
+			}
+
+			//Images in the order of ImageHessianFilter (xx, yy, zz, xy, xz, yz)
+			void setInput(const typename HessianImageType::ConstantPointer* hessian)
+			{
+				for (int i=0; i<6; ++i) m_Input[i] = hessian[i];
+			}
+			void setInput(int i, const typename HessianImageType::ConstantPointer& img)
+			{
+				m_Input[i] = img;
+			}
+
+			//Combination of Plateness, Vesselness, Blobness and PlanePlateness
+			void setMeasures(int measures)
+			{
+				m_Measures = measures;
+			}
+
+			void setAlpha(double val)
+			{
+				m_Alpha = val;
+			}
+
+			void setBeta(double val)
+			{
+				m_Beta = val;
+			}
+
+			//c of the measures, <=0 for half the largest norm of the Hessian (of each plane orientation for PlanePlateness)
+			void setStructureness(double val)
+			{
+				m_Structureness = val;
+			}
+
+			void setBrightObject(bool stat)
+			{
+				m_BrightObject = stat;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
+
+			void update()
+			{
+				if (!this->m_OutputRegion.empty()) pcl_ThrowException(Exception(), "ImageHessianShapeFilter computes the whole image, the output region must not be set");
+				for (int i=0; i<4; ++i) {
+					if (m_Measures&(1<<i)) m_Output[i] = OutputImageType::New(m_Input[0]);
+					else m_Output[i].reset();
+				}
+				const Point3D<int>& size = m_Input[0]->getSize();
+				long n = (long)size.x()*size.y()*size.z();
+
+				//c of the 3D Hessian, then of the xy, xz and yz planes
+				double c[4] = {m_Structureness, m_Structureness, m_Structureness, m_Structureness};
+				if (m_Structureness<=0) {
+					long num_threads = std::max<long>(1, std::min<long>(m_NumberOfThreads, n));
+					std::vector<double> max_norm(4*num_threads, 0);
+					run(n, num_threads, [this, &max_norm](int t, long begin, long end) {
+						double* thread_max = &max_norm[4*t];
+						for (long i=begin; i<end; ++i) {
+							double xx = m_Input[0]->get(i), yy = m_Input[1]->get(i), zz = m_Input[2]->get(i),
+								xy = m_Input[3]->get(i), xz = m_Input[4]->get(i), yz = m_Input[5]->get(i);
+							thread_max[0] = std::max(thread_max[0], xx*xx + yy*yy + zz*zz + 2*(xy*xy + xz*xz + yz*yz));
+							thread_max[1] = std::max(thread_max[1], xx*xx + yy*yy + 2*xy*xy);
+							thread_max[2] = std::max(thread_max[2], xx*xx + zz*zz + 2*xz*xz);
+							thread_max[3] = std::max(thread_max[3], yy*yy + zz*zz + 2*yz*yz);
+						}
+					});
+					for (int k=0; k<4; ++k) {
+						double max_val = 0;
+						for (long t=0; t<num_threads; ++t) max_val = std::max(max_val, max_norm[4*t+k]);
+						c[k] = sqrt(max_val)/2;
+						if (c[k]<=0) c[k] = 1;
+					}
+				}
+				m_Factor[0] = -1/(2*m_Alpha*m_Alpha);
+				m_Factor[1] = -1/(2*m_Beta*m_Beta);
+				m_Factor[2] = -1/(2*c[0]*c[0]);
+				for (int k=0; k<3; ++k) m_PlaneFactor[k] = -1/(2*c[k+1]*c[k+1]);
+
+				run(n, std::max<long>(1, std::min<long>(m_NumberOfThreads, n)), [this](int t, long begin, long end) {
+					for (long i=begin; i<end; i+=BlockSize) computeBlock(i, std::min<long>(end-i, BlockSize));
+				});
+			}
+
+			typename OutputImageType::Pointer getPlateness()
+			{
+				return m_Output[0];
+			}
+
+			typename OutputImageType::Pointer getVesselness()
+			{
+				return m_Output[1];
+			}
+
+			typename OutputImageType::Pointer getBlobness()
+			{
+				return m_Output[2];
+			}
+
+			typename OutputImageType::Pointer getPlanePlateness()
+			{
+				return m_Output[3];
+			}
+
+			//Eigenvalues of a symmetric 3x3 matrix sorted by absolute value as PointEigenAnalysisFilter (ties by value)
+			static inline void ComputeEigenvalues(double m11, double m22, double m33, double m12, double m13, double m23, double& l1, double& l2, double& l3)
+			{
+				double q = (m11 + m22 + m33)/3,
+					a11 = m11-q, a22 = m22-q, a33 = m33-q,
+					p2 = (a11*a11 + a22*a22 + a33*a33 + 2*(m12*m12 + m13*m13 + m23*m23))/6,
+					p = sqrt(p2),
+					inv_p = p>0 ? 1/p : 0,
+					b11 = a11*inv_p, b22 = a22*inv_p, b33 = a33*inv_p,
+					b12 = m12*inv_p, b13 = m13*inv_p, b23 = m23*inv_p,
+					r = (b11*(b22*b33 - b23*b23) - b12*(b12*b33 - b23*b13) + b13*(b12*b23 - b22*b13))/2;
+				r = std::max(-1.0, std::min(1.0, r));
+				double phi = acos(r)/3;
+				l1 = q + 2*p*cos(phi);
+				l3 = q + 2*p*cos(phi + 2*pcl::PI/3);
+				l2 = 3*q - l1 - l3;
+				SortByMagnitude(l1, l2);
+				SortByMagnitude(l2, l3);
+				SortByMagnitude(l1, l2);
+			}
+
+		protected:
+			enum { BlockSize = 256 };
+
+			typename HessianImageType::ConstantPointer m_Input[6];
+			typename OutputImageType::Pointer m_Output[4];
+			int m_Measures;
+			double m_Alpha, m_Beta, m_Structureness;
+			double m_Factor[3]; //-1/2a^2, -1/2b^2 and -1/2c^2 of the 3D measures
+			double m_PlaneFactor[3]; //-1/2c^2 of the xy, xz and yz planes
+			bool m_BrightObject;
+			int m_NumberOfThreads;
+
+			static inline void SortByMagnitude(double& a, double& b)
+			{
+				double fa = fabs(a), fb = fabs(b);
+				if (fa>fb || (fa==fb && a>b)) std::swap(a, b);
+			}
+
+			template <class Func>
+			static void run(long n, long num_threads, Func func)
+			{
+				if (num_threads<=1) func(0, 0, n);
+				else {
+					std::vector<std::thread> workers;
+					for (int t=0; t<num_threads; ++t) {
+						long begin = n*t/num_threads,
+							end = n*(t+1)/num_threads;
+						workers.push_back(std::thread(func, t, begin, end));
+					}
+					pcl_ForEach(workers, w) w->join();
+				}
+			}
+
+			//Voxels start to start+num-1, loaded into arrays so that each step is a loop over the block
+			void computeBlock(long start, long num)
+			{
+				double m[6][BlockSize], l[3][BlockSize], result[BlockSize];
+				double sign = m_BrightObject ? 1 : -1;
+				for (int k=0; k<6; ++k) for (long i=0; i<num; ++i) m[k][i] = sign*m_Input[k]->get(start+i);
+
+				//3D measures, with the eigenvalues of bright structures negative
+				if (m_Measures&(Plateness|Vesselness|Blobness)) {
+					for (long i=0; i<num; ++i) ComputeEigenvalues(m[0][i], m[1][i], m[2][i], m[3][i], m[4][i], m[5][i], l[0][i], l[1][i], l[2][i]);
+					if (m_Measures&Plateness) {
+						for (long i=0; i<num; ++i) {
+							double a1 = fabs(l[0][i]), a2 = fabs(l[1][i]), a3 = fabs(l[2][i]),
+								inv_a3 = a3>0 ? 1/a3 : 0,
+								ra = a2*inv_a3, rc = (2*a3 - a2 - a1)*inv_a3,
+								s2 = a1*a1 + a2*a2 + a3*a3;
+							double val = exp(m_Factor[0]*ra*ra) * (1-exp(m_Factor[1]*rc*rc)) * (1-exp(m_Factor[2]*s2));
+							result[i] = l[2][i]<0 ? val : 0;
+						}
+						store(0, start, num, result);
+					}
+					if (m_Measures&Vesselness) {
+						for (long i=0; i<num; ++i) {
+							double a1 = fabs(l[0][i]), a2 = fabs(l[1][i]), a3 = fabs(l[2][i]),
+								ra = a3>0 ? a2/a3 : 0, a23 = a2*a3, rb2 = a23>0 ? a1*a1/a23 : 0,
+								s2 = a1*a1 + a2*a2 + a3*a3;
+							double val = (1-exp(m_Factor[0]*ra*ra)) * exp(m_Factor[1]*rb2) * (1-exp(m_Factor[2]*s2));
+							result[i] = (l[1][i]<0 && l[2][i]<0) ? val : 0;
+						}
+						store(1, start, num, result);
+					}
+					if (m_Measures&Blobness) {
+						for (long i=0; i<num; ++i) {
+							double a1 = fabs(l[0][i]), a2 = fabs(l[1][i]), a3 = fabs(l[2][i]),
+								a23 = a2*a3, rb2 = a23>0 ? a1*a1/a23 : 0,
+								s2 = a1*a1 + a2*a2 + a3*a3;
+							double val = (1-exp(m_Factor[1]*rb2)) * (1-exp(m_Factor[2]*s2));
+							result[i] = (l[0][i]<0 && l[1][i]<0 && l[2][i]<0) ? val : 0;
+						}
+						store(2, start, num, result);
+					}
+				}
+
+				//2D line measure in the xy (xx, yy, xy), xz (xx, zz, xz) and yz (yy, zz, yz) planes
+				if (m_Measures&PlanePlateness) {
+					const int plane[3][3] = {{0,1,3}, {0,2,4}, {1,2,5}};
+					for (long i=0; i<num; ++i) result[i] = 0;
+					for (int k=0; k<3; ++k) {
+						const double *a = m[plane[k][0]], *d = m[plane[k][1]], *b = m[plane[k][2]];
+						for (long i=0; i<num; ++i) {
+							double mean = (a[i]+d[i])/2, half_diff = (a[i]-d[i])/2,
+								root = sqrt(half_diff*half_diff + b[i]*b[i]),
+								u1 = mean+root, u2 = mean-root;
+							double small = fabs(u1)<fabs(u2) ? u1 : u2, large = fabs(u1)<fabs(u2) ? u2 : u1;
+							double rb = large!=0 ? small/large : 0, s2 = u1*u1 + u2*u2;
+							double val = exp(m_Factor[1]*rb*rb) * (1-exp(m_PlaneFactor[k]*s2));
+							result[i] += large<0 ? val : 0;
+						}
+					}
+					store(3, start, num, result);
+				}
+			}
+
+			void store(int output, long start, long num, const double* result)
+			{
+				typename OutputImageType::Pointer& img = m_Output[output];
+				for (long i=0; i<num; ++i) img->set(start+i, result[i]);
+			}
+		};
+
+	}
+}
+
+#endif
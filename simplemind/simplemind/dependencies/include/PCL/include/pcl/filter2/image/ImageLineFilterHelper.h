@@ -0,0 +1,296 @@
+#ifndef PCL2_IMAGE_LINE_FILTER_HELPER
+#define PCL2_IMAGE_LINE_FILTER_HELPER
+
+#include <pcl/image.h>
+#include <math.h>
+#include <algorithm>
+#include <complex>
+#include <thread>
+#include <vector>
+
+namespace pcl
+{
+	namespace filter2
+	{
+
+		/**
+			Applies a 1D filter to every line of an image along one axis (one pass of a separable filter).
+			Lines along x are contiguous and are filtered one at a time. Lines along y and z are filtered in tiles of TileWidth lines that are neighbors along x,
+			copied transposed (position along the axis major, line minor) so that the filter loops run over contiguous memory and are vectorized by the compiler,
+			and the image is read a row segment at a time instead of one voxel per row.
+			The lines (or tiles) are split over num_threads threads.
+			Note: A LineFilter provides getMarginBefore() and getMarginAfter(), the number of voxels it needs before and after a line (read from the boundary),
+			getScratchSize(length, lanes), the number of doubles of working memory it needs,
+			and apply(in, out, length, lanes, scratch), which filters lanes interleaved lines: in[(i+margin_before)*lanes+l] is voxel i of line l (i from -margin_before to
+			length+margin_after-1) and out[i*lanes+l] receives the result of voxel i. apply() is called concurrently from the threads, each with its own buffers,
+			which are allocated once per thread and reused for all its lines.
+		**/
+		class ImageLineFilterHelper
+		{
+		public:
+			enum { TileWidth = 16 };
+
+			//Output must have the region of the input image
+			template <class BoundaryType, class OutputImagePointerType, class LineFilter>
+			static void Apply(const BoundaryType& input, const OutputImagePointerType& output, int axis, const LineFilter& filter, int num_threads)
+			{
+				const Region3D<int>& region = output->getRegion();
+				Point3D<int> size = region.getMaxPoint() - region.getMinPoint() + 1;
+				int lane_axis = axis==0 ? -1 : 0,
+					outer_axis = axis==2 ? 1 : 2;
+				int tile_width = lane_axis<0 ? 1 : TileWidth,
+					num_tiles = lane_axis<0 ? size[1] : (size[lane_axis]+tile_width-1)/tile_width;
+				long num_items = (long)num_tiles*size[outer_axis];
+				if (num_items<=0) return;
+
+				//Work item i is the tile (or line) i%num_tiles of the slice i/num_tiles along outer_axis
+				auto process = [&input, &output, &filter, &region, &size, axis, lane_axis, outer_axis, tile_width, num_tiles](long begin, long end) {
+					int length = size[axis];
+					std::vector<double> in_buffer((length+filter.getMarginBefore()+filter.getMarginAfter())*tile_width),
+						out_buffer(length*tile_width),
+					scratch_buffer(filter.getScratchSize(length, tile_width));
+					for (long i=begin; i<end; ++i) {
+						Point3D<int> start = region.getMinPoint();
+						start[outer_axis] += i/num_tiles;
+						int lanes = 1;
+						if (lane_axis<0) start[1] += i%num_tiles;
+						else {
+							start[lane_axis] += (i%num_tiles)*tile_width;
+							lanes = std::min(tile_width, region.getMaxPoint()[lane_axis]-start[lane_axis]+1);
+						}
+						ApplyToLines(input, output, axis, filter, start, length, lanes, &in_buffer[0], &out_buffer[0], scratch_buffer.empty() ? 0 : &scratch_buffer[0]);
+					}
+				};
+
+				num_threads = (int)std::min<long>(std::max(num_threads, 1), num_items);
+				if (num_threads==1) process(0, num_items);
+				else {
+					std::vector<std::thread> workers;
+					for (int t=0; t<num_threads; ++t) {
+						long begin = num_items*t/num_threads,
+							end = num_items*(t+1)/num_threads;
+						workers.push_back(std::thread(process, begin, end));
+					}
+					pcl_ForEach(workers, w) w->join();
+				}
+			}
+
+			//Returns the axis of a kernel spanning one axis with the origin inside, -1 otherwise
+			template <class KernelPointerType>
+			static int GetKernelAxis(const KernelPointerType& kernel)
+			{
+				int axis = 0, num_axes = 0;
+				for (int i=0; i<3; ++i) if (kernel->getMinPoint()[i]!=kernel->getMaxPoint()[i]) {
+					axis = i;
+					++num_axes;
+				}
+				if (num_axes>1) return -1;
+				for (int i=0; i<3; ++i) if (kernel->getMinPoint()[i]>0 || kernel->getMaxPoint()[i]<0) return -1;
+				return axis;
+			}
+
+		protected:
+			template <class BoundaryType, class OutputImagePointerType, class LineFilter>
+			static void ApplyToLines(const BoundaryType& input, const OutputImagePointerType& output, int axis, const LineFilter& filter, const Point3D<int>& start, int length, int lanes, double* in, double* out, double* scratch)
+			{
+				auto image = input.getImage();
+				int margin_before = filter.getMarginBefore(),
+					margin_after = filter.getMarginAfter();
+				long in_index = image->toIndex(start),
+					in_step = image->getOffsetTable()[axis];
+				for (int i=-margin_before; i<length+margin_after; ++i) {
+					double* row = in + (i+margin_before)*lanes;
+					if (i>=0 && i<length) {
+						long index = in_index + i*in_step;
+						for (int l=0; l<lanes; ++l) row[l] = image->get(index+l);
+					} else {
+						Point3D<int> p(start);
+						p[axis] += i;
+						for (int l=0; l<lanes; ++l, ++p.x()) row[l] = input.get(p);
+					}
+				}
+
+				filter.apply(in, out, length, lanes, scratch);
+
+				long out_index = output->toIndex(start),
+					out_step = output->getOffsetTable()[axis];
+				for (int i=0; i<length; ++i) {
+					long index = out_index + i*out_step;
+					const double* row = out + i*lanes;
+					for (int l=0; l<lanes; ++l) output->set(index+l, row[l]);
+				}
+			}
+		};
+
+
+		/**
+			Convolution with a 1D kernel along one axis, summing the taps in the order of ImageConvolutionFilter so that results are identical
+		**/
+		class ImageKernelLineFilter
+		{
+		public:
+			template <class KernelPointerType>
+			ImageKernelLineFilter(const KernelPointerType& kernel, int axis)
+			{
+				int kmin = kernel->getMinPoint()[axis],
+					kmax = kernel->getMaxPoint()[axis];
+				m_MarginBefore = -kmin;
+				m_MarginAfter = kmax;
+				//Tap t reads the voxel at offset kmin+t, which the convolution weighs by the kernel at the mirrored offset
+				Point3D<int> p(kernel->getMinPoint());
+				for (int o=kmin; o<=kmax; ++o) {
+					p[axis] = kmin+kmax-o;
+					m_Weights.push_back(kernel->get(p));
+				}
+			}
+
+			//Weight t applies to the voxel at offset t-margin_before (correlation, no mirroring)
+			ImageKernelLineFilter(const std::vector<double>& weights, int margin_before)
+			{
+				m_Weights = weights;
+				m_MarginBefore = margin_before;
+				m_MarginAfter = (int)weights.size()-1-margin_before;
+			}
+
+			int getMarginBefore() const
+			{
+				return m_MarginBefore;
+			}
+			int getMarginAfter() const
+			{
+				return m_MarginAfter;
+			}
+
+			long getScratchSize(int length, int lanes) const
+			{
+				return 0;
+			}
+
+			void apply(const double* in, double* out, int length, int lanes, double* scratch) const
+			{
+				long n = (long)length*lanes;
+				std::fill(out, out+n, 0.0);
+				for (size_t t=0; t<m_Weights.size(); ++t) {
+					const double w = m_Weights[t];
+					const double* src = in + t*lanes;
+					for (long m=0; m<n; ++m) out[m] += src[m]*w;
+				}
+			}
+
+		protected:
+			std::vector<double> m_Weights;
+			int m_MarginBefore, m_MarginAfter;
+		};
+
+
+		/**
+			Recursive Gaussian along one axis, whose cost does not depend on sigma: the sum of a causal and an anti-causal 4th order filter,
+			whose responses approximate the two halves of the Gaussian within 0.05% of its peak.
+			Reference: R. Deriche, "Recursively implementing the Gaussian and its derivatives", INRIA Research Report 1893, 1993.
+			Note: The filters start from the steady state of the first (and last) voxel of a margin of 3 sigma read from the boundary
+		**/
+		class ImageRecursiveGaussianLineFilter
+		{
+		public:
+			ImageRecursiveGaussianLineFilter(double sigma)
+			{
+				//Response of the causal filter, h(n) = sum of alpha*pole^n over two pairs of conjugate poles
+				const double a[2] = {1.680, -0.6803}, c[2] = {3.735, -0.2598}, b[2] = {1.783, 1.723}, w[2] = {0.6318, 1.997};
+				std::complex<double> alpha[4], pole[4];
+				for (int i=0; i<2; ++i) {
+					alpha[2*i] = std::complex<double>(a[i], -c[i])/2.0;
+					pole[2*i] = std::exp(std::complex<double>(-b[i], w[i])/sigma);
+					alpha[2*i+1] = std::conj(alpha[2*i]);
+					pole[2*i+1] = std::conj(pole[2*i]);
+				}
+
+				//Denominator prod(1-pole*z^-1) and numerator sum(alpha*prod_others(1-pole*z^-1))
+				std::complex<double> den[5] = {1.0, 0.0, 0.0, 0.0, 0.0}, num[4] = {0.0, 0.0, 0.0, 0.0};
+				for (int k=0; k<4; ++k) {
+					for (int i=k+1; i>0; --i) den[i] -= pole[k]*den[i-1];
+					std::complex<double> term[4] = {alpha[k], 0.0, 0.0, 0.0};
+					for (int j=0, order=0; j<4; ++j) if (j!=k) {
+						++order;
+						for (int i=order; i>0; --i) term[i] -= pole[j]*term[i-1];
+					}
+					for (int i=0; i<4; ++i) num[i] += term[i];
+				}
+				for (int i=0; i<4; ++i) {
+					m_D[i] = den[i+1].real();
+					m_N[i] = num[i].real();
+				}
+				//The anti-causal filter has the mirrored response without h(0)
+				for (int i=0; i<3; ++i) m_M[i] = m_N[i+1] - m_N[0]*m_D[i];
+				m_M[3] = -m_N[0]*m_D[3];
+
+				//Unit gain
+				double sum_d = 1 + m_D[0] + m_D[1] + m_D[2] + m_D[3],
+					causal_gain = (m_N[0] + m_N[1] + m_N[2] + m_N[3])/sum_d,
+					anticausal_gain = (m_M[0] + m_M[1] + m_M[2] + m_M[3])/sum_d,
+					scale = 1/(causal_gain + anticausal_gain);
+				for (int i=0; i<4; ++i) {
+					m_N[i] *= scale;
+					m_M[i] *= scale;
+				}
+				m_CausalGain = causal_gain*scale;
+				m_AnticausalGain = anticausal_gain*scale;
+				m_Margin = 4 + (int)ceil(3*sigma);
+			}
+
+			int getMarginBefore() const
+			{
+				return m_Margin;
+			}
+			int getMarginAfter() const
+			{
+				return m_Margin;
+			}
+
+			//Scratch holds the causal and anti-causal responses of the padded lines
+			long getScratchSize(int length, int lanes) const
+			{
+				return 2L*(length+2*m_Margin)*lanes;
+			}
+
+			void apply(const double* in, double* out, int length, int lanes, double* scratch) const
+			{
+				int padded = length + 2*m_Margin;
+				double *causal = scratch, *anticausal = scratch + (long)padded*lanes;
+				const double *first = in, *last = in + (padded-1)*lanes;
+				for (int i=0; i<4; ++i) for (int l=0; l<lanes; ++l) {
+					causal[i*lanes+l] = m_CausalGain*first[l];
+					anticausal[(padded-1-i)*lanes+l] = m_AnticausalGain*last[l];
+				}
+
+				const long s1 = lanes, s2 = 2*lanes, s3 = 3*lanes, s4 = 4*lanes;
+				for (int i=4; i<padded; ++i) {
+					const double* x = in + i*lanes;
+					double* y = causal + i*lanes;
+					for (int l=0; l<lanes; ++l) {
+						y[l] = m_N[0]*x[l] + m_N[1]*x[l-s1] + m_N[2]*x[l-s2] + m_N[3]*x[l-s3]
+							- m_D[0]*y[l-s1] - m_D[1]*y[l-s2] - m_D[2]*y[l-s3] - m_D[3]*y[l-s4];
+					}
+				}
+				for (int i=padded-5; i>=m_Margin; --i) {
+					const double* x = in + i*lanes;
+					double* y = anticausal + i*lanes;
+					for (int l=0; l<lanes; ++l) {
+						y[l] = m_M[0]*x[l+s1] + m_M[1]*x[l+s2] + m_M[2]*x[l+s3] + m_M[3]*x[l+s4]
+							- m_D[0]*y[l+s1] - m_D[1]*y[l+s2] - m_D[2]*y[l+s3] - m_D[3]*y[l+s4];
+					}
+				}
+
+				long offset = (long)m_Margin*lanes, n = (long)length*lanes;
+				for (long m=0; m<n; ++m) out[m] = causal[offset+m] + anticausal[offset+m];
+			}
+
+		protected:
+			double m_N[4], m_M[4], m_D[4];
+			double m_CausalGain, m_AnticausalGain;
+			int m_Margin;
+		};
+
+	}
+}
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <pcl/filter2/image/ImageConvolutionFilter.h>
 #include <pcl/filter2/image/ImageFilterBase.h>
+#include <pcl/filter2/image/ImageLineFilterHelper.h>
 #include <pcl/filter2/boundary/ZeroFluxBoundary.h>
 
 namespace pcl
@@ -9,23 +10,35 @@ namespace pcl
 	namespace filter2
 	{
 
+		/**
+			Note: Kernels spanning one axis are applied line by line with ImageLineFilterHelper (vectorized, split over setNumberOfThreads() threads),
+			giving the same results as ImageConvolutionFilter, which applies the other kernels and is used when an output region is set
+		**/
 		template <class BoundaryType, class KernelType, class OutputImageType>
 		class ImageSeparableFilter: public ImageFilterBase
 		{
 		public:
-			static typename OutputImageType::Pointer Compute(const BoundaryType& input, const std::vector<typename KernelType::Pointer>& kernels, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset())
+			static typename OutputImageType::Pointer Compute(const BoundaryType& input, const std::vector<typename KernelType::Pointer>& kernels, pcl::Region3D<int>& output_region=pcl::Region3D<int>().reset(), int num_threads=1)
 			{
 				ImageSeparableFilter filter;
 				filter.setInput(input);
 				filter.setKernels(kernels);
 				filter.setOutputRegion(output_region);
+				filter.setNumberOfThreads(num_threads);
 				filter.update();
 				return filter.getOutput();
 			}
 
 
 			ImageSeparableFilter() 
-			{}
+			{
+				m_NumberOfThreads = 1;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
 
 			void setInput(const BoundaryType& input)
 			{
@@ -49,7 +62,14 @@ namespace pcl
 						touched_region.getMinPoint() += m_Kernels[i]->getMinPoint();
 						touched_region.getMaxPoint() += m_Kernels[i]->getMaxPoint();
 					}
-					if (kernel_index==0) {
+					int axis = ImageLineFilterHelper::GetKernelAxis(m_Kernels[kernel_index]);
+					if (this->m_OutputRegion.empty() && axis>=0) {
+						typename OutputImageType::Pointer output = OutputImageType::New(m_Input.getImage());
+						ImageKernelLineFilter line_filter(m_Kernels[kernel_index], axis);
+						if (kernel_index==0) ImageLineFilterHelper::Apply(m_Input, output, axis, line_filter, m_NumberOfThreads);
+						else ImageLineFilterHelper::Apply(ZeroFluxBoundary<OutputImageType>(m_Output), output, axis, line_filter, m_NumberOfThreads);
+						m_Output = output;
+					} else if (kernel_index==0) {
 						m_Output = ImageConvolutionFilter<BoundaryType, KernelType, OutputImageType>::Compute(m_Input, m_Kernels[kernel_index], touched_region);
 					} else {
 						ZeroFluxBoundary<OutputImageType> boundary(m_Output);
@@ -67,6 +87,7 @@ namespace pcl
 			BoundaryType m_Input;
 			typename OutputImageType::Pointer m_Output;
 			std::vector<typename KernelType::Pointer> m_Kernels;
+			int m_NumberOfThreads;
 		};
 
 	}
@@ -0,0 +1,452 @@
+#ifndef PCL2_PRIORITY_FLOOD_WATERSHED
+#define PCL2_PRIORITY_FLOOD_WATERSHED
+
+#include <pcl/iterator/ImageNeighborIterator.h>
+#include <pcl/image.h>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <vector>
+
+namespace pcl
+{
+	namespace filter2
+	{
+		/**
+			Watershed by flooding (F. Meyer, "Un algorithme optimal de ligne de partage des eaux", 1991) with a hierarchical queue.
+			The input is quantized to setNumberOfLevels() levels (integer inputs with a smaller range are used as is), so that the queue
+			is an array of FIFO buckets and flooding runs in time linear in the number of voxels.
+
+			Note: Basins flow to the minima of the input; every voxel of a basin is reached from its minimum, and there are no watershed lines
+			Note: Without markers each regional minimum (plateau with no lower neighbor) of the quantized input starts a basin, labeled from 1 in raster order
+			Note: With setMarkers() the basins start from the voxels where the markers are positive and take their labels; voxels that no marker reaches are 0
+			Note: Only voxels where the mask is positive are labeled and crossed by the flood (the whole region if no mask is set); others are 0
+			Note: The mask and markers must cover the region of the input
+			Note: The region can be split along z into slabs (setNumberOfThreads(), setSlabThickness()) that are flooded in parallel. The minima are found
+			for the whole region (plateaus crossing the seams are joined). The voxels next to a seam that the adjacent slab reaches at a lower cost then take
+			its label and are flooded again within their slab, until no seam changes, so every voxel is reached at the same level and number of steps as
+			with a single slab. Where several basins reach a voxel at the same level and number of steps (above the saddle between them) the basin that
+			gets the voxel depends on the order of the flood, so the boundary between such basins may differ from a single slab.
+		**/
+		template <class InputImageType, class OutputImageType, class MaskImageType=InputImageType>
+		class PriorityFloodWatershed
+		{
+		public:
+			typedef typename InputImageType::IoValueType InputValueType;
+			typedef typename OutputImageType::IoValueType OutputValueType;
+
+			static typename OutputImageType::Pointer Compute(const typename InputImageType::ConstantPointer& input, const typename MaskImageType::ConstantPointer& mask, const pcl::iterator::ImageNeighborIterator::ConstantOffsetListPointer& neighborhood, int num_threads=1, int num_levels=256)
+			{
+				PriorityFloodWatershed filter;
+				filter.setInput(input);
+				filter.setMask(mask);
+				filter.setNeighborhood(neighborhood);
+				filter.setNumberOfThreads(num_threads);
+				filter.setNumberOfLevels(num_levels);
+				filter.update();
+				return filter.getOutput();
+			}
+
+			static typename OutputImageType::Pointer ComputeWithMarkers(const typename InputImageType::ConstantPointer& input, const typename OutputImageType::ConstantPointer& markers, const typename MaskImageType::ConstantPointer& mask, const pcl::iterator::ImageNeighborIterator::ConstantOffsetListPointer& neighborhood, int num_threads=1, int num_levels=256)
+			{
+				PriorityFloodWatershed filter;
+				filter.setInput(input);
+				filter.setMarkers(markers);
+				filter.setMask(mask);
+				filter.setNeighborhood(neighborhood);
+				filter.setNumberOfThreads(num_threads);
+				filter.setNumberOfLevels(num_levels);
+				filter.update();
+				return filter.getOutput();
+			}
+
+
+			PriorityFloodWatershed()
+			{
+				m_NumberOfThreads = 1;
+				m_SlabThickness = 0;
+				m_NumberOfLevels = 256;
+				m_NumberOfBasins = 0;
+			}
+
+			void setInput(const typename InputImageType::ConstantPointer& input)
+			{
+				m_Input = input;
+			}
+
+			void setMask(const typename MaskImageType::ConstantPointer& mask)
+			{
+				m_Mask = mask;
+			}
+
+			void setMarkers(const typename OutputImageType::ConstantPointer& markers)
+			{
+				m_Markers = markers;
+			}
+
+			void setNeighborhood(const pcl::iterator::ImageNeighborIterator::ConstantOffsetListPointer& neighbor)
+			{
+				m_Neighborhood = neighbor;
+			}
+
+			void setNumberOfThreads(int num)
+			{
+				m_NumberOfThreads = num<1 ? 1 : num;
+			}
+
+			/**
+				Sets the number of slices of each slab; by default the region is split into one slab per thread.
+				The labels only depend on the slabs, so a fixed thickness gives the same output for any number of threads.
+			**/
+			void setSlabThickness(int num)
+			{
+				m_SlabThickness = num<0 ? 0 : num;
+			}
+
+			void setNumberOfLevels(int num)
+			{
+				m_NumberOfLevels = num<2 ? 2 : num;
+			}
+
+			void update()
+			{
+				//Setting up environment
+				const Point3D<int>& minp = m_Input->getRegion().getMinPoint();
+				m_Size = m_Input->getRegion().getSize();
+				m_PlaneSize = (long)m_Size.x()*m_Size.y();
+				long n = m_PlaneSize*m_Size.z();
+				m_Offsets.clear();
+				m_IndexOffsets.clear();
+				m_MaxOffset = Point3D<int>(0, 0, 0);
+				pcl_ForEach(*m_Neighborhood, iter) if (iter->x()!=0 || iter->y()!=0 || iter->z()!=0) {
+					m_Offsets.push_back(*iter);
+					m_IndexOffsets.push_back(iter->x() + (long)iter->y()*m_Size.x() + iter->z()*m_PlaneSize);
+					for (int d=0; d<3; ++d) m_MaxOffset[d] = std::max(m_MaxOffset[d], std::abs((*iter)[d]));
+				}
+
+				//Slabs are at least as thick as the neighborhood, so that seams only join adjacent slabs
+				int num_slabs = m_SlabThickness>0 ? (m_Size.z()+m_SlabThickness-1)/m_SlabThickness : m_NumberOfThreads;
+				num_slabs = std::max(1, std::min(num_slabs, m_Size.z()/std::max(1, m_MaxOffset.z())));
+				m_SlabStart.resize(num_slabs+1);
+				for (int s=0; s<=num_slabs; ++s) m_SlabStart[s] = (int)((long)m_Size.z()*s/num_slabs);
+
+				//Masking and quantization
+				m_Inside.assign(n, 0);
+				m_Border.assign(n, 0);
+				m_Voxels.assign(n, Voxel());
+				std::vector<char> slab_any(num_slabs, 0);
+				std::vector<InputValueType> slab_min(num_slabs, 0), slab_max(num_slabs, 0);
+				runOnSlabs([&](int s) {
+					for (int z=m_SlabStart[s]; z<m_SlabStart[s+1]; ++z) for (int y=0; y<m_Size.y(); ++y) {
+						long i = z*m_PlaneSize + (long)y*m_Size.x();
+						bool border_yz = y<m_MaxOffset.y() || y>=m_Size.y()-m_MaxOffset.y() || z<m_SlabStart[s]+m_MaxOffset.z() || z>=m_SlabStart[s+1]-m_MaxOffset.z();
+						for (int x=0; x<m_Size.x(); ++x, ++i) {
+							m_Border[i] = border_yz || x<m_MaxOffset.x() || x>=m_Size.x()-m_MaxOffset.x();
+							Point3D<int> p(minp.x()+x, minp.y()+y, minp.z()+z);
+							if (m_Mask && !(m_Mask->get(m_Mask->toIndex(p))>0)) continue;
+							m_Inside[i] = 1;
+							m_Voxels[i].cost = std::numeric_limits<int>::max();
+							InputValueType v = m_Input->get(m_Input->toIndex(p));
+							if (!slab_any[s] || v<slab_min[s]) slab_min[s] = v;
+							if (!slab_any[s] || v>slab_max[s]) slab_max[s] = v;
+							slab_any[s] = 1;
+							if (m_Markers) m_Voxels[i].label = std::max<OutputValueType>(0, m_Markers->get(m_Markers->toIndex(p)));
+						}
+					}
+				});
+				bool any_inside = false;
+				InputValueType min_val = 0, max_val = 0;
+				for (int s=0; s<num_slabs; ++s) if (slab_any[s]) {
+					if (!any_inside || slab_min[s]<min_val) min_val = slab_min[s];
+					if (!any_inside || slab_max[s]>max_val) max_val = slab_max[s];
+					any_inside = true;
+				}
+				double range = (double)max_val - (double)min_val;
+				bool exact_levels = std::numeric_limits<InputValueType>::is_integer && range<m_NumberOfLevels;
+				m_LevelCount = exact_levels ? (int)range+1 : m_NumberOfLevels;
+				if (any_inside && range>0) {
+					double scale = exact_levels ? 1 : (m_NumberOfLevels-1)/range;
+					runOnSlabs([&](int s) {
+						for (int z=m_SlabStart[s]; z<m_SlabStart[s+1]; ++z) for (int y=0; y<m_Size.y(); ++y) {
+							long i = z*m_PlaneSize + (long)y*m_Size.x();
+							for (int x=0; x<m_Size.x(); ++x, ++i) if (m_Inside[i]) {
+								double v = m_Input->get(m_Input->toIndex(minp.x()+x, minp.y()+y, minp.z()+z));
+								m_Voxels[i].level = std::min(m_LevelCount-1, (int)((v-min_val)*scale));
+							}
+						}
+					});
+				}
+
+				//Seeds
+				if (m_Markers) {
+					m_NumberOfBasins = 0;
+					for (long i=0; i<n; ++i) if (m_Inside[i] && m_Voxels[i].label>m_NumberOfBasins) m_NumberOfBasins = m_Voxels[i].label;
+				} else {
+					labelMinima();
+				}
+
+				//Flooding each slab from its seeds, then from the seams until no voxel is reached at a lower level from another slab
+				std::vector<std::vector<long> > seeds(num_slabs);
+				for (int s=0; s<num_slabs; ++s) {
+					for (long i=m_SlabStart[s]*m_PlaneSize; i<m_SlabStart[s+1]*m_PlaneSize; ++i) if (m_Inside[i] && m_Voxels[i].label) {
+						m_Voxels[i].cost = m_Voxels[i].level;
+						seeds[s].push_back(i);
+					}
+				}
+				do {
+					runOnSlabs([this, &seeds](int s) { flood(m_SlabStart[s], m_SlabStart[s+1], seeds[s]); });
+				} while (reconcileSeams(seeds));
+
+				//Generating output
+				m_Output = OutputImageType::New(m_Input);
+				ImageHelper::Fill(m_Output, 0);
+				runOnSlabs([&](int s) {
+					for (int z=m_SlabStart[s]; z<m_SlabStart[s+1]; ++z) for (int y=0; y<m_Size.y(); ++y) {
+						long i = z*m_PlaneSize + (long)y*m_Size.x();
+						for (int x=0; x<m_Size.x(); ++x, ++i) if (m_Voxels[i].label) {
+							m_Output->set(m_Output->toIndex(minp.x()+x, minp.y()+y, minp.z()+z), m_Voxels[i].label);
+						}
+					}
+				});
+			}
+
+			typename OutputImageType::Pointer getOutput()
+			{
+				return m_Output;
+			}
+
+			/**
+				Returns the number of basins (minima, or the largest marker label) of the last update
+			**/
+			OutputValueType getNumberOfBasins() const
+			{
+				return m_NumberOfBasins;
+			}
+
+		protected:
+			typename InputImageType::ConstantPointer m_Input;
+			typename MaskImageType::ConstantPointer m_Mask;
+			typename OutputImageType::ConstantPointer m_Markers;
+			typename OutputImageType::Pointer m_Output;
+			pcl::iterator::ImageNeighborIterator::ConstantOffsetListPointer m_Neighborhood;
+			int m_NumberOfThreads;
+			int m_SlabThickness;
+			int m_NumberOfLevels;
+			OutputValueType m_NumberOfBasins;
+
+			struct Voxel
+			{
+				int level;
+				int cost; //Level at which the flood reaches the voxel, -1 outside the mask
+				int steps; //Steps taken at that level
+				OutputValueType label;
+
+				Voxel() : level(0), cost(-1), steps(0), label(0) {}
+			};
+
+			//Working data over the region of the input, in raster order
+			Point3D<int> m_Size;
+			long m_PlaneSize;
+			Point3D<int> m_MaxOffset;
+			int m_LevelCount;
+			std::vector<Point3D<int> > m_Offsets;
+			std::vector<long> m_IndexOffsets;
+			std::vector<int> m_SlabStart;
+			std::vector<char> m_Inside;
+			std::vector<char> m_Border; //Voxels with neighbors outside the region or their slab
+			std::vector<Voxel> m_Voxels;
+
+			template <class SlabFunc>
+			void runOnSlabs(SlabFunc func)
+			{
+				int num_slabs = (int)m_SlabStart.size()-1;
+				int num_threads = std::min(m_NumberOfThreads, num_slabs);
+				if (num_threads==1) {
+					for (int s=0; s<num_slabs; ++s) func(s);
+					return;
+				}
+				std::vector<std::thread> workers;
+				for (int t=0; t<num_threads; ++t) {
+					workers.push_back(std::thread([&func, t, num_slabs, num_threads]() {
+						for (int s=t; s<num_slabs; s+=num_threads) func(s);
+					}));
+				}
+				pcl_ForEach(workers, w) w->join();
+			}
+
+			/**
+				Returns whether the neighbor o of the voxel at (x,y,z) lies within the region and the slabs from z0 to z1 (exclusive)
+			**/
+			inline bool isNeighborValid(int x, int y, int z, int o, int z0, int z1) const
+			{
+				const Point3D<int>& d = m_Offsets[o];
+				int nx = x+d.x(), ny = y+d.y(), nz = z+d.z();
+				return nx>=0 && nx<m_Size.x() && ny>=0 && ny<m_Size.y() && nz>=z0 && nz<z1;
+			}
+
+			inline void toPoint(long i, int& x, int& y, int& z) const
+			{
+				z = (int)(i/m_PlaneSize);
+				long r = i - z*m_PlaneSize;
+				y = (int)(r/m_Size.x());
+				x = (int)(r - (long)y*m_Size.x());
+			}
+
+			/**
+				Floods the slabs from z0 to z1 (exclusive) from the seeds, which are then cleared.
+				The cost of a voxel is the level at which the flood reaches it (the lowest, over the paths from a seed, of the highest level along the path),
+				then the number of steps taken at that level, as with the FIFO order of the buckets.
+				A voxel takes the label of the voxel that first reaches it at a lower cost than it has; voxels whose steps are lowered are queued again.
+			**/
+			void flood(int z0, int z1, std::vector<long>& seeds)
+			{
+				std::vector<std::vector<long> > queue(m_LevelCount);
+				pcl_ForEach(seeds, iter) queue[m_Voxels[*iter].cost].push_back(*iter);
+				std::vector<long>().swap(seeds);
+
+				int x, y, z;
+				const int num_offsets = (int)m_Offsets.size();
+				for (int level=0; level<m_LevelCount; ++level) {
+					std::vector<long>& bucket = queue[level];
+					for (size_t head=0; head<bucket.size(); ++head) {
+						long i = bucket[head];
+						if (m_Voxels[i].cost!=level) continue; //Reached at a lower level since it was queued
+						bool border = m_Border[i];
+						if (border) toPoint(i, x, y, z);
+						for (int o=0; o<num_offsets; ++o) if (!border || isNeighborValid(x, y, z, o, z0, z1)) {
+							long j = i+m_IndexOffsets[o];
+							//Most neighbors are already reached at a lower level
+							if (m_Voxels[j].cost<level || (m_Voxels[j].cost==level && m_Voxels[j].steps<=m_Voxels[i].steps+1)) continue;
+							if (reach(i, j)) queue[m_Voxels[j].cost].push_back(j);
+						}
+					}
+					std::vector<long>().swap(bucket);
+				}
+			}
+
+			/**
+				Gives voxel j the cost and label of a step from voxel i if that lowers its cost. Returns whether it did.
+			**/
+			inline bool reach(long i, long j)
+			{
+				int cost = std::max(m_Voxels[i].cost, m_Voxels[j].level);
+				int steps = cost==m_Voxels[i].cost ? m_Voxels[i].steps+1 : 0;
+				if (cost>m_Voxels[j].cost || (cost==m_Voxels[j].cost && steps>=m_Voxels[j].steps)) return false;
+				m_Voxels[j].cost = cost;
+				m_Voxels[j].steps = steps;
+				m_Voxels[j].label = m_Voxels[i].label;
+				return true;
+			}
+
+			/**
+				Lowers the cost of the voxels next to a seam that the flood of the adjacent slab reaches at a lower level,
+				and adds them to the seeds of their slab. Returns whether any voxel was changed.
+			**/
+			bool reconcileSeams(std::vector<std::vector<long> >& seeds)
+			{
+				bool changed = false;
+				int x, y, z;
+				for (int s=1; s<(int)m_SlabStart.size()-1; ++s) {
+					int seam = m_SlabStart[s];
+					for (long i=(seam-m_MaxOffset.z())*m_PlaneSize; i<(seam+m_MaxOffset.z())*m_PlaneSize; ++i) if (m_Inside[i]) {
+						toPoint(i, x, y, z);
+						int side = z<seam ? s-1 : s;
+						for (int o=0; o<(int)m_Offsets.size(); ++o) if (isNeighborValid(x, y, z, o, seam-m_MaxOffset.z(), seam+m_MaxOffset.z())) {
+							long j = i+m_IndexOffsets[o];
+							if ((z+m_Offsets[o].z()<seam)==(z<seam) || !m_Inside[j] || !m_Voxels[j].label) continue;
+							if (reach(j, i)) {
+								if (seeds[side].empty() || seeds[side].back()!=i) seeds[side].push_back(i);
+								changed = true;
+							}
+						}
+					}
+				}
+				return changed;
+			}
+
+			/**
+				Labels the regional minima of the quantized input in raster order.
+				The plateaus are found per slab in parallel and joined across the seams.
+			**/
+			void labelMinima()
+			{
+				long n = m_PlaneSize*m_Size.z();
+				int num_slabs = (int)m_SlabStart.size()-1;
+				std::vector<int> plateau(n, -1);
+				std::vector<std::vector<char> > has_lower(num_slabs);
+
+				//Plateaus (connected voxels of the same level) within each slab, and whether they have a lower neighbor anywhere in the region
+				runOnSlabs([this, &plateau, &has_lower](int s) {
+					int z0 = m_SlabStart[s], z1 = m_SlabStart[s+1];
+					std::vector<long> stack;
+					int x, y, z;
+					for (long i=z0*m_PlaneSize; i<z1*m_PlaneSize; ++i) if (m_Inside[i] && plateau[i]<0) {
+						int id = (int)has_lower[s].size();
+						bool lower = false;
+						plateau[i] = id;
+						stack.push_back(i);
+						while (!stack.empty()) {
+							long k = stack.back();
+							stack.pop_back();
+							bool border = m_Border[k];
+							if (border) toPoint(k, x, y, z);
+							for (int o=0; o<(int)m_Offsets.size(); ++o) if (!border || isNeighborValid(x, y, z, o, 0, m_Size.z())) {
+								long j = k+m_IndexOffsets[o];
+								if (!m_Inside[j]) continue;
+								if (m_Voxels[j].level<m_Voxels[k].level) lower = true;
+								//The slab test comes first: plateau[j] of a voxel in another slab is written by the thread of that slab
+								else if ((!border || (z+m_Offsets[o].z()>=z0 && z+m_Offsets[o].z()<z1)) && m_Voxels[j].level==m_Voxels[k].level && plateau[j]<0) {
+									plateau[j] = id;
+									stack.push_back(j);
+								}
+							}
+						}
+						has_lower[s].push_back(lower);
+					}
+				});
+
+				//Global plateau ids, joined across the seams
+				std::vector<int> first_id(num_slabs+1, 0);
+				for (int s=0; s<num_slabs; ++s) first_id[s+1] = first_id[s]+(int)has_lower[s].size();
+				std::vector<int> parent(first_id[num_slabs]);
+				std::vector<char> lower(first_id[num_slabs]);
+				for (int s=0; s<num_slabs; ++s) for (int k=0; k<(int)has_lower[s].size(); ++k) {
+					parent[first_id[s]+k] = first_id[s]+k;
+					lower[first_id[s]+k] = has_lower[s][k];
+				}
+				auto find = [&parent](int a) {
+					while (parent[a]!=a) a = parent[a] = parent[parent[a]];
+					return a;
+				};
+				for (int s=1; s<num_slabs; ++s) {
+					int z0 = m_SlabStart[s], z_end = std::min(m_SlabStart[s+1], z0+m_MaxOffset.z());
+					int x, y, z;
+					for (long i=z0*m_PlaneSize; i<z_end*m_PlaneSize; ++i) if (m_Inside[i]) {
+						toPoint(i, x, y, z);
+						for (int o=0; o<(int)m_Offsets.size(); ++o) if (z+m_Offsets[o].z()<z0 && isNeighborValid(x, y, z, o, 0, z0)) {
+							long j = i+m_IndexOffsets[o];
+							if (!m_Inside[j] || m_Voxels[j].level!=m_Voxels[i].level) continue;
+							int a = find(first_id[s]+plateau[i]), b = find(first_id[s-1]+plateau[j]);
+							if (a==b) continue;
+							parent[b] = a;
+							lower[a] = lower[a] || lower[b];
+						}
+					}
+				}
+
+				//Labels of the minima in raster order
+				std::vector<OutputValueType> label(parent.size(), 0);
+				m_NumberOfBasins = 0;
+				for (int s=0; s<num_slabs; ++s) for (long i=m_SlabStart[s]*m_PlaneSize; i<m_SlabStart[s+1]*m_PlaneSize; ++i) if (m_Inside[i]) {
+					int root = find(first_id[s]+plateau[i]);
+					if (lower[root]) continue;
+					if (!label[root]) label[root] = ++m_NumberOfBasins;
+					m_Voxels[i].label = label[root];
+				}
+			}
+		};
+
+	}
+}
+
+#endif
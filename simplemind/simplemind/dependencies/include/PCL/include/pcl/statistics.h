@@ -1,3 +1,5 @@
 #include <pcl/statistics/VariableWidthHistogram.h>
 #include <pcl/statistics/PercentileCalculator.h>
-#include <pcl/statistics/StatisticsCalculator.h>
\ No newline at end of file
+#include <pcl/statistics/StatisticsCalculator.h>
+#include <pcl/statistics/DenseHistogram.h>
+#include <pcl/statistics/TDigest.h>
\ No newline at end of file
@@ -0,0 +1,244 @@
+#ifndef PCL_DENSE_HISTOGRAM
+#define PCL_DENSE_HISTOGRAM
+
+#include <pcl/macro.h>
+#include <math.h>
+#include <map>
+#include <vector>
+#include <limits>
+#include <boost/math/special_functions/fpclassify.hpp>
+
+namespace pcl
+{
+	namespace statistics
+	{
+
+		/*
+		Counts of integral values in a flat array with one bin per value between the smallest and the largest value added,
+		giving the same results as PercentileCalculator with an increment per value instead of a map insertion.
+		The array grows (by at least half its size, so that growing is amortized) when a value is out of its range, so the values
+		should span a narrow range (e.g. CT intensities); reserve() allocates a known range at once.
+		Histograms filled separately (e.g. by different threads) are combined with merge().
+		*/
+		template <class ValueType>
+		class DenseHistogram
+		{
+		public:
+			DenseHistogram()
+			{
+				m_Offset = 0;
+				m_Num = 0;
+			}
+
+			void reserve(ValueType min_val, ValueType max_val)
+			{
+				resize(min_val, max_val);
+			}
+
+			void addValue(const ValueType& val, long count=1)
+			{
+				if (m_Counts.empty() || val<m_Offset || distance(m_Offset, val)>=m_Counts.size()) grow(val);
+				m_Counts[distance(m_Offset, val)] += count;
+				m_Num += count;
+			}
+			template <class MapType>
+			void addMap(const MapType& map)
+			{
+				pcl_ForEach(map, item) {
+					addValue(item->first, item->second);
+				}
+			}
+
+			void merge(const DenseHistogram& other)
+			{
+				if (other.m_Num==0) return;
+				if (m_Counts.empty()) resize(other.m_Offset, other.lastValue());
+				else resize(std::min(m_Offset, other.m_Offset), std::max(lastValue(), other.lastValue()));
+				unsigned long long shift = distance(m_Offset, other.m_Offset);
+				for (size_t i=0; i<other.m_Counts.size(); ++i) m_Counts[shift+i] += other.m_Counts[i];
+				m_Num += other.m_Num;
+			}
+
+			/************************* Results related methods *************************/
+
+			double getEntropy() const
+			{
+				double sum = 0;
+				double log2 = log(2.0);
+				pcl_ForEach(m_Counts, item) if (*item>0) {
+					double prob = double(*item)/double(m_Num);
+					sum += prob*(log(prob)/log2);
+				}
+				return -sum;
+			}
+
+			double getEnergy() const
+			{
+				double sum = 0;
+				pcl_ForEach(m_Counts, item) {
+					double prob = double(*item)/double(m_Num);
+					sum += prob*prob;
+				}
+				return sum;
+			}
+
+			double getMedian(bool interpolate) const
+			{
+				if (interpolate) return getInterpolatedMedian();
+				else return getMedian();
+			}
+			double getMedian() const
+			{
+				return getPercentile(0.5);
+			}
+			double getInterpolatedMedian() const
+			{
+				return getInterpolatedPercentile(0.5);
+			}
+
+			double getPercentile(double val, bool interpolate) const
+			{
+				if (interpolate) return getInterpolatedPercentile(val);
+				else return getPercentile(val);
+			}
+			double getPercentile(double val) const
+			{
+				if (m_Num==0) return std::numeric_limits<double>::quiet_NaN();
+				if (val<0) val = 0;
+				else if (val>1) val = 1;
+				double target_cummulative = m_Num*val;
+				double cur_cummulative = 0;
+				for (size_t i=0; i<m_Counts.size(); ++i) if (m_Counts[i]>0) {
+					cur_cummulative += m_Counts[i];
+					if (cur_cummulative>=target_cummulative) return valueAt(i);
+				}
+				return getMax();
+			}
+
+			// Same interpolation as PercentileCalculator::getInterpolatedPercentile
+			double getInterpolatedPercentile(double val) const
+			{
+				if (m_Num==0) return std::numeric_limits<double>::quiet_NaN();
+				if (getMin()==getMax()) return getMin();
+				if (val<0) val = 0;
+				else if (val>1) val = 1;
+				double cur_cummulative = 0;
+				double target_cummulative = (val*m_Num) + 0.5;
+				// next_key stays the max when the target is past the last count (rounding up of the 0.5 offset)
+				double prev_key = 0, prev_val = std::numeric_limits<double>::quiet_NaN(),
+					next_key = getMax();
+				for (size_t i=0; i<m_Counts.size(); ++i) if (m_Counts[i]>0) {
+					cur_cummulative += m_Counts[i];
+					if (cur_cummulative<target_cummulative) {
+						prev_key = valueAt(i);
+						prev_val = cur_cummulative;
+					} else {
+						next_key = valueAt(i);
+						break;
+					}
+				}
+				if (!boost::math::isnormal(prev_val)) return next_key;
+				if (prev_val+1>target_cummulative) {
+					double s = target_cummulative-prev_val;
+					return (1-s)*prev_key + s*next_key;
+				} else return next_key;
+			}
+
+			template <class EvalFunc>
+			long getNum(EvalFunc& eval_func) const
+			{
+				long num = 0;
+				for (size_t i=0; i<m_Counts.size(); ++i) {
+					if (m_Counts[i]>0 && eval_func(valueAt(i))) num += m_Counts[i];
+				}
+				return num;
+			}
+
+			long getNum() const
+			{
+				return m_Num;
+			}
+
+			double getMin() const
+			{
+				for (size_t i=0; i<m_Counts.size(); ++i) if (m_Counts[i]>0) return valueAt(i);
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+			double getMax() const
+			{
+				for (size_t i=m_Counts.size(); i>0; --i) if (m_Counts[i-1]>0) return valueAt(i-1);
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+
+			// Counts of the values added, as PercentileCalculator::getMap
+			std::map<ValueType,long> getMap() const
+			{
+				std::map<ValueType,long> map;
+				for (size_t i=0; i<m_Counts.size(); ++i) if (m_Counts[i]>0) map[valueAt(i)] = m_Counts[i];
+				return map;
+			}
+
+		protected:
+			// Count of value m_Offset+i at i
+			std::vector<long> m_Counts;
+			ValueType m_Offset;
+			long m_Num;
+
+			ValueType valueAt(size_t i) const
+			{
+				return ValueType((unsigned long long)m_Offset+i);
+			}
+
+			ValueType lastValue() const
+			{
+				return valueAt(m_Counts.size()-1);
+			}
+
+			void grow(ValueType val)
+			{
+				if (m_Counts.empty()) {
+					resize(val, val);
+					return;
+				}
+				size_t slack = m_Counts.size()/2;
+				if (val<m_Offset) resize(subtractSaturated(val, slack), lastValue());
+				else resize(m_Offset, addSaturated(val, slack));
+			}
+
+			// Makes the array span [min_val, max_val], which contains the current range
+			void resize(ValueType min_val, ValueType max_val)
+			{
+				if (!m_Counts.empty()) {
+					min_val = std::min(min_val, m_Offset);
+					max_val = std::max(max_val, lastValue());
+					if (min_val==m_Offset && max_val==lastValue()) return;
+				}
+				std::vector<long> counts(distance(min_val, max_val)+1, 0);
+				if (!m_Counts.empty()) std::copy(m_Counts.begin(), m_Counts.end(), counts.begin()+distance(min_val, m_Offset));
+				m_Counts.swap(counts);
+				m_Offset = min_val;
+			}
+
+			// Number of values from low to high (low<=high), computed in unsigned arithmetic: high-low overflows ValueType (and int for narrower types) when the range is wide
+			static unsigned long long distance(ValueType low, ValueType high)
+			{
+				return (unsigned long long)high-(unsigned long long)low;
+			}
+
+			static ValueType subtractSaturated(ValueType val, size_t n)
+			{
+				unsigned long long room = distance(std::numeric_limits<ValueType>::min(), val);
+				return room>n ? ValueType(val-n) : std::numeric_limits<ValueType>::min();
+			}
+
+			static ValueType addSaturated(ValueType val, size_t n)
+			{
+				unsigned long long room = distance(val, std::numeric_limits<ValueType>::max());
+				return room>n ? ValueType(val+n) : std::numeric_limits<ValueType>::max();
+			}
+		};
+
+	}
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef PCL_TDIGEST
+#define PCL_TDIGEST
+
+#include <pcl/macro.h>
+#include <math.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+namespace pcl
+{
+	namespace statistics
+	{
+
+		/*
+		Streaming quantile sketch (merging t-digest, Dunning & Ertl) for values of any range, e.g. floating point intensities.
+		Values are summarized by at most about compression centroids, small ones near the extremes, so that the rank error of a percentile
+		is bounded (roughly 1/compression in the middle of the distribution and much less in the tails) while memory stays constant.
+		Digests filled separately (e.g. by different threads) are combined with merge().
+		*/
+		class TDigest
+		{
+		public:
+			TDigest(double compression=200)
+			{
+				m_Compression = compression;
+				m_Num = 0;
+				m_Min = std::numeric_limits<double>::infinity();
+				m_Max = -std::numeric_limits<double>::infinity();
+			}
+
+			void addValue(double val, double weight=1)
+			{
+				if (val!=val) return;
+				m_Buffer.push_back(Centroid(val, weight));
+				m_Num += weight;
+				if (m_Min>val) m_Min = val;
+				if (m_Max<val) m_Max = val;
+				if (m_Buffer.size()>=10*m_Compression) compress();
+			}
+
+			void merge(const TDigest& other)
+			{
+				m_Buffer.insert(m_Buffer.end(), other.m_Centroids.begin(), other.m_Centroids.end());
+				m_Buffer.insert(m_Buffer.end(), other.m_Buffer.begin(), other.m_Buffer.end());
+				m_Num += other.m_Num;
+				if (m_Min>other.m_Min) m_Min = other.m_Min;
+				if (m_Max<other.m_Max) m_Max = other.m_Max;
+				compress();
+			}
+
+			/************************* Results related methods *************************/
+
+			double getMedian()
+			{
+				return getPercentile(0.5);
+			}
+
+			// Interpolates between the centers of the centroids (and the min and max at the ends)
+			double getPercentile(double val)
+			{
+				if (m_Num==0) return std::numeric_limits<double>::quiet_NaN();
+				if (val<=0) return m_Min;
+				if (val>=1) return m_Max;
+				compress();
+				double index = val*m_Num;
+				const Centroid& first = m_Centroids.front();
+				if (index<first.weight/2) {
+					if (first.weight<=1) return first.mean;
+					return m_Min + (first.mean-m_Min)*index/(first.weight/2);
+				}
+				double cummulative = first.weight/2;
+				for (size_t i=0; i+1<m_Centroids.size(); ++i) {
+					double step = (m_Centroids[i].weight+m_Centroids[i+1].weight)/2;
+					if (cummulative+step>index) {
+						double s = (index-cummulative)/step;
+						return m_Centroids[i].mean + s*(m_Centroids[i+1].mean-m_Centroids[i].mean);
+					}
+					cummulative += step;
+				}
+				const Centroid& last = m_Centroids.back();
+				if (last.weight<=1) return last.mean;
+				double s = std::min(1.0, (index-cummulative)/(last.weight/2));
+				return last.mean + s*(m_Max-last.mean);
+			}
+
+			double getNum() const
+			{
+				return m_Num;
+			}
+
+			double getMin() const
+			{
+				return m_Min;
+			}
+			double getMax() const
+			{
+				return m_Max;
+			}
+
+			// Number of centroids once the added values are merged
+			size_t getSize()
+			{
+				compress();
+				return m_Centroids.size();
+			}
+
+		protected:
+			struct Centroid
+			{
+				double mean, weight;
+
+				Centroid(double m, double w) : mean(m), weight(w) {}
+
+				bool operator<(const Centroid& other) const
+				{
+					return mean<other.mean;
+				}
+			};
+
+			double m_Compression, m_Num, m_Min, m_Max;
+			std::vector<Centroid> m_Centroids, m_Buffer;
+
+			// Scale function k1: centroids may span one unit of k, which is narrow near q=0 and q=1
+			double scale(double q) const
+			{
+				return m_Compression/(2*pcl::PI)*asin(2*std::min(1.0, std::max(0.0, q))-1);
+			}
+
+			// Merges the buffered values and the centroids in one sorted sweep
+			void compress()
+			{
+				if (m_Buffer.empty()) return;
+				m_Buffer.insert(m_Buffer.end(), m_Centroids.begin(), m_Centroids.end());
+				std::sort(m_Buffer.begin(), m_Buffer.end());
+				std::vector<Centroid> result;
+				Centroid current = m_Buffer.front();
+				double weight_before = 0, k_lower = scale(0);
+				for (size_t i=1; i<m_Buffer.size(); ++i) {
+					const Centroid& next = m_Buffer[i];
+					if (scale((weight_before+current.weight+next.weight)/m_Num)-k_lower<=1) {
+						current.weight += next.weight;
+						current.mean += (next.mean-current.mean)*next.weight/current.weight;
+					} else {
+						result.push_back(current);
+						weight_before += current.weight;
+						k_lower = scale(weight_before/m_Num);
+						current = next;
+					}
+				}
+				result.push_back(current);
+				m_Centroids.swap(result);
+				m_Buffer.clear();
+			}
+		};
+
+	}
+}
+
+#endif
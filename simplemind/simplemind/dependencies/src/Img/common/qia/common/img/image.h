@@ -13,6 +13,11 @@
 
 #include <pcl/measurement/GeometricalMeasurementHelper.h>
 #include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <thread>
 
 #define callFunctionType(type,func) \
 	if (type==typeid(long long)) func<long long>(); \
@@ -417,8 +422,12 @@ struct PointValue
 	}
 };
 
+class ImageExpression;
+
 class ImageObject
 {
+	friend class ImageExpression;
+
 public:
 	ImageObject(const std::string& type, const pcl::Point3D<int>& minp, const pcl::Point3D<int>& maxp,
 		const pcl::Point3D<double>& spacing, const pcl::Point3D<double>& origin, const std::vector<double>& o, double fill_value)
@@ -763,6 +772,14 @@ public:
 		callFunctionParamTypeWithReturn(*m_Type, actualGetPercentileCalculator, mask);
 	}
 
+	// Percentiles (0 to 1) of the voxels where mask (if not NULL) is positive, with the slices split over threads (0: one per core).
+	// Integral types give the values of PercentileCalculator (dense histograms), floating point types and wide ranges estimates (t-digests).
+	std::vector<double> getPercentiles(const ImageObject* mask, const std::vector<double>& percentiles, bool interpolate, int num_threads)
+	{
+		boost::tuple<const ImageObject*, const std::vector<double>&, bool, int> param(mask, percentiles, interpolate, num_threads);
+		callFunctionParamTypeWithReturn(*m_Type, actualGetPercentiles, param);
+	}
+
 	ImageObject* getFlip(int flip_axis)
 	{
 		callFunctionParamTypeWithReturn(*m_Type, actualFlip, flip_axis);
@@ -910,6 +927,18 @@ public:
 	{		
 		callFunctionParamTypeWithReturn(*m_Type, actualGetBufferSize, 1);
 	}
+
+	// Address of the voxel at the min point, which is not the start of the buffer for sub-images
+	void* getDataPointer()
+	{
+		callFunctionParamTypeWithReturn(*m_Type, actualGetDataPointer, 1);
+	}
+
+	// Number of voxels between neighbors along axis (0: x, 1: y, 2: z) in the buffer
+	long getOffset(int axis) const
+	{
+		return m_Image->getOffsetTable()[axis];
+	}
 	
 	unsigned int getVoxelSize()
 	{
@@ -1427,6 +1456,89 @@ protected:
 		return calc;
 	}
 
+	// Fills one calculator per thread from a range of slices of the region and merges them into the first
+	template <class T, class CalcType>
+	void populateCalculatorsParallel(std::vector<CalcType>& calcs, const ImageObject* mask)
+	{
+		auto img = boost::static_pointer_cast<pcl::Image<T,true>>(m_Image);
+		auto region = img->getRegion();
+		if (mask) region.setIntersect(mask->m_Image->getRegion());
+		if (region.empty()) return;
+		pcl::Point3D<int> minp = region.getMinPoint(), maxp = region.getMaxPoint();
+		int num_slices = maxp.z()-minp.z()+1,
+			num_threads = std::max<int>(1, std::min<int>(calcs.size(), num_slices));
+		auto fill = [&](int t) {
+			pcl::Region3D<int> slices(
+				pcl::Point3D<int>(minp.x(), minp.y(), minp.z()+num_slices*t/num_threads),
+				pcl::Point3D<int>(maxp.x(), maxp.y(), minp.z()+num_slices*(t+1)/num_threads-1)
+			);
+			pcl::ImageIterator s_iter(img);
+			s_iter.setRegion(slices);
+			if (!mask) {
+				pcl_ForIterator(s_iter) calcs[t].addValue(img->get(s_iter));
+				return;
+			}
+			pcl::ImageIterator m_iter(mask->m_Image);
+			m_iter.setRegion(slices);
+			if (mask->type()==typeid(char)) {
+				auto mask_img = boost::static_pointer_cast<pcl::Image<char,true>>(mask->m_Image);
+				pcl_ForIterator2(s_iter, m_iter) if (mask_img->get(m_iter)>0) calcs[t].addValue(img->get(s_iter));
+			} else {
+				pcl_ForIterator2(s_iter, m_iter) if (mask->m_Image->getValue(m_iter)>0) calcs[t].addValue(img->get(s_iter));
+			}
+		};
+		std::vector<std::thread> workers;
+		for (int t=1; t<num_threads; ++t) workers.push_back(std::thread(fill, t));
+		fill(0);
+		for (auto w=workers.begin(); w!=workers.end(); ++w) w->join();
+		for (int t=1; t<num_threads; ++t) calcs[0].merge(calcs[t]);
+	}
+
+	template <class T>
+	std::vector<double> getSketchPercentiles(boost::tuple<const ImageObject*, const std::vector<double>&, bool, int>& param)
+	{
+		std::vector<pcl::statistics::TDigest> calcs(getNumberOfThreads(param.get<3>()));
+		populateCalculatorsParallel<T>(calcs, param.get<0>());
+		std::vector<double> result;
+		pcl_ForEach(param.get<1>(), item) result.push_back(calcs[0].getPercentile(*item));
+		return result;
+	}
+
+	template <class T>
+	typename boost::enable_if<boost::is_integral<T>, std::vector<double>>::type actualGetPercentiles(boost::tuple<const ImageObject*, const std::vector<double>&, bool, int>& param)
+	{
+		// At most 2^24 bins (128 MB of counts) over all the histograms, one per thread
+		const double max_bins = 1<<24;
+		T min_val = std::numeric_limits<T>::min(), max_val = std::numeric_limits<T>::max();
+		if (sizeof(T)>2) {
+			// one bin per value of the image, unless the range is too wide for a single histogram
+			boost::tuple<double,double> min_max = actualGetMinMax<T>(1);
+			if (min_max.get<1>()-min_max.get<0>()+1>max_bins) return getSketchPercentiles<T>(param);
+			min_val = static_cast<T>(min_max.get<0>());
+			max_val = static_cast<T>(min_max.get<1>());
+		}
+		// Wide ranges use fewer threads so that the histograms fit in max_bins
+		int num_threads = (int)std::min<double>(getNumberOfThreads(param.get<3>()), floor(max_bins/((double)max_val-(double)min_val+1)));
+		std::vector<pcl::statistics::DenseHistogram<T>> calcs(std::max(1, num_threads));
+		pcl_ForEach(calcs, calc) calc->reserve(min_val, max_val);
+		populateCalculatorsParallel<T>(calcs, param.get<0>());
+		std::vector<double> result;
+		pcl_ForEach(param.get<1>(), item) result.push_back(calcs[0].getPercentile(*item, param.get<2>()));
+		return result;
+	}
+
+	template <class T>
+	typename boost::disable_if<boost::is_integral<T>, std::vector<double>>::type actualGetPercentiles(boost::tuple<const ImageObject*, const std::vector<double>&, bool, int>& param)
+	{
+		return getSketchPercentiles<T>(param);
+	}
+
+	static int getNumberOfThreads(int num_threads)
+	{
+		if (num_threads<=0) num_threads = std::thread::hardware_concurrency();
+		return std::max(1, num_threads);
+	}
+
 	template <class T>
 	ImageObject* actualFlip(int flip_axis)
 	{
@@ -1536,6 +1648,13 @@ protected:
 		return (void*)(boost::static_pointer_cast<pcl::Image<T, true>>(m_Image)->getBuffer()->getPointer());
 	}
 
+	template <class T>
+	void* actualGetDataPointer(int)
+	{
+		auto image = boost::static_pointer_cast<pcl::Image<T, true>>(m_Image);
+		return (void*)(image->getBuffer()->getPointer() + image->localToIndex(image->getMinPoint()));
+	}
+
 	template <class T>
 	unsigned long long actualGetBufferSize(int)
 	{		
@@ -1552,4 +1671,253 @@ protected:
 
 };
 
-#endif
\ No newline at end of file
+// Element-wise operations recorded by ImageExpression
+enum ExpressionOperation
+{
+	ExprAdd, ExprSubtract, ExprMultiply, ExprDivide, ExprReverseSubtract, ExprReverseDivide,
+	ExprMin, ExprMax, ExprEq, ExprNe, ExprGt, ExprGe, ExprLt, ExprLe,
+	ExprClip, ExprNegate, ExprAbs, ExprLog, ExprExp, ExprSqrt
+};
+
+/*
+ Chain of element-wise operations on an image (e.g. (image-mean)/std clipped to a range), recorded lazily and evaluated in one pass.
+ Rows are split over threads and processed in blocks: a block of voxels is converted to double once, every operation runs over
+ the whole block (plain loops the compiler vectorizes) and the block is converted to the result type once. The type of each image
+ is dispatched once per evaluation instead of once per operation and voxel.
+ Intermediate values are doubles, so integer results can differ from the same chain of in-place operations, which round after each one.
+ Integral results saturate at the limits of the type and NaN (e.g. log of a negative value) gives 0.
+ Binary operations take a scalar or an image that contains the region of the source image (read at the same points).
+ The comparisons give 1 or 0; clip takes the lower and upper bounds.
+*/
+class ImageExpression
+{
+public:
+	ImageExpression(const ImageObject& source)
+		: m_Source(source)
+	{
+		if (m_Source.m_Type==NULL) pcl_ThrowException(pcl::Exception(), "Expression on dummy image is not allowed!");
+	}
+
+	void addOperation(ExpressionOperation op, double value, double value2)
+	{
+		m_Operations.push_back(Operation(op, value, value2, -1));
+	}
+
+	void addImageOperation(ExpressionOperation op, const ImageObject& operand)
+	{
+		if (operand.m_Type==NULL) pcl_ThrowException(pcl::Exception(), "Dummy image is not allowed as operand!");
+		if (!operand.m_Image->getRegion().contain(m_Source.m_Image->getRegion())) pcl_ThrowException(pcl::Exception(), "Operand image does not contain the region of the expression!");
+		m_Operations.push_back(Operation(op, 0, 0, m_Operands.size()));
+		m_Operands.push_back(operand);
+	}
+
+	int getNumberOfOperations() const
+	{
+		return m_Operations.size();
+	}
+
+	// Evaluates into a new image of the region of the source image ("auto" type: the type of the source image)
+	ImageObject* evaluate(const std::string& type, int num_threads)
+	{
+		std::unique_ptr<ImageObject> result(new ImageObject(m_Source.m_Image, *m_Source.m_Type));
+		if (type.compare("auto")!=0) {
+			result->m_Type = &getType(type);
+			result->m_TypeStr = type;
+		}
+		callFunctionType(*result->m_Type, result->createActualImage);
+		run(*result, num_threads);
+		return result.release();
+	}
+
+	// Evaluates into the source image.
+	// An operand sharing voxels of the source at other points (e.g. an alias with another min point) would read voxels already written,
+	// the result is then evaluated into a new image and copied.
+	void evaluateInplace(int num_threads)
+	{
+		if (readsOverwrittenVoxels()) {
+			std::unique_ptr<ImageObject> result(evaluate("auto", num_threads));
+			m_Source.fill(*result, m_Source.getMinPoint(), m_Source.getMaxPoint());
+		}
+		else run(m_Source, num_threads);
+	}
+
+protected:
+	static const int BlockSize = 256;
+
+	struct Operation
+	{
+		ExpressionOperation op;
+		double value, value2;
+		int operand;
+
+		Operation(ExpressionOperation o, double v, double v2, int i) : op(o), value(v), value2(v2), operand(i) {}
+	};
+
+	// Strided access to the rows of an image of any type
+	struct RowAccess
+	{
+		char* origin;
+		long offset[3];
+		pcl::Point3D<int> minp;
+		void (*load)(const char*, double*, int);
+		void (*store)(const double*, char*, int);
+
+		char* row(int x, int y, int z) const
+		{
+			return origin + (x-minp.x())*offset[0] + (y-minp.y())*offset[1] + (z-minp.z())*offset[2];
+		}
+	};
+
+	ImageObject m_Source;
+	std::vector<ImageObject> m_Operands;
+	std::vector<Operation> m_Operations;
+
+	template <class T>
+	static void loadRow(const char* p, double* out, int n)
+	{
+		const T* in = reinterpret_cast<const T*>(p);
+		for (int i=0; i<n; ++i) out[i] = static_cast<double>(in[i]);
+	}
+
+	// A plain cast of NaN or of a value out of the range of an integral type is undefined: NaN gives 0, other values saturate
+	template <class T>
+	static typename boost::enable_if<boost::is_integral<T>, T>::type toResultType(double v)
+	{
+		if (v!=v) return 0;
+		if (v<=static_cast<double>(std::numeric_limits<T>::min())) return std::numeric_limits<T>::min();
+		if (v>=static_cast<double>(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+		return static_cast<T>(v);
+	}
+
+	template <class T>
+	static typename boost::disable_if<boost::is_integral<T>, T>::type toResultType(double v)
+	{
+		return static_cast<T>(v);
+	}
+
+	template <class T>
+	static void storeRow(const double* in, char* p, int n)
+	{
+		T* out = reinterpret_cast<T*>(p);
+		for (int i=0; i<n; ++i) out[i] = toResultType<T>(in[i]);
+	}
+
+	template <class T>
+	static void actualRowAccess(RowAccess& access)
+	{
+		access.load = &loadRow<T>;
+		access.store = &storeRow<T>;
+		for (int i=0; i<3; ++i) access.offset[i] *= sizeof(T);
+	}
+
+	static RowAccess getRowAccess(ImageObject& obj)
+	{
+		RowAccess access;
+		access.origin = static_cast<char*>(obj.getDataPointer());
+		for (int i=0; i<3; ++i) access.offset[i] = obj.getOffset(i);
+		access.minp = obj.getMinPoint();
+		callFunctionParamType(*obj.m_Type, actualRowAccess, access);
+		return access;
+	}
+
+	template <class Function>
+	static void applyBinary(double* v, const double* rhs, double value, int n, Function f)
+	{
+		if (rhs) for (int i=0; i<n; ++i) v[i] = f(v[i], rhs[i]);
+		else for (int i=0; i<n; ++i) v[i] = f(v[i], value);
+	}
+
+	void applyOperations(double* v, double* operand_values, const std::vector<RowAccess>& operands, int x, int y, int z, int n) const
+	{
+		for (auto op=m_Operations.begin(); op!=m_Operations.end(); ++op) {
+			const double* rhs = NULL;
+			if (op->operand>=0) {
+				const RowAccess& operand = operands[op->operand];
+				operand.load(operand.row(x, y, z), operand_values, n);
+				rhs = operand_values;
+			}
+			switch (op->op) {
+			case ExprAdd: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a+b; }); break;
+			case ExprSubtract: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a-b; }); break;
+			case ExprMultiply: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a*b; }); break;
+			case ExprDivide: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a/b; }); break;
+			case ExprReverseSubtract: applyBinary(v, rhs, op->value, n, [](double a, double b) { return b-a; }); break;
+			case ExprReverseDivide: applyBinary(v, rhs, op->value, n, [](double a, double b) { return b/a; }); break;
+			case ExprMin: applyBinary(v, rhs, op->value, n, [](double a, double b) { return b<a ? b : a; }); break;
+			case ExprMax: applyBinary(v, rhs, op->value, n, [](double a, double b) { return b>a ? b : a; }); break;
+			case ExprEq: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a==b ? 1.0 : 0.0; }); break;
+			case ExprNe: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a!=b ? 1.0 : 0.0; }); break;
+			case ExprGt: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a>b ? 1.0 : 0.0; }); break;
+			case ExprGe: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a>=b ? 1.0 : 0.0; }); break;
+			case ExprLt: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a<b ? 1.0 : 0.0; }); break;
+			case ExprLe: applyBinary(v, rhs, op->value, n, [](double a, double b) { return a<=b ? 1.0 : 0.0; }); break;
+			case ExprClip: {
+				double lower = op->value, upper = op->value2;
+				for (int i=0; i<n; ++i) v[i] = v[i]<lower ? lower : (v[i]>upper ? upper : v[i]);
+				break;
+			}
+			case ExprNegate: for (int i=0; i<n; ++i) v[i] = -v[i]; break;
+			case ExprAbs: for (int i=0; i<n; ++i) v[i] = std::fabs(v[i]); break;
+			case ExprLog: for (int i=0; i<n; ++i) v[i] = std::log(v[i]); break;
+			case ExprExp: for (int i=0; i<n; ++i) v[i] = std::exp(v[i]); break;
+			case ExprSqrt: for (int i=0; i<n; ++i) v[i] = std::sqrt(v[i]); break;
+			}
+		}
+	}
+
+	// True if an operand overlaps the buffer of the source without reading each voxel at the point it is written (same type, address and offsets)
+	bool readsOverwrittenVoxels()
+	{
+		const char* begin = static_cast<const char*>(m_Source.getBuffer());
+		const char* end = begin + m_Source.getBufferSize();
+		RowAccess source = getRowAccess(m_Source);
+		pcl::Point3D<int> minp = m_Source.getMinPoint();
+		for (auto iter=m_Operands.begin(); iter!=m_Operands.end(); ++iter) {
+			const char* operand_begin = static_cast<const char*>(iter->getBuffer());
+			if (operand_begin+iter->getBufferSize()<=begin || operand_begin>=end) continue;
+			RowAccess operand = getRowAccess(*iter);
+			bool same_voxels = *iter->m_Type==*m_Source.m_Type && operand.row(minp.x(), minp.y(), minp.z())==source.row(minp.x(), minp.y(), minp.z());
+			for (int i=0; i<3; ++i) same_voxels = same_voxels && operand.offset[i]==source.offset[i];
+			if (!same_voxels) return true;
+		}
+		return false;
+	}
+
+	void run(ImageObject& target, int num_threads)
+	{
+		RowAccess source = getRowAccess(m_Source), output = getRowAccess(target);
+		std::vector<RowAccess> operands;
+		for (auto iter=m_Operands.begin(); iter!=m_Operands.end(); ++iter) operands.push_back(getRowAccess(*iter));
+
+		pcl::Point3D<int> minp = m_Source.getMinPoint(), size = m_Source.getSize();
+		long num_rows = (long)size.y()*size.z();
+		auto apply_rows = [&](long begin, long end) {
+			double values[BlockSize], operand_values[BlockSize];
+			for (long r=begin; r<end; ++r) {
+				int y = minp.y() + r%size.y(), z = minp.z() + r/size.y();
+				for (int x=minp.x(); x<minp.x()+size.x(); x+=BlockSize) {
+					int n = std::min<int>(BlockSize, minp.x()+size.x()-x);
+					source.load(source.row(x, y, z), values, n);
+					applyOperations(values, operand_values, operands, x, y, z, n);
+					output.store(values, output.row(x, y, z), n);
+				}
+			}
+		};
+
+		if (num_threads<=0) num_threads = std::thread::hardware_concurrency();
+		num_threads = std::max<int>(1, std::min<long>(num_threads, num_rows));
+		if (num_threads==1) {
+			apply_rows(0, num_rows);
+			return;
+		}
+		std::vector<std::thread> workers;
+		for (int t=0; t<num_threads; ++t) {
+			long begin = num_rows*t/num_threads,
+				end = num_rows*(t+1)/num_threads;
+			workers.push_back(std::thread(apply_rows, begin, end));
+		}
+		for (auto w=workers.begin(); w!=workers.end(); ++w) w->join();
+	}
+};
+
+#endif
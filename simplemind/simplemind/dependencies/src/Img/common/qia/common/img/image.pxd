@@ -190,6 +190,7 @@ cdef extern from "image.h":
         unordered_map_full[boost_tuple[double,double],long long,ihash[double],iequal_to[double]] getJointHistogram(const ImageObject&, const Region3D[int]&, double) nogil
         StatisticsCalculator* getStatisticsCalculator(const ImageObject&) nogil
         PercentileCalculator[double]* getPercentileCalculator(const ImageObject&) nogil
+        vector[double] getPercentiles(const ImageObject*, const vector[double]&, bint, int) nogil except +raisePyError
         vector[double] computeOriginalLongestAxialDiameter() nogil
         vector[double] computeLongestAxialDiameter() nogil
         vector[double] computeLongestDiameter() nogil
@@ -205,6 +206,21 @@ cdef extern from "image.h":
         unsigned long long getBufferSize() nogil  
         unsigned int getVoxelSize() nogil
         void* getBuffer() nogil
+        void* getDataPointer() nogil
+        long getOffset(int) nogil
+
+    cdef enum ExpressionOperation:
+        ExprAdd, ExprSubtract, ExprMultiply, ExprDivide, ExprReverseSubtract, ExprReverseDivide,
+        ExprMin, ExprMax, ExprEq, ExprNe, ExprGt, ExprGe, ExprLt, ExprLe,
+        ExprClip, ExprNegate, ExprAbs, ExprLog, ExprExp, ExprSqrt
+
+    cdef cppclass ImageExpression:
+        ImageExpression(const ImageObject&) nogil except +raisePyError
+        void addOperation(ExpressionOperation, double, double) nogil
+        void addImageOperation(ExpressionOperation, const ImageObject&) nogil except +raisePyError
+        int getNumberOfOperations() nogil
+        ImageObject* evaluate(const string&, int) nogil except +raisePyError
+        void evaluateInplace(int) nogil except +raisePyError
         
 cdef class _GlcmFeatures:
     cdef GlcmFeatures *ptr
@@ -212,3 +228,12 @@ cdef class _GlcmFeatures:
 cdef class _Image:
     cdef ImageObject *ptr
     cdef public object _data
+    cdef Py_ssize_t _shape[3]
+    cdef Py_ssize_t _strides[3]
+
+cdef class _Expression:
+    cdef ImageExpression *ptr
+    cdef _Image _source
+    cdef list _operands
+    cdef ImageExpression* _get(self) except NULL
+    cdef _record(self, ExpressionOperation op, val)
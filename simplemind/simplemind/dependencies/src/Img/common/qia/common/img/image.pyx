@@ -7,6 +7,7 @@ from qia.common.img.common cimport shared_ptr, Point3D, Region3D
 from qia.common.img.element cimport _Element
 from qia.common.img.statistics cimport StatisticsCalculator, PercentileCalculator, _PercCalc, _StatCalc
 from cython.operator cimport dereference as deref, preincrement 
+from cpython.buffer cimport PyBUF_ND, PyBUF_STRIDES, PyBUF_FORMAT, PyBUF_C_CONTIGUOUS, PyBUF_F_CONTIGUOUS, PyBUF_ANY_CONTIGUOUS
 import warnings
 
 import numpy as np
@@ -42,6 +43,11 @@ NP_DTYPE_LOOKUP = {
     np.dtype(np.float64): Type.double
 }
 
+TYPE_NP_DTYPE_LOOKUP = {v: k for k, v in NP_DTYPE_LOOKUP.items()}
+
+# struct format characters given to buffer consumers, kept here so that the pointers stay valid
+BUFFER_FORMAT_LOOKUP = {v: k.char.encode("ascii") for k, v in NP_DTYPE_LOOKUP.items()}
+
 
 cdef class _GlcmFeatures:
     def __dealloc__(self):
@@ -852,6 +858,18 @@ cdef class _Image:
             ret_obj.ptr = self.ptr.getPercentileCalculator(obj.ptr[0])
         return ret_obj
      
+    # Percentiles (0 to 1) of the voxels in mask (whole image if None), computed in one multi-threaded pass (num_threads 0: one per core).
+    # Exact (as the percentile calculator) for integer types, estimated with a t-digest for floating point types.
+    def get_percentiles(self, percentiles, _Image mask=None, bint interpolate=True, int num_threads=0):
+        cdef vector[double] cpercentiles = percentiles
+        cdef const ImageObject* cmask = NULL
+        cdef vector[double] cres
+        if mask is not None:
+            cmask = mask.ptr
+        with nogil:
+            cres = self.ptr.getPercentiles(cmask, cpercentiles, interpolate, num_threads)
+        return list(cres)
+     
     # original Java implementation for longest axis diameter computation	 
     def compute_original_longest_axial_diameter(self):
         with nogil:
@@ -933,6 +951,7 @@ cdef class _Image:
                 for i in orientation:
                     corientation.push_back(i)
             ret.ptr = self.ptr.getAlias(cminp, cspacing, corigin, corientation)
+        ret._data = self._data
         return ret
         
     def get_sub_image(self, min_point, max_point):
@@ -942,44 +961,89 @@ cdef class _Image:
         cmaxp.set(max_point[0],max_point[1],max_point[2])
         ret = _Image()
         ret.ptr = self.ptr.getSubImage(cminp, cmaxp)
+        ret._data = self._data
         return ret
         
     def get_whole_image(self):
         ret = _Image()
         ret.ptr = self.ptr.getWholeImage()
+        ret._data = self._data
         return ret
         
     def is_sub_image(self):
         return self.ptr.isSubImage()
+
+    # Buffer protocol: a (z,y,x) view of the voxels of the image (or sub-image) without copying.
+    # The view keeps the image, and the array the image wraps (see from_array), alive.
+    def __getbuffer__(self, Py_buffer *buffer, int flags):
+        type = self.get_type()
+        if type not in BUFFER_FORMAT_LOOKUP:
+            raise BufferError("Image of type %s has no voxel buffer" % type.value)
+        cdef Point3D[int] size = self.ptr.getSize()
+        cdef Py_ssize_t itemsize = self.ptr.getVoxelSize()
+        self._shape[0] = size.z()
+        self._shape[1] = size.y()
+        self._shape[2] = size.x()
+        self._strides[0] = self.ptr.getOffset(2)*itemsize
+        self._strides[1] = self.ptr.getOffset(1)*itemsize
+        self._strides[2] = itemsize
+        if self.ptr.isSubImage():
+            # rows of a sub-image are not adjacent in the buffer
+            if (flags & PyBUF_STRIDES)!=PyBUF_STRIDES or (flags & PyBUF_C_CONTIGUOUS)==PyBUF_C_CONTIGUOUS or (flags & PyBUF_F_CONTIGUOUS)==PyBUF_F_CONTIGUOUS or (flags & PyBUF_ANY_CONTIGUOUS)==PyBUF_ANY_CONTIGUOUS:
+                raise BufferError("Sub-image is not contiguous, use get_whole_image() or request strides")
+        elif (flags & PyBUF_F_CONTIGUOUS)==PyBUF_F_CONTIGUOUS:
+            raise BufferError("Image is C contiguous (z,y,x), not Fortran contiguous")
+        cdef bytes format = BUFFER_FORMAT_LOOKUP[type]
+        buffer.buf = self.ptr.getDataPointer()
+        buffer.obj = self
+        buffer.len = itemsize*size.x()*size.y()*size.z()
+        buffer.itemsize = itemsize
+        buffer.readonly = 0
+        buffer.ndim = 3
+        buffer.format = NULL
+        if (flags & PyBUF_FORMAT)==PyBUF_FORMAT:
+            buffer.format = format
+        buffer.shape = NULL
+        if (flags & PyBUF_ND)==PyBUF_ND:
+            buffer.shape = self._shape
+        buffer.strides = NULL
+        if (flags & PyBUF_STRIDES)==PyBUF_STRIDES:
+            buffer.strides = self._strides
+        buffer.suboffsets = NULL
+        buffer.internal = NULL
+
+    def __releasebuffer__(self, Py_buffer *buffer):
+        pass
+
+    @property
+    def __array_interface__(self):
+        type = self.get_type()
+        if type not in TYPE_NP_DTYPE_LOOKUP:
+            raise AttributeError("Image of type %s has no voxel buffer" % type.value)
+        size = self.get_size()
+        itemsize = self.ptr.getVoxelSize()
+        return {
+            "version": 3,
+            "shape": (size[2], size[1], size[0]),
+            "typestr": TYPE_NP_DTYPE_LOOKUP[type].str,
+            "data": (<size_t>self.ptr.getDataPointer(), False),
+            "strides": (self.ptr.getOffset(2)*itemsize, self.ptr.getOffset(1)*itemsize, itemsize) if self.ptr.isSubImage() else None,
+        }
+    
+    def expr(self):
+        ret = _Expression()
+        with nogil:
+            ret.ptr = new ImageExpression(self.ptr[0])
+        ret._source = self
+        ret._operands = []
+        return ret
     
     def get_array(self, region=None):
-        cdef np.NPY_TYPES np_type
         type = self.get_type()
-        if type==Type.char:
-            np_type = np.NPY_INT8
-        elif type==Type.uchar:
-            np_type = np.NPY_UINT8
-        elif type==Type.short:
-            np_type = np.NPY_INT16
-        elif type==Type.ushort:
-            np_type = np.NPY_UINT16
-        elif type==Type.int:
-            np_type = np.NPY_INT32
-        elif type==Type.uint:
-            np_type = np.NPY_UINT32
-        elif type==Type.long:
-            np_type = np.NPY_INT64
-        elif type==Type.ulong:
-            np_type = np.NPY_UINT64
-        elif type==Type.float:
-            np_type = np.NPY_FLOAT32
-        elif type==Type.double:
-            np_type = np.NPY_FLOAT64
-        else:
+        if type not in TYPE_NP_DTYPE_LOOKUP:
             raise ValueError("Invalid type %s encountered" % type)
         # get image pointing to the original image
-        whole_image = (<_Image>self.get_whole_image())
-        cdef void* buffer = whole_image.ptr.getBuffer()
+        whole_image = self.get_whole_image()
         # get size of current image
         if region is None:
             region = self.get_region()
@@ -993,11 +1057,8 @@ cdef class _Image:
                 raise ValueError("Min point of requested region is less than image")
         request_offset = [j-i for i,j in zip(whole_image.get_min_point(), region[0])]
                 
-        cdef vector[np.npy_intp] dims
-        dims.push_back(whole_image.get_size()[2])
-        dims.push_back(whole_image.get_size()[1])
-        dims.push_back(whole_image.get_size()[0])
-        arr = np.PyArray_SimpleNewFromData(3, &dims[0], np_type, buffer)
+        # view through the buffer protocol, so the array keeps the image alive
+        arr = np.asarray(whole_image)
 
         return arr[
             request_offset[2]:request_offset[2]+request_size[2],
@@ -1005,6 +1066,98 @@ cdef class _Image:
             request_offset[0]:request_offset[0]+request_size[0],
         ]
         
+# Chain of element-wise operations on an image, evaluated in one multi-threaded pass, e.g.
+#   image.expr().subtract(mean).divide(std).clip(-3, 3).evaluate(Type.float)
+# Operations return the expression; values are doubles until the result is stored (see ImageExpression in image.h).
+cdef class _Expression:
+    def __cinit__(self):
+        self.ptr = NULL
+
+    def __dealloc__(self):
+        del self.ptr
+
+    # expressions are made by _Image.expr(), which sets ptr
+    cdef ImageExpression* _get(self) except NULL:
+        if self.ptr == NULL:
+            raise ValueError("Expression is not bound to an image, use expr() of an image")
+        return self.ptr
+
+    cdef _record(self, ExpressionOperation op, val):
+        if type(val) is _Image:
+            self._get().addImageOperation(op, (<_Image>val).ptr[0])
+            # keeps operands wrapping arrays alive until evaluation
+            self._operands.append(val)
+        else:
+            self._get().addOperation(op, float(val), 0)
+        return self
+
+    def __len__(self):
+        return self._get().getNumberOfOperations()
+
+    def add(self, val):
+        return self._record(ExprAdd, val)
+    def subtract(self, val):
+        return self._record(ExprSubtract, val)
+    def multiply(self, val):
+        return self._record(ExprMultiply, val)
+    def divide(self, val):
+        return self._record(ExprDivide, val)
+    def rsubtract(self, val):
+        return self._record(ExprReverseSubtract, val)
+    def rdivide(self, val):
+        return self._record(ExprReverseDivide, val)
+    def minimum(self, val):
+        return self._record(ExprMin, val)
+    def maximum(self, val):
+        return self._record(ExprMax, val)
+    def eq(self, val):
+        return self._record(ExprEq, val)
+    def ne(self, val):
+        return self._record(ExprNe, val)
+    def gt(self, val):
+        return self._record(ExprGt, val)
+    def ge(self, val):
+        return self._record(ExprGe, val)
+    def lt(self, val):
+        return self._record(ExprLt, val)
+    def le(self, val):
+        return self._record(ExprLe, val)
+
+    def clip(self, double lower, double upper):
+        self._get().addOperation(ExprClip, lower, upper)
+        return self
+    def negate(self):
+        self._get().addOperation(ExprNegate, 0, 0)
+        return self
+    def abs(self):
+        self._get().addOperation(ExprAbs, 0, 0)
+        return self
+    def log(self):
+        self._get().addOperation(ExprLog, 0, 0)
+        return self
+    def exp(self):
+        self._get().addOperation(ExprExp, 0, 0)
+        return self
+    def sqrt(self):
+        self._get().addOperation(ExprSqrt, 0, 0)
+        return self
+
+    # num_threads 0: one thread per core
+    def evaluate(self, type=Type.auto, int num_threads=0):
+        cdef string ctype = type.value.encode("utf-8")
+        cdef ImageExpression* expr = self._get()
+        ret = _Image()
+        ret._data = None
+        with nogil:
+            ret.ptr = expr.evaluate(ctype, num_threads)
+        return ret
+
+    def evaluate_inplace(self, int num_threads=0):
+        cdef ImageExpression* expr = self._get()
+        with nogil:
+            expr.evaluateInplace(num_threads)
+        return self._source
+
 def new(type, minp, maxp, spacing=(1,1,1), origin=(0,0,0), orientation=(1,0,0,0,1,0,0,0,1), double fillval=0):
     cdef Point3D[int] cminp
     cdef Point3D[int] cmaxp
@@ -1030,7 +1183,9 @@ def cast(_Image obj, type=Type.auto, bint copy=False, double fillval=0):
     ret_obj.ptr = new ImageObject(type.value.encode("utf-8"), obj.ptr[0], copy, fillval)
     return ret_obj
     
-def from_array(array, template=None):
+# Wraps the array (z,y,x) in an image. The array is copied only if it is not C contiguous or not writeable,
+# which raises ValueError instead if allow_copy is False.
+def from_array(array, template=None, bint allow_copy=True):
     cdef Point3D[int] cminp
     cdef Point3D[int] cmaxp
     cdef Point3D[double] cspacing
@@ -1064,8 +1219,12 @@ def from_array(array, template=None):
     if array.dtype not in NP_DTYPE_LOOKUP:
         raise ValueError("Conversion from %s is not supported" % array.dtype)
     type = NP_DTYPE_LOOKUP[array.dtype]
+    if not (array.flags.c_contiguous and array.flags.writeable):
+        if not allow_copy:
+            raise ValueError("Array is not C contiguous and writeable, it cannot be wrapped without copying")
+        array = np.array(array, order="C")
     ret_obj = _Image()
-    ret_obj._data = np.ascontiguousarray(array)
+    ret_obj._data = array
     cdef string ctype = type.value.encode("utf-8")
     ret_obj.ptr = new ImageObject(np.PyArray_GETPTR3(ret_obj._data, 0,0,0),
         ctype,
@@ -1073,6 +1232,10 @@ def from_array(array, template=None):
     )
     return ret_obj
 
+# Image sharing the voxels of the array, writes through either are seen by the other
+def wrap_array(array, template=None):
+    return from_array(array, template, allow_copy=False)
+
 def read(file, type=Type.auto):
     cdef string cfile = str(file).encode("utf-8")
     cdef string ctype = type.value.encode("utf-8")
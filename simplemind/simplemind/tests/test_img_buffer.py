@@ -0,0 +1,215 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Tests for the NumPy views of qia.common.img images (buffer protocol, __array_interface__, get_array, from_array and wrap_array).
+
+From the project root (the Img extension must be built in simplemind/dependencies/bin):
+```
+pytest -s simplemind/tests/test_img_buffer.py
+```
+"""
+
+import pytest
+
+import gc
+import ctypes
+import numpy as np
+
+from simplemind import __qia__
+import qia.common.img.image as qimage
+
+# Request flags of PyObject_GetBuffer (Include/cpython/object.h)
+PyBUF_SIMPLE = 0
+PyBUF_WRITABLE = 0x0001
+PyBUF_FORMAT = 0x0004
+PyBUF_ND = 0x0008
+PyBUF_STRIDES = 0x0010 | PyBUF_ND
+PyBUF_C_CONTIGUOUS = 0x0020 | PyBUF_STRIDES
+PyBUF_F_CONTIGUOUS = 0x0040 | PyBUF_STRIDES
+PyBUF_ANY_CONTIGUOUS = 0x0080 | PyBUF_STRIDES
+
+class Py_buffer(ctypes.Structure):
+    _fields_ = [
+        ('buf', ctypes.c_void_p),
+        ('obj', ctypes.c_void_p),
+        ('len', ctypes.c_ssize_t),
+        ('itemsize', ctypes.c_ssize_t),
+        ('readonly', ctypes.c_int),
+        ('ndim', ctypes.c_int),
+        ('format', ctypes.c_char_p),
+        ('shape', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('strides', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('suboffsets', ctypes.POINTER(ctypes.c_ssize_t)),
+        ('internal', ctypes.c_void_p),
+    ]
+
+ctypes.pythonapi.PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(Py_buffer), ctypes.c_int]
+ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(Py_buffer)]
+
+def get_buffer(obj, flags):
+    '''
+    Returns the fields of the buffer obj gives for the request flags (None for the NULL pointers), raises what __getbuffer__ raises
+    '''
+    view = Py_buffer()
+    ctypes.pythonapi.PyObject_GetBuffer(obj, ctypes.byref(view), flags)
+    try:
+        return {
+            'buf': view.buf,
+            'len': view.len,
+            'itemsize': view.itemsize,
+            'readonly': view.readonly,
+            'ndim': view.ndim,
+            'format': view.format,
+            'shape': tuple(view.shape[i] for i in range(view.ndim)) if view.shape else None,
+            'strides': tuple(view.strides[i] for i in range(view.ndim)) if view.strides else None,
+        }
+    finally:
+        ctypes.pythonapi.PyBuffer_Release(ctypes.byref(view))
+
+def ramp(shape, dtype=np.int16):
+    '''
+    (z,y,x) array whose voxels all differ
+    '''
+    return np.arange(np.prod(shape)).reshape(shape).astype(dtype)
+
+####################################################################################################################
+# Buffer protocol
+####################################################################################################################
+def test_buffer_of_whole_image():
+    arr = ramp((3, 4, 5))
+    image = qimage.from_array(arr)
+    data = np.asarray(image).ctypes.data
+    for flags in (PyBUF_SIMPLE, PyBUF_ND, PyBUF_STRIDES, PyBUF_C_CONTIGUOUS, PyBUF_ANY_CONTIGUOUS):
+        view = get_buffer(image, flags | PyBUF_WRITABLE)
+        assert view['buf'] == data
+        assert view['len'] == arr.nbytes
+        assert view['itemsize'] == 2
+        assert view['readonly'] == 0
+        assert view['ndim'] == 3
+        assert view['format'] is None
+        assert view['shape'] == ((3, 4, 5) if flags & PyBUF_ND else None)
+        assert view['strides'] == ((40, 10, 2) if (flags & PyBUF_STRIDES) == PyBUF_STRIDES else None)
+    assert get_buffer(image, PyBUF_FORMAT)['format'] == b'h'
+    with pytest.raises(BufferError):
+        get_buffer(image, PyBUF_F_CONTIGUOUS)
+
+def test_buffer_of_sub_image():
+    image = qimage.from_array(ramp((3, 4, 5)))
+    sub = image.get_sub_image((1, 1, 0), (3, 2, 1))
+    view = get_buffer(sub, PyBUF_STRIDES | PyBUF_FORMAT)
+    assert view['buf'] == np.asarray(image).ctypes.data + (0*20 + 1*5 + 1)*2
+    assert view['shape'] == (2, 2, 3)
+    assert view['strides'] == (40, 10, 2)
+    assert view['format'] == b'h'
+    # rows of a sub-image are not adjacent, requests that assume it are refused
+    for flags in (PyBUF_SIMPLE, PyBUF_ND, PyBUF_C_CONTIGUOUS, PyBUF_F_CONTIGUOUS, PyBUF_ANY_CONTIGUOUS):
+        with pytest.raises(BufferError):
+            get_buffer(sub, flags)
+    with pytest.raises(BufferError):
+        (ctypes.c_char * 12).from_buffer(sub)
+
+def test_buffer_of_every_type():
+    for dtype in (np.int8, np.uint8, np.int16, np.uint16, np.int32, np.uint32, np.int64, np.uint64, np.float32, np.float64):
+        arr = ramp((2, 3, 4), dtype)
+        image = qimage.from_array(arr)
+        assert image.get_type() == qimage.NP_DTYPE_LOOKUP[np.dtype(dtype)]
+        view = np.asarray(image)
+        assert view.dtype == np.dtype(dtype)
+        np.testing.assert_array_equal(view, arr)
+        assert memoryview(image).format == np.dtype(dtype).char
+
+####################################################################################################################
+# NumPy views
+####################################################################################################################
+def test_array_views_share_voxels():
+    image = qimage.from_array(ramp((3, 4, 5)))
+    view = np.asarray(image)
+    assert view.flags.c_contiguous
+    view[2, 1, 3] = -7
+    assert image.get_value((3, 1, 2)) == -7
+    image.set_value((0, 3, 1), 99)
+    assert view[1, 3, 0] == 99
+
+    sub = image.get_sub_image((1, 1, 0), (3, 2, 1))
+    sub_view = np.asarray(sub)
+    assert sub_view.shape == (2, 2, 3)
+    assert not sub_view.flags.c_contiguous
+    np.testing.assert_array_equal(sub_view, view[0:2, 1:3, 1:4])
+    sub_view[1, 0, 2] = 1234
+    assert image.get_value((3, 1, 1)) == 1234
+    np.testing.assert_array_equal(sub.get_array(), view[0:2, 1:3, 1:4])
+
+def test_array_interface():
+    image = qimage.from_array(ramp((3, 4, 5), np.float32))
+    interface = image.__array_interface__
+    assert interface['shape'] == (3, 4, 5)
+    assert np.dtype(interface['typestr']) == np.dtype(np.float32)
+    assert interface['data'] == (np.asarray(image).ctypes.data, False)
+    assert interface['strides'] is None
+
+    sub = image.get_sub_image((2, 0, 1), (4, 3, 2))
+    interface = sub.__array_interface__
+    assert interface['shape'] == (2, 4, 3)
+    assert interface['strides'] == (80, 20, 4)
+    assert interface['data'][0] == np.asarray(image).ctypes.data + (1*20 + 2)*4
+
+####################################################################################################################
+# Lifetime of the voxels
+####################################################################################################################
+def test_get_array_keeps_image_alive():
+    expected = ramp((3, 4, 5))
+    # an image that owns its voxels
+    image = qimage.cast(qimage.from_array(expected), copy=True)
+    arr = image.get_array()
+    sub_arr = image.get_sub_image((1, 1, 1), (3, 2, 2)).get_array()
+    del image
+    gc.collect()
+    # voxels freed with the image would be reused by these
+    garbage = [np.full((3, 4, 5), -1, np.int16) for i in range(20)]
+    np.testing.assert_array_equal(arr, expected)
+    np.testing.assert_array_equal(sub_arr, expected[1:3, 1:3, 1:4])
+
+def test_wrap_array_shares_voxels():
+    arr = ramp((3, 4, 5))
+    image = qimage.wrap_array(arr)
+    assert np.asarray(image).ctypes.data == arr.ctypes.data
+    arr[1, 2, 3] = -5
+    assert image.get_value((3, 2, 1)) == -5
+    image.fill(8)
+    assert np.all(arr == 8)
+
+def test_wrap_array_keeps_array_alive():
+    expected = ramp((3, 4, 5))
+    image = qimage.wrap_array(expected.copy())
+    alias = image.get_alias(min_point=(10, 10, 10))
+    sub = image.get_sub_image((0, 1, 1), (4, 2, 2))
+    whole = sub.get_whole_image()
+    del image
+    gc.collect()
+    garbage = [np.full((3, 4, 5), -1, np.int16) for i in range(20)]
+    assert alias.get_value((13, 12, 11)) == expected[1, 2, 3]
+    np.testing.assert_array_equal(np.asarray(sub), expected[1:3, 1:3, :])
+    np.testing.assert_array_equal(np.asarray(whole), expected)
+    del alias, whole
+    gc.collect()
+    garbage = [np.full((3, 4, 5), -1, np.int16) for i in range(20)]
+    np.testing.assert_array_equal(np.asarray(sub), expected[1:3, 1:3, :])
+
+def test_wrap_array_refuses_copies():
+    arr = ramp((3, 4, 6))
+    with pytest.raises(ValueError):
+        qimage.wrap_array(arr[:, :, ::2])
+    read_only = arr.copy()
+    read_only.flags.writeable = False
+    with pytest.raises(ValueError):
+        qimage.wrap_array(read_only)
+
+    # from_array copies them instead
+    image = qimage.from_array(arr[:, :, ::2])
+    np.testing.assert_array_equal(np.asarray(image), arr[:, :, ::2])
+    image.fill(0)
+    assert arr[0, 0, 2] == 2
+    image = qimage.from_array(read_only)
+    image.fill(0)
+    np.testing.assert_array_equal(read_only, arr)
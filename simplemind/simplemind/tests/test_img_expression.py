@@ -0,0 +1,204 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Tests for the element-wise expressions of qia.common.img images (image.expr()), against the same operations in NumPy.
+
+From the project root (the Img extension must be built in simplemind/dependencies/bin):
+```
+pytest -s simplemind/tests/test_img_expression.py
+```
+"""
+
+import pytest
+
+import numpy as np
+
+from simplemind import __qia__
+import qia.common.img.image as qimage
+
+def random_array(shape, seed, low=0.5, high=5.0):
+    '''
+    (z,y,x) doubles in [low,high), a few of them exactly 2.5 (the scalar operand of the tests)
+    '''
+    rng = np.random.RandomState(seed)
+    arr = rng.uniform(low, high, shape)
+    arr.flat[::7] = 2.5
+    return arr
+
+####################################################################################################################
+# Operations
+####################################################################################################################
+SCALAR_OPERATIONS = [
+    ('add', lambda v, s: v+s),
+    ('subtract', lambda v, s: v-s),
+    ('multiply', lambda v, s: v*s),
+    ('divide', lambda v, s: v/s),
+    ('rsubtract', lambda v, s: s-v),
+    ('rdivide', lambda v, s: s/v),
+    ('minimum', np.minimum),
+    ('maximum', np.maximum),
+    ('eq', lambda v, s: (v==s).astype(np.float64)),
+    ('ne', lambda v, s: (v!=s).astype(np.float64)),
+    ('gt', lambda v, s: (v>s).astype(np.float64)),
+    ('ge', lambda v, s: (v>=s).astype(np.float64)),
+    ('lt', lambda v, s: (v<s).astype(np.float64)),
+    ('le', lambda v, s: (v<=s).astype(np.float64)),
+]
+
+@pytest.mark.parametrize('name, expected', SCALAR_OPERATIONS)
+def test_scalar_operation(name, expected):
+    # rows longer than a block (256 voxels) and more rows than threads
+    arr = random_array((3, 7, 300), 1)
+    image = qimage.from_array(arr)
+    expr = getattr(image.expr(), name)(2.5)
+    assert len(expr) == 1
+    result = expr.evaluate(qimage.Type.double)
+    np.testing.assert_array_equal(result.get_array(), expected(arr, 2.5))
+
+@pytest.mark.parametrize('name, expected', SCALAR_OPERATIONS)
+def test_image_operation(name, expected):
+    arr, operand = random_array((3, 7, 300), 2), random_array((3, 7, 300), 3)
+    image = qimage.from_array(arr)
+    result = getattr(image.expr(), name)(qimage.from_array(operand)).evaluate(qimage.Type.double)
+    np.testing.assert_array_equal(result.get_array(), expected(arr, operand))
+
+def test_unary_operations():
+    arr = random_array((2, 5, 9), 4, -3, 3)
+    image = qimage.from_array(arr)
+    np.testing.assert_array_equal(image.expr().negate().evaluate().get_array(), -arr)
+    np.testing.assert_array_equal(image.expr().abs().evaluate().get_array(), np.abs(arr))
+    np.testing.assert_array_equal(image.expr().clip(-1, 2).evaluate().get_array(), np.clip(arr, -1, 2))
+    np.testing.assert_allclose(image.expr().exp().evaluate().get_array(), np.exp(arr), rtol=1e-14)
+    np.testing.assert_allclose(image.expr().abs().log().evaluate().get_array(), np.log(np.abs(arr)), rtol=1e-14)
+    np.testing.assert_allclose(image.expr().abs().sqrt().evaluate().get_array(), np.sqrt(np.abs(arr)), rtol=1e-14)
+
+def test_chain_is_evaluated_in_double():
+    arr = (random_array((2, 6, 40), 5, -500, 500)).astype(np.int16)
+    image = qimage.from_array(arr)
+    mean, std = float(arr.mean()), float(arr.std())
+    expr = image.expr().subtract(mean).divide(std).clip(-1.5, 1.5).multiply(100)
+    assert len(expr) == 4
+    result = expr.evaluate(qimage.Type.float)
+    assert result.get_type() == qimage.Type.float
+    np.testing.assert_array_equal(result.get_array(), (np.clip((arr-mean)/std, -1.5, 1.5)*100).astype(np.float32))
+    # the source type by default, truncated once at the end
+    result = expr.evaluate()
+    assert result.get_type() == qimage.Type.short
+    np.testing.assert_array_equal(result.get_array(), np.trunc(np.clip((arr-mean)/std, -1.5, 1.5)*100).astype(np.int16))
+    # the source is unchanged
+    np.testing.assert_array_equal(image.get_array(), arr)
+
+def test_result_does_not_depend_on_threads():
+    arr, operand = random_array((4, 9, 70), 6), random_array((4, 9, 70), 7)
+    image, operand_image = qimage.from_array(arr), qimage.from_array(operand)
+    expected = image.expr().multiply(operand_image).sqrt().add(1).evaluate(num_threads=1).get_array()
+    for num_threads in (0, 2, 3, 8, 100):
+        result = image.expr().multiply(operand_image).sqrt().add(1).evaluate(num_threads=num_threads)
+        np.testing.assert_array_equal(result.get_array(), expected)
+
+####################################################################################################################
+# Integral results
+####################################################################################################################
+def test_integral_results_saturate():
+    image = qimage.from_array(np.array([[[-3, 0, 100, 30000]]], np.int16))
+    np.testing.assert_array_equal(image.expr().multiply(20000).evaluate().get_array(), [[[-32768, 0, 32767, 32767]]])
+    np.testing.assert_array_equal(image.expr().evaluate(qimage.Type.uchar).get_array(), [[[0, 0, 100, 255]]])
+    np.testing.assert_array_equal(image.expr().multiply(1e300).evaluate(qimage.Type.long).get_array(),
+        [[[np.iinfo(np.int64).min, 0, np.iinfo(np.int64).max, np.iinfo(np.int64).max]]])
+    np.testing.assert_array_equal(image.expr().multiply(-1e300).evaluate(qimage.Type.ulong).get_array(),
+        [[[np.iinfo(np.uint64).max, 0, 0, 0]]])
+
+def test_nan_gives_zero_for_integral_results():
+    image = qimage.from_array(np.array([[[-3, 0, 100, 30000]]], np.int16))
+    # log(-3) is NaN, log(0) is -inf
+    np.testing.assert_array_equal(image.expr().log().evaluate(qimage.Type.int).get_array(), [[[0, np.iinfo(np.int32).min, 4, 10]]])
+    result = image.expr().log().evaluate(qimage.Type.float).get_array()
+    assert np.isnan(result[0, 0, 0])
+    assert result[0, 0, 1] == -np.inf
+
+####################################################################################################################
+# In-place evaluation
+####################################################################################################################
+def test_evaluate_inplace():
+    arr = random_array((3, 7, 300), 8)
+    image = qimage.from_array(arr.copy())
+    assert image.expr().subtract(1).multiply(2).evaluate_inplace() is image
+    np.testing.assert_array_equal(image.get_array(), (arr-1)*2)
+
+def test_evaluate_inplace_with_the_source_as_operand():
+    arr = random_array((3, 7, 300), 9)
+    image = qimage.from_array(arr.copy())
+    image.expr().multiply(image).add(image).evaluate_inplace()
+    np.testing.assert_array_equal(image.get_array(), arr*arr+arr)
+    # an alias at the same points reads each voxel where it is written too
+    image.expr().subtract(image.get_alias(min_point=(0, 0, 0))).evaluate_inplace()
+    np.testing.assert_array_equal(image.get_array(), np.zeros(arr.shape))
+
+@pytest.mark.parametrize('num_threads', [1, 0, 4])
+def test_evaluate_inplace_with_shifted_alias(num_threads):
+    arr = random_array((2, 40, 30), 10)
+    # the alias reads the row before (min point (0,1,0)) or after (min point (0,-1,0)) the voxel written
+    for shift in (1, -1):
+        image = qimage.from_array(arr.copy())
+        if shift==1:
+            sub = image.get_sub_image((0, 1, 0), (29, 39, 1))
+            expected = arr.copy()
+            expected[:, 1:, :] = arr[:, 1:, :] + arr[:, :-1, :]
+        else:
+            sub = image.get_sub_image((0, 0, 0), (29, 38, 1))
+            expected = arr.copy()
+            expected[:, :-1, :] = arr[:, :-1, :] + arr[:, 1:, :]
+        alias = image.get_alias(min_point=(0, shift, 0))
+        sub.expr().add(alias).evaluate_inplace(num_threads)
+        np.testing.assert_array_equal(image.get_array(), expected)
+
+def test_evaluate_inplace_with_wrapped_arrays_sharing_voxels():
+    arr = random_array((3, 20, 30), 11)
+    expected = arr[1:] + arr[:-1]
+    image = qimage.wrap_array(arr[1:])
+    # another image on the voxels of the array, one plane before
+    operand = qimage.wrap_array(arr[:-1])
+    image.expr().add(operand).evaluate_inplace()
+    np.testing.assert_array_equal(image.get_array(), expected)
+
+####################################################################################################################
+# Sub-images
+####################################################################################################################
+def test_sub_image_source():
+    arr, operand = random_array((3, 8, 9), 12), random_array((3, 8, 9), 13)
+    image, operand_image = qimage.from_array(arr.copy()), qimage.from_array(operand)
+    sub = image.get_sub_image((1, 2, 0), (6, 5, 1))
+    result = sub.expr().subtract(operand_image).evaluate()
+    assert result.get_min_point() == (1, 2, 0)
+    assert result.get_size() == (6, 4, 2)
+    np.testing.assert_array_equal(result.get_array(), arr[0:2, 2:6, 1:7] - operand[0:2, 2:6, 1:7])
+
+    # in place, only the sub-image changes
+    sub.expr().multiply(-1).evaluate_inplace()
+    expected = arr.copy()
+    expected[0:2, 2:6, 1:7] *= -1
+    np.testing.assert_array_equal(image.get_array(), expected)
+
+def test_sub_image_operands():
+    arr, operand = random_array((3, 8, 9), 14), random_array((3, 8, 9), 15)
+    image, operand_image = qimage.from_array(arr), qimage.from_array(operand)
+    sub = image.get_sub_image((1, 2, 0), (6, 5, 1))
+    # an operand that is a sub-image of the same region or of a larger one
+    for operand_sub in (operand_image.get_sub_image((1, 2, 0), (6, 5, 1)), operand_image.get_sub_image((0, 1, 0), (8, 6, 2))):
+        result = sub.expr().multiply(operand_sub).evaluate()
+        np.testing.assert_array_equal(result.get_array(), arr[0:2, 2:6, 1:7] * operand[0:2, 2:6, 1:7])
+    # a sub-image operand of the whole source
+    result = image.expr().add(operand_image.get_sub_image((0, 0, 0), (8, 7, 2))).evaluate()
+    np.testing.assert_array_equal(result.get_array(), arr + operand)
+    # operands must contain the region of the source
+    with pytest.raises(RuntimeError):
+        sub.expr().add(operand_image.get_sub_image((2, 2, 0), (6, 5, 1)))
+    with pytest.raises(RuntimeError):
+        image.expr().add(operand_image.get_sub_image((0, 0, 0), (8, 7, 1)))
+
+def test_unbound_expression():
+    with pytest.raises(ValueError):
+        qimage._Expression().add(1)
+    with pytest.raises(ValueError):
+        qimage._Expression().evaluate()
@@ -155,7 +155,24 @@ from cnntools import _get_owner, _get_original_cmd, lock_file, unlock_file
 logging.getLogger('matplotlib').setLevel(logging.ERROR)
 import matplotlib.pyplot as plt
 
-def main(config_model, config_resource, log):
+def main(config_model, config_resource, log, network_cache=None, image_cache=None, batch_size=1):
+    """Predict the ROIs of a node and write them to the output directory
+
+    Parameters
+    ----------
+    config_model: dict
+        model configuration map
+    config_resource: dict
+        resource configuration map
+    log: logging.Logger
+        logging class instance
+    network_cache: dict (optional. default=None)
+        networks with loaded weights, reused by later calls (see cnn_predict_server.py)
+    image_cache: dict (optional. default=None)
+        base image read for the last image path, reused by later calls
+    batch_size: int (optional. default=1)
+        number of inputs (e.g., slices) predicted per batch
+    """
     try:
         """
         TODO: @youngwonchoi
@@ -204,7 +221,15 @@ def main(config_model, config_resource, log):
         process_cmd = ' '.join(_get_original_cmd(process_id))
         status_update_weight = False
         
-        network.set_network(target_shape, img_channels)
+        network_key = (config_model['model_info']['network_class'], config_model['model_info']['architecture'],
+                       network.saved_weight_path, tuple(np.ravel(target_shape)), img_channels)
+        if network_cache is not None and network_key in network_cache:
+            network = network_cache[network_key]
+            log.info(f'Reusing the network loaded with weights {network.saved_weight_path}')
+        else:
+            network.set_network(target_shape, img_channels)
+            if network_cache is not None:
+                network_cache[network_key] = network
 
         # tic = timeit.default_timer()
         # while True:
@@ -251,7 +276,7 @@ def main(config_model, config_resource, log):
         img_arr = reader.get_predict_mini_batch([0])
         
         """4. Predict ROIs"""
-        pred = network.predict(img_arr, batch_size=1)
+        pred = network.predict(img_arr, batch_size=batch_size)
         # log.debug(f'prediction: {pred}')
         """5. Write ROIs.
         TODO
@@ -260,7 +285,14 @@ def main(config_model, config_resource, log):
         need some wrapper in reader class...
         should not using qimage.load outside the reader..
         """
-        base_img = qimage.read(image_path)
+        if image_cache is not None and image_path in image_cache:
+            base_img = image_cache[image_path]
+        else:
+            base_img = qimage.read(image_path)
+            if image_cache is not None:
+                # Only the image of the current case is kept
+                image_cache.clear()
+                image_cache[image_path] = base_img
         # try:
         #     base_img = qimage.read(image_path) #our inhouse image object format
         # except Exception as e:
@@ -330,6 +362,61 @@ def main(config_model, config_resource, log):
         raise ValueError('cnn_train.py failed with exception ', e)
     # finally:
 
+def read_configs(model_config_path, log):
+    """Read the model and resource configuration maps
+
+    Parameters
+    ----------
+    model_config_path: str
+        model configuration file path
+    log: logging.Logger
+        logging class instance
+
+    Returns
+    -------
+    tuple of dict
+        model and resource configuration maps
+    """
+    """Model configuration maps"""
+    log.info('---------------------------------------------------------------')
+    log.info('Model Configuration')
+    log.info('---------------------------------------------------------------')
+    log.debug(f'Model configuration path: {model_config_path}')
+    config_model_class = Configurator(model_config_path, log)
+    config_model_class.set_config_map(config_model_class.get_section_map())
+    config_model_class.print_config_map()
+    config_model = config_model_class.get_config_map()
+    log.debug(config_model)
+
+    """Resource configuration maps"""
+    log.info('---------------------------------------------------------------')
+    log.info('Resource Configuration')
+    log.info('---------------------------------------------------------------')
+    is_predict_with_cpu = config_model['switch_from_miu_info']['predict_cpu_only'].strip().lower()
+    # log.debug(f'Use a single-core CPU for predictions: {is_predict_with_cpu}')
+    # if (is_predict_with_cpu == 'true'): predict_with_cpu = True
+    # else: predict_with_cpu = False
+    # if not predict_with_cpu:
+    #     if os.path.exists(args.resource_config):
+    #         resource_config_path = args.resource_config
+    #     else:
+    #         resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
+    #         log.info('No resource information is detected. Reference resource configuration is used instead.')
+    #         log.info('MIU will use CPU resources only.')
+    # else:
+    #     resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
+    #     log.info('With the `-p` argument, MIU will use CPU resources only for prediction.')
+    log.info('Before fixing the watcher problem for prediction, we will use CPU only prediction....')
+    resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
+    log.info('---------------------------------------------------------------')
+    config_resource_class = Configurator(resource_config_path, log)
+    config_resource_class.set_config_map(config_resource_class.get_section_map())
+    log.debug(f'Resource configuration path: {resource_config_path}')
+    config_resource_class.print_config_map()
+    config_resource = config_resource_class.get_config_map()
+    log.debug(config_resource)
+    return config_model, config_resource
+
 if __name__=='__main__':
     """Parsing the input arguments"""
     parser = ArgumentParser(description='Script to run a CNN model prediction from miu')
@@ -371,43 +458,5 @@ if __name__=='__main__':
     log.info(f'tensorflow v. {tf.__version__}')
     log.info(f'keras v. {keras.__version__}')
 
-    """Model configuration maps"""
-    log.info('---------------------------------------------------------------')
-    log.info('Model Configuration')
-    log.info('---------------------------------------------------------------')
-    log.debug(f'Model configuration path: {args.model_config}')
-    config_model_class = Configurator(args.model_config, log)
-    config_model_class.set_config_map(config_model_class.get_section_map())
-    config_model_class.print_config_map()
-    config_model = config_model_class.get_config_map()
-    log.debug(config_model)
-
-    """Resource configuration maps"""
-    log.info('---------------------------------------------------------------')
-    log.info('Resource Configuration')
-    log.info('---------------------------------------------------------------')
-    is_predict_with_cpu = config_model['switch_from_miu_info']['predict_cpu_only'].strip().lower()
-    # log.debug(f'Use a single-core CPU for predictions: {is_predict_with_cpu}')
-    # if (is_predict_with_cpu == 'true'): predict_with_cpu = True
-    # else: predict_with_cpu = False
-    # if not predict_with_cpu:
-    #     if os.path.exists(args.resource_config):
-    #         resource_config_path = args.resource_config
-    #     else:
-    #         resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
-    #         log.info('No resource information is detected. Reference resource configuration is used instead.')
-    #         log.info('MIU will use CPU resources only.')
-    # else:
-    #     resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
-    #     log.info('With the `-p` argument, MIU will use CPU resources only for prediction.')
-    log.info('Before fixing the watcher problem for prediction, we will use CPU only prediction....')
-    resource_config_path = os.path.join(os.path.dirname(__file__), "ref_resource.ini")
-    log.info('---------------------------------------------------------------')
-    config_resource_class = Configurator(resource_config_path, log)
-    config_resource_class.set_config_map(config_resource_class.get_section_map())
-    log.debug(f'Resource configuration path: {resource_config_path}')
-    config_resource_class.print_config_map()
-    config_resource = config_resource_class.get_config_map()
-    log.debug(config_resource)
-
+    config_model, config_resource = read_configs(args.model_config, log)
     main(config_model, config_resource, log)
\ No newline at end of file
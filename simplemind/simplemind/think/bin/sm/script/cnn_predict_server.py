@@ -0,0 +1,141 @@
+"""Prediction server
+
+This script runs CNN model predictions for miu in a persistent process
+(see CnnPredictWorker in pclMIU), so that tensorflow is imported and the
+networks with their weights are loaded once instead of for every node and case.
+
+    * serve - reads the requests and writes the replies
+
+Requests are read from the standard input, one per line, and each is answered
+with one line on the standard output:
+    predict<TAB>MODEL_CONFIG_PATH<TAB>RESOURCE_CONFIG_PATH
+        runs the prediction as cnn_predict.py with the same arguments,
+        replies `ok` or `error MESSAGE`
+    quit
+        exits the server
+The log is written to the standard error.
+
+Parameters
+----------
+-v: int
+    '--verbose': (optional) default=0
+    set the logging level
+        0: no logging (critical error only)
+        1: info level
+        2: debug level
+-b: int
+    '--batch_size': (optional) default=8
+    number of inputs (e.g., slices) predicted per batch
+-n: int
+    '--max_networks': (optional) default=4
+    number of networks kept loaded, the least recently used one is dropped
+    when another is loaded (e.g., for each chromosome with different weights)
+"""
+
+import os
+import gc
+import sys
+import logging
+import traceback
+from argparse import ArgumentParser
+from collections import OrderedDict
+
+"""The replies use the original standard output, anything else printed goes to the standard error"""
+reply = os.fdopen(os.dup(1), 'w')
+os.dup2(2, 1)
+sys.stdout = sys.stderr
+
+import numpy as np
+import tensorflow as tf
+import keras
+import cnn_predict
+
+class LRUCache(OrderedDict):
+    """Dictionary that keeps at most max_size entries, dropping the least recently used one
+
+    Parameters
+    ----------
+    max_size: int
+        maximum number of entries
+    log: logging.Logger
+        logging class instance
+    """
+    def __init__(self, max_size, log):
+        super().__init__()
+        self.max_size = max_size
+        self.log = log
+
+    def __getitem__(self, key):
+        value = super().__getitem__(key)
+        self.move_to_end(key)
+        return value
+
+    def __setitem__(self, key, value):
+        super().__setitem__(key, value)
+        self.move_to_end(key)
+        while len(self) > self.max_size:
+            dropped_key, _ = self.popitem(last=False)
+            self.log.info(f'Dropping the least recently used network: {dropped_key}')
+            gc.collect()
+
+def serve(log, batch_size, max_networks):
+    """Serves the requests until `quit` or the end of the standard input
+
+    Parameters
+    ----------
+    log: logging.Logger
+        logging class instance
+    batch_size: int
+        number of inputs (e.g., slices) predicted per batch
+    max_networks: int
+        number of networks kept loaded
+    """
+    network_cache = LRUCache(max_networks, log)
+    image_cache = {}
+    for line in sys.stdin:
+        request = line.rstrip('\n').split('\t')
+        if request[0] == 'quit':
+            break
+        if (request[0] == 'predict') and (len(request) == 3):
+            try:
+                config_model, config_resource = cnn_predict.read_configs(request[1], log)
+                cnn_predict.main(config_model, config_resource, log, network_cache=network_cache,
+                                 image_cache=image_cache, batch_size=batch_size)
+                result = 'ok'
+            except Exception as e:
+                traceback.print_exc()
+                result = 'error ' + ' '.join(str(e).split())
+        else:
+            result = f'error unknown request: {request[0]}'
+        reply.write(result + '\n')
+        reply.flush()
+
+if __name__=='__main__':
+    """Parsing the input arguments"""
+    parser = ArgumentParser(description='Server to run CNN model predictions from miu')
+    parser.add_argument('-v', '--verbose', type=int, dest='verbose', default=0,
+                        help="logging level")
+    parser.add_argument('-b', '--batch_size', type=int, dest='batch_size', default=8,
+                        help="number of inputs predicted per batch")
+    parser.add_argument('-n', '--max_networks', type=int, dest='max_networks', default=4,
+                        help="number of networks kept loaded")
+    args = parser.parse_args()
+
+    log = logging.getLogger()
+    formatter = logging.Formatter('[%(name)-6s|%(levelname)-6s|%(filename)-20s:%(lineno)-3s] %(message)s')
+    ch = logging.StreamHandler()
+    if args.verbose >= 2: log.setLevel(logging.DEBUG)
+    elif args.verbose >= 1: log.setLevel(logging.INFO)
+    else: log.setLevel(logging.WARNING) # logging.ERROR / logging.CRITICAL
+    ch.setFormatter(formatter)
+    log.addHandler(ch)
+
+    log.info('---------------------------------------------------------------')
+    log.info('Python Environments')
+    log.info('---------------------------------------------------------------')
+    log.info('python v. %d.%d.%d' % (sys.version_info[:3]))
+    log.info(f'numpy v. {np.__version__}')
+    log.info(f'tensorflow v. {tf.__version__}')
+    log.info(f'keras v. {keras.__version__}')
+
+    serve(log, args.batch_size, max(1, args.max_networks))
@@ -106,10 +106,13 @@ void ImageCandidate::write(ostream& s) const
 }
 
 
+thread_local SolElement* SolElement::_staging = 0;
+
 SolElement::SolElement(const std::string& name)
 	: _name(name),
 	_attribute(10),
 	_candidate(20),
+	_staged_candidate(20),
 	_matched_cand_index(5),
 	_matched_prim(0)
 	/*,_num_matched_cands(0)*/
@@ -121,6 +124,7 @@ SolElement::SolElement(const SolElement& s)
 	: _name(s._name),
 	_attribute(10),
 	_candidate(20),
+	_staged_candidate(20),
 	_matched_cand_index(5),
 	_matched_prim(0)
 {
@@ -134,6 +138,8 @@ SolElement::~SolElement()
 		delete _attribute(i);
 	for(i=0; i<_candidate.N(); i++)
 		delete _candidate(i);
+	for(i=0; i<_staged_candidate.N(); i++)
+		delete _staged_candidate(i);
 
 	if (_matched_prim)
 		delete _matched_prim;
@@ -192,7 +198,34 @@ Attribute* SolElement::find_update_attribute(const char* const att_name)
 void SolElement::add_candidate(ImagePrimitive* prim)
 {
 	ImageCandidate *ic = new ImageCandidate (prim, num_attributes());
-	_candidate.push_last(ic);
+	if (_staging==this)
+		_staged_candidate.push_last(ic);
+	else
+		_candidate.push_last(ic);
+}
+
+
+void SolElement::staging(SolElement* se)
+{
+	_staging = se;
+}
+
+
+void SolElement::commit_staged_candidates()
+{
+	int i;
+	for(i=0; i<_staged_candidate.N(); i++)
+		_candidate.push_last(_staged_candidate[i]);
+	_staged_candidate.clear();
+}
+
+
+void SolElement::free_staged_candidates()
+{
+	int i;
+	for(i=0; i<_staged_candidate.N(); i++)
+		delete _staged_candidate(i);
+	_staged_candidate.clear();
 }
 
 
@@ -212,11 +245,12 @@ ostream& operator<<(ostream& s, const SolElement& e)
 
 ImageCandidate* SolElement::candidate(const int i)
 {
-	if ((i<0) || (i>=_candidate.N())) {
+	const Darray<ImageCandidate*>& cand = (_staging==this) ? _staged_candidate : _candidate;
+	if ((i<0) || (i>=cand.N())) {
 		cerr << "ERROR: Blackboard: SolElement: index invalid for getting candidate" << endl;
 		exit(1);
 	}
-	return _candidate[i];
+	return cand[i];
 }
 
 
@@ -536,8 +570,11 @@ ostream& operator<<(ostream& s, const ActivationRecord& a)
 	return s;
 }
 
+thread_local const Blackboard* Blackboard::_thread_bb = 0;
+thread_local int Blackboard::_thread_solel = -1;
+
 Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod, const char* const image_path, const char* const exec_path, const char* const temp_file_path)
-	: _mis(ms)/*, _hu_values_column_major(0)*/, _model(mod), _solel(10), _actrec(30), _group(10), _next_group(-1), _next_solel(-1)
+	: _mis(ms)/*, _hu_values_column_major(0)*/, _model(mod), _solel(10), _actrec(30), _group(10), _next_group(-1), _next_solel(-1), _num_threads(1), _external_edm(false), _group_beam_width(0)
 {
 	Point tl(0, 0, 0), br(ms.xdim()-1, ms.ydim()-1, ms.zdim()-1);
 	_overall_search_area.add_box(tl, br);
@@ -550,7 +587,7 @@ Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod, const char* const i
 
 Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod , const ROI& s_area, const char* const image_path, const char* const exec_path, const char* const temp_file_path/*, MedicalImageSequence* ss_ms*/)
 	: _mis(ms)/*, _hu_values_column_major(0)*/, _model(mod), _solel(10), _actrec(30), _group(10), 
-	_overall_search_area(s_area), _next_group(-1), _next_solel(-1)/*,_ss_mis(ss_ms)*/
+	_overall_search_area(s_area), _next_group(-1), _next_solel(-1), _num_threads(1), _external_edm(false), _group_beam_width(0)/*,_ss_mis(ss_ms)*/
 {
 	_image_path = new char [strlen(image_path)+1];
 	strcpy(_image_path, image_path);
@@ -561,7 +598,7 @@ Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod , const ROI& s_area,
 
 Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod , const ROI& s_area, const char* const image_path, const char* const exec_path, const char* const temp_file_path, const char* const roi_directory, const char* const edm_directory, const char* const stop_at_node)
 	: _mis(ms)/*, _hu_values_column_major(0)*/, _model(mod), _solel(10), _actrec(30), _group(10), 
-	_overall_search_area(s_area), _next_group(-1), _next_solel(-1)/*,_ss_mis(ss_ms)*/
+	_overall_search_area(s_area), _next_group(-1), _next_solel(-1), _num_threads(1), _external_edm(false), _group_beam_width(0)/*,_ss_mis(ss_ms)*/
 {
 	_image_path = new char [strlen(image_path)+1];
 	strcpy(_image_path, image_path);
@@ -589,7 +626,7 @@ Blackboard::Blackboard(MedicalImageSequence& ms, Model& mod , const ROI& s_area,
 						const bool skip_normalized_image_png, const bool skip_normalized_image_png_training, const bool skip_tensorboard_logging, 
 						const bool predict_cpu_only)
 	: _mis(ms)/*, _hu_values_column_major(0)*/, _model(mod), _solel(10), _actrec(30), _group(10), 
-	_overall_search_area(s_area), _next_group(-1), _next_solel(-1)/*,_ss_mis(ss_ms)*/
+	_overall_search_area(s_area), _next_group(-1), _next_solel(-1), _num_threads(1), _external_edm(false), _group_beam_width(0)/*,_ss_mis(ss_ms)*/
 {
 	_image_path = new char [strlen(image_path)+1];
 	strcpy(_image_path, image_path);
@@ -847,6 +884,24 @@ void Blackboard::next_group(const int index)
 }
 
 
+void Blackboard::num_threads(const int n)
+{
+	_num_threads = (n<1) ? 1 : n;
+}
+
+
+void Blackboard::external_edm(const bool b)
+{
+	_external_edm = b;
+}
+
+
+void Blackboard::group_beam_width(const int w)
+{
+	_group_beam_width = (w<0) ? 0 : w;
+}
+
+
 void Blackboard::next_solel(const int index)
 {
 	if ((index<-1) || (index>=_solel.N())) {
@@ -858,6 +913,26 @@ void Blackboard::next_solel(const int index)
 }
 
 
+void Blackboard::thread_solel(const int index)
+{
+	if ((index<-1) || (index>=_solel.N())) {
+		cerr << "ERROR: Blackboard: thread_solel: invalid index for solution element" << endl;
+		exit(1);
+	}
+
+	if (index>-1) {
+		_thread_bb = this;
+		_thread_solel = index;
+		SolElement::staging(&_solel(index));
+	}
+	else {
+		_thread_bb = 0;
+		_thread_solel = -1;
+		SolElement::staging(0);
+	}
+}
+
+
 void Blackboard::append_act_rec(const std::string& name, const std::string& type)
 {
 	ActivationRecord ar(name, type);
@@ -55,6 +55,7 @@
 #include "Attribute.h"
 #include "MedicalImageSequence.h"
 #include "ROI.h"
+#include "SearchAreaCache.h"
 
 
 /// A candidate image primitive for matching to a model entity.
@@ -187,7 +188,7 @@ public:
 	void add_candidate(ImagePrimitive* prim);
 
 	/// Number of candidates
-	inline const int num_candidates() const { return _candidate.N(); };
+	inline const int num_candidates() const { return (_staging==this) ? _staged_candidate.N() : _candidate.N(); };
 
 	/**
 	Get i'th candidate.
@@ -195,6 +196,19 @@ public:
 	*/
 	ImageCandidate* candidate(const int i);
 
+	/**
+	Sets the solution element whose candidates are staged by the calling thread (0 to stop staging).
+	While staging, candidates added to that solution element from the calling thread are kept in a separate list, which is the only list of candidates the thread sees.
+	Other threads see the solution element unchanged until the staged candidates are committed.
+	*/
+	static void staging(SolElement* se);
+
+	/// Appends the staged candidates to the candidates of the solution element
+	void commit_staged_candidates();
+
+	/// Frees the staged candidates
+	void free_staged_candidates();
+
 	/**
 	Appends the index of a matched candidate to the array of indices.
 	If index is invalid program exits with error message.
@@ -265,6 +279,12 @@ private:
 	*/
 	Darray<ImageCandidate*> _candidate;
 
+	/// Candidates staged by a worker thread (see staging method), managed the same way as _candidate
+	Darray<ImageCandidate*> _staged_candidate;
+
+	/// Solution element whose candidates are staged by the current thread (0 if none)
+	static thread_local SolElement* _staging;
+
 	/// Array of indices of image candidates matched to the solution element
 	Darray<int> _matched_cand_index;
 
@@ -575,6 +595,45 @@ public:
 	*/
 	const bool skip_normalized_image_png() const;
 
+	/**
+	Sets the number of threads knowledge sources may use for in-process image computations.
+	Values smaller than 1 are set to 1.
+	*/
+	void num_threads(const int n);
+
+	/**
+	Returns the number of threads knowledge sources may use for in-process image computations.
+	*/
+	inline const int num_threads() const { return _num_threads; };
+
+	/**
+	Returns the number of threads a knowledge source activated from the calling thread may use for in-process image computations:
+	1 if the thread segments a solution element in parallel with others (see thread_solel), num_threads otherwise.
+	*/
+	inline const int activation_threads() const { return (_thread_bb==this) ? 1 : _num_threads; };
+
+	/**
+	Sets whether distance maps and watersheds are computed by the external MyDistanceTransform.exe (legacy) instead of in-process.
+	*/
+	void external_edm(const bool b);
+
+	/**
+	Returns true if distance maps and watersheds are computed by the external MyDistanceTransform.exe.
+	*/
+	inline const bool external_edm() const { return _external_edm; };
+
+	/**
+	Sets the beam width of the group candidate search (see FormGroupCandsA).
+	0 (the default) => exact search, otherwise only the given number of partial group candidates with the highest confidences are extended for each solution element of a group.
+	Negative values are set to 0.
+	*/
+	void group_beam_width(const int w);
+
+	/**
+	Returns the beam width of the group candidate search (0 => exact search).
+	*/
+	inline const int group_beam_width() const { return _group_beam_width; };
+
 	/**
 	Returns boolean for skipping png image for training phase
 	*/
@@ -675,8 +734,17 @@ public:
 	/**
 	Returns the index of the next solution element to be processed (determined by the scheduler).
 	-1 if undefined.
+	If the calling thread has set a solution element with thread_solel, that index is returned instead.
 	*/
-	inline const int next_solel() const { return _next_solel; };
+	inline const int next_solel() const { return (_thread_bb==this) ? _thread_solel : _next_solel; };
+
+	/**
+	Sets the solution element processed by knowledge sources activated from the calling thread, overriding the index set by the scheduler.
+	Candidates added to that solution element from the calling thread are staged (see SolElement::staging).
+	-1 removes the override.
+	Program exits with error message if index is invalid.
+	*/
+	void thread_solel(const int index);
 
 	/**
 	Append a new activation record.
@@ -738,6 +806,9 @@ public:
 	/// Get overall search area
 	const ROI& overall_search_area() const;
 
+	/// Returns the cache of the ROIs search areas derive from related primitives, shared by the solution elements (see SearchArea::cached_search_area)
+	inline SearchAreaCache& search_area_cache() { return _search_area_cache; };
+
 	/// Form groups of solution elements
 	friend void GroupFormerA(Blackboard&);
 
@@ -774,6 +845,9 @@ private:
 	/// Overall search area for segmentation
 	ROI _overall_search_area;
 
+	/// Search area relations computed for this case
+	SearchAreaCache _search_area_cache;
+
 	/**
 	Index of next group to be processed (as determined by the Scheduler).
 	Initialized to -1 => not defined.
@@ -786,6 +860,12 @@ private:
 	*/
 	int _next_solel;
 
+	/// Blackboard for which the current thread has set a solution element (0 if none)
+	static thread_local const Blackboard* _thread_bb;
+
+	/// Solution element set by the current thread with thread_solel
+	static thread_local int _thread_solel;
+
 	/**
 	Path for storage of temporary files needed during computation.
 	*/
@@ -821,6 +901,24 @@ private:
 	*/
 	bool _predict_cpu_only;
 
+	/**
+	Number of threads available to knowledge sources for in-process image computations.
+	Initialized to 1.
+	*/
+	int _num_threads;
+
+	/**
+	Boolean for computing distance maps and watersheds with the external MyDistanceTransform.exe.
+	Initialized to false => computed in-process.
+	*/
+	bool _external_edm;
+
+	/**
+	Beam width of the group candidate search.
+	Initialized to 0 => exact search.
+	*/
+	int _group_beam_width;
+
 	/**
 	Boolean for skipping png image
 	*/
@@ -0,0 +1,156 @@
+#include "CnnPredictWorker.h"
+#include "KSprofiler.h"
+#include <chrono>
+#include <iostream>
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32)) || defined(__CYGWIN__)
+#define CNN_PREDICT_WORKER
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+std::shared_ptr<CnnPredictWorker> CnnPredictWorker::_worker;
+std::mutex CnnPredictWorker::_worker_mutex;
+bool CnnPredictWorker::_disabled = false;
+
+CnnPredictWorker::CnnPredictWorker(const std::string& server_script)
+	: _pid(0), _socket(-1)
+{
+#ifdef CNN_PREDICT_WORKER
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		cerr << "WARNING: CnnPredictWorker: could not create socket, cnn_predict.py will be run for each prediction" << endl;
+		return;
+	}
+
+	const int pid = fork();
+	if (pid<0) {
+		cerr << "WARNING: CnnPredictWorker: could not start process, cnn_predict.py will be run for each prediction" << endl;
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	if (pid==0) {
+		// The requests are read from standard input and the replies written to standard output, the log goes to standard error
+		dup2(sv[1], 0);
+		dup2(sv[1], 1);
+		close(sv[0]);
+		close(sv[1]);
+		execlp("python", "python", "-u", server_script.c_str(), "--verbose", "2", (char*)0);
+		_exit(127);
+	}
+
+	close(sv[1]);
+	_socket = sv[0];
+	_pid = pid;
+	cout << "Started CNN prediction worker: python " << server_script << " (pid " << _pid << ")" << endl;
+#endif
+}
+
+
+CnnPredictWorker::~CnnPredictWorker()
+{
+	if (_running())
+		_send_line("quit");
+	_stop();
+}
+
+
+std::shared_ptr<CnnPredictWorker> CnnPredictWorker::get(const std::string& server_script)
+{
+#ifdef CNN_PREDICT_WORKER
+	std::lock_guard<std::mutex> lock(_worker_mutex);
+	if (_disabled)
+		return std::shared_ptr<CnnPredictWorker>();
+	// Threads still holding a stopped worker keep it alive, it is deleted when they release it
+	if (!_worker || !_worker->_running())
+		_worker.reset(new CnnPredictWorker(server_script));
+	return _worker->_running() ? _worker : std::shared_ptr<CnnPredictWorker>();
+#else
+	return std::shared_ptr<CnnPredictWorker>();
+#endif
+}
+
+
+void CnnPredictWorker::disable()
+{
+	std::lock_guard<std::mutex> lock(_worker_mutex);
+	_disabled = true;
+}
+
+
+const int CnnPredictWorker::predict(const std::string& model_config, const std::string& resource_config)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::string reply;
+	std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+	const bool received = _running() && _send_line("predict\t"+model_config+"\t"+resource_config) && _receive_line(reply);
+	KSprofiler::add_external_time(std::chrono::duration<double>(std::chrono::steady_clock::now()-t).count());
+	if (!received) {
+		cerr << "WARNING: CnnPredictWorker: lost connection to the prediction worker" << endl;
+		_stop();
+		return -1;
+	}
+	if (!reply.compare("ok"))
+		return 0;
+	cerr << "WARNING: CnnPredictWorker: prediction failed: " << reply << endl;
+	return 1;
+}
+
+
+void CnnPredictWorker::_stop()
+{
+#ifdef CNN_PREDICT_WORKER
+	if (_socket>=0)
+		close(_socket);
+	_socket = -1;
+	if (_pid>0) {
+		int status;
+		waitpid(_pid, &status, 0);
+	}
+	_pid = 0;
+#endif
+}
+
+
+const int CnnPredictWorker::_send_line(const std::string& line)
+{
+#ifdef CNN_PREDICT_WORKER
+	const std::string s(line+"\n");
+	size_t n=0;
+	while(n<s.length()) {
+		// MSG_NOSIGNAL: a process that exited must not raise SIGPIPE
+		const ssize_t k = send(_socket, s.c_str()+n, s.length()-n, MSG_NOSIGNAL);
+		if (k<=0)
+			return 0;
+		n += k;
+	}
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+
+const int CnnPredictWorker::_receive_line(std::string& line)
+{
+#ifdef CNN_PREDICT_WORKER
+	line.clear();
+	char c;
+	for(;;) {
+		const ssize_t k = recv(_socket, &c, 1, 0);
+		if (k<=0)
+			return 0;
+		if (c=='\n')
+			return 1;
+		line += c;
+	}
+#else
+	return 0;
+#endif
+}
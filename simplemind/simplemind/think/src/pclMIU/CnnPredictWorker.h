@@ -0,0 +1,77 @@
+#ifndef __CnnPredictWorker_h_
+#define __CnnPredictWorker_h_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+A persistent python process that runs CNN predictions for NeuralNetKeras nodes (script/cnn_predict_server.py).
+The process is started once, when the first prediction is requested, and is reused by all nodes and cases segmented by the sm process.
+It keeps tensorflow imported and the networks with their weights loaded, so that only the first prediction with given weights pays for them.
+Requests are exchanged over a local socket, one line per request and per reply:
+	predict<TAB>MODEL_CONFIG_PATH<TAB>RESOURCE_CONFIG_PATH
+	ok | error MESSAGE
+Predictions are made as by cnn_predict.py with the same configuration files (the predicted ROIs are written to the output directory of the model configuration).
+Requests from several threads are served one at a time.
+The worker is not available on Windows, or if it is disabled (see disable), in which case cnn_predict.py is run for each prediction.
+*/
+class CnnPredictWorker {
+public:
+	/// Destructor - asks the process to exit and waits for it
+	~CnnPredictWorker();
+
+	/**
+	Returns the worker of the sm process, starting it with the given server script if it is not running.
+	Returns 0 if the worker is disabled or not available, or if the process cannot be started.
+	A worker that is replaced (after it was stopped) stays valid until the last thread using it releases it.
+	*/
+	static std::shared_ptr<CnnPredictWorker> get(const std::string& server_script);
+
+	/// Disables the worker, so that get always returns 0 (to be called before any prediction)
+	static void disable();
+
+	/**
+	Runs a prediction with the given model and resource configuration files.
+	Returns 0 if the prediction succeeded, 1 if it failed and -1 if the worker could not be reached (the worker is then stopped and is restarted by the next call to get).
+	*/
+	const int predict(const std::string& model_config, const std::string& resource_config);
+
+private:
+	/// Constructor - starts the process with the given server script
+	CnnPredictWorker(const std::string& server_script);
+
+	/// Returns 1 if the process is running
+	inline const int _running() const { return _pid>0; };
+
+	/// Closes the socket and waits for the process to exit
+	void _stop();
+
+	/// Sends a line (including the trailing newline), returns 0 on failure
+	const int _send_line(const std::string& line);
+
+	/// Receives a line (without the trailing newline), returns 0 on failure
+	const int _receive_line(std::string& line);
+
+	/// Process id of the python process (0 if not running), written by predict under _mutex and read by get without it
+	std::atomic<int> _pid;
+
+	/// Socket connected to the standard input and output of the python process
+	int _socket;
+
+	/// Serializes the requests
+	std::mutex _mutex;
+
+	/// The worker of the sm process
+	static std::shared_ptr<CnnPredictWorker> _worker;
+
+	/// Guards _worker
+	static std::mutex _worker_mutex;
+
+	/// Set if the worker is disabled
+	static bool _disabled;
+};
+
+
+#endif // !__CnnPredictWorker_h_
@@ -53,6 +53,7 @@
 #include <string.h>
 #include <assert.h>
 #include <iostream>
+#include <utility>
 #include <vector>
 //using std::ostream;
 //using std::cerr;
@@ -88,6 +89,15 @@ public:
 	*/
 	Darray(const Darray<T>&);
 
+	/// Move constructor (the elements are not copied)
+	Darray(Darray<T>&& a) noexcept : _data(std::move(a._data)) {};
+
+	/// Assignment operator
+	Darray<T>& operator=(const Darray<T>& a) { _data = a._data; return *this; };
+
+	/// Move assignment operator (the elements are not copied)
+	Darray<T>& operator=(Darray<T>&& a) noexcept { _data = std::move(a._data); return *this; };
+
   	/// Destructor
  	~Darray();
 
@@ -97,6 +107,15 @@ public:
 	/// Appends an element to the end of the Darray
 	void push_last(const T&);
 
+	/// Appends an element to the end of the Darray, moving it rather than copying it
+	void push_last(T&& ndata) { _data.push_back(std::move(ndata)); };
+
+	/// Allocates space for n elements so that appending up to n elements does not move existing ones
+	void reserve(const long n) { _data.reserve(n); };
+
+	/// Exchanges the elements with those of another Darray
+	void swap(Darray<T>& a) { _data.swap(a._data); };
+
 	/**
 	Inserts an element into the Darray at position ind.
 	Program exits with error if ind is invalid.
@@ -349,7 +368,7 @@ template<class T> void Darray<T>::push_here(const T &ndata, const long ind)
 
 template<class T> void Darray<T>::push_inorder(const T &ndata, int (*compar)(const T &, const T &))
 {
-	static int low, high, mid, x;
+	int low, high, mid, x;
 
 	if(_data.empty()) {
     	_data.push_back(ndata);
@@ -480,7 +499,7 @@ template<class T> void Darray<T>::delete_item(const long i)
 
 template<class T> const long Darray<T>::find_item(const T& fdata, int (*compar)(const T&, const T&)) const
 {
-	static int low, high, mid, x;
+	int low, high, mid, x;
 
     if(_data.empty())
         return -1;
@@ -521,7 +540,7 @@ template<class T> const long Darray<T>::find_item(const T& fdata, int (*compar)(
 
 template<class T> const long Darray<T>::find_or_add(const T& fdata, int (*compar)(const T&, const T&), int& found)
 {
-	static int low, high, mid, x;
+	int low, high, mid, x;
 
     found = 0;
 
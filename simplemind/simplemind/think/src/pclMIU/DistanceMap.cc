@@ -0,0 +1,73 @@
+#include "DistanceMap.h"
+#include "ROItraverser.h"
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/filter2/image/EuclideanDistanceTransformFilter.h>
+
+EDMmaskImage::Pointer roi_mask_image(const ROI& roi, const int xdim, const int ydim, const int zdim, const float xsize, const float ysize, const float zsize, const bool border_is_background, const bool planar)
+{
+	if (roi.empty()) return EDMmaskImage::Pointer();
+	Point tl, br;
+	roi.bounding_cube(tl, br);
+	const int zmargin = planar ? 0 : 1;
+	pcl::Point3D<int> minp(tl.x-1, tl.y-1, tl.z-zmargin);
+	pcl::Point3D<int> maxp(br.x+1, br.y+1, br.z+zmargin);
+	if (!border_is_background) {
+		minp.x() = (minp.x()<0) ? 0 : minp.x();
+		minp.y() = (minp.y()<0) ? 0 : minp.y();
+		minp.z() = (minp.z()<0) ? 0 : minp.z();
+		maxp.x() = (maxp.x()>=xdim) ? xdim-1 : maxp.x();
+		maxp.y() = (maxp.y()>=ydim) ? ydim-1 : maxp.y();
+		maxp.z() = (maxp.z()>=zdim) ? zdim-1 : maxp.z();
+	}
+	EDMmaskImage::Pointer mask = EDMmaskImage::New(minp, maxp, pcl::Point3D<double>(xsize, ysize, zsize), pcl::Point3D<double>(0, 0, 0));
+	ROItraverser rt(roi);
+	fill_mask_image(mask, rt);
+	return mask;
+}
+
+void fill_mask_image(const EDMmaskImage::Pointer& mask, ROItraverser& rt)
+{
+	pcl::ImageHelper::Fill(mask, 0);
+	TravStatus s = rt.valid();
+	Point p1, p2;
+	while(s<END_ROI) {
+		rt.current_interval(p1, p2);
+		long j = mask->toIndex(p1.x, p1.y, p1.z);
+		for(; p1.x<=p2.x; p1.x++) {
+			mask->set(j, 1);
+			j++;
+		}
+		s = rt.next_interval();
+	}
+}
+
+EDMimage::Pointer mask_distance_map(const EDMmaskImage::Pointer& mask, const bool planar, const int num_threads)
+{
+	typedef pcl::filter2::ZeroFluxBoundary<EDMmaskImage> BoundaryType;
+	return pcl::filter2::EuclideanDistanceTransformFilter<BoundaryType, EDMimage>::Compute(BoundaryType(mask), false, false, true, pcl::Region3D<int>().reset(), num_threads, planar ? 2 : 3);
+}
+
+EDMimage::Pointer roi_distance_map(const ROI& roi, const int xdim, const int ydim, const int zdim, const float xsize, const float ysize, const float zsize, const bool planar, const bool border_is_background, const int num_threads)
+{
+	EDMmaskImage::Pointer mask = roi_mask_image(roi, xdim, ydim, zdim, xsize, ysize, zsize, border_is_background, planar);
+	if (!mask) return EDMimage::Pointer();
+	return mask_distance_map(mask, planar, num_threads);
+}
+
+EDMimage::Pointer roi_distance_map_2d(const ROI& roi, const MedicalImageSequence& mis, const int num_threads)
+{
+	Point fp;
+	if (!roi.first_point(fp)) return EDMimage::Pointer();
+	// Columns are along x, rows along y (as in distance_map_2d)
+	return roi_distance_map(roi, mis.xdim(), mis.ydim(), mis.zdim(), mis.column_pixel_spacing(fp.z), mis.row_pixel_spacing(fp.z), 1, true, true, num_threads);
+}
+
+EDMimage::Pointer roi_distance_map_2d(const ROI& roi, const int z, const MedicalImageSequence& mis, const int num_threads)
+{
+	Point tl, br;
+	if (!roi.bounding_box(tl, br, z)) return EDMimage::Pointer();
+	EDMmaskImage::Pointer mask = EDMmaskImage::New(pcl::Point3D<int>(tl.x-1, tl.y-1, z), pcl::Point3D<int>(br.x+1, br.y+1, z), pcl::Point3D<double>(mis.column_pixel_spacing(z), mis.row_pixel_spacing(z), 1), pcl::Point3D<double>(0, 0, 0));
+	ROItraverser rt(roi, z);
+	fill_mask_image(mask, rt);
+	return mask_distance_map(mask, true, num_threads);
+}
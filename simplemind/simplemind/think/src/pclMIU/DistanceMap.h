@@ -0,0 +1,88 @@
+#ifndef __DistanceMap_h_
+#define __DistanceMap_h_
+
+#include "ROI.h"
+#include "ROItraverser.h"
+#include "MedicalImageSequence.h"
+#include <pcl/image.h>
+
+/**
+Exact Euclidean distance maps of ROIs.
+
+The distance transform is the linear-time separable transform of pcl::filter2::EuclideanDistanceTransformFilter
+(Maurer et al.), with the voxel spacing of the image sequence; each pass (rows, columns, slices) is split over threads.
+Only the bounding cube of the ROI enlarged by one voxel is materialized, which gives the same distances as a transform of the whole image.
+Image coordinates are the voxel coordinates of the image sequence.
+*/
+
+/// Binary mask of an ROI (1 in the ROI, 0 elsewhere)
+typedef pcl::Image<char> EDMmaskImage;
+
+/// Distance map in mm
+typedef pcl::Image<float> EDMimage;
+
+/**
+Creates a binary mask image of the ROI over its bounding cube enlarged by one voxel.
+If border_is_background is set the cube is not clipped to the image (xdim, ydim, zdim), so that voxels beyond the image border are background;
+otherwise it is clipped and the border has no effect on the distances.
+If planar is set the cube is not enlarged along z.
+Returns a null pointer if the ROI is empty.
+*/
+EDMmaskImage::Pointer roi_mask_image(const ROI& roi, const int xdim, const int ydim, const int zdim, const float xsize, const float ysize, const float zsize, const bool border_is_background=false, const bool planar=false);
+
+/// Sets the voxels of mask at the points of the traverser to 1, other voxels to 0 (points must be in the region of mask)
+void fill_mask_image(const EDMmaskImage::Pointer& mask, ROItraverser& rt);
+
+/**
+Computes the distance map of a mask from roi_mask_image: voxels of the mask hold the distance to the nearest background voxel, other voxels are 0.
+If planar is set the distances are measured within each plane (the transform is not applied along z).
+*/
+EDMimage::Pointer mask_distance_map(const EDMmaskImage::Pointer& mask, const bool planar=false, const int num_threads=1);
+
+/**
+Computes the distance map of the ROI (see roi_mask_image and mask_distance_map).
+Returns a null pointer if the ROI is empty.
+*/
+EDMimage::Pointer roi_distance_map(const ROI& roi, const int xdim, const int ydim, const int zdim, const float xsize, const float ysize, const float zsize, const bool planar=false, const bool border_is_background=false, const int num_threads=1);
+
+/**
+Computes the 2D distance map of each plane of the ROI, with the pixel spacing of mis; voxels beyond the image border are background.
+Returns a null pointer if the ROI is empty.
+*/
+EDMimage::Pointer roi_distance_map_2d(const ROI& roi, const MedicalImageSequence& mis, const int num_threads=1);
+
+/**
+As roi_distance_map_2d, for plane z of the ROI only (the map covers the bounding box of the plane and one pixel beyond).
+Returns a null pointer if the plane is empty.
+*/
+EDMimage::Pointer roi_distance_map_2d(const ROI& roi, const int z, const MedicalImageSequence& mis, const int num_threads=1);
+
+/**
+Copies the values of img into arr (size xdim*ydim*zdim, raster order) at the image coordinates of img.
+Values of arr outside the image region, and values of img outside the array, are not copied.
+*/
+template <class ImagePointerType, class T>
+void copy_to_raster_array(const ImagePointerType& img, T* arr, const int xdim, const int ydim, const int zdim)
+{
+	pcl::Point3D<int> minp = img->getRegion().getMinPoint();
+	pcl::Point3D<int> maxp = img->getRegion().getMaxPoint();
+	minp.x() = (minp.x()<0) ? 0 : minp.x();
+	minp.y() = (minp.y()<0) ? 0 : minp.y();
+	minp.z() = (minp.z()<0) ? 0 : minp.z();
+	maxp.x() = (maxp.x()>=xdim) ? xdim-1 : maxp.x();
+	maxp.y() = (maxp.y()>=ydim) ? ydim-1 : maxp.y();
+	maxp.z() = (maxp.z()>=zdim) ? zdim-1 : maxp.z();
+	for(int z=minp.z(); z<=maxp.z(); z++) {
+		for(int y=minp.y(); y<=maxp.y(); y++) {
+			long i = img->toIndex(minp.x(), y, z);
+			long j = (long)z*xdim*ydim + (long)y*xdim + minp.x();
+			for(int x=minp.x(); x<=maxp.x(); x++) {
+				arr[j] = (T) img->get(i);
+				i++;
+				j++;
+			}
+		}
+	}
+}
+
+#endif // !__DistanceMap_h_
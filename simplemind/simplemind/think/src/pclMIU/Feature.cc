@@ -58,14 +58,13 @@ const int Area_maxXY::value(MedicalImageSequence& mis, const Darray<ImagePrimiti
 	const ImageRegion* r0 = (ImageRegion*)prim[0];
 
 	Point fp, lp;
-	r0->roi().first_point(fp);
-	r0->roi().last_point(lp);
+	r0->bounding_cube(fp, lp);
 
 	int z;
 	float a;
 	val=0;
 	for(z=fp.z; z<=lp.z; z++) {
-		a = r0->roi().num_pix(z)*mis.row_pixel_spacing(z)*mis.column_pixel_spacing(z);
+		a = r0->num_pix(z)*mis.row_pixel_spacing(z)*mis.column_pixel_spacing(z);
 		if (a>val) val=a;
 	}
   }
@@ -100,8 +99,7 @@ const int Area_perXY::value(MedicalImageSequence& mis, const Darray<ImagePrimiti
 	const ImageRegion* r0 = (ImageRegion*)prim[0];
 
 	Point fp, lp;
-	r0->roi().first_point(fp);
-	r0->roi().last_point(lp);
+	r0->bounding_cube(fp, lp);
 
 	val = r0->area_xy()/(lp.z-fp.z+1);
   }
@@ -164,11 +162,9 @@ const int AvgDiameter::value(MedicalImageSequence& mis, const Darray<ImagePrimit
 	Point fp;
 	if (r1->roi().first_point(fp)) {
 		Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
-		mdist_pt1.x = -1;
-		mpdist_pt1.x = -1;
   		double max_diameter, perp_diameter;
   
-  		compute_diameters(r1->roi(), mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+  		r1->diameters(mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
 
 		if (mdist_pt1.x==-1) max_diameter=mis.row_pixel_spacing(fp.z);
 		if (mpdist_pt1.x==-1) perp_diameter=mis.row_pixel_spacing(fp.z);
@@ -206,11 +202,9 @@ const int AvgDiameterInSliceThicknesses::value(MedicalImageSequence& mis, const
 	Point fp;
 	if (r1->roi().first_point(fp)) {
 		Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
-		mdist_pt1.x = -1;
-		mpdist_pt1.x = -1;
   		double max_diameter, perp_diameter;
   
-  		compute_diameters(r1->roi(), mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+  		r1->diameters(mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
 
 		if (mdist_pt1.x==-1) max_diameter=mis.row_pixel_spacing(fp.z);
 		if (mpdist_pt1.x==-1) perp_diameter=mis.row_pixel_spacing(fp.z);
@@ -471,10 +465,9 @@ const int CircularityAtMaxDia::value(MedicalImageSequence& mis, const Darray<Ima
 
 	if (r0->roi().first_point(fp)) {
 		Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
-		mdist_pt1.x = -1;
   		double max_diameter, perp_diameter;
   
-  		compute_diameters(r0->roi(), mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+  		r0->diameters(mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
  
 		//if (mdist_pt1.x==-1) max_diameter=mis.row_pixel_spacing(fp.z);
   		//val = max_diameter/mis.slice_thickness(mdist_pt1.z);
@@ -711,7 +704,7 @@ const int MaxBBoxLength::value(MedicalImageSequence& mis, const Darray<ImagePrim
 	const ImageRegion* r1 = (ImageRegion*)prim[0];
 	
 	Point tl, br;
-	if (r1->roi().bounding_cube(tl, br)) {
+	if (r1->bounding_cube(tl, br)) {
         Point px(br.x,tl.y,tl.z);
 		float dx = distance_mm(tl, px, mis);
         Point py(tl.x,br.y,tl.z);
@@ -757,10 +750,9 @@ const int MaxDiameterInSliceThicknesses::value(MedicalImageSequence& mis, const
 	Point fp;
 	if (r1->roi().first_point(fp)) {
 		Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
-		mdist_pt1.x = -1;
   		double max_diameter, perp_diameter;
   
-  		compute_diameters(r1->roi(), mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+  		r1->diameters(mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
  
 		if (mdist_pt1.x==-1) max_diameter=mis.row_pixel_spacing(fp.z);
 
@@ -792,8 +784,7 @@ const int MedianHU::value(MedicalImageSequence& mis, const Darray<ImagePrimitive
   if ((prim.N()==1) && (!strcmp(prim[0]->type(), "ImageRegion"))) {
   	done = 1;
   	const ImageRegion* r0 = (ImageRegion*)prim[0];
-  	ROItraverser rt(r0->roi());
-  	val = (float) medianHU(mis, rt);
+  	val = (float) r0->median_hu(mis);
   }
   else if (prim.N()>1) {
   	ROI r;
@@ -874,7 +865,7 @@ const int PerpDiameterInSliceThicknesses::value(MedicalImageSequence& mis, const
 		Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
   		double max_diameter, perp_diameter;
   
-  		compute_diameters(r1->roi(), mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+  		r1->diameters(mis.row_pixel_spacing(fp.z), mis.column_pixel_spacing(fp.z), mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
     
   		val = perp_diameter/mis.slice_thickness(mdist_pt1.z);
   	}
@@ -1012,7 +1003,8 @@ RadLogicsNoduleClassification::~RadLogicsNoduleClassification()
 }
 
 // Dummy function. Will be provided by RadLogics
-void RunNoduleClassification(double& classification_score, int& classification_result, const short* const image_volume, const ROI& roi, double meanHU, double max_diameter, double perp_diameter, double sphericity, int node_to_be_classified) {
+// image_volume(x, y, z) is the HU value of a voxel (a view of the image buffer when possible, see MedicalImageSequence::hu_values)
+void RunNoduleClassification(double& classification_score, int& classification_result, const ShortVolumeView& image_volume, const ROI& roi, double meanHU, double max_diameter, double perp_diameter, double sphericity, int node_to_be_classified) {
 }
 
 const int RadLogicsNoduleClassification::value(MedicalImageSequence& mis, const Darray<ImagePrimitive*>& prim, float& val)
@@ -1036,7 +1028,7 @@ const int RadLogicsNoduleClassification::value(MedicalImageSequence& mis, const
 
 		int classification_result; // 0,1 values indicating whether nodule or not
 		double classification_score;
-		RunNoduleClassification(classification_score, classification_result, mis.hu_values_column_major(), roi, meanHU(mis, rt), max_diameter, perp_diameter, sphericity(roi, r0->centroid(), r0->volume(), mis), _node_to_be_classified);
+		RunNoduleClassification(classification_score, classification_result, mis.hu_values(), roi, meanHU(mis, rt), max_diameter, perp_diameter, sphericity(roi, r0->centroid(), r0->volume(), mis), _node_to_be_classified);
 			
 		val = (float) classification_result;
 	}
@@ -1071,11 +1063,10 @@ const int ShortAxisInPixels::value(MedicalImageSequence& mis, const Darray<Image
 	const ImageRegion* r1 = (ImageRegion*)prim[0];
 
 	Point mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2;
-	mpdist_pt1.x = -1;
 	double max_diameter, perp_diameter;
 
 	// Pixel spacing arguments set to 1.0 so that distances are in units of pixels
-	compute_diameters(r1->roi(), 1.0, 1.0, mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+	r1->diameters(1.0, 1.0, mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
 
 	if (mpdist_pt1.x==-1) perp_diameter=1.0;
 
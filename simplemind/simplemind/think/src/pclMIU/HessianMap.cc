@@ -0,0 +1,50 @@
+#include "HessianMap.h"
+#include "IntensityVolume.h"
+#include "DistanceMap.h"
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/filter2/image/ImageHessianFilter.h>
+#include <math.h>
+
+HessianImage::Pointer hu_image(MedicalImageSequence& mis)
+{
+	const IntensityVolume& vol = mis.hu_volume();
+	const int xdim = vol.xdim(), ydim = vol.ydim(), zdim = vol.zdim();
+	const float zsize = (zdim>1) ? fabs(mis.slice_location(1)-mis.slice_location(0)) : 1;
+	// x spacing is the row pixel spacing, as stored by the sequence readers (spacing[0]) and used by the segmentation KSs
+	HessianImage::Pointer img = HessianImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(xdim-1, ydim-1, zdim-1), pcl::Point3D<double>(mis.row_pixel_spacing(0), mis.column_pixel_spacing(0), zsize), pcl::Point3D<double>(0, 0, 0));
+	for(int z=0; z<zdim; z++) {
+		for(int y=0; y<ydim; y++) {
+			const short* hu_row = vol.hu_row(y, z);
+			long i = img->toIndex(0, y, z);
+			for(int x=0; x<xdim; x++, i++) img->set(i, hu_row[x]);
+		}
+	}
+	return img;
+}
+
+void hessian_shape_maps(MedicalImageSequence& mis, const float sigma, const int num_threads, float* plane_plateness, float* plateness, float* vesselness, float* blobness)
+{
+	typedef pcl::filter2::ZeroFluxBoundary<HessianImage> BoundaryType;
+	typedef pcl::filter2::ImageHessianShapeFilter<HessianImage, HessianImage> ShapeFilterType;
+
+	HessianImage::Pointer img = hu_image(mis);
+	pcl::filter2::ImageHessianFilter<BoundaryType, HessianImage> hessian_filter;
+	hessian_filter.setInput(BoundaryType(img));
+	hessian_filter.setSigma(sigma);
+	hessian_filter.setNumberOfThreads(num_threads);
+	hessian_filter.update();
+	img.reset();
+
+	ShapeFilterType shape_filter;
+	for(int i=0; i<6; i++) shape_filter.setInput(i, hessian_filter.getOutput(i));
+	shape_filter.setMeasures((plane_plateness ? ShapeFilterType::PlanePlateness : 0) | (plateness ? ShapeFilterType::Plateness : 0) |
+		(vesselness ? ShapeFilterType::Vesselness : 0) | (blobness ? ShapeFilterType::Blobness : 0));
+	shape_filter.setNumberOfThreads(num_threads);
+	shape_filter.update();
+
+	const int xdim = mis.xdim(), ydim = mis.ydim(), zdim = mis.zdim();
+	if (plane_plateness) copy_to_raster_array(shape_filter.getPlanePlateness(), plane_plateness, xdim, ydim, zdim);
+	if (plateness) copy_to_raster_array(shape_filter.getPlateness(), plateness, xdim, ydim, zdim);
+	if (vesselness) copy_to_raster_array(shape_filter.getVesselness(), vesselness, xdim, ydim, zdim);
+	if (blobness) copy_to_raster_array(shape_filter.getBlobness(), blobness, xdim, ydim, zdim);
+}
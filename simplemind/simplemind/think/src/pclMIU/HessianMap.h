@@ -0,0 +1,29 @@
+#ifndef __HessianMap_h_
+#define __HessianMap_h_
+
+#include "MedicalImageSequence.h"
+#include <pcl/image.h>
+
+/**
+Hessian shape maps of the HU values of an image sequence, computed in-process.
+
+The six second derivatives are computed for the whole volume with shared separable passes (pcl::filter2::ImageHessianFilter),
+then the eigenvalues of the Hessian of each voxel in closed form (pcl::filter2::ImageHessianShapeFilter), both split over threads.
+Derivatives are at scale sigma (mm), with the voxel spacing of the image sequence; only structures brighter than their surroundings (negative eigenvalues) get non-zero measures.
+Maps are raster arrays of xdim*ydim*zdim values (index x + y*xdim + z*xdim*ydim).
+*/
+
+/// HU values and Hessian images
+typedef pcl::Image<float> HessianImage;
+
+/// Creates an image of the HU values of mis, with the spacing of mis (x from row_pixel_spacing, y from column_pixel_spacing, as in PlatenessThreshRegGrowA; z between the first two slices)
+HessianImage::Pointer hu_image(MedicalImageSequence& mis);
+
+/**
+Computes the requested shape maps (non-zero arrays) of mis at scale sigma:
+plane_plateness is the sum of the 2D plateness of the axial, coronal and sagittal planes (0 to 3, as the plateness raw files read by PlatenessThreshRegGrow),
+plateness, vesselness and blobness are the 3D measures (0 to 1) of pcl::filter2::ImageHessianShapeFilter.
+*/
+void hessian_shape_maps(MedicalImageSequence& mis, const float sigma, const int num_threads, float* plane_plateness, float* plateness=0, float* vesselness=0, float* blobness=0);
+
+#endif // !__HessianMap_h_
@@ -36,6 +36,7 @@ Image::Image(const int instance_number, const int width, const int height,
   _ri = rescale_intercept;
   _bits_per_pixel = bits_per_pixel; 
   _pixel_data = 0;
+  _pixel_view = false;
   if (file_name) {
     _pixel_filename = new char[strlen(file_name) + 1];
     assert(file_name != 0);
@@ -72,14 +73,24 @@ Image::Image(const int instance_number, const int width, const int height,
   };
   _file_offset = 0;
   _pixel_filename = 0;
+  _pixel_view = false;
 };
 
 Image::~Image() 
 {
-  delete [] _pixel_data;
+  if (!_pixel_view)
+    delete [] _pixel_data;
   delete [] _pixel_filename;
 };
 
+void Image::set_pixel_view(short* pixels)
+{
+  if (!_pixel_view)
+    delete [] _pixel_data;
+  _pixel_data = pixels;
+  _pixel_view = true;
+};
+
 void Image::force_load()
 {
   pixel_data();
@@ -135,7 +146,7 @@ Image::Image()
 
 //Changed by BW to allow copy constructor use
 Image::Image(const Image& im)
-  : _pixel_filename(NULL), _pixel_data(NULL)
+  : _pixel_filename(NULL), _pixel_data(NULL), _pixel_view(false)
 { 
   *this = im;
 }
@@ -159,6 +170,7 @@ const Image& Image::operator=(const Image& Rhs)
       _pixel_filename = 0;
       const int num_pixels = _width*_height;
       _pixel_data = new short[num_pixels];
+      _pixel_view = false;
       int i;
       for (i = 0; i < num_pixels; i++) {
 	_pixel_data[i] = Rhs._pixel_data[i];
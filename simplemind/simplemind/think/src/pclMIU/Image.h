@@ -162,6 +162,16 @@ public:
   /// Returns whether the image data has been loaded from disk to memory.
   const bool pixels_in_memory() const;
 
+  /**
+   *  Makes the image a view into #pixels# (width*height values in row
+   *  major order), which are not copied and not deleted by the image.
+   *  The buffer must outlive the image.
+   */
+  void set_pixel_view(short* pixels);
+
+  /// Returns whether the pixel data is a view into a buffer owned elsewhere.
+  const bool pixel_view() const { return _pixel_view; };
+
 private:
   /// Not to be used.
   Image();
@@ -198,6 +208,9 @@ private:
 
   /// Offset (zero based) of first pixel in file.
   int _file_offset;
+
+  /// Whether _pixel_data is a view into a buffer owned elsewhere (see set_pixel_view).
+  bool _pixel_view;
 };
 
 inline
@@ -1,4 +1,5 @@
 #include "ImageRegion.h"
+#include "IntensityVolume.h"
 
 float z_spacing_for_vol(const MedicalImageSequence& mis, const int z)
 {
@@ -16,7 +17,7 @@ float z_spacing_for_vol(const MedicalImageSequence& mis, const int z)
 }
 
 ImageRegion::ImageRegion(const ROI& roi, const MedicalImageSequence& mis)
-	: ImagePrimitive(), _roi(roi)
+	: ImagePrimitive(), _roi(roi), _extent_cached(false), _diam_cached(false), _hist_mis(0), _digest_cached(false)
 {
 	ROItraverser rt(_roi);
 	register Point rtp1, rtp2;
@@ -84,7 +85,11 @@ ImageRegion::ImageRegion(const ImageRegion& i)
 	_centroid(i._centroid),
 	_max_z(i._max_z),
 	_area_xy(i._area_xy),
-	_volume(i._volume)
+	_volume(i._volume),
+	_extent_cached(false),
+	_diam_cached(false),
+	_hist_mis(0),
+	_digest_cached(false)
 {
 	_planar_centroids = new FPoint* [_max_z+1];
 	for(int j=0; j<=_max_z; j++) {
@@ -97,6 +102,7 @@ ImageRegion::ImageRegion(const ImageRegion& i)
 
 ImageRegion::~ImageRegion()
 {
+	_clear_cache();
 	for(int j=0; j<=_max_z; j++)
 		if (_planar_centroids[j])
 			delete _planar_centroids[j];
@@ -130,8 +136,172 @@ const FPoint* ImageRegion::centroid(const int z) const
 }
 
 
+const int ImageRegion::bounding_cube(Point& tl, Point& br) const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	_cache_extent();
+	tl = _tl;
+	br = _br;
+	return 1;
+}
+
+
+const int ImageRegion::num_pix(const int z) const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	_cache_extent();
+	if ((z<_tl.z) || (z>_br.z))
+		return 0;
+	return _plane_num_pix[z-_tl.z];
+}
+
+
+const Contour* ImageRegion::boundaries(int& n, const int z) const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	_cache_extent();
+	if ((z<_tl.z) || (z>_br.z) || !_plane_num_pix[z-_tl.z]) {
+		n = 0;
+		return 0;
+	}
+	const int i = z-_tl.z;
+	if (_plane_num_bnd[i]<0)
+		_plane_bnd[i] = _roi.boundaries(_plane_num_bnd[i], z);
+	n = _plane_num_bnd[i];
+	return _plane_bnd[i];
+}
+
+
+void ImageRegion::diameters(const float row_pixel_spacing, const float col_pixel_spacing, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2, double& max_diameter, double& perp_diameter) const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	if (!_diam_cached) {
+		_cache_extent();
+		int z;
+		for(z=_tl.z; z<=_br.z; z++) {
+			const int i = z-_tl.z;
+			if (_plane_num_pix[i] && (_plane_num_bnd[i]<0))
+				_plane_bnd[i] = _roi.boundaries(_plane_num_bnd[i], z);
+		}
+		// Empty planes have no contours
+		std::vector<int> num_bnd(_plane_num_bnd);
+		for(size_t i=0; i<num_bnd.size(); i++)
+			if (num_bnd[i]<0)
+				num_bnd[i] = 0;
+
+		_mdist_pt1.x = _mdist_pt2.x = _mpdist_pt1.x = _mpdist_pt2.x = -1;
+		_mdist_pt1.y = _mdist_pt2.y = _mpdist_pt1.y = _mpdist_pt2.y = 0;
+		_mdist_pt1.z = _mdist_pt2.z = _mpdist_pt1.z = _mpdist_pt2.z = 0;
+		compute_diameter_points(&_plane_bnd[0], &num_bnd[0], _tl.z, _br.z, _mdist_pt1, _mdist_pt2, _mpdist_pt1, _mpdist_pt2);
+		_diam_cached = true;
+	}
+	mdist_pt1 = _mdist_pt1;
+	mdist_pt2 = _mdist_pt2;
+	mpdist_pt1 = _mpdist_pt1;
+	mpdist_pt2 = _mpdist_pt2;
+	diameters_from_points(row_pixel_spacing, col_pixel_spacing, mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+}
+
+
+const pcl::statistics::DenseHistogram<int>& ImageRegion::hu_hist(MedicalImageSequence& mis) const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	if (_hist_mis!=&mis) {
+		// The HU values of each row, rescaled with the slope and intercept of its own slice, as medianHU
+		const IntensityVolume& vol = mis.hu_volume();
+		_hist = pcl::statistics::DenseHistogram<int>();
+		ROItraverser rt(_roi);
+		Point p1, p2;
+		TravStatus s = rt.valid();
+		while(s<END_ROI) {
+			rt.current_interval(p1, p2);
+			const short* hu = vol.hu_row(p1.y, p1.z);
+			for(int x=p1.x; x<=p2.x; x++)
+				_hist.addValue(hu[x]);
+			s = rt.next_interval();
+		}
+		_median_hu = (_hist.getNum()==0) ? 0 : (int)_hist.getMedian();
+
+		_hist_mis = &mis;
+	}
+	return _hist;
+}
+
+
+const int ImageRegion::median_hu(MedicalImageSequence& mis) const
+{
+	hu_hist(mis);
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	return _median_hu;
+}
+
+
+const unsigned long long ImageRegion::digest() const
+{
+	std::lock_guard<std::mutex> lock(_cache_mutex);
+	if (!_digest_cached) {
+		// FNV-1a over the coordinates of the intervals
+		unsigned long long h = 14695981039346656037ULL;
+		ROItraverser rt(_roi);
+		Point p1, p2;
+		TravStatus s = rt.valid();
+		while(s<END_ROI) {
+			rt.current_interval(p1, p2);
+			const int v[4] = {p1.x, p2.x, p1.y, p1.z};
+			for(int i=0; i<4; i++) {
+				h ^= (unsigned int)v[i];
+				h *= 1099511628211ULL;
+			}
+			s = rt.next_interval();
+		}
+		_digest = h;
+		_digest_cached = true;
+	}
+	return _digest;
+}
+
+
+void ImageRegion::_clear_cache()
+{
+	for(size_t i=0; i<_plane_bnd.size(); i++)
+		if (_plane_bnd[i])
+			delete [] _plane_bnd[i];
+	_plane_bnd.clear();
+	_plane_num_bnd.clear();
+	_plane_num_pix.clear();
+	_extent_cached = false;
+	_diam_cached = false;
+	_hist_mis = 0;
+	_digest_cached = false;
+}
+
+
+void ImageRegion::_cache_extent() const
+{
+	if (_extent_cached)
+		return;
+
+	_roi.bounding_cube(_tl, _br);
+	const int nz = _br.z-_tl.z+1;
+	_plane_num_pix.assign(nz, 0);
+	_plane_bnd.assign(nz, 0);
+	_plane_num_bnd.assign(nz, -1);
+
+	ROItraverser rt(_roi);
+	Point p1, p2;
+	TravStatus s = rt.valid();
+	while(s<END_ROI) {
+		rt.current_interval(p1, p2);
+		_plane_num_pix[p1.z-_tl.z] += p2.x-p1.x+1;
+		s = rt.next_interval();
+	}
+	_extent_cached = true;
+}
+
+
 //void ImageRegion::translate_to_inst_nums(const int offset) {
 void ImageRegion::translate_z(const int offset) {
+	_clear_cache();
 	_roi.translate(0,0,offset);
 	_centroid.z += offset;
 
@@ -153,6 +323,7 @@ void ImageRegion::translate_z(const int offset) {
 
 
 void ImageRegion::map_to_inst_nums(const int* im_inst_nums) {
+	_clear_cache();
 	ROI rt;
 
 	Point fp;
@@ -49,11 +49,14 @@
 -*/
 
 #include <ostream>
+#include <mutex>
+#include <vector>
 #include "MedicalImageSequence.h"
 #include "ROItraverser.h"
 #include "ImagePrimitive.h"
 #include "FPoint.h"
 #include "tools_miu.h"
+#include <pcl/statistics/DenseHistogram.h>
 
 using std::ostream;
 
@@ -61,6 +64,7 @@ using std::ostream;
 An ROI image primitive.
 An ROI primitive without any points is not allowed.
 This class maintains some internal values derived from the ROI (e.g. centroid). Therefore these values must be updated internally any time the ROI is changed.
+Other values that several features need (e.g. boundaries and diameters) are computed on first use and cached until the ROI is changed.
 */
 class ImageRegion : public ImagePrimitive {
 public:
@@ -101,6 +105,42 @@ public:
 	/// Return the volume (in mm3)
 	inline const float volume() const { return _volume; };
 
+	/** @name Cached values
+	Computed from the ROI when first requested and kept until the ROI is changed (by translate_z or map_to_inst_nums), so that the features of a region share them.
+	They may be requested concurrently from several threads.
+	*/
+	//@{
+
+	/// Sets the bounding cube of the ROI and returns 1 (as ROI::bounding_cube, the region is never empty)
+	const int bounding_cube(Point& tl, Point& br) const;
+
+	/// Returns the number of points in the plane z (0 if the plane contains no points)
+	const int num_pix(const int z) const;
+
+	/**
+	Returns the boundaries of the plane z (as ROI::boundaries), n is set to the number of contours.
+	The contours belong to the region and remain valid until its ROI is changed.
+	*/
+	const Contour* boundaries(int& n, const int z) const;
+
+	/**
+	Computes the maximum diameter and its perpendicular diameter (as compute_diameters).
+	The end points are found once in pixel coordinates, the diameters are computed from them using the pixel spacings.
+	End points that are not found have x-coordinate -1.
+	*/
+	void diameters(const float row_pixel_spacing, const float col_pixel_spacing, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2, double& max_diameter, double& perp_diameter) const;
+
+	/// Returns the histogram of the HU values of the ROI in the image sequence (see MedicalImageSequence::hu_volume)
+	const pcl::statistics::DenseHistogram<int>& hu_hist(MedicalImageSequence& mis) const;
+
+	/// Returns the median HU of the ROI in the image sequence (as medianHU)
+	const int median_hu(MedicalImageSequence& mis) const;
+
+	/// Returns a 64-bit hash of the intervals of the ROI (regions with the same points have the same digest, see SearchAreaCache)
+	const unsigned long long digest() const;
+
+	//@}
+
 	/**
 	Performs a z-coordinate translation of the primitive.
 	Intended to make the primitive compliant with ImageInstanceNumber in the dicom header rather than based on images indexed from zero.
@@ -178,6 +218,51 @@ private:
 
 	/// The volume of the ROI in mm3
 	float _volume;
+
+	/// Clears the cached values (called when the ROI is changed)
+	void _clear_cache();
+
+	/// Computes the bounding cube and the number of points in each plane, if not cached (_cache_mutex must be locked)
+	void _cache_extent() const;
+
+	/// Guards the cached values
+	mutable std::mutex _cache_mutex;
+
+	/// Set if _tl, _br and _plane_num_pix are cached
+	mutable bool _extent_cached;
+
+	/// Bounding cube of the ROI
+	mutable Point _tl, _br;
+
+	/// Number of points in each plane from _tl.z to _br.z
+	mutable std::vector<int> _plane_num_pix;
+
+	/// Boundaries of each plane from _tl.z to _br.z (0 if not computed)
+	mutable std::vector<Contour*> _plane_bnd;
+
+	/// Number of contours in each of _plane_bnd
+	mutable std::vector<int> _plane_num_bnd;
+
+	/// Set if the diameter end points are cached
+	mutable bool _diam_cached;
+
+	/// End points of the maximum diameter and its perpendicular diameter (pixel coordinates)
+	mutable Point _mdist_pt1, _mdist_pt2, _mpdist_pt1, _mpdist_pt2;
+
+	/// Image sequence of the cached histogram (0 if not cached)
+	mutable const MedicalImageSequence* _hist_mis;
+
+	/// Histogram of the HU values of the ROI
+	mutable pcl::statistics::DenseHistogram<int> _hist;
+
+	/// Median HU of the ROI (computed with the histogram)
+	mutable int _median_hu;
+
+	/// Set if _digest is cached
+	mutable bool _digest_cached;
+
+	/// Hash of the intervals of the ROI
+	mutable unsigned long long _digest;
 };
 
 
@@ -10,13 +10,14 @@ using std::ifstream;
 using std::ofstream;
 
 ImageSequence::ImageSequence() 
-  : _num_images(0), _images(0)
+  : _num_images(0), _images(0), _volume(0)
 {};
 
 ImageSequence::ImageSequence(const int num_images, 
 			     const int width, const int height,
 			     const int bits_per_pixel, 
 			     const char** const file_names)
+  : _volume(0)
 {
   _num_images = num_images;
   _images = new Image*[num_images];
@@ -34,13 +35,14 @@ ImageSequence::ImageSequence(const int num_images,
 
 ImageSequence::ImageSequence(const int num_images,
 			     Image** images)
+  : _volume(0)
 {
   _num_images = num_images;
   _images = images;
 };
 
 ImageSequence::ImageSequence(const ImageSequence& is) 
-  : _num_images(0), _images(0)
+  : _num_images(0), _images(0), _volume(0)
 {
   *this = is;
 }
@@ -52,6 +54,7 @@ ImageSequence::~ImageSequence()
     delete _images[i];
   };
   delete [] _images;
+  delete [] _volume;
 };
 
 void ImageSequence::force_load()
@@ -133,6 +136,8 @@ ifstream& operator>>(ifstream& file, ImageSequence& is) {
     delete is._images[i];
   }
   delete [] is._images;
+  delete [] is._volume;
+  is._volume = 0;
   
   //Read in new number of images, and allocate new image array
   file >> is._num_images;
@@ -157,6 +162,8 @@ const ImageSequence& ImageSequence::operator=(const ImageSequence& Rhs) {
       delete _images[i];
     }
     delete [] _images;
+    delete [] _volume;
+    _volume = 0;
 
     //Allocate new image array
     _num_images = Rhs._num_images;
@@ -139,12 +139,25 @@ public:
   /// Returns long description of sequence (probably override in derived).
   virtual const char* const long_desc() const;
 
+  /**
+   *  Returns the contiguous buffer of width*height*num_images pixels
+   *  (row major, image by image) that the images are views into,
+   *  0 if each image holds its own pixel data.
+   */
+  const short* const volume_data() const;
+
 protected:
   /// Number of images in sequence.
   int _num_images;
 
   /// Array of Image pointers to the images.
   Image** _images;
+
+  /**
+   *  Contiguous pixel buffer that the images are views into, 0 if the
+   *  images hold their own pixel data.  Deleted with the sequence.
+   */
+  short* _volume;
 };
 
 inline
@@ -165,5 +178,11 @@ const int ImageSequence::bits_per_pixel() const
   return _images[0]->bits_per_pixel();
 };
 
+inline
+const short* const ImageSequence::volume_data() const
+{
+  return _volume;
+};
+
 
 #endif /* !__ImageSequence_h_ */
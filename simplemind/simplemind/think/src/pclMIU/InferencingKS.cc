@@ -1,4 +1,6 @@
 #include "InferencingKS.h"
+#include <algorithm>
+#include <vector>
 
 
 void ImCandConfR(Blackboard& bb)
@@ -83,7 +85,7 @@ float RadLogicsCandConfS(const Blackboard& bb)
 }
 
 // Dummy function. Will be provided by RadLogics
-//void RunNoduleClassification(double& classification_score, int& classification_result, const short* const image_volume, ROI& roi, double meanHU, double max_diameter, double perp_diameter, double sphericity, const std::string& const node_name) {
+//void RunNoduleClassification(double& classification_score, int& classification_result, const ShortVolumeView& image_volume, ROI& roi, double meanHU, double max_diameter, double perp_diameter, double sphericity, const std::string& const node_name) {
 //}
 
 void RadLogicsCandConfA(Blackboard& bb)
@@ -121,7 +123,7 @@ void RadLogicsCandConfA(Blackboard& bb)
 
 						int classification_result; // 0,1 values indicating whether nodule or not
 						double classification_score;
-						RunNoduleClassification(&classification_score, &classification_result, bb.hu_values_column_major(), roi, meanHU(bb.med_im_seq(), rt), max_diameter, perp_diameter, sphericity(ir), s.name());
+						RunNoduleClassification(&classification_score, &classification_result, bb.med_im_seq().hu_values(), roi, meanHU(bb.med_im_seq(), rt), max_diameter, perp_diameter, sphericity(ir), s.name());
 						
 						s.candidate(j)->feature_value(i, classificationResult);
 						s.candidate(j)->conf_score(i, ((Feature*)a)->fuzzy().val(classificationResult));
@@ -165,16 +167,99 @@ float FormGroupCandsS(Blackboard& bb)
 }
 
 
-void add_im_cands_to_group_cand(Blackboard& bb, SEgroup& g, GroupCandidate gc, const int se_ind_ind)
+/**
+Returns true if the GroupCandConf knowledge source computes the attribute of a solution element of group g for the group candidates:
+a feature related to a solution element of the group, whose other related solution elements are matched.
+*/
+static const bool group_feature(Blackboard& bb, const SEgroup& g, const Attribute* a)
+{
+	if (strcmp(a->type(), "Feature"))
+		return false;
+	int k, ok=0, fail=0;
+	for(k=0; (k<a->num_rel_solels()) && !fail; k++) {
+		if (g.in_group(a->rel_solel_index(k)))
+			ok = 1;
+		else if (!bb.sol_element(a->rel_solel_index(k)).matched_prim())
+			fail = 1;
+	}
+	return ok && !fail;
+}
+
+
+/// Lowers the confidence of group candidate gc to the fuzzy values of a group feature (see group_feature) of the m'th solution element of the group
+static void group_feature_conf(Blackboard& bb, SEgroup& g, GroupCandidate& gc, const int m, const Attribute* a)
+{
+	SolElement& s = bb.sol_element(g.sol_el_index(m));
+	int k;
+	float val, conf;
+	Darray<ImagePrimitive*> prim(2);
+	ImagePrimitive* const s_prim = s.candidate(gc.im_cand_index(m))->primitive();
+	prim.push_last(s_prim);
+
+	for(k=0; k<a->num_rel_solels(); k++) {
+		SolElement& rs = bb.sol_element(a->rel_solel_index(k));
+		if (rs.matched_prim()) {
+			prim.push_last((ImagePrimitive* const)rs.matched_prim());
+		}
+		else {
+			int rs_grp_ind = g.find_solel_grp_ind(a->rel_solel_index(k));
+			if (rs_grp_ind>-1) {
+			   if (gc.im_cand_index(rs_grp_ind)>-1) {
+				ImagePrimitive* const related_prim = bb.sol_element(a->rel_solel_index(k)).candidate(gc.im_cand_index(rs_grp_ind))->primitive();
+				prim.push_last(related_prim);
+			   }
+			}
+			else {
+				cerr << "ERROR: BestGroupCandA: Cannot figure out what to do with solution element" << endl;
+				exit(1);
+			}
+		}
+
+		if (((Feature*)a)->value(bb.med_im_seq(), prim, val)) {
+			conf = ((Feature*)a)->fuzzy().val(val);
+			if (conf<gc.conf_score())
+				gc.conf_score(conf);
+		}
+	}
+}
+
+
+/// State of the group candidate search of FormGroupCandsA
+struct GroupCandSearch {
+	/// Group features (solution element index in the group, attribute index) computed when the solution element with the highest group index they involve is assigned
+	std::vector<std::vector<std::pair<int, int> > > features;
+
+	/// Group candidates with a higher confidence are kept (lowest MatchAboveConf threshold of the group, 1 if none)
+	float keep_above;
+
+	/// Highest confidence of the group candidates found so far
+	float best;
+};
+
+
+/**
+Assigns image candidates to the se_ind_ind'th solution element of the group candidate, and recursively to the following ones.
+The confidence of a partial group candidate (minimum of the partial confidences and of the group features of the assigned image candidates) can only decrease as it is extended,
+so partial group candidates are pruned if their confidence is not higher than both the best confidence found so far and search.keep_above.
+The group candidates MatchCandsA can use, i.e. the first one with the highest confidence and those above the MatchAboveConf thresholds, are kept.
+*/
+void add_im_cands_to_group_cand(Blackboard& bb, SEgroup& g, GroupCandidate gc, const int se_ind_ind, GroupCandSearch& search)
 {
-	if (se_ind_ind>=g.num_sol_els())
-		g.add_group_cand(gc);
+	if (se_ind_ind>=g.num_sol_els()) {
+		if ((gc.conf_score()>search.best) || (gc.conf_score()>search.keep_above)) {
+			g.add_group_cand(gc);
+			if (gc.conf_score()>search.best)
+				search.best = gc.conf_score();
+		}
+	}
 	else {
 		int sol_el_ind = g.sol_el_index(se_ind_ind);
 		SolElement& s = bb.sol_element(sol_el_ind);
-		register int k;
-		register float partial_conf;
-		register float orig_conf = gc.conf_score();
+		const std::vector<std::pair<int, int> >& features = search.features[se_ind_ind];
+		int k;
+		size_t f;
+		float partial_conf;
+		float orig_conf = gc.conf_score();
 		for(k=0; k<s.num_candidates(); k++) {
 			partial_conf = s.candidate(k)->partial_confidence();
 			if (partial_conf>0) {
@@ -184,19 +269,106 @@ void add_im_cands_to_group_cand(Blackboard& bb, SEgroup& g, GroupCandidate gc, c
 				else
 					gc.conf_score(orig_conf);
 
-				add_im_cands_to_group_cand(bb, g, gc, se_ind_ind+1);
+				for(f=0; (f<features.size()) && (gc.conf_score()>std::min(search.best, search.keep_above)); f++)
+					group_feature_conf(bb, g, gc, features[f].first, bb.sol_element(g.sol_el_index(features[f].first)).attribute(features[f].second));
+				if (gc.conf_score()>std::min(search.best, search.keep_above))
+					add_im_cands_to_group_cand(bb, g, gc, se_ind_ind+1, search);
 			}
 		}
 	}
 }
 
 
+/// Returns true if the image candidate indices of a come before those of b in the order the candidates are enumerated by add_im_cands_to_group_cand
+static const bool enumerated_before(const GroupCandidate& a, const GroupCandidate& b)
+{
+	for(int i=0; i<a.num_sol_els(); i++)
+		if (a.im_cand_index(i)!=b.im_cand_index(i))
+			return a.im_cand_index(i)<b.im_cand_index(i);
+	return false;
+}
+
+
+/// Returns true if a has a higher confidence than b
+static const bool higher_conf(const GroupCandidate& a, const GroupCandidate& b)
+{
+	return a.conf_score()>b.conf_score();
+}
+
+
+/**
+Beam search (see Blackboard::group_beam_width): the partial group candidates are extended one solution element at a time,
+keeping the beam_width ones with the highest confidences (earlier enumerated ones first for equal confidences).
+*/
+static void add_group_cands_beam(Blackboard& bb, SEgroup& g, const int beam_width, const GroupCandSearch& search)
+{
+	std::vector<GroupCandidate> beam(1, GroupCandidate(g.num_sol_els())), next;
+	const float keep_above = std::min(search.best, search.keep_above);
+	int i, k;
+	size_t b, f;
+	for(i=0; (i<g.num_sol_els()) && !beam.empty(); i++) {
+		SolElement& s = bb.sol_element(g.sol_el_index(i));
+		const std::vector<std::pair<int, int> >& features = search.features[i];
+		next.clear();
+		for(b=0; b<beam.size(); b++)
+			for(k=0; k<s.num_candidates(); k++) {
+				float partial_conf = s.candidate(k)->partial_confidence();
+				if (partial_conf>0) {
+					GroupCandidate gc(beam[b]);
+					gc.im_cand_index(i, k);
+					if (partial_conf<gc.conf_score())
+						gc.conf_score(partial_conf);
+					for(f=0; (f<features.size()) && (gc.conf_score()>keep_above); f++)
+						group_feature_conf(bb, g, gc, features[f].first, bb.sol_element(g.sol_el_index(features[f].first)).attribute(features[f].second));
+					if (gc.conf_score()>keep_above)
+						next.push_back(gc);
+				}
+			}
+		std::stable_sort(next.begin(), next.end(), higher_conf);
+		if ((int)next.size()>beam_width)
+			next.erase(next.begin()+beam_width, next.end());
+		beam.swap(next);
+	}
+
+	std::sort(beam.begin(), beam.end(), enumerated_before);
+	for(b=0; b<beam.size(); b++)
+		g.add_group_cand(beam[b]);
+}
+
+
 void FormGroupCandsA(Blackboard& bb)
 {
 	SEgroup& g = bb.group(bb.next_group());
 
-	GroupCandidate gc(g.num_sol_els());
-	add_im_cands_to_group_cand(bb, g, gc, 0);
+	// Group features are computed during the search, when the image candidates of all the solution elements of the group they involve are assigned
+	GroupCandSearch search;
+	search.features.resize(g.num_sol_els());
+	search.keep_above = 1;
+	search.best = 0;
+	int m, i, k;
+	for(m=0; m<g.num_sol_els(); m++) {
+		const SolElement& s = bb.sol_element(g.sol_el_index(m));
+		const Attribute* const match = s.find_attribute("MatchAboveConf");
+		if (match && (((MatchAboveConf*)match)->conf_thresh()<search.keep_above))
+			search.keep_above = ((MatchAboveConf*)match)->conf_thresh();
+
+		for(i=0; i<s.num_attributes(); i++) {
+			const Attribute* a = s.attribute(i);
+			if (group_feature(bb, g, a)) {
+				int last = m;
+				for(k=0; k<a->num_rel_solels(); k++)
+					last = std::max(last, g.find_solel_grp_ind(a->rel_solel_index(k)));
+				search.features[last].push_back(std::make_pair(m, i));
+			}
+		}
+	}
+
+	if (bb.group_beam_width()>0)
+		add_group_cands_beam(bb, g, bb.group_beam_width(), search);
+	else {
+		GroupCandidate gc(g.num_sol_els());
+		add_im_cands_to_group_cand(bb, g, gc, 0, search);
+	}
 }
 
 
@@ -216,59 +388,16 @@ float GroupCandConfS(Blackboard& bb)
 void GroupCandConfA(Blackboard& bb)
 {
 	SEgroup& g = bb.group(bb.next_group());
-	register int i, j, k, m, ok, fail;
-	float val, conf;
+	int i, j, m;
 
 	for(m=0; m<g.num_sol_els(); m++) {
 		SolElement& s = bb.sol_element(g.sol_el_index(m));
 
 		for(i=0; i<s.num_attributes(); i++) {
 			const Attribute* a = s.attribute(i);
-			if (!strcmp(a->type(), "Feature")) {
-				ok = 0, fail = 0;
-				for(k=0; (k<a->num_rel_solels()) && !fail; k++) {
-					SolElement& rs = bb.sol_element(a->rel_solel_index(k));
-					if (g.in_group(a->rel_solel_index(k)))
-						ok = 1;
-					else if (!rs.matched_prim())
-						fail = 1;
-				}
-
-				if (ok) {
-			  		for(j=0; j<g.num_group_cands(); j++) {
-						GroupCandidate& gc = g.group_cand(j);
-						Darray<ImagePrimitive*> prim(2);
-						ImagePrimitive* const s_prim = s.candidate(gc.im_cand_index(m))->primitive();
-						prim.push_last(s_prim);
-
-						for(k=0; k<a->num_rel_solels(); k++) {
-							SolElement& rs = bb.sol_element(a->rel_solel_index(k));
-							if (rs.matched_prim()) {
-								prim.push_last((ImagePrimitive* const)rs.matched_prim());
-							}
-							else {
-								int rs_grp_ind = g.find_solel_grp_ind(a->rel_solel_index(k));
-								if (rs_grp_ind>-1) {
-								   if (gc.im_cand_index(rs_grp_ind)>-1) {
-									ImagePrimitive* const related_prim = bb.sol_element(a->rel_solel_index(k)).candidate(gc.im_cand_index(rs_grp_ind))->primitive();
-									prim.push_last(related_prim);
-								   }
-								}
-								else {
-									cerr << "ERROR: BestGroupCandA: Cannot figure out what to do with solution element" << endl;
-									exit(1);
-								}
-							}
-
-							if (((Feature*)a)->value(bb.med_im_seq(), prim, val)) {
-								conf = ((Feature*)a)->fuzzy().val(val);
-								if (conf<gc.conf_score())
-									gc.conf_score(conf);
-							}
-						}
-					}
-				}
-			}
+			if (group_feature(bb, g, a))
+				for(j=0; j<g.num_group_cands(); j++)
+					group_feature_conf(bb, g, g.group_cand(j), m, a);
 		}
 	}
 }
@@ -103,6 +103,10 @@ float FormGroupCandsS(Blackboard&);
 /**
 Forms group candidates and sets their overall confidence based on the partial confidences of the included image candidates (fuzzy logic).
 Image candidates are only used if their partial confidence is > 0.
+The features computed by GroupCandConfA are included in the confidence as soon as the image candidates they involve are assigned,
+and partial group candidates that cannot beat the best confidence found so far are pruned (branch and bound).
+Only the group candidates MatchCandsA can use are formed: the first one with the highest confidence and those above the MatchAboveConf thresholds of the group.
+If Blackboard::group_beam_width is > 0, a beam search keeping that many partial group candidates per solution element is done instead (approximate).
 */
 void FormGroupCandsA(Blackboard&);
 
@@ -0,0 +1,74 @@
+#include "IntensityVolume.h"
+#include "simd_miu.h"
+#include <algorithm>
+
+/// Side of the square tiles in which planes are transposed (two 64x64 short tiles fit in the L1 cache)
+static const int TRANSPOSE_TILE = 64;
+
+IntensityVolume::IntensityVolume(MedicalImageSequence& mis)
+	: _xdim(mis.xdim()), _ydim(mis.ydim()), _zdim(mis.zdim()), _plane_size((long)mis.xdim()*mis.ydim()),
+	  _gl(mis.zdim()), _slope(mis.zdim()), _intercept(mis.zdim()), _hu(0), _own_hu(false), _hu_column_major(0)
+{
+	bool identity = true;
+	for(int z=0; z<_zdim; z++) {
+		Image& im = mis.image(z);
+		_gl[z] = im.pixel_data();
+		_slope[z] = im.rescale_slope();
+		_intercept[z] = im.rescale_intercept();
+		identity = identity && (_slope[z]==1) && (_intercept[z]==0);
+	}
+
+	if (identity && mis.volume_data())
+		_hu = const_cast<short*>(mis.volume_data());
+	else {
+		_hu = new short [_plane_size*_zdim];
+		_own_hu = true;
+		for(int z=0; z<_zdim; z++)
+			rescale_short_array(_gl[z], _hu + z*_plane_size, _plane_size, _slope[z], _intercept[z]);
+	}
+}
+
+IntensityVolume::~IntensityVolume()
+{
+	if (_own_hu)
+		delete [] _hu;
+	delete [] _hu_column_major;
+}
+
+const ShortVolumeView IntensityVolume::hu_view() const
+{
+	ShortVolumeView v;
+	v.data = _hu;
+	v.x_stride = 1;
+	v.y_stride = _xdim;
+	v.z_stride = _plane_size;
+	return v;
+}
+
+const short* IntensityVolume::hu_column_major()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_hu_column_major) {
+		_hu_column_major = new short [_plane_size*_zdim];
+		short tile[TRANSPOSE_TILE*TRANSPOSE_TILE];
+		for(int z=0; z<_zdim; z++) {
+			const short* gl = _gl[z];
+			short* out = _hu_column_major + z*_plane_size;
+			for(int y0=0; y0<_ydim; y0+=TRANSPOSE_TILE) {
+				const int ny = std::min(TRANSPOSE_TILE, _ydim-y0);
+				for(int x0=0; x0<_xdim; x0+=TRANSPOSE_TILE) {
+					const int nx = std::min(TRANSPOSE_TILE, _xdim-x0);
+					// Rescale the rows of the tile, then write its columns
+					for(int y=0; y<ny; y++)
+						rescale_short_array(gl + (long)(y0+y)*_xdim + x0, tile + y*TRANSPOSE_TILE, nx, _slope[z], _intercept[z]);
+					for(int x=0; x<nx; x++) {
+						short* col = out + (long)(x0+x)*_ydim + y0;
+						for(int y=0; y<ny; y++)
+							col[y] = tile[y*TRANSPOSE_TILE + x];
+					}
+				}
+			}
+		}
+	}
+	return _hu_column_major;
+}
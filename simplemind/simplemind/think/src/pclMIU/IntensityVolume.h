@@ -0,0 +1,92 @@
+#ifndef __IntensityVolume_h_
+#define __IntensityVolume_h_
+
+#include "MedicalImageSequence.h"
+#include <mutex>
+#include <vector>
+
+/**
+Gray level and HU values of a MedicalImageSequence as plain arrays, for knowledge sources that read many voxels.
+
+The gray levels are the pixel data of the images (not copied).
+The HU values are computed once with the rescale slope and intercept of each image (see rescale_short in simd_miu.h),
+using SSE2/AVX2 where available.
+If the images are views into a contiguous volume buffer (see ImageSequence::volume_data) and all slopes are 1 and intercepts 0,
+the HU values are that buffer and no copy is made.
+
+A sequence builds its IntensityVolume on first use and shares it (see MedicalImageSequence::hu_volume).
+*/
+class IntensityVolume {
+public:
+	/// Constructor - computes the HU values of mis
+	IntensityVolume(MedicalImageSequence& mis);
+
+	/// Destructor
+	~IntensityVolume();
+
+	/// Number of pixels in x
+	inline const int xdim() const { return _xdim; };
+
+	/// Number of pixels in y
+	inline const int ydim() const { return _ydim; };
+
+	/// Number of planes
+	inline const int zdim() const { return _zdim; };
+
+	/// Gray levels of plane z in row major order
+	inline const short* gl_plane(const int z) const { return _gl[z]; };
+
+	/// Gray levels of row y of plane z
+	inline const short* gl_row(const int y, const int z) const { return _gl[z] + (long)y*_xdim; };
+
+	/// HU values of plane z in row major order
+	inline const short* hu_plane(const int z) const { return _hu + z*_plane_size; };
+
+	/// HU values of row y of plane z
+	inline const short* hu_row(const int y, const int z) const { return _hu + z*_plane_size + (long)y*_xdim; };
+
+	/// HU value at (x, y, z)
+	inline const short hu(const int x, const int y, const int z) const { return _hu[z*_plane_size + (long)y*_xdim + x]; };
+
+	/// Strided access to the HU values
+	const ShortVolumeView hu_view() const;
+
+	/**
+	Returns the HU values in column-major order (index y + x*ydim + z*ydim*xdim).
+	Computed from the gray levels in cache-blocked tiles the first time it is called.
+	*/
+	const short* hu_column_major();
+
+	/// Returns true if the HU values are the volume buffer of the sequence (no copy was made)
+	inline const bool hu_is_volume() const { return !_own_hu; };
+
+private:
+	/// Not to be used
+	IntensityVolume(const IntensityVolume&);
+	const IntensityVolume& operator=(const IntensityVolume&);
+
+	int _xdim, _ydim, _zdim;
+
+	/// xdim*ydim
+	long _plane_size;
+
+	/// Gray level planes (pixel data of the images)
+	std::vector<const short*> _gl;
+
+	/// Rescale slope and intercept of each plane
+	std::vector<float> _slope, _intercept;
+
+	/// HU values in row major order
+	short* _hu;
+
+	/// Whether _hu was allocated here
+	bool _own_hu;
+
+	/// HU values in column-major order, 0 until hu_column_major is called
+	short* _hu_column_major;
+
+	/// Guards the construction of _hu_column_major
+	std::mutex _mutex;
+};
+
+#endif // !__IntensityVolume_h_
@@ -1,11 +1,5 @@
 #include "Interval.h"
 
-Interval::Interval(const Interval& i)
-	: x1(i.x1), x2(i.x2)
-{
-}
-
-
 int ivl_comp_touch(const Interval& i1, const Interval& i2)
 {
 	int d;
@@ -77,11 +77,14 @@ struct Interval {
 	/// Constructor	
 	Interval(int xv=0) { x1=x2=xv; };
 
-	/// Copy constructor
-	Interval(const Interval&);
+	/// Copy constructor (trivial, so that arrays of Intervals are copied and sorted as plain memory)
+	Interval(const Interval&) = default;
+
+	/// Assignment operator
+	Interval& operator=(const Interval&) = default;
 
 	/// Destructor
-	~Interval() { /*cout << "ivl dest" << endl;*/};
+	~Interval() = default;
 
 	/// Returns the number of points in the interval
 	const int num_pts() const { return (x2-x1+1); };
@@ -0,0 +1,328 @@
+#include "KSprofiler.h"
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+#if !(defined(WIN32) || defined(_WIN32) || defined(__WIN32)) || defined(__CYGWIN__)
+#define KS_PROFILER_POSIX
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+typedef std::chrono::steady_clock KSclock;
+
+thread_local double KSprofiler::_external_time = 0;
+
+static double seconds_since(const KSclock::time_point& t)
+{
+	return std::chrono::duration<double>(KSclock::now()-t).count();
+}
+
+/// Writes s as a JSON string (with quotes)
+static void write_json_string(ostream& out, const std::string& s)
+{
+	out << '"';
+	for(size_t i=0; i<s.length(); i++) {
+		const char c = s[i];
+		if ((c=='"') || (c=='\\'))
+			out << '\\' << c;
+		else if ((unsigned char)c<0x20)
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+/// Writes s as a CSV field (quoted if necessary)
+static void write_csv_field(ostream& out, const std::string& s)
+{
+	if (s.find_first_of(",\"\n")==std::string::npos) {
+		out << s;
+		return;
+	}
+	out << '"';
+	for(size_t i=0; i<s.length(); i++) {
+		if (s[i]=='"')
+			out << '"';
+		out << s[i];
+	}
+	out << '"';
+}
+
+
+KSprofiler::Scope::Scope(KSprofiler* profiler, const KnowledgeSource& ks, Blackboard& bb, const bool worker)
+	: _profiler(profiler), _bb(bb), _solel(-1), _first_cand(0)
+{
+	if (!_profiler)
+		return;
+	_a.ks_name = ks.name();
+	_a.ks_type = ks.type();
+	_a.thread = 0;
+	_a.worker = worker;
+	_a.replayed = false;
+	_solel = bb.next_solel();
+	if ((_solel>=0) && (_solel<bb.num_sol_elements())) {
+		SolElement& se = bb.sol_element(_solel);
+		_a.solel = se.name();
+		_first_cand = se.num_candidates();
+	}
+	else
+		_solel = -1;
+	_a.peak_rss_delta = _peak_rss();
+	_a.external_time = _external_time;
+	_a.cpu_time = _thread_cpu_time();
+	_start = KSclock::now();
+	_a.start = std::chrono::duration<double>(_start-_profiler->_start).count();
+}
+
+
+KSprofiler::Scope::~Scope()
+{
+	if (!_profiler)
+		return;
+	_a.wall_time = seconds_since(_start);
+	_a.cpu_time = _thread_cpu_time()-_a.cpu_time;
+	_a.external_time = _external_time-_a.external_time;
+	_a.peak_rss_delta = _peak_rss()-_a.peak_rss_delta;
+
+	_a.num_candidates = _a.num_voxels = _a.num_intervals = 0;
+	if (_solel>=0) {
+		SolElement& se = _bb.sol_element(_solel);
+		for(int i=_first_cand; i<se.num_candidates(); i++) {
+			_a.num_candidates++;
+			const ImagePrimitive* prim = se.candidate(i)->primitive();
+			if (prim && !strcmp(prim->type(), "ImageRegion")) {
+				const ROI& r = ((const ImageRegion*)prim)->roi();
+				_a.num_voxels += r.num_pix();
+				_a.num_intervals += r.num_intervals();
+			}
+		}
+	}
+	_profiler->_add(_a);
+}
+
+
+KSprofiler::KSprofiler()
+	: _start(KSclock::now())
+{
+}
+
+
+const int KSprofiler::num_activations() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _activation.size();
+}
+
+
+void KSprofiler::_add(Activation& a)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::map<std::thread::id, int>::const_iterator it = _thread.find(std::this_thread::get_id());
+	if (it==_thread.end())
+		it = _thread.insert(std::make_pair(std::this_thread::get_id(), (int)_thread.size())).first;
+	a.thread = it->second;
+	_activation.push_back(a);
+}
+
+
+int KSprofiler::system(const char* command)
+{
+	KSclock::time_point t = KSclock::now();
+	const int retVal = ::system(command);
+	_external_time += seconds_since(t);
+	return retVal;
+}
+
+
+void KSprofiler::add_external_time(const double seconds)
+{
+	_external_time += seconds;
+}
+
+
+double KSprofiler::_thread_cpu_time()
+{
+#ifdef KS_PROFILER_POSIX
+	struct timespec ts;
+	if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+		return ts.tv_sec + 1e-9*ts.tv_nsec;
+#endif
+	// Process CPU time
+	return (double)std::clock()/CLOCKS_PER_SEC;
+}
+
+
+long KSprofiler::_peak_rss()
+{
+#ifdef KS_PROFILER_POSIX
+	struct rusage ru;
+	if (!getrusage(RUSAGE_SELF, &ru))
+		return ru.ru_maxrss;
+#endif
+	return 0;
+}
+
+
+void KSprofiler::write(const std::string& output_directory, const std::string& image_file) const
+{
+	const char* const name[3] = {"ks_profile.csv", "ks_profile.json", "ks_trace.json"};
+	for(int i=0; i<3; i++) {
+		std::string fn = output_directory + "/" + name[i];
+		cout << "Writing knowledge source profile to " << fn << " ..." << endl;
+		ofstream outfile(fn);
+		if (!outfile) {
+			cerr << "WARNING: KSprofiler: unable to open output file for writing: " << fn << endl;
+			continue;
+		}
+		if (i==0)
+			write_csv(outfile);
+		else if (i==1)
+			write_json(outfile, image_file);
+		else
+			write_trace(outfile);
+	}
+}
+
+
+void KSprofiler::write_csv(ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	// Formatted separately so that the format flags of a stream shared by concurrent cases (batch mode) are not changed
+	std::ostringstream s;
+	s << std::setprecision(9);
+	s << "index,ks_name,ks_type,solel,thread,worker,replayed,start_s,wall_time_s,cpu_time_s,external_time_s,peak_rss_delta_kb,num_candidates,num_voxels,num_intervals" << endl;
+	for(size_t i=0; i<_activation.size(); i++) {
+		const Activation& a = _activation[i];
+		s << i << ",";
+		write_csv_field(s, a.ks_name);
+		s << ",";
+		write_csv_field(s, a.ks_type);
+		s << ",";
+		write_csv_field(s, a.solel);
+		s << "," << a.thread << "," << a.worker << "," << a.replayed << "," << a.start << "," << a.wall_time << "," << a.cpu_time << "," << a.external_time
+			<< "," << a.peak_rss_delta << "," << a.num_candidates << "," << a.num_voxels << "," << a.num_intervals << endl;
+	}
+	out << s.str();
+}
+
+
+/// Totals of the activations of a knowledge source or solution element
+struct KSprofileTotal {
+	KSprofileTotal() : num_activations(0), wall_time(0), cpu_time(0), external_time(0), peak_rss_delta(0), num_candidates(0), num_voxels(0), num_intervals(0) {};
+
+	/// Adds an activation (the candidates of activations on worker threads are counted when they are replayed)
+	void add(const KSprofiler::Activation& a) {
+		num_activations++;
+		wall_time += a.wall_time;
+		cpu_time += a.cpu_time;
+		external_time += a.external_time;
+		peak_rss_delta += a.peak_rss_delta;
+		if (!a.worker) {
+			num_candidates += a.num_candidates;
+			num_voxels += a.num_voxels;
+			num_intervals += a.num_intervals;
+		}
+	};
+
+	/// Writes the totals as JSON members (after the name member)
+	void write(ostream& s) const {
+		s << ", \"activations\": " << num_activations << ", \"wall_time_s\": " << wall_time << ", \"cpu_time_s\": " << cpu_time << ", \"external_time_s\": " << external_time
+			<< ", \"peak_rss_delta_kb\": " << peak_rss_delta << ", \"num_candidates\": " << num_candidates << ", \"num_voxels\": " << num_voxels << ", \"num_intervals\": " << num_intervals;
+	};
+
+	long num_activations;
+	double wall_time, cpu_time, external_time;
+	long peak_rss_delta, num_candidates, num_voxels, num_intervals;
+};
+
+
+void KSprofiler::write_json(ostream& out, const std::string& image_file) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::ostringstream s;
+	s << std::setprecision(9);
+
+	// Totals in order of first activation
+	std::vector<std::string> ks_order, solel_order;
+	std::map<std::string, KSprofileTotal> ks_total, solel_total;
+	size_t i;
+	for(i=0; i<_activation.size(); i++) {
+		const Activation& a = _activation[i];
+		if (!ks_total.count(a.ks_name))
+			ks_order.push_back(a.ks_name);
+		ks_total[a.ks_name].add(a);
+		if (!a.solel.empty()) {
+			if (!solel_total.count(a.solel))
+				solel_order.push_back(a.solel);
+			solel_total[a.solel].add(a);
+		}
+	}
+
+	s << "{" << endl << "\"image_file\": ";
+	write_json_string(s, image_file);
+	s << "," << endl << "\"knowledge_sources\": [";
+	for(i=0; i<ks_order.size(); i++) {
+		s << ((i>0) ? "," : "") << endl << "  {\"name\": ";
+		write_json_string(s, ks_order[i]);
+		ks_total[ks_order[i]].write(s);
+		s << "}";
+	}
+	s << endl << "]," << endl << "\"solels\": [";
+	for(i=0; i<solel_order.size(); i++) {
+		s << ((i>0) ? "," : "") << endl << "  {\"name\": ";
+		write_json_string(s, solel_order[i]);
+		solel_total[solel_order[i]].write(s);
+		s << "}";
+	}
+	s << endl << "]," << endl << "\"activations\": [";
+	for(i=0; i<_activation.size(); i++) {
+		const Activation& a = _activation[i];
+		s << ((i>0) ? "," : "") << endl << "  {\"ks_name\": ";
+		write_json_string(s, a.ks_name);
+		s << ", \"ks_type\": ";
+		write_json_string(s, a.ks_type);
+		s << ", \"solel\": ";
+		write_json_string(s, a.solel);
+		s << ", \"thread\": " << a.thread << ", \"worker\": " << (a.worker ? "true" : "false") << ", \"replayed\": " << (a.replayed ? "true" : "false")
+			<< ", \"start_s\": " << a.start << ", \"wall_time_s\": " << a.wall_time << ", \"cpu_time_s\": " << a.cpu_time << ", \"external_time_s\": " << a.external_time
+			<< ", \"peak_rss_delta_kb\": " << a.peak_rss_delta << ", \"num_candidates\": " << a.num_candidates << ", \"num_voxels\": " << a.num_voxels
+			<< ", \"num_intervals\": " << a.num_intervals << "}";
+	}
+	s << endl << "]" << endl << "}" << endl;
+	out << s.str();
+}
+
+
+void KSprofiler::write_trace(ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(3);
+	s << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	bool first = true;
+	for(int t=0; t<(int)_thread.size(); t++) {
+		s << (first ? "" : ",") << endl << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t << ", \"args\": {\"name\": \""
+			<< ((t==0) ? "scheduler" : "worker ") << ((t==0) ? "" : std::to_string(t)) << "\"}}";
+		first = false;
+	}
+	for(size_t i=0; i<_activation.size(); i++) {
+		const Activation& a = _activation[i];
+		// Complete events, times in microseconds
+		s << (first ? "" : ",") << endl << "  {\"name\": ";
+		write_json_string(s, a.ks_name);
+		s << ", \"cat\": ";
+		write_json_string(s, a.ks_type);
+		s << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << a.thread << ", \"ts\": " << 1e6*a.start << ", \"dur\": " << 1e6*a.wall_time << ", \"args\": {\"solel\": ";
+		write_json_string(s, a.solel);
+		s << ", \"replayed\": " << (a.replayed ? "true" : "false") << ", \"cpu_time_ms\": " << 1e3*a.cpu_time << ", \"external_time_ms\": " << 1e3*a.external_time
+			<< ", \"peak_rss_delta_kb\": " << a.peak_rss_delta << ", \"num_candidates\": " << a.num_candidates << ", \"num_voxels\": " << a.num_voxels
+			<< ", \"num_intervals\": " << a.num_intervals << "}}";
+		first = false;
+	}
+	s << endl << "]}" << endl;
+	out << s.str();
+}
@@ -0,0 +1,150 @@
+#ifndef __KSprofiler_h_
+#define __KSprofiler_h_
+
+#include "KnowledgeSource.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+Records timing and memory measurements for each knowledge source activation (see KSscheduler::profile).
+For each activation the knowledge source, the solution element being processed (if any) and the thread are recorded, with:
+	- wall time and CPU time of the calling thread,
+	- increase of the peak resident set size of the process (not available on Windows),
+	- time spent waiting for external processes (see system and add_external_time),
+	- the number of candidates formed for the solution element, with the number of voxels and Intervals of their ROIs.
+Activations run on worker threads by the SolelPrefetcher are recorded separately (worker flag), their candidates are counted again when the scheduler commits them (replayed flag),
+so the totals per knowledge source and per solution element count the candidates of the replayed activations only.
+The activations are written as CSV (ks_profile.csv), as JSON with totals per knowledge source and per solution element (ks_profile.json)
+and as a Chrome trace (ks_trace.json, for chrome://tracing or https://ui.perfetto.dev).
+Activations may be recorded from several threads.
+*/
+class KSprofiler {
+public:
+	/// Measurements of one activation
+	struct Activation {
+		/// Knowledge source name
+		std::string ks_name;
+		/// Knowledge source type
+		std::string ks_type;
+		/// Solution element being processed (empty if none)
+		std::string solel;
+		/// Thread number (0 for the first thread that recorded an activation, normally the scheduler)
+		int thread;
+		/// Activated ahead by the SolelPrefetcher (normally on one of its worker threads)
+		bool worker;
+		/// Replay of an activation done on a worker thread (only its candidates are committed)
+		bool replayed;
+		/// Start time (seconds since the profiler was constructed)
+		double start;
+		/// Wall time (seconds)
+		double wall_time;
+		/// CPU time of the calling thread (seconds)
+		double cpu_time;
+		/// Time spent waiting for external processes (seconds)
+		double external_time;
+		/// Increase of the peak resident set size of the process (kB)
+		long peak_rss_delta;
+		/// Number of candidates formed
+		long num_candidates;
+		/// Number of voxels of the ROIs of the candidates formed
+		long num_voxels;
+		/// Number of Intervals of the ROIs of the candidates formed
+		long num_intervals;
+	};
+
+	/**
+	Measures one activation from construction to destruction (does nothing if the profiler is 0).
+	The solution element is the one being processed by the calling thread at construction (see Blackboard::next_solel).
+	*/
+	class Scope {
+	public:
+		/// Constructor - starts measuring an activation of ks (worker: activated ahead by the SolelPrefetcher)
+		Scope(KSprofiler* profiler, const KnowledgeSource& ks, Blackboard& bb, const bool worker);
+
+		/// Destructor - records the activation
+		~Scope();
+
+		/// Marks the activation as the replay of an activation done on a worker thread
+		inline void replayed() { _a.replayed = true; };
+
+	private:
+		/// Profiler (0 if not profiling)
+		KSprofiler* _profiler;
+
+		/// Blackboard
+		Blackboard& _bb;
+
+		/// Index of the solution element (-1 if none)
+		int _solel;
+
+		/// Number of candidates of the solution element at the start
+		int _first_cand;
+
+		/// Start time
+		std::chrono::steady_clock::time_point _start;
+
+		/// Values at the start, replaced by the measurements
+		Activation _a;
+	};
+
+	/// Constructor - the start times of the activations are measured from construction
+	KSprofiler();
+
+	/// Destructor
+	~KSprofiler() {};
+
+	/// Number of activations recorded
+	const int num_activations() const;
+
+	/// Writes ks_profile.csv, ks_profile.json and ks_trace.json to the output directory (image_file is written to the JSON file)
+	void write(const std::string& output_directory, const std::string& image_file) const;
+
+	/// Writes one line per activation, with a header line
+	void write_csv(ostream& s) const;
+
+	/// Writes the activations and the totals per knowledge source and per solution element as JSON
+	void write_json(ostream& s, const std::string& image_file) const;
+
+	/// Writes the activations as complete events of the Chrome trace event format
+	void write_trace(ostream& s) const;
+
+	/**
+	Runs a command with system(), adding its run time to the external process time of the calling thread.
+	Returns the value returned by system().
+	*/
+	static int system(const char* command);
+
+	/// Adds time spent waiting for an external process to the calling thread
+	static void add_external_time(const double seconds);
+
+private:
+	/// Adds an activation (thread is set by the method)
+	void _add(Activation& a);
+
+	/// CPU time of the calling thread (seconds)
+	static double _thread_cpu_time();
+
+	/// Peak resident set size of the process (kB), 0 if not available
+	static long _peak_rss();
+
+	/// Time the profiler was constructed
+	std::chrono::steady_clock::time_point _start;
+
+	/// Recorded activations
+	std::vector<Activation> _activation;
+
+	/// Thread numbers
+	std::map<std::thread::id, int> _thread;
+
+	/// Guards _activation and _thread
+	mutable std::mutex _mutex;
+
+	/// External process time of the calling thread (seconds)
+	static thread_local double _external_time;
+};
+
+#endif // !__KSprofiler_h_
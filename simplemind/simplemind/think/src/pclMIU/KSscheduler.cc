@@ -0,0 +1,192 @@
+#include "KSscheduler.h"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+typedef std::chrono::steady_clock KSclock;
+
+static double seconds_since(const KSclock::time_point& t)
+{
+	return std::chrono::duration<double>(KSclock::now()-t).count();
+}
+
+KSscheduler::KSscheduler(const Darray<KnowledgeSource>& ks)
+	: _ks(ks), _version(ks.N(), 0), _stale(ks.N(), true), _verify(false), _prefetcher(0), _profiler(0), _memo(0), _num_steps(0),
+	_num_scores(ks.N(), 0), _score_time(ks.N(), 0), _num_activations(ks.N(), 0), _activation_time(ks.N(), 0)
+{
+}
+
+KSscheduler::~KSscheduler()
+{
+	if (_prefetcher)
+		delete _prefetcher;
+}
+
+void KSscheduler::verify(const bool v)
+{
+	_verify = v;
+}
+
+void KSscheduler::parallel_solels(Blackboard& bb, const int num_threads)
+{
+	if (_prefetcher) {
+		delete _prefetcher;
+		_prefetcher = 0;
+	}
+	if (num_threads>0) {
+		_prefetcher = new SolelPrefetcher(_ks, bb, num_threads);
+		_prefetcher->profile(_profiler);
+		_prefetcher->memo(_memo);
+	}
+}
+
+void KSscheduler::memo(SolelMemo* m)
+{
+	_memo = m;
+	if (_memo)
+		_memo->new_blackboard();
+	if (_prefetcher)
+		_prefetcher->memo(m);
+}
+
+void KSscheduler::profile(KSprofiler* p)
+{
+	_profiler = p;
+	if (_prefetcher)
+		_prefetcher->profile(p);
+}
+
+void KSscheduler::rescore(const int i, Blackboard& bb)
+{
+	KSclock::time_point t = KSclock::now();
+	QueueEntry e;
+	e.score = _ks[i].activation_score(bb);
+	_score_time[i] += seconds_since(t);
+	_num_scores[i]++;
+
+	e.ks_index = i;
+	e.version = ++_version[i];
+	if (e.score>0.0)
+		_queue.push(e);
+	_stale[i] = false;
+}
+
+const int KSscheduler::next(Blackboard& bb)
+{
+	_num_steps++;
+	int i;
+	for(i=0; i<_ks.N(); i++)
+		if (_stale[i])
+			rescore(i, bb);
+
+	while (!_queue.empty() && (_queue.top().version!=_version[_queue.top().ks_index]))
+		_queue.pop();
+	int best_ind = _queue.empty() ? -1 : _queue.top().ks_index;
+
+	if (_verify) {
+		int poll_ind = -1;
+		float act_score, best_score = 0.0;
+		for(i=0; i<_ks.N(); i++) {
+			act_score = _ks[i].activation_score(bb);
+			if (act_score>best_score) {
+				best_score = act_score;
+				poll_ind = i;
+			}
+		}
+		if (poll_ind!=best_ind) {
+			cerr << "WARNING: KSscheduler: selected " << ((best_ind>-1) ? _ks[best_ind].name() : "none") << " but polling selects " << ((poll_ind>-1) ? _ks[poll_ind].name() : "none") << endl;
+			for(i=0; i<_ks.N(); i++)
+				_stale[i] = true;
+			best_ind = poll_ind;
+		}
+	}
+
+	if ((best_ind<0) && _prefetcher)
+		_prefetcher->stop();
+
+	return best_ind;
+}
+
+void KSscheduler::activate(const int i, Blackboard& bb)
+{
+	int next_solel = bb.next_solel();
+	int next_group = bb.next_group();
+	int num_solels = bb.num_sol_elements();
+	int num_groups = bb.num_groups();
+	int num_act_recs = bb.num_act_recs();
+	long num_cands = num_candidates(bb);
+
+	const bool memo_store = _memo && (next_solel>=0) && (bb.sol_element(next_solel).num_candidates()==0);
+	const int num_messages = bb.last_act_rec() ? bb.last_act_rec()->num_messages() : 0;
+	if (memo_store)
+		_memo->begin(bb);
+
+	KSclock::time_point t = KSclock::now();
+	{
+		KSprofiler::Scope scope(_profiler, _ks[i], bb, false);
+		if ((_prefetcher && _prefetcher->replay(i)) || (_memo && _memo->replay(_ks[i], bb)))
+			scope.replayed();
+		else
+			_ks[i].activate(bb);
+	}
+	if (memo_store)
+		_memo->store(_ks[i], bb, num_act_recs, num_messages);
+	_ks[i].add_activation_rec(bb);
+	_activation_time[i] += seconds_since(t);
+	_num_activations[i]++;
+
+	int events = 0;
+	if (bb.next_solel()!=next_solel)
+		events |= KS_NEXT_SOLEL_CHANGED;
+	if (bb.next_group()!=next_group)
+		events |= KS_NEXT_GROUP_CHANGED;
+	if ((bb.num_sol_elements()!=num_solels) || (bb.num_groups()!=num_groups))
+		events |= KS_STRUCTURE_CHANGED;
+	if (num_candidates(bb)!=num_cands)
+		events |= KS_CANDIDATES_CHANGED;
+	if (bb.num_act_recs()!=num_act_recs)
+		events |= KS_ACT_REC_ADDED;
+
+	if (_prefetcher && (events & KS_NEXT_GROUP_CHANGED))
+		_prefetcher->prefetch();
+
+	_stale[i] = true;
+	int j, k;
+	for(j=0; j<_ks.N(); j++)
+		if (!_stale[j]) {
+			_stale[j] = _ks[j].needs_rescore(events);
+			for(k=num_act_recs; (k<bb.num_act_recs()) && !_stale[j]; k++)
+				_stale[j] = _ks[j].needs_rescore(bb.act_rec(k));
+		}
+}
+
+const long KSscheduler::num_candidates(Blackboard& bb) const
+{
+	long n = 0;
+	for(int i=0; i<bb.num_sol_elements(); i++)
+		n += bb.sol_element(i).num_candidates();
+	return n;
+}
+
+void KSscheduler::print_timing(ostream& out) const
+{
+	// Formatted separately so that the format flags of a stream shared by concurrent cases (batch mode) are not changed
+	std::ostringstream s;
+	long total_scores = 0;
+	double total_score_time = 0, total_activation_time = 0;
+	s << "Knowledge source timing (seconds):" << endl;
+	s << std::left << std::setw(30) << "Name" << std::right << std::setw(10) << "Scores" << std::setw(14) << "Score time" << std::setw(13) << "Activations" << std::setw(17) << "Activation time" << endl;
+	for(int i=0; i<_ks.N(); i++) {
+		s << std::left << std::setw(30) << _ks[i].name() << std::right << std::setw(10) << _num_scores[i] << std::setw(14) << std::fixed << std::setprecision(4) << _score_time[i]
+			<< std::setw(13) << _num_activations[i] << std::setw(17) << _activation_time[i] << endl;
+		total_scores += _num_scores[i];
+		total_score_time += _score_time[i];
+		total_activation_time += _activation_time[i];
+	}
+	if (_memo)
+		s << "Segmentations reused from other chromosomes (all chromosomes so far): " << _memo->num_replayed() << " reused, " << _memo->num_stored() << " stored" << endl;
+	if (_prefetcher)
+		s << "Solution elements segmented in parallel: " << _prefetcher->num_replayed() << " used, " << _prefetcher->num_discarded() << " discarded" << endl;
+	s << "Total: " << total_scores << " score computations (" << _num_steps*_ks.N() << " when polling), score time " << total_score_time << ", activation time " << total_activation_time << endl;
+	out << s.str();
+}
@@ -0,0 +1,119 @@
+#ifndef __KSscheduler_h_
+#define __KSscheduler_h_
+
+#include "KnowledgeSource.h"
+#include "SolelPrefetcher.h"
+#include "KSprofiler.h"
+#include "SolelMemo.h"
+#include <queue>
+#include <vector>
+
+/**
+Event-driven scheduler for knowledge sources.
+Activation scores are kept in a priority queue. After each activation only the scores of knowledge sources whose
+rescore events occurred (see KnowledgeSource::rescore_on and KnowledgeSource::rescore_after) are recomputed.
+The knowledge source selected is the same as when polling all activation scores: the highest score, with ties going to the knowledge source added first.
+Scoring and activation times are accumulated for each knowledge source.
+Optionally independent solution elements are segmented in parallel (see parallel_solels) and activations are profiled (see profile).
+Candidates formed in an earlier segmentation of the same image with another chromosome can be reused (see memo).
+*/
+class KSscheduler {
+public:
+	/// Constructor (the knowledge sources must not be modified while the scheduler is used)
+	KSscheduler(const Darray<KnowledgeSource>& ks);
+
+	/// Destructor
+	~KSscheduler();
+
+	/**
+	Returns the index of the knowledge source with the highest activation score.
+	Returns -1 if no activation score is above zero.
+	*/
+	const int next(Blackboard& bb);
+
+	/**
+	Activates the i'th knowledge source and adds its activation record.
+	The blackboard changes are used to determine which activation scores must be recomputed.
+	*/
+	void activate(const int i, Blackboard& bb);
+
+	/**
+	If set, next() also polls all knowledge sources and reports (on cerr) when the selection differs, in which case the polled selection is used.
+	For checking the rescore events of knowledge sources.
+	*/
+	void verify(const bool v);
+
+	/**
+	Segments independent solution elements on num_threads worker threads, using the knowledge sources marked parallel (see SolelPrefetcher).
+	The activations and the resulting blackboard are the same as with serial processing.
+	*/
+	void parallel_solels(Blackboard& bb, const int num_threads);
+
+	/// Records each activation with the profiler, also those of the worker threads of parallel_solels (0 to stop profiling, the profiler must outlive the scheduler or be removed)
+	void profile(KSprofiler* p);
+
+	/**
+	Reuses the candidates stored in the memo for segmentation knowledge sources and stores the candidates of the other segmentation activations (0 to stop using it).
+	To be set before the first call to next(), the memo must outlive the scheduler or be removed.
+	*/
+	void memo(SolelMemo* m);
+
+	/// Writes the number of score computations and activations, and their times, for each knowledge source
+	void print_timing(ostream& s) const;
+
+private:
+	/// Priority queue entry: ordered by score, then by knowledge source index (lower first)
+	struct QueueEntry {
+		float score;
+		int ks_index;
+		int version;
+		bool operator<(const QueueEntry& e) const { return (score<e.score) || ((score==e.score) && (ks_index>e.ks_index)); };
+	};
+
+	/// Recomputes the activation score of the i'th knowledge source and queues it
+	void rescore(const int i, Blackboard& bb);
+
+	/// Returns the total number of candidates on the blackboard
+	const long num_candidates(Blackboard& bb) const;
+
+	/// Knowledge sources
+	const Darray<KnowledgeSource>& _ks;
+
+	/// Queue of scores above zero (entries with an outdated version are skipped)
+	std::priority_queue<QueueEntry> _queue;
+
+	/// Version of the current score of each knowledge source
+	std::vector<int> _version;
+
+	/// Knowledge sources whose scores must be recomputed
+	std::vector<bool> _stale;
+
+	/// Verify selections by polling all knowledge sources
+	bool _verify;
+
+	/// Parallel segmentation of solution elements (0 if not used)
+	SolelPrefetcher* _prefetcher;
+
+	/// Profiler of the activations (0 if not used)
+	KSprofiler* _profiler;
+
+	/// Candidates reused across chromosomes (0 if not used)
+	SolelMemo* _memo;
+
+	/// Number of calls to next()
+	long _num_steps;
+
+	/// Number of score computations for each knowledge source
+	std::vector<long> _num_scores;
+
+	/// Time (seconds) spent computing scores for each knowledge source
+	std::vector<double> _score_time;
+
+	/// Number of activations for each knowledge source
+	std::vector<long> _num_activations;
+
+	/// Time (seconds) spent in activations for each knowledge source
+	std::vector<double> _activation_time;
+};
+
+#endif // !__KSscheduler_h_
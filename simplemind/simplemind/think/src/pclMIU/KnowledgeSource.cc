@@ -10,7 +10,9 @@ KnowledgeSource::KnowledgeSource(
 	_type(type),
 	_activation_score(activation_score),
 	_activate(activate),
-	_activation_record(activation_record)
+	_activation_record(activation_record),
+	_rescore_events(KS_ALL_EVENTS),
+	_parallel(false)
 {
 }
 
@@ -19,7 +21,10 @@ KnowledgeSource::KnowledgeSource(const KnowledgeSource& ks)
 	_type(ks._type),
 	_activation_score(ks._activation_score),
 	_activate(ks._activate),
-	_activation_record(ks._activation_record)
+	_activation_record(ks._activation_record),
+	_rescore_events(ks._rescore_events),
+	_rescore_act_recs(ks._rescore_act_recs),
+	_parallel(ks._parallel)
 {
 }
 
@@ -53,3 +58,33 @@ void KnowledgeSource::activate(Blackboard& bb) const
 {
 	(*_activate)(bb);
 }
+
+void KnowledgeSource::rescore_on(const int events)
+{
+	_rescore_events = events;
+}
+
+void KnowledgeSource::rescore_after(const std::string& ks_name_or_type)
+{
+	_rescore_act_recs.push_back(ks_name_or_type);
+}
+
+void KnowledgeSource::parallel(const bool p)
+{
+	_parallel = p;
+}
+
+const bool KnowledgeSource::needs_rescore(const int events) const
+{
+	return (_rescore_events & events)!=0;
+}
+
+const bool KnowledgeSource::needs_rescore(const ActivationRecord& a) const
+{
+	if (_rescore_events & KS_ACT_REC_ADDED)
+		return true;
+	for(unsigned int i=0; i<_rescore_act_recs.size(); i++)
+		if ((a.ks_name().compare(_rescore_act_recs[i])==0) || (a.ks_type().compare(_rescore_act_recs[i])==0))
+			return true;
+	return false;
+}
@@ -50,6 +50,25 @@
 
 #include "Blackboard.h"
 
+/**
+Blackboard changes after which activation scores may have to be recomputed (bit flags).
+Used by the KSscheduler to recompute only the activation scores affected by the last activation.
+*/
+enum KSevent {
+	/// The next solution element was set to a different index
+	KS_NEXT_SOLEL_CHANGED = 1,
+	/// The next group was set to a different index
+	KS_NEXT_GROUP_CHANGED = 2,
+	/// Solution elements or groups were added or removed
+	KS_STRUCTURE_CHANGED = 4,
+	/// The number of candidates on the blackboard changed
+	KS_CANDIDATES_CHANGED = 8,
+	/// Any activation record was added
+	KS_ACT_REC_ADDED = 16,
+	/// All of the above
+	KS_ALL_EVENTS = 31
+};
+
 /// A class for knowledge sources that can operate on the blackboard
 class KnowledgeSource {
 public:
@@ -81,6 +100,34 @@ public:
 	/// Operate on the blackboard, i.e. contribute to the solution
 	void activate(Blackboard&) const;
 
+	/**
+	Sets the blackboard events (combination of KSevent flags) after which the activation score must be recomputed.
+	By default the score is recomputed after every activation (KS_ALL_EVENTS).
+	*/
+	void rescore_on(const int events);
+
+	/**
+	Adds a knowledge source name or type whose activation records require the activation score to be recomputed.
+	The score of a knowledge source is always recomputed after its own activation (see KSscheduler), so it need not name itself.
+	*/
+	void rescore_after(const std::string& ks_name_or_type);
+
+	/// Returns true if the activation score may have changed given the blackboard events that occurred (combination of KSevent flags)
+	const bool needs_rescore(const int events) const;
+
+	/// Returns true if the activation score may have changed after adding the activation record
+	const bool needs_rescore(const ActivationRecord&) const;
+
+	/**
+	Sets whether the knowledge source may be activated for a solution element from a worker thread (see SolelPrefetcher).
+	Only set this if the activation function writes nothing to the blackboard other than the candidates of the next solution element, does not add activation records, and only reads solution elements that have been matched.
+	Default is false.
+	*/
+	void parallel(const bool p);
+
+	/// Returns true if the knowledge source may be activated from a worker thread
+	inline const bool parallel() const { return _parallel; };
+
 private:
 	/// Name of the knowledge source
 	std::string _name;
@@ -100,6 +147,15 @@ private:
 	It is zero by default in which case nothing is called.
 	*/
 	void (*_activation_record) (Blackboard&);
+
+	/// Blackboard events (KSevent flags) after which the activation score is recomputed
+	int _rescore_events;
+
+	/// Knowledge source names or types whose activation records cause the activation score to be recomputed
+	std::vector<std::string> _rescore_act_recs;
+
+	/// Activation from a worker thread is allowed
+	bool _parallel;
 };
 
 #endif // !__KnowledgeSource_h_
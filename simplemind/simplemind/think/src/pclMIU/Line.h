@@ -50,6 +50,7 @@
 -*/
 
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include "Darray.h"
@@ -80,6 +81,15 @@ struct Line {
 	/// Copy constructor.
 	Line(const Line &l) : y(l.y), ivl(l.ivl) {};
 
+	/// Move constructor (the Intervals are not copied).
+	Line(Line &&l) noexcept : y(l.y), ivl(std::move(l.ivl)) {};
+
+	/// Assignment operator.
+	Line& operator=(const Line &l) { y=l.y; ivl=l.ivl; return *this; };
+
+	/// Move assignment operator (the Intervals are not copied).
+	Line& operator=(Line &&l) noexcept { y=l.y; ivl=std::move(l.ivl); return *this; };
+
 	/// Destructor.
 	~Line() {};
 
@@ -1,4 +1,6 @@
 #include "MedicalImageSequence.h"
+#include "IntensityVolume.h"
+#include "HessianMap.h"
 #include "Exception.h"
 #include <string>
 
@@ -26,7 +28,7 @@ MedicalImageSequence::MedicalImageSequence()
     _series_description(NULL), _operators_name(NULL), 
     _patient_position(NULL), _manufacturer(NULL), _institution_name(NULL), 
     _manufacturers_model_name(NULL), _image_plane(NULL),
-    _short_desc(0), _long_desc(0), _hu_values_column_major(0)
+    _short_desc(0), _long_desc(0), _hu_volume(0)
 {
 
   _short_desc = new char[1];
@@ -63,7 +65,7 @@ MedicalImageSequence::MedicalImageSequence(const int num_images,
     _protocol_name(NULL), _series_description(NULL), _operators_name(NULL), 
     _patient_position(NULL), _manufacturer(NULL), _institution_name(NULL), 
     _manufacturers_model_name(NULL), _image_plane(NULL),
-    _short_desc(0), _long_desc(0), _hu_values_column_major(0)
+    _short_desc(0), _long_desc(0), _hu_volume(0)
 {
   //cout << "MedicalImageSequence -> Not a default CONSTRUCTOR CALLED!" << endl;
   
@@ -192,7 +194,7 @@ MedicalImageSequence::MedicalImageSequence(const int num_images,
     _protocol_name(NULL), _series_description(NULL), _operators_name(NULL), 
     _patient_position(NULL), _manufacturer(NULL), _institution_name(NULL), 
     _manufacturers_model_name(NULL), _image_plane(NULL),
-    _short_desc(0), _long_desc(0), _hu_values_column_major(0)
+    _short_desc(0), _long_desc(0), _hu_volume(0)
 {
 _patient_name = new char[1];
 _patient_name[0] = 0;
@@ -291,6 +293,16 @@ _long_desc = new char[1];
 
 _create_descriptions();
 
+// As the other constructors, so that the destructor does not free uninitialized pointers
+_init_PACS_SUBHEADER_MAMO();
+_rov = new char[1];
+_rov[0] = '\0';
+_angle_tilted = new char[1];
+_angle_tilted[0] = '\0';
+_inteliWin = 0.0;
+_inteliLevel = 0.0;
+_access_count = 0;
+
 };
 
 
@@ -308,7 +320,7 @@ MedicalImageSequence::MedicalImageSequence(const MedicalImageSequence& mis)
     _series_description(NULL), _operators_name(NULL), 
     _patient_position(NULL), _manufacturer(NULL), _institution_name(NULL), 
     _manufacturers_model_name(NULL), _image_plane(NULL),
-    _short_desc(0), _long_desc(0), _hu_values_column_major(0) 
+    _short_desc(0), _long_desc(0), _hu_volume(0) 
 {
   //Initialize ImageSequence variables for a consistent state when using =
   _num_images = 0;
@@ -384,13 +396,21 @@ MedicalImageSequence::~MedicalImageSequence()
   delete [] _short_desc;
   delete [] _long_desc;
   
-  if (_hu_values_column_major) delete [] _hu_values_column_major;
+  delete _hu_volume;
+  for(std::map<float, float*>::iterator it=_plane_plateness.begin(); it!=_plane_plateness.end(); it++)
+    delete [] it->second;
 };
 
 const MedicalImageSequence& MedicalImageSequence::
 operator=(const MedicalImageSequence & Rhs)
 {
   if(&Rhs != this) {
+    delete _hu_volume;
+    _hu_volume = 0;
+    for(std::map<float, float*>::iterator it=_plane_plateness.begin(); it!=_plane_plateness.end(); it++)
+      delete [] it->second;
+    _plane_plateness.clear();
+
     //Init image planes if image_plane is NULL, otherwise nothing will happen
     _init_image_planes();
     
@@ -1154,21 +1174,31 @@ const int MedicalImageSequence::zdim() const
 
 
 const short* const MedicalImageSequence::hu_values_column_major() {
-	if (!_hu_values_column_major) {
-		register int xdim = this->xdim();
-		register int ydim = this->ydim();
-		register int zdim = this->zdim();
-		_hu_values_column_major = new short [xdim*ydim*zdim];
-		for (int z = 0; z < zdim; z++) {
-			const Image& im = image_const(z);
-			register int rs = im.rescale_slope();
-			register int ri = im.rescale_intercept();
-			for (int y = 0; y < ydim; y++)
-				for (int x = 0; x < xdim; x++)
-					_hu_values_column_major[y + x * ydim + z * ydim * xdim] = (short) (fast_pix_val(x, y, z) * rs + ri);
-		}
+	return hu_volume().hu_column_major();
+}
+
+
+const ShortVolumeView MedicalImageSequence::hu_values() {
+	return hu_volume().hu_view();
+}
+
+
+IntensityVolume& MedicalImageSequence::hu_volume() {
+	std::lock_guard<std::mutex> lock(_hu_volume_mutex);
+	if (!_hu_volume)
+		_hu_volume = new IntensityVolume(*this);
+	return *_hu_volume;
+}
+
+
+const float* const MedicalImageSequence::plane_plateness(const float sigma, const int num_threads) {
+	std::lock_guard<std::mutex> lock(_plane_plateness_mutex);
+	float*& pltns = _plane_plateness[sigma];
+	if (!pltns) {
+		pltns = new float [xdim()*ydim()*zdim()];
+		hessian_shape_maps(*this, sigma, num_threads, pltns);
 	}
-	return _hu_values_column_major;
+	return pltns;
 }
 
 
@@ -61,9 +61,29 @@
 #include <string.h>
 //}
 #include <iostream>
+#include <map>
+#include <mutex>
 using std::ifstream;
 using std::ofstream;
 
+class IntensityVolume;
+
+/**
+ *  Read-only strided access to a volume of short values:
+ *  the value at (x, y, z) is data[x*x_stride + y*y_stride + z*z_stride].
+ */
+struct ShortVolumeView {
+  /// Value at (x, y, z).
+  inline const short operator()(const int x, const int y, const int z) const
+  { return data[x*x_stride + y*y_stride + z*z_stride]; };
+
+  /// Pointer to the value at (0, 0, 0).
+  const short* data;
+
+  /// Distances between consecutive values in x, y and z.
+  long x_stride, y_stride, z_stride;
+};
+
 /// Image sequence corresponding to a medical series.
 class MedicalImageSequence : public ImageSequence
 {
@@ -391,6 +411,26 @@ public:
 	*/
 	const short* const hu_values_column_major();
 
+	/**
+	Returns strided access to the HU values (row major, see IntensityVolume).
+	If the images are views into a contiguous volume buffer (see volume_data)
+	and their rescale slope is 1 and intercept 0, the view refers to that buffer and no copy is made.
+	*/
+	const ShortVolumeView hu_values();
+
+	/**
+	Returns the gray level and HU values of the sequence as plain arrays.
+	Built the first time it is called and shared by all callers (thread safe).
+	*/
+	IntensityVolume& hu_volume();
+
+	/**
+	Returns the sum of the 2D plateness of the axial, coronal and sagittal planes at scale sigma (mm), see hessian_shape_maps.
+	1D array with size xdim*ydim*zdim (raster order).
+	Computed with num_threads threads the first time it is called for sigma and kept with the sequence, shared by all callers (thread safe, callers wait while it is computed).
+	*/
+	const float* const plane_plateness(const float sigma, const int num_threads);
+
   /// Returns x-dimension (number of pixels in x-direction).
   const int xdim() const;
 
@@ -865,10 +905,19 @@ protected:
   /* Ended by Kelvin */
 
 	/**
-	HU values derived from _mis.
+	Gray level and HU values, see hu_volume.
 	Initialized to zero.
 	*/
-	short* _hu_values_column_major;
+	IntensityVolume* _hu_volume;
+
+	/// Guards the construction of _hu_volume
+	std::mutex _hu_volume_mutex;
+
+	/// Plane plateness of each scale, see plane_plateness
+	std::map<float, float*> _plane_plateness;
+
+	/// Guards the construction of _plane_plateness
+	std::mutex _plane_plateness_mutex;
 };
 
 ///
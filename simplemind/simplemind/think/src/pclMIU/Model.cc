@@ -28,6 +28,11 @@ Model::Model(const Model& m)
 		//for (int i=0; i<_bit_used.size(); i++) _bit_used.push_back(m._bit_used[i]);
 }
 
+Model::Model(const Model& m, const char* const chromosome)
+	: _file(m._file), _entity(m._entity)
+{
+	if (chromosome != 0) _chromosome.append(chromosome);
+}
 
 Model::~Model()
 {
@@ -67,6 +67,9 @@ public:
 	/// Copy constructor
 	Model(const Model&);
 
+	/// Copy of a model with another chromosome (0 for none); the entities are not read again
+	Model(const Model&, const char* const chromosome);
+
 	/// Destructor
 	virtual ~Model();
 
@@ -265,7 +265,11 @@ NeuralNet_Parameter test_info augment boolean false;
 */
 /**
 @name PlatenessRegionGrowing
-@memo PlatenessRegionGrowing low high. When performing region growing, voxels will be included if the plateness values are >= low and <= high (which are floats). The range of the plateness values are [0.0, 3.0] obtained by summing the 2D plateness values from three orthogonal planes. The function reads a raw plateness file from the ROI directory.
+@memo PlatenessRegionGrowing low high. When performing region growing, voxels will be included if the plateness values are >= low and <= high (which are floats). The range of the plateness values are [0.0, 3.0] obtained by summing the 2D plateness values from three orthogonal planes. The function reads the raw plateness files (plateness_axial.raw, plateness_coronal.raw and plateness_sagittal.raw) from the ROI directory.
+*/
+/**
+@name PlatenessRegionGrowing_InProcess
+@memo PlatenessRegionGrowing_InProcess low high. As PlatenessRegionGrowing, but if the raw plateness files are not in the ROI directory the plateness is computed in-process (see HessianMap.h): the 2D plateness of the axial, coronal and sagittal planes from the Hessian of the HU values at a scale of 1 mm, with the structureness (c) of each plane orientation set to half its largest Hessian norm in the image. The range is also [0.0, 3.0], but the values are not those of the program that writes the raw files, so low and high may need to be tuned again.
 */
 /**
 @name SameCandidatesAs
@@ -466,6 +470,14 @@ NeuralNet_Parameter test_info augment boolean false;
 @memo Circle radius. The radius is a floating point number with units of mm. To convert this to a radius in pixels, the row pixel spacing of the first image in the sequence is used, i.e. the row and column spacings are assumed equal and the spacings on all image slices are assumed equal.
 */
 /**
+@name Sphere
+@memo Sphere radius. Represents a sphere centered at the origin. The radius is a floating point number with units of mm. It is converted to pixels separately along each axis, using the column and row pixel spacings of the first image in the sequence and the spacing between the first and second images, so the sphere is an ellipsoid in pixels for anisotropic voxels. If there is only 1 slice in the sequence it is a circle.
+*/
+/**
+@name Cylinder
+@memo Cylinder radius height. Represents a cylinder along the z-direction centered at the origin. The radius and height are floating point numbers with units of mm. The radius is converted to pixels as for Sphere, the height as for Line_Z.
+*/
+/**
 @name Line_X
 @memo Line_X length. Represents a line in the x-direction, with a given length, centered at the origin. The length is a floating point number with units of mm. To convert this to a length in pixels, the column pixel spacing of the first image in the sequence is used, i.e. the spacings on all image slices are assumed equal.
 */
@@ -2839,7 +2851,7 @@ void ModelMapperA(Blackboard& bb)
 				}
 			}
 
-			else if (!att_name.compare("PlatenessRegionGrowing")) {
+			else if (!att_name.compare("PlatenessRegionGrowing") || !att_name.compare("PlatenessRegionGrowing_InProcess")) {
 				float low, high;
 				//std::string to_str;
 				std::vector<bool> chromosome_bit_used;
@@ -2856,7 +2868,7 @@ void ModelMapperA(Blackboard& bb)
 				}
 
 				if (ok) {
-					PlatenessThreshRegGrow* pl = new PlatenessThreshRegGrow(low, high);
+					PlatenessThreshRegGrow* pl = new PlatenessThreshRegGrow(low, high, !att_name.compare("PlatenessRegionGrowing_InProcess"));
 					pl->set_chromosome_bits_used(chromosome_bit_used);
 					se.add_attribute(pl);
 				}
@@ -7,7 +7,12 @@
 class PCLsequence : public MedicalImageSequence {
 public:
 	typedef pcl::Image<short> ImageType;
-	///Constructor.
+	/**
+	Constructor.
+	If the image buffer holds exactly the image region (as for images read from file),
+	the slices are views into that buffer, which is taken over as the volume buffer (see volume_data), so no pixel is copied.
+	Otherwise each slice is cropped into its own buffer.
+	*/
 	PCLsequence(const std::string& file) : MedicalImageSequence()
 	{
 		auto image = pcl::ImageIoHelper::Read<ImageType>(file);
@@ -18,15 +23,27 @@ public:
 
 		auto minp = image->getMinPoint(),
 			maxp = image->getMaxPoint();
+		const bool contiguous = (image->getBufferSize()==image->getSize());
 		int i=0;
 		for (int z=minp.z(); z<=maxp.z(); ++z) {
-			auto region = image->getRegion();
-			region.getMinPoint()[2] = z;
-			region.getMaxPoint()[2] = z;
-			auto slice = pcl::ImageHelper::GetCroppedAuto(image, region);
-			_collect_dicom_image_data(slice, i, z);
+			_collect_dicom_image_data(image, i, z);
+			if (contiguous) {
+				_images[i]->set_pixel_view(image->getBuffer()->getPointer() + image->toIndex(minp.x(), minp.y(), z));
+			}
+			else {
+				auto region = image->getRegion();
+				region.getMinPoint()[2] = z;
+				region.getMaxPoint()[2] = z;
+				auto slice = pcl::ImageHelper::GetCroppedAuto(image, region);
+				_images[i]->unsafe_pixel_data() = slice->getBuffer()->getPointer();
+				slice->getBuffer()->dropOwnership();
+			}
 			++i;
 		}
+		if (contiguous) {
+			_volume = image->getBuffer()->getPointer();
+			image->getBuffer()->dropOwnership();
+		}
 	}
 
 	///Destructor.
@@ -71,7 +88,7 @@ private:
 		manufacturers_model_name("dummy");
 	}
 
-	///Collects specific image data for DICOM image
+	///Collects specific image data for plane z of a DICOM image (the caller sets the pixel data)
 	void _collect_dicom_image_data(ImageType::Pointer& image, int index, int z)
 	{
 		int bits_per_pixel = sizeof(short)*8;
@@ -81,14 +98,14 @@ private:
 		int height = image->getSize()[1];
 
 		float aslice_thickness = image->getSpacing()[2];
-		float aslice_location = image->toPhysicalCoordinate(image->getMinPoint()).z();
+		auto p = image->getMinPoint();
+		p[2] = z;
+		float aslice_location = image->toPhysicalCoordinate(p).z();
 
 		int instance_number = z;
 
 		//Creating the image
 		_images[index] = new Image(instance_number, width, height, bits_per_pixel);
-		_images[index]->unsafe_pixel_data() = image->getBuffer()->getPointer();
-		image->getBuffer()->dropOwnership();
 
 		/*
 		std::cout << arow_pixel_spacing 
@@ -50,6 +50,7 @@
 -*/
 
 #include <ostream>
+#include <utility>
 
 using std::ostream;
 
@@ -81,6 +82,15 @@ struct Plane {
 	/// Copy constructor.
 	Plane(const Plane &p) : z(p.z), ivl_mod(p.ivl_mod), ln(p.ln) {};
 
+	/// Move constructor (the Lines are not copied).
+	Plane(Plane &&p) noexcept : z(p.z), ivl_mod(p.ivl_mod), ln(std::move(p.ln)) {};
+
+	/// Assignment operator.
+	Plane& operator=(const Plane &p) { z=p.z; ivl_mod=p.ivl_mod; ln=p.ln; return *this; };
+
+	/// Move assignment operator (the Lines are not copied).
+	Plane& operator=(Plane &&p) noexcept { z=p.z; ivl_mod=p.ivl_mod; ln=std::move(p.ln); return *this; };
+
 	/// Destructor.
 	~Plane() {};
 
@@ -0,0 +1,611 @@
+#include "RLEroi.h"
+#include "ROI.h"
+#include <algorithm>
+#include <stdlib.h>
+
+using std::cerr;
+
+
+RLEroi::RLEroi()
+	: _line_ivl(1, 0), _plane_line(1, 0)
+{
+}
+
+
+RLEroi::RLEroi(const ROI& r)
+	: _line_ivl(1, 0), _plane_line(1, 0)
+{
+	copy(r);
+}
+
+
+void RLEroi::copy(const ROI& r)
+{
+	clear();
+
+	int i, j, num_ln=0, num_ivl=0;
+	for(i=0; i<r._pl.N(); i++) {
+		num_ln += r._pl[i].ln.N();
+		for(j=0; j<r._pl[i].ln.N(); j++)
+			num_ivl += r._pl[i].ln[j].ivl.size();
+	}
+	_plane_z.reserve(r._pl.N());
+	_plane_line.reserve(r._pl.N()+1);
+	_line_y.reserve(num_ln);
+	_line_ivl.reserve(num_ln+1);
+	_ivl.reserve(num_ivl);
+
+	for(i=0; i<r._pl.N(); i++) {
+		const Plane& pl = r._pl[i];
+		_plane_z.push_back(pl.z);
+		for(j=0; j<pl.ln.N(); j++) {
+			_line_y.push_back(pl.ln[j].y);
+			_ivl.insert(_ivl.end(), pl.ln[j].ivl.begin(), pl.ln[j].ivl.end());
+			_line_ivl.push_back(_ivl.size());
+		}
+		_plane_line.push_back(_line_y.size());
+	}
+}
+
+
+void RLEroi::to_roi(ROI& r) const
+{
+	r.clear();
+	r._pl.reserve(num_planes());
+
+	int p, l;
+	for(p=0; p<num_planes(); p++) {
+		Plane pl(_plane_z[p], r._ln_mod, r._ivl_mod);
+		pl.ln.reserve(_plane_line[p+1]-_plane_line[p]);
+		for(l=_plane_line[p]; l<_plane_line[p+1]; l++) {
+			Line ln(_line_y[l]);
+			ln.ivl.assign(_ivl.begin()+_line_ivl[l], _ivl.begin()+_line_ivl[l+1]);
+			pl.ln.push_last(std::move(ln));
+		}
+		r._pl.push_last(std::move(pl));
+	}
+}
+
+
+void RLEroi::clear()
+{
+	_ivl.clear();
+	_line_y.clear();
+	_line_ivl.assign(1, 0);
+	_plane_z.clear();
+	_plane_line.assign(1, 0);
+}
+
+
+void RLEroi::swap(RLEroi& r)
+{
+	_ivl.swap(r._ivl);
+	_line_y.swap(r._line_y);
+	_line_ivl.swap(r._line_ivl);
+	_plane_z.swap(r._plane_z);
+	_plane_line.swap(r._plane_line);
+}
+
+
+void RLEroi::_append_plane(const int z)
+{
+	_plane_z.push_back(z);
+	_plane_line.push_back(_plane_line.back());
+}
+
+
+void RLEroi::_append_line(const int y)
+{
+	_line_y.push_back(y);
+	_line_ivl.push_back(_line_ivl.back());
+	_plane_line.back()++;
+}
+
+
+void RLEroi::_drop_empty_line()
+{
+	if (!_line_y.empty() && (_line_ivl[_line_y.size()-1]==_line_ivl.back())) {
+		_line_y.pop_back();
+		_line_ivl.pop_back();
+		_plane_line.back()--;
+	}
+}
+
+
+void RLEroi::_drop_empty_plane()
+{
+	if (!_plane_z.empty() && (_plane_line[_plane_z.size()-1]==_plane_line.back())) {
+		_plane_z.pop_back();
+		_plane_line.pop_back();
+	}
+}
+
+
+void RLEroi::append_interval(const int x1, const int x2, const int y, const int z)
+{
+	if (x1>x2)
+		return;
+
+	if (_plane_z.empty() || (z>_plane_z.back())) {
+		_append_plane(z);
+		_append_line(y);
+	}
+	else if ((z==_plane_z.back()) && (y>_line_y.back()))
+		_append_line(y);
+	else if ((z==_plane_z.back()) && (y==_line_y.back()) && (x1>=_ivl.back().x1)) {
+		Interval& last = _ivl.back();
+		if (x1<=(last.x2+1)) {
+			if (x2>last.x2)
+				last.x2 = x2;
+			return;
+		}
+	}
+	else {
+		cerr << "ERROR: RLEroi::append_interval: interval " << x1 << "-" << x2 << " (y=" << y << ", z=" << z << ") is not in raster order" << endl;
+		exit(1);
+	}
+
+	_ivl.push_back(Interval(x1, x2));
+	_line_ivl.back()++;
+}
+
+
+void RLEroi::merge_line(const Interval* a, const int na, const Interval* b, const int nb, const RLEop op, std::vector<Interval>& r)
+{
+	int i=0, j=0;
+
+	if (op==RLE_OR) {
+		const size_t first = r.size();
+		while((i<na) || (j<nb)) {
+			const Interval& iv = ((j==nb) || ((i<na) && (a[i].x1<=b[j].x1))) ? a[i++] : b[j++];
+			if ((r.size()>first) && (iv.x1<=(r.back().x2+1))) {
+				if (iv.x2>r.back().x2)
+					r.back().x2 = iv.x2;
+			}
+			else
+				r.push_back(iv);
+		}
+	}
+
+	else if (op==RLE_AND) {
+		while((i<na) && (j<nb)) {
+			const int x1 = std::max(a[i].x1, b[j].x1);
+			const int x2 = std::min(a[i].x2, b[j].x2);
+			if (x1<=x2)
+				r.push_back(Interval(x1, x2));
+			if (a[i].x2<b[j].x2)
+				i++;
+			else
+				j++;
+		}
+	}
+
+	else {
+		for(; i<na; i++) {
+			int x1 = a[i].x1;
+			// Intervals of b ending before the interval of a do not affect it or the ones after it
+			while((j<nb) && (b[j].x2<x1))
+				j++;
+			for(; (j<nb) && (b[j].x1<=a[i].x2); j++) {
+				if (b[j].x1>x1)
+					r.push_back(Interval(x1, b[j].x1-1));
+				x1 = b[j].x2+1;
+				// An interval of b extending beyond the interval of a may also cover the next one
+				if (b[j].x2>a[i].x2)
+					break;
+			}
+			if (x1<=a[i].x2)
+				r.push_back(Interval(x1, a[i].x2));
+		}
+	}
+}
+
+
+void RLEroi::merge(const RLEroi& a, const RLEroi& b, const RLEop op, RLEroi& r)
+{
+	assert((&r!=&a) && (&r!=&b));
+	r.clear();
+	if (op==RLE_OR) {
+		r._ivl.reserve(a._ivl.size()+b._ivl.size());
+		r._line_y.reserve(a._line_y.size()+b._line_y.size());
+	}
+	else {
+		r._ivl.reserve(a._ivl.size());
+		r._line_y.reserve(a._line_y.size());
+	}
+
+	const bool keep_a = (op!=RLE_AND);
+	const bool keep_b = (op==RLE_OR);
+	int pa=0, pb=0, la, lb, ea, eb;
+	while((pa<a.num_planes()) || (pb<b.num_planes())) {
+		const bool in_a = (pa<a.num_planes()) && ((pb==b.num_planes()) || (a._plane_z[pa]<=b._plane_z[pb]));
+		const bool in_b = (pb<b.num_planes()) && ((pa==a.num_planes()) || (b._plane_z[pb]<=a._plane_z[pa]));
+		if ((in_a && !in_b && !keep_a) || (in_b && !in_a && !keep_b)) {
+			if (in_a) pa++; else pb++;
+			continue;
+		}
+
+		r._append_plane(in_a ? a._plane_z[pa] : b._plane_z[pb]);
+		la = in_a ? a._plane_line[pa] : 0;
+		ea = in_a ? a._plane_line[pa+1] : 0;
+		lb = in_b ? b._plane_line[pb] : 0;
+		eb = in_b ? b._plane_line[pb+1] : 0;
+		while((la<ea) || (lb<eb)) {
+			const bool ln_a = (la<ea) && ((lb==eb) || (a._line_y[la]<=b._line_y[lb]));
+			const bool ln_b = (lb<eb) && ((la==ea) || (b._line_y[lb]<=a._line_y[la]));
+			if ((ln_a && !ln_b && !keep_a) || (ln_b && !ln_a && !keep_b)) {
+				if (ln_a) la++; else lb++;
+				continue;
+			}
+
+			r._append_line(ln_a ? a._line_y[la] : b._line_y[lb]);
+			const Interval* ia = ln_a ? &a._ivl[a._line_ivl[la]] : 0;
+			const int na = ln_a ? (a._line_ivl[la+1]-a._line_ivl[la]) : 0;
+			const Interval* ib = ln_b ? &b._ivl[b._line_ivl[lb]] : 0;
+			const int nb = ln_b ? (b._line_ivl[lb+1]-b._line_ivl[lb]) : 0;
+			merge_line(ia, na, ib, nb, op, r._ivl);
+			r._line_ivl.back() = r._ivl.size();
+			r._drop_empty_line();
+			if (ln_a) la++;
+			if (ln_b) lb++;
+		}
+		r._drop_empty_plane();
+		if (in_a) pa++;
+		if (in_b) pb++;
+	}
+}
+
+
+void RLEroi::OR(const RLEroi& b)
+{
+	RLEroi r;
+	merge(*this, b, RLE_OR, r);
+	swap(r);
+}
+
+
+void RLEroi::AND(const RLEroi& b)
+{
+	RLEroi r;
+	merge(*this, b, RLE_AND, r);
+	swap(r);
+}
+
+
+void RLEroi::subtract(const RLEroi& b)
+{
+	RLEroi r;
+	merge(*this, b, RLE_SUBTRACT, r);
+	swap(r);
+}
+
+
+void RLEroi::translate(const int x_shift, const int y_shift, const int z_shift)
+{
+	size_t i;
+	if (x_shift)
+		for(i=0; i<_ivl.size(); i++) {
+			_ivl[i].x1 += x_shift;
+			_ivl[i].x2 += x_shift;
+		}
+	if (y_shift)
+		for(i=0; i<_line_y.size(); i++)
+			_line_y[i] += y_shift;
+	if (z_shift)
+		for(i=0; i<_plane_z.size(); i++)
+			_plane_z[i] += z_shift;
+}
+
+
+void RLEroi::dilate(const RLEroi& se)
+{
+	_morph(se, 1);
+}
+
+
+void RLEroi::erode(const RLEroi& se)
+{
+	_morph(se, -1);
+}
+
+
+const int RLEroi::_find_plane(const int z) const
+{
+	std::vector<int>::const_iterator pz = std::lower_bound(_plane_z.begin(), _plane_z.end(), z);
+	if ((pz==_plane_z.end()) || (*pz!=z))
+		return -1;
+	return pz-_plane_z.begin();
+}
+
+
+const int RLEroi::_advance_line(const int p, const int y, int& l) const
+{
+	while((l<_plane_line[p+1]) && (_line_y[l]<y))
+		l++;
+	return ((l<_plane_line[p+1]) && (_line_y[l]==y)) ? l : -1;
+}
+
+
+void RLEroi::_morph(const RLEroi& se, const int sign)
+{
+	if (se.empty()) {
+		clear();
+		return;
+	}
+	if (empty())
+		return;
+
+	int p, l, i;
+
+	// Planes that are identical and contiguous in z are a plane and a z line
+	const int z0 = se._plane_z.front(), z1 = se._plane_z.back();
+	bool z_sep = (z1>z0) && ((z1-z0+1)==se.num_planes());
+	for(p=1; z_sep && (p<se.num_planes()); p++) {
+		z_sep = ((se._plane_line[p+1]-se._plane_line[p])==se._plane_line[1]);
+		for(l=0; z_sep && (l<se._plane_line[1]); l++) {
+			const int lp = se._plane_line[p]+l;
+			z_sep = (se._line_y[lp]==se._line_y[l]) && ((se._line_ivl[lp+1]-se._line_ivl[lp])==(se._line_ivl[l+1]-se._line_ivl[l]));
+			for(i=0; z_sep && (i<(se._line_ivl[l+1]-se._line_ivl[l])); i++)
+				z_sep = (se._ivl[se._line_ivl[lp]+i].x1==se._ivl[se._line_ivl[l]+i].x1) && (se._ivl[se._line_ivl[lp]+i].x2==se._ivl[se._line_ivl[l]+i].x2);
+		}
+	}
+
+	// Lines of a single plane that are identical and contiguous in y are a line and a y line
+	const int num_ln = se._plane_line[1];
+	const int y0 = se._line_y.front(), y1 = se._line_y[num_ln-1];
+	bool y_sep = (z_sep || (se.num_planes()==1)) && (y1>y0) && ((y1-y0+1)==num_ln);
+	const int num_ivl = se._line_ivl[1];
+	for(l=1; y_sep && (l<num_ln); l++) {
+		y_sep = ((se._line_ivl[l+1]-se._line_ivl[l])==num_ivl);
+		for(i=0; y_sep && (i<num_ivl); i++)
+			y_sep = (se._ivl[se._line_ivl[l]+i].x1==se._ivl[i].x1) && (se._ivl[se._line_ivl[l]+i].x2==se._ivl[i].x2);
+	}
+
+	// Remaining structuring element, applied row by row
+	RLEroi base;
+	const int np = z_sep ? 1 : se.num_planes();
+	for(p=0; p<np; p++)
+		for(l=se._plane_line[p]; l<(y_sep ? 1 : se._plane_line[p+1]); l++)
+			for(i=se._line_ivl[l]; i<se._line_ivl[l+1]; i++)
+				base.append_interval(se._ivl[i].x1, se._ivl[i].x2, y_sep ? 0 : se._line_y[l], z_sep ? 0 : se._plane_z[p]);
+
+	_morph_rows(base, sign);
+	if (y_sep)
+		_morph_line(y0, y1, 1, sign);
+	if (z_sep)
+		_morph_line(z0, z1, 2, sign);
+}
+
+
+void RLEroi::_morph_rows(const RLEroi& se, const int sign)
+{
+	RLEroi r;
+	std::vector<int> se_pl(se.num_planes()), se_ln(se.num_lines()), cand;
+	std::vector<Interval> buf, row, res, tmp;
+	int p, l, i, sp, sl, si, k;
+
+	if (sign>0) {
+		// Result planes and, within each, result lines are those under a structuring element row from a line of the RLEroi
+		std::vector<int> zs;
+		for(p=0; p<num_planes(); p++)
+			for(sp=0; sp<se.num_planes(); sp++)
+				zs.push_back(_plane_z[p]+se._plane_z[sp]);
+		std::sort(zs.begin(), zs.end());
+		zs.erase(std::unique(zs.begin(), zs.end()), zs.end());
+
+		for(k=0; k<(int)zs.size(); k++) {
+			cand.clear();
+			for(sp=0; sp<se.num_planes(); sp++) {
+				se_pl[sp] = _find_plane(zs[k]-se._plane_z[sp]);
+				if (se_pl[sp]>=0)
+					for(sl=se._plane_line[sp]; sl<se._plane_line[sp+1]; sl++)
+						for(l=_plane_line[se_pl[sp]]; l<_plane_line[se_pl[sp]+1]; l++)
+							cand.push_back(_line_y[l]+se._line_y[sl]);
+			}
+			std::sort(cand.begin(), cand.end());
+			cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+
+			// Lines under each structuring element row, advanced as the result line moves down
+			for(sp=0; sp<se.num_planes(); sp++)
+				for(sl=se._plane_line[sp]; sl<se._plane_line[sp+1]; sl++)
+					se_ln[sl] = (se_pl[sp]>=0) ? _plane_line[se_pl[sp]] : 0;
+
+			r._append_plane(zs[k]);
+			for(size_t c=0; c<cand.size(); c++) {
+				buf.clear();
+				for(sp=0; sp<se.num_planes(); sp++)
+					for(sl=se._plane_line[sp]; (se_pl[sp]>=0) && (sl<se._plane_line[sp+1]); sl++) {
+						l = _advance_line(se_pl[sp], cand[c]-se._line_y[sl], se_ln[sl]);
+						if (l>=0)
+							for(si=se._line_ivl[sl]; si<se._line_ivl[sl+1]; si++)
+								for(i=_line_ivl[l]; i<_line_ivl[l+1]; i++)
+									buf.push_back(Interval(_ivl[i].x1+se._ivl[si].x1, _ivl[i].x2+se._ivl[si].x2));
+					}
+				std::sort(buf.begin(), buf.end(), [](const Interval& a, const Interval& b) { return a.x1<b.x1; });
+
+				r._append_line(cand[c]);
+				merge_line(buf.data(), buf.size(), 0, 0, RLE_OR, r._ivl);
+				r._line_ivl.back() = r._ivl.size();
+			}
+		}
+	}
+
+	else {
+		// A result line needs a line of the RLEroi under every structuring element row, so the candidates are those under the first row
+		const int sz0 = se._plane_z[0], sy0 = se._line_y[0];
+		for(p=0; p<num_planes(); p++) {
+			const int z = _plane_z[p]-sz0;
+			bool ok = true;
+			for(sp=0; ok && (sp<se.num_planes()); sp++) {
+				se_pl[sp] = _find_plane(z+se._plane_z[sp]);
+				ok = (se_pl[sp]>=0);
+			}
+			if (!ok)
+				continue;
+
+			for(sp=0; sp<se.num_planes(); sp++)
+				for(sl=se._plane_line[sp]; sl<se._plane_line[sp+1]; sl++)
+					se_ln[sl] = _plane_line[se_pl[sp]];
+
+			r._append_plane(z);
+			for(l=_plane_line[p]; l<_plane_line[p+1]; l++) {
+				const int y = _line_y[l]-sy0;
+				bool first = true;
+				res.clear();
+				for(sp=0; ok && (sp<se.num_planes()); sp++)
+					for(sl=se._plane_line[sp]; ok && (sl<se._plane_line[sp+1]); sl++) {
+						const int li = _advance_line(se_pl[sp], y+se._line_y[sl], se_ln[sl]);
+						if (li<0) {
+							ok = false;
+							break;
+						}
+
+						// Touching intervals are joined so that the erosion of a line only depends on its points
+						row.clear();
+						for(i=_line_ivl[li]; i<_line_ivl[li+1]; i++)
+							if (!row.empty() && (_ivl[i].x1<=(row.back().x2+1)))
+								row.back().x2 = std::max(row.back().x2, _ivl[i].x2);
+							else
+								row.push_back(_ivl[i]);
+
+						for(si=se._line_ivl[sl]; ok && (si<se._line_ivl[sl+1]); si++) {
+							tmp.clear();
+							for(i=0; i<(int)row.size(); i++)
+								if ((row[i].x1-se._ivl[si].x1)<=(row[i].x2-se._ivl[si].x2))
+									tmp.push_back(Interval(row[i].x1-se._ivl[si].x1, row[i].x2-se._ivl[si].x2));
+							if (first) {
+								res.swap(tmp);
+								first = false;
+							}
+							else {
+								buf.clear();
+								merge_line(res.data(), res.size(), tmp.data(), tmp.size(), RLE_AND, buf);
+								res.swap(buf);
+							}
+							ok = !res.empty();
+						}
+					}
+
+				if (ok) {
+					r._append_line(y);
+					r._ivl.insert(r._ivl.end(), res.begin(), res.end());
+					r._line_ivl.back() = r._ivl.size();
+				}
+				ok = true;
+			}
+			r._drop_empty_plane();
+		}
+	}
+
+	swap(r);
+}
+
+
+void RLEroi::_morph_line(const int d1, const int d2, const int axis, const int sign)
+{
+	// Offsets 0 to covered are applied after each shift, doubling the length (the last shift completes it)
+	int covered=0, step;
+	while((covered<(d2-d1)) && !empty()) {
+		step = std::min(covered+1, (d2-d1)-covered);
+		_morph_shift(step, axis, sign);
+		covered += step;
+	}
+	if (axis==1)
+		translate(0, sign*d1, 0);
+	else
+		translate(0, 0, sign*d1);
+}
+
+
+void RLEroi::_morph_shift(const int d, const int axis, const int sign)
+{
+	RLEroi t(*this), r;
+	if (axis==1)
+		t.translate(0, sign*d, 0);
+	else
+		t.translate(0, 0, sign*d);
+	merge(*this, t, (sign>0) ? RLE_OR : RLE_AND, r);
+	swap(r);
+}
+
+
+const int RLEroi::num_pix() const
+{
+	int n=0;
+	for(size_t i=0; i<_ivl.size(); i++)
+		n += _ivl[i].num_pts();
+	return n;
+}
+
+
+const int RLEroi::in_roi(const Point& p) const
+{
+	std::vector<int>::const_iterator pz = std::lower_bound(_plane_z.begin(), _plane_z.end(), p.z);
+	if ((pz==_plane_z.end()) || (*pz!=p.z))
+		return 0;
+	const int pi = pz-_plane_z.begin();
+
+	std::vector<int>::const_iterator ly = std::lower_bound(_line_y.begin()+_plane_line[pi], _line_y.begin()+_plane_line[pi+1], p.y);
+	if ((ly==_line_y.begin()+_plane_line[pi+1]) || (*ly!=p.y))
+		return 0;
+	const int li = ly-_line_y.begin();
+
+	// First interval that does not end before x
+	int low=_line_ivl[li], high=_line_ivl[li+1];
+	while(low<high) {
+		const int mid = (low+high)/2;
+		if (_ivl[mid].x2<p.x)
+			low = mid+1;
+		else
+			high = mid;
+	}
+	return ((low<_line_ivl[li+1]) && (_ivl[low].x1<=p.x));
+}
+
+
+const int RLEroi::bounding_cube(Point& tl, Point& br) const
+{
+	if (empty())
+		return 0;
+
+	tl.z = _plane_z.front();
+	br.z = _plane_z.back();
+	tl.y = br.y = _line_y.front();
+	tl.x = _ivl.front().x1;
+	br.x = _ivl.front().x2;
+	int l;
+	for(l=0; l<num_lines(); l++) {
+		if (_line_y[l]<tl.y)
+			tl.y = _line_y[l];
+		if (_line_y[l]>br.y)
+			br.y = _line_y[l];
+		// Intervals are ordered within a line
+		if (_ivl[_line_ivl[l]].x1<tl.x)
+			tl.x = _ivl[_line_ivl[l]].x1;
+		if (_ivl[_line_ivl[l+1]-1].x2>br.x)
+			br.x = _ivl[_line_ivl[l+1]-1].x2;
+	}
+	return 1;
+}
+
+
+const int RLEroi::first_point(Point& p) const
+{
+	if (empty())
+		return 0;
+	p.x = _ivl.front().x1;
+	p.y = _line_y.front();
+	p.z = _plane_z.front();
+	return 1;
+}
+
+
+const int RLEroi::last_point(Point& p) const
+{
+	if (empty())
+		return 0;
+	p.x = _ivl.back().x2;
+	p.y = _line_y.back();
+	p.z = _plane_z.back();
+	return 1;
+}
@@ -0,0 +1,214 @@
+#ifndef __RLEroi_h_
+#define __RLEroi_h_
+
+#include <vector>
+
+#include "Interval.h"
+#include "Point.h"
+
+class ROI;
+
+/// Set operations performed by linear merges of run-length encoded lines (see RLEroi::merge_line)
+enum RLEop {
+	RLE_OR,
+	RLE_AND,
+	RLE_SUBTRACT
+};
+
+/**
+Compact run-length encoded representation of an ROI.
+All Intervals are stored in one contiguous array in raster order (increasing z, then y, then x).
+Lines are stored as a y-coordinate and the offset of their first Interval, planes as a z-coordinate and the offset of their first line.
+Each offset table has a trailing entry, so that the Intervals of line l are [line_ivl(l), line_ivl(l+1)) and the lines of plane p are [plane_line(p), plane_line(p+1)).
+As with the ROI, a plane only exists if it has at least one line and a line only exists if it has at least one Interval.
+The representation can only be built in raster order (see append_interval) and the set operations are linear merges, so it is suited to regions that are built once and combined or queried often.
+*/
+class RLEroi {
+public:
+	/// Default constructor
+	RLEroi();
+
+	/// Constructor that converts an ROI
+	RLEroi(const ROI&);
+
+	/// Destructor
+	~RLEroi() {};
+
+	/** @name Conversion */
+	//@{
+
+	/// Clears the RLEroi and converts the argument
+	void copy(const ROI&);
+
+	/// Clears the argument and sets it to the points of the RLEroi
+	void to_roi(ROI&) const;
+
+	//@}
+
+	/** @name Modification */
+	//@{
+
+	/// Removes all points
+	void clear();
+
+	/// Exchanges the points with those of another RLEroi
+	void swap(RLEroi&);
+
+	/**
+	Appends an interval in raster order.
+	The interval may overlap or touch the last interval of the same line, otherwise x1 must be greater than all x-coordinates of the line and the line (y, z) must not precede the last line.
+	Program exits with an error message if the interval is out of order.
+	Does nothing if x1>x2.
+	*/
+	void append_interval(const int x1, const int x2, const int y, const int z=0);
+
+	/// Takes the logical "or" with the argument
+	void OR(const RLEroi&);
+
+	/// Takes the logical "and" with the argument
+	void AND(const RLEroi&);
+
+	/// Removes points which are in common with the argument
+	void subtract(const RLEroi&);
+
+	/// Translates the points
+	void translate(const int x_shift, const int y_shift, const int z_shift=0);
+
+	/**
+	Morphological dilation: the points p+s for every point p of the RLEroi and s of the structuring element (as ROI::dilate).
+	See erode for how the structuring element is decomposed.
+	The RLEroi is cleared if the structuring element is empty.
+	*/
+	void dilate(const RLEroi& se);
+
+	/**
+	Morphological erosion: the points p for which p+s is in the RLEroi for every point s of the structuring element (as ROI::erode).
+	A structuring element whose planes are identical and contiguous in z (e.g. a box or cylinder) is split into a single plane and a z line, and a plane whose lines are identical and contiguous in y (e.g. a box) into a single line and a y line.
+	Lines along y and z are applied as a logarithmic number of shifts, each an "and" (or "or" for dilation) with a translated copy.
+	The remaining structuring element (e.g. a circle or sphere) is applied row by row: each result line is computed from the lines under the structuring element rows, without building a translated copy of the RLEroi per structuring element interval.
+	The RLEroi is cleared if the structuring element is empty.
+	*/
+	void erode(const RLEroi& se);
+
+	/**
+	Sets r to the result of the set operation op applied to a and b.
+	The planes, lines and Intervals of a and b are merged in a single pass.
+	r must be a different object from a and b.
+	*/
+	static void merge(const RLEroi& a, const RLEroi& b, const RLEop op, RLEroi& r);
+
+	/**
+	Applies the set operation op to two lines given as ordered arrays of non-overlapping Intervals.
+	The resulting Intervals are appended to r in order (r is not cleared).
+	For RLE_OR overlapping and touching Intervals are joined, RLE_AND and RLE_SUBTRACT only split Intervals of a.
+	*/
+	static void merge_line(const Interval* a, const int na, const Interval* b, const int nb, const RLEop op, std::vector<Interval>& r);
+
+	//@}
+
+	/** @name Queries */
+	//@{
+
+	/// Returns 1 if the RLEroi contains no points, 0 otherwise
+	const int empty() const { return _ivl.empty(); };
+
+	/// Returns the number of pixels
+	const int num_pix() const;
+
+	/// Returns 1 if the Point is in the RLEroi, 0 otherwise (binary searches of the planes, lines and Intervals)
+	const int in_roi(const Point&) const;
+
+	/**
+	Determines the bounding cube.
+	@return	1 if the RLEroi is not empty (tl, br set), otherwise 0 (tl, br not set)
+	*/
+	const int bounding_cube(Point& tl, Point& br) const;
+
+	/// Sets the argument to the first point (raster order), returns 0 if the RLEroi is empty (argument not set) and 1 otherwise
+	const int first_point(Point&) const;
+
+	/// Sets the argument to the last point (raster order), returns 0 if the RLEroi is empty (argument not set) and 1 otherwise
+	const int last_point(Point&) const;
+
+	//@}
+
+	/** @name Direct access to the run-length tables */
+	//@{
+
+	/// Number of planes
+	inline const int num_planes() const { return _plane_z.size(); };
+
+	/// Number of lines
+	inline const int num_lines() const { return _line_y.size(); };
+
+	/// Number of Intervals
+	inline const int num_intervals() const { return _ivl.size(); };
+
+	/// z-coordinate of the p'th plane
+	inline const int plane_z(const int p) const { assert((p>=0)&&(p<num_planes())); return _plane_z[p]; };
+
+	/// Index of the first line of the p'th plane (p may be num_planes())
+	inline const int plane_line(const int p) const { assert((p>=0)&&(p<=num_planes())); return _plane_line[p]; };
+
+	/// y-coordinate of the l'th line
+	inline const int line_y(const int l) const { assert((l>=0)&&(l<num_lines())); return _line_y[l]; };
+
+	/// Index of the first Interval of the l'th line (l may be num_lines())
+	inline const int line_ivl(const int l) const { assert((l>=0)&&(l<=num_lines())); return _line_ivl[l]; };
+
+	/// i'th Interval
+	inline const Interval& interval(const int i) const { assert((i>=0)&&(i<num_intervals())); return _ivl[i]; };
+
+	//@}
+
+private:
+	/// Starts a new plane at the end of the tables
+	void _append_plane(const int z);
+
+	/// Starts a new line at the end of the tables (in the last plane)
+	void _append_line(const int y);
+
+	/// Removes the last line if it has no Intervals
+	void _drop_empty_line();
+
+	/// Returns the index of the plane with z-coordinate z, or -1
+	const int _find_plane(const int z) const;
+
+	/**
+	Advances l (a line index in plane p) to the first line of the plane with y-coordinate >= y.
+	Returns l if that line has y-coordinate y, -1 otherwise.
+	*/
+	const int _advance_line(const int p, const int y, int& l) const;
+
+	/// Dilation (sign 1) or erosion (sign -1), decomposing the structuring element (see erode)
+	void _morph(const RLEroi& se, const int sign);
+
+	/// Dilation (sign 1) or erosion (sign -1) by a structuring element, computing the result row by row
+	void _morph_rows(const RLEroi& se, const int sign);
+
+	/// Dilation (sign 1) or erosion (sign -1) by the line of offsets d1 to d2 along y (axis 1) or z (axis 2)
+	void _morph_line(const int d1, const int d2, const int axis, const int sign);
+
+	/// Dilation (sign 1) or erosion (sign -1) by the two offsets 0 and d along y (axis 1) or z (axis 2)
+	void _morph_shift(const int d, const int axis, const int sign);
+
+	/// Removes the last plane if it has no lines
+	void _drop_empty_plane();
+
+	/// Intervals in raster order
+	std::vector<Interval> _ivl;
+
+	/// y-coordinate of each line
+	std::vector<int> _line_y;
+
+	/// Offset of the first Interval of each line, followed by the number of Intervals
+	std::vector<int> _line_ivl;
+
+	/// z-coordinate of each plane
+	std::vector<int> _plane_z;
+
+	/// Offset of the first line of each plane, followed by the number of lines
+	std::vector<int> _plane_line;
+};
+
+#endif // !__RLEroi_h_
@@ -1274,141 +1274,29 @@ const int ROI::pop_first_interval(int& x1, int& x2, int& y, int& z)
 
 void ROI::AND(const ROI& b)
 {
-	ROIworkspace w, wb;
-	WkspaceStatus s;
-	int w_advanced;
-
-	s = _plane_status(w);
-	if (s==ROI_STAT_OK)
-		s = NEW_PLANE;
-
-	while(s<END_ROI) {
-	    w_advanced = 0;
-	    		
-	    if (s>=NEW_PLANE) {
-		while ((_plane_status(w)==ROI_STAT_OK) && (b._find_fwd_plane(wb, _plane(w).z)==NOT_FOUND))
-		    _pl.delete_item(w.pi);
-	    }
-	    // Either matching planes have been found or the end of the ROI has been reached
-
-		if (_plane_status(w)!=ROI_STAT_OK)  // end of ROI has been reached
-	        s = END_ROI;
-	    else { // matching plane has been found
-	    	if (s>=NEW_LINE) {
-				while ((_line_status(w)==ROI_STAT_OK) && (b._find_fwd_line(wb, _line(w).y)==NOT_FOUND)) {
-					_plane(w).ln.delete_item(w.li);
-				}
-			}
-			// Either matching lines have been found or the end of the plane has been reached
-
-			if (_line_status(w)!=ROI_STAT_OK) { // end of plane has been reached
-				// Advance ROI to next plane (deleting current plane if it has no lines left)
-				if (_plane(w).ln.N()==0) {
-					_pl.delete_item(w.pi);
-					_first_line(w);
-					s = NEW_PLANE;
-				}
-				else
-					s = _next_plane(w);
-			}
-			else { // matching line has been found
-				while ((_interval_status(w)==ROI_STAT_OK) && (b._overlap_fwd_interval(wb, _interval(w))==NOT_FOUND))
-					_line(w).ivl.erase(_line(w).ivl.begin()+w.ii);
-				// Either matching intervals have been found or the end of the line has been reached
-
-				if (_interval_status(w)!=ROI_STAT_OK) { // end of line has been reached
-					// Advance ROI to next line
-					// Delete current line if it has no intervals left (delete plane if it then has no lines left)
-					if (_line(w).ivl.size()==0) {
-						_plane(w).ln.delete_item(w.li);
-					
-						if (_plane(w).ln.N()==0) {
-							_pl.delete_item(w.pi);
-							_first_line(w);
-							s = NEW_PLANE;
-						}
-						else
-								_first_interval(w);
-					}
-					else
-						s = _next_line(w);
-				}
-				else { // matching interval has been found
-					if (b._interval_const(wb).x1>_interval(w).x1)
-						_interval(w).x1 = b._interval_const(wb).x1;
-						
-					if (b._interval_const(wb).x2<_interval(w).x2) {
-						Interval iv(b._interval_const(wb).x2+1, _interval(w).x2);
-						_interval(w).x2 = b._interval_const(wb).x2;
-						_line(w).ivl.insert(_line(w).ivl.begin()+w.ii+1, iv);
-					}					
-					s=_next_interval(w);
-				}
-			}
-	    }	
-	}
+	_merge(b, RLE_AND);
 }
 
 
 void ROI::subtract(const ROI& b)
 {
-//cout << "start subtract" << endl;
-	ROIworkspace w, wb;
-	WkspaceStatus s;
-
-	s = b._plane_status(wb);
-	if (s==ROI_STAT_OK)
-		s = NEW_PLANE;
-
-	while(s<END_ROI) {
-		if (s>=NEW_PLANE) {
-			if (_find_fwd_plane(w, b._plane_const(wb).z)==NOT_FOUND) {
-				b._end_of_plane(wb);
-				s = ROI_STAT_OK;
-			}
-		}
-		if (s>=NEW_LINE) {
-			if (_find_fwd_line(w, b._line_const(wb).y)==NOT_FOUND) {
-				b._end_of_line(wb);
-				s = ROI_STAT_OK;
-			}
-		}
-//cout << b._interval(wb).x1 << "  " << b._interval(wb).x2 << endl;
-		if (s>=NEW_INTERVAL) {
-//cout << _line(w) << endl;
-			_line(w).subtract_ivl(b._interval_const(wb));
-//cout << _line(w) << endl;
-
-			if (_line(w).ivl.size()==0) {
-				_plane(w).ln.delete_item(w.li);
-				w.ii = 0;
-				b._end_of_line(wb);
-
-				if (_plane(w).ln.N()==0) {
-					_pl.delete_item(w.pi);
-					w.li = 0;
-					b._end_of_plane(wb);
-				}
-			}
-		}
-
-		s=b._next_interval(wb);		
-	}
-//cout << "done subtract" << endl;
+	_merge(b, RLE_SUBTRACT);
 }
 
 
 void ROI::erode(const ROI& struct_element)
 {
-	//std::cout << "Here A" << std::endl << std::flush;
-	_morph_shell(struct_element, -1);
-	//std::cout << "Here B" << std::endl << std::flush;
+	RLEroi r(*this);
+	r.erode(RLEroi(struct_element));
+	r.to_roi(*this);
 }
 
 
 void ROI::dilate(const ROI& struct_element)
 {
-	_morph_shell(struct_element, 1);
+	RLEroi r(*this);
+	r.dilate(RLEroi(struct_element));
+	r.to_roi(*this);
 }
 
 
@@ -1439,49 +1327,73 @@ void ROI::copy(const ROI& b, const int z)
 
 void ROI::OR(const ROI& b)
 {
-	ROIworkspace w, wb;
-	WkspaceStatus s;
-	//Plane *pp;
-	//Line *lp;
-	//Interval *ip;
+	_merge(b, RLE_OR);
+}
 
-	s = b._plane_status(wb);
-	if (s==ROI_STAT_OK)
-		s = NEW_PLANE;
 
-	while(s<END_ROI) {
-		if (s>=NEW_PLANE) {
-			//pp = &b._plane(wb);
-			//if (_find_fwd_plane(w, pp->z)==NOT_FOUND) {
-			if (_find_fwd_plane(w, b._plane_const(wb).z)==NOT_FOUND) {
-				/*
-				Plane tp(*pp);
-				_pl.push_here(tp, w.pi);
-				*/
-//cout << _pl.N() << ", " << pp->z << ", " << w.pi << endl;
-				//_pl.push_here(*pp, w.pi);
-				_pl.push_here(b._plane_const(wb), w.pi);
-				_end_of_plane(w);
-				b._end_of_plane(wb);
-				s = ROI_STAT_OK;
-			}
+void ROI::_merge(const ROI& b, const RLEop op)
+{
+	if (b._pl.N()==0) {
+		if (op==RLE_AND)
+			clear();
+		return;
+	}
+
+	Darray<Plane> pl;
+	pl.reserve((op==RLE_OR) ? (_pl.N()+b._pl.N()) : _pl.N());
+
+	long i=0, j=0;
+	while((i<_pl.N()) || ((op==RLE_OR) && (j<b._pl.N()))) {
+		if ((j==b._pl.N()) || ((i<_pl.N()) && (_pl[i].z<b._pl[j].z))) {
+			if (op!=RLE_AND)
+				pl.push_last(std::move(_pl(i)));
+			i++;
 		}
-		if (s>=NEW_LINE) {
-			//lp = &b._line(wb);
-			//if (_find_fwd_line(w, lp->y)==NOT_FOUND) {
-			if (_find_fwd_line(w, b._line_const(wb).y)==NOT_FOUND) {
-				//_plane(w).ln.push_here(*lp, w.li);
-				_plane(w).ln.push_here(b._line_const(wb), w.li);
-				_end_of_line(w);
-				b._end_of_line(wb);
-				s = ROI_STAT_OK;
-			}
+		else if ((i==_pl.N()) || (b._pl[j].z<_pl[i].z)) {
+			if (op==RLE_OR)
+				pl.push_last(b._pl[j]);
+			j++;
 		}
-		if (s>=NEW_INTERVAL) {
-			_line(w).add_ivl(b._interval_const(wb));
+		else {
+			Plane p(_pl[i].z, _ln_mod, _ivl_mod);
+			_merge_plane(_pl(i), b._pl[j], op, p);
+			if (p.ln.N()>0)
+				pl.push_last(std::move(p));
+			i++;
+			j++;
 		}
+	}
+	_pl.swap(pl);
+}
 
-		s=b._next_interval(wb);		
+
+void ROI::_merge_plane(Plane& a, const Plane& b, const RLEop op, Plane& p) const
+{
+	p.ln.reserve((op==RLE_OR) ? (a.ln.N()+b.ln.N()) : a.ln.N());
+
+	long i=0, j=0;
+	while((i<a.ln.N()) || ((op==RLE_OR) && (j<b.ln.N()))) {
+		if ((j==b.ln.N()) || ((i<a.ln.N()) && (a.ln[i].y<b.ln[j].y))) {
+			if (op!=RLE_AND)
+				p.ln.push_last(std::move(a.ln(i)));
+			i++;
+		}
+		else if ((i==a.ln.N()) || (b.ln[j].y<a.ln[i].y)) {
+			if (op==RLE_OR)
+				p.ln.push_last(b.ln[j]);
+			j++;
+		}
+		else {
+			Line l(a.ln[i].y);
+			const std::vector<Interval>& ia = a.ln[i].ivl;
+			const std::vector<Interval>& ib = b.ln[j].ivl;
+			l.ivl.reserve((op==RLE_OR) ? (ia.size()+ib.size()) : (ia.size()+1));
+			RLEroi::merge_line(ia.data(), ia.size(), ib.data(), ib.size(), op, l.ivl);
+			if (!l.ivl.empty())
+				p.ln.push_last(std::move(l));
+			i++;
+			j++;
+		}
 	}
 }
 
@@ -1519,6 +1431,17 @@ const int ROI::num_pix(const int zv) const
 }
 
 
+const int ROI::num_intervals() const
+{
+	ROIworkspace w;
+	int status, n=0;
+	
+	for(status=_plane_status(w); (status<END_ROI); status=_next_interval(w))
+		n++;
+	return n;
+}
+
+
 const int ROI::num_pix_grequal(const int v) const
 {
 	ROIworkspace w;
@@ -1955,6 +1878,122 @@ const WkspaceStatus ROI::_set_workspace(ROIworkspace& w, const int z, const int
 }
 
 
+/*
+Union-find root of interval i (with path halving).
+*/
+static inline int cc_find(std::vector<int>& parent, int i)
+{
+	while(parent[i]!=i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+
+/*
+Joins the components of intervals i and j, the root being the first interval in raster order.
+*/
+static inline void cc_union(std::vector<int>& parent, const int i, const int j)
+{
+	const int ri = cc_find(parent, i), rj = cc_find(parent, j);
+	if (ri<rj)
+		parent[rj] = ri;
+	else if (rj<ri)
+		parent[ri] = rj;
+}
+
+
+/*
+Joins intervals of lines l1 and l2 of r that overlap when extended by x_tol in x.
+*/
+static void cc_link_lines(const RLEroi& r, const int l1, const int l2, const int x_tol, std::vector<int>& parent)
+{
+	int i=r.line_ivl(l1), j=r.line_ivl(l2);
+	const int ei=r.line_ivl(l1+1), ej=r.line_ivl(l2+1);
+	while((i<ei) && (j<ej)) {
+		const Interval& a = r.interval(i);
+		const Interval& b = r.interval(j);
+		if ((a.x1<=(b.x2+x_tol)) && (b.x1<=(a.x2+x_tol)))
+			cc_union(parent, i, j);
+		if (a.x2<b.x2)
+			i++;
+		else
+			j++;
+	}
+}
+
+
+ROI* ROI::connected_components(int& n, std::vector<int>& num_vox, const int connectivity, const int min_num_vox) const
+{
+	if ((connectivity!=4) && (connectivity!=8) && (connectivity!=6) && (connectivity!=18) && (connectivity!=26)) {
+		cerr << "ERROR: ROI: connected_components: connectivity must be 4, 8, 6, 18 or 26" << endl;
+		exit(1);
+	}
+
+	const RLEroi r(*this);
+	std::vector<int> parent(r.num_intervals());
+	int i, l, k, p;
+	for(i=0; i<r.num_intervals(); i++)
+		parent[i] = i;
+
+	// Diagonal neighbours within a slice
+	const int xy_tol = ((connectivity==4) || (connectivity==6)) ? 0 : 1;
+
+	for(p=0; p<r.num_planes(); p++) {
+		const bool link_z = (connectivity!=4) && (connectivity!=8) && (p>0) && (r.plane_z(p-1)==(r.plane_z(p)-1));
+		int lp = link_z ? r.plane_line(p-1) : 0;
+
+		for(l=r.plane_line(p); l<r.plane_line(p+1); l++) {
+			const int y = r.line_y(l);
+
+			for(i=r.line_ivl(l)+1; i<r.line_ivl(l+1); i++)
+				if (r.interval(i).x1<=(r.interval(i-1).x2+1))
+					cc_union(parent, i-1, i);
+
+			if ((l>r.plane_line(p)) && (r.line_y(l-1)==(y-1)))
+				cc_link_lines(r, l, l-1, xy_tol, parent);
+
+			if (link_z) {
+				// Lines y-1 to y+1 of the previous slice (the cursor only moves forward as y increases)
+				while((lp<r.plane_line(p)) && (r.line_y(lp)<(y-1)))
+					lp++;
+				for(k=lp; (k<r.plane_line(p)) && (r.line_y(k)<=(y+1)); k++) {
+					const int dy = abs(r.line_y(k)-y);
+					if ((connectivity==6) && dy)
+						continue;
+					// 18-connectivity: neighbours differ in at most two coordinates
+					const int x_tol = (connectivity==26) ? 1 : ((connectivity==18) && !dy) ? 1 : 0;
+					cc_link_lines(r, l, k, x_tol, parent);
+				}
+			}
+		}
+	}
+
+	// Components in order of their root, which is their first interval
+	std::vector<int> count(r.num_intervals(), 0), id(r.num_intervals(), -1);
+	for(i=0; i<r.num_intervals(); i++)
+		count[cc_find(parent, i)] += r.interval(i).num_pts();
+	n = 0;
+	num_vox.clear();
+	for(i=0; i<r.num_intervals(); i++)
+		if ((parent[i]==i) && (count[i]>=min_num_vox) && (count[i]>0)) {
+			id[i] = n++;
+			num_vox.push_back(count[i]);
+		}
+
+	ROI* comp = new ROI [n];
+	for(p=0; p<r.num_planes(); p++)
+		for(l=r.plane_line(p); l<r.plane_line(p+1); l++)
+			for(i=r.line_ivl(l); i<r.line_ivl(l+1); i++) {
+				const int c = id[parent[i]];
+				if (c>=0)
+					comp[c].append_interval(r.interval(i).x1, r.interval(i).x2, r.line_y(l), r.plane_z(p));
+			}
+	return comp;
+}
+
+
 const int ROI::bounding_box(Point& ul, Point& br, const int z) const
 {
 	ROIworkspace w;
@@ -2397,79 +2436,6 @@ z)
 	w.ii++;
 }
 
-void ROI::_morph_shell(const ROI& se, const int trans_sign)
-{
-    	if ((trans_sign!=-1) && (trans_sign!=1)) {
-		cout << endl << endl << "ERROR: ROI: morph_shell: trans_sign must be -1 or 1" << endl;
-		exit(1);
-    	}
-
-	ROI result;
-	int first_time=1;
-	int x1, x2, y, z;
-	int x_prev, y_prev, z_prev;
-
-	ROIworkspace wse;
-	for(WkspaceStatus stat_se=se._valid_wkspace(wse); stat_se<END_ROI; stat_se=se._next_interval(wse)) {
-		ROI partial_result;
-		ROIworkspace w, wpr(-1, -1, -1, -1);
-		register int z_offset = trans_sign*se._plane_const(wse).z;
-		register int y_offset = trans_sign*se._line_const(wse).y;
-		register int x1_offset = trans_sign*se._interval_const(wse).x1;
-		register int x2_offset = trans_sign*se._interval_const(wse).x2;
-
-		WkspaceStatus stat=_valid_wkspace(w);
-		if (stat==ROI_STAT_OK) {
-			z_prev = _plane(w).z + z_offset;
-			y_prev = _line(w).y + y_offset;
-			x_prev = _interval(w).x2 + x2_offset;
-			
-			for(; stat<END_ROI; stat=_next_interval(w)) {
-			//cout << "here1" << endl;
-				z = _plane(w).z + z_offset;
-
-				y = _line(w).y + y_offset;
-
-				x1 = _interval(w).x1 + x1_offset;
-				x2 = _interval(w).x2 + x2_offset;
-				//cout << "here2" << endl;
-			
-				if (x1<=x2) {
-					if ((y==y_prev) && (x1<=(x_prev+1)) && (z==z_prev)) {
-					//cout << "here4" << endl;
-						partial_result.add_interval(x1, x2, y, z);
-						//cout << "here5" << endl;
-						if (wpr.pi==-1) {
-							wpr.zero();
-						}
-					}
-					else {
-					//cout << "here6" << endl;
-						partial_result._append_interval(wpr, x1, x2, y, z);
-						//cout << "here7" << endl;
-					}
-				}
-				//cout << "here3" << endl;
-				z_prev = z;
-				y_prev = y;
-				x_prev = x2;
-			}
-		}
-
-		if ((trans_sign==1) || first_time) {
-			first_time=0;
-			result.OR(partial_result);
-		}
-		else {
-			result.AND(partial_result);
-		}
-	}
-
-
-	clear();
-	OR(result);
-}
-
 void ROI::_add_overlap_interval(const int x1, const int x2, const int y, const int z, ROI& r)
 {
 	ROIworkspace w;
@@ -59,6 +59,7 @@
 #include "Point.h"
 #include "Contour.h"
 #include "ROIworkspace.h"
+#include "RLEroi.h"
 
 using std::cout;
 using std::endl;
@@ -87,6 +88,12 @@ class ROI {
    	*/
   	friend istream& operator>>(istream& file, ROI& is);
 
+	/// Converts to and from the planes of the ROI
+	friend class RLEroi;
+
+	/// Reads and writes the planes of the ROI in the binary ROI file format
+	friend class ROIfile;
+
 public:
 	/// Default constructor
 	ROI();
@@ -301,19 +308,19 @@ public:
 	*/
 	void copy(const ROI&b, const int z);
 
-	/// Takes the logical "or" with the argument
+	/// Takes the logical "or" with the argument (linear merge, see RLEroi::merge_line)
 	void OR(const ROI&);
 
-	/// Takes the logical "and" with the argument
+	/// Takes the logical "and" with the argument (linear merge, see RLEroi::merge_line)
 	void AND(const ROI& r);
 
-	/// Removes points which are in common with r
+	/// Removes points which are in common with r (linear merge, see RLEroi::merge_line)
 	void subtract(const ROI& r);
 
-	/// Morphological erosion
+	/// Morphological erosion (computed on the run-length representation, see RLEroi::erode)
 	void erode(const ROI& struct_element);
 
-	/// Morphological dilation
+	/// Morphological dilation (computed on the run-length representation, see RLEroi::dilate)
 	void dilate(const ROI& struct_element);
 
 	//@}
@@ -331,6 +338,9 @@ public:
 	/// Returns the number of pixels in the image slice with the specified z-coordinate.
 	const int num_pix(const int) const;
 
+	/// Returns the number of Intervals (run-length encoded lines) in the ROI
+	const int num_intervals() const;
+
 	/// Returns 1 if the number of pixels in the ROI is greater than or equal to the specified number (0 otherwise).
 	const int num_pix_grequal(const int) const;
 
@@ -347,6 +357,17 @@ public:
 	*/
 	Contour* boundaries(int& n, const int zv=0) const;
 
+	/**
+	Labels the connected components of the ROI in a single pass over its intervals (union-find on run-length intervals) and returns them as an array of n ROIs (to be deleted by the caller with delete []).
+	Components are ordered by their first point (raster order), as when they are extracted one at a time with add_contig or add_contig_3d starting from the first point of the remaining ROI.
+	Program exits with an error message if the connectivity is invalid.
+	@param	n	the number of components returned
+	@param	num_vox	set to the number of points in each component returned
+	@param	connectivity	6, 18 or 26 for 3-D components (26 as add_contig_3d), or 4 or 8 for components within each slice (8 as add_contig)
+	@param	min_num_vox	components with fewer points are not returned (they are not built as ROIs)
+	*/
+	ROI* connected_components(int& n, std::vector<int>& num_vox, const int connectivity=26, const int min_num_vox=0) const;
+
 	/**
 	Determines the bounding box for a given slice of the ROI.
 	@param	z	z-coordinate of slice to be considered
@@ -684,18 +705,18 @@ private:
 	*/
 	void _append_interval(ROIworkspace& w, const int x1, const int x2, const int y, const int z=0);
 
-	/**
-	Algorithm based on Sonka's suggestion for morphological processing (erosion and dilation). See p. 429 of Image Processing, Analysis and Machine Vision.
+	/// Adds intervals from r that overlap the specified interval, and delete the intervals from r
+	void _add_overlap_interval(const int x1, const int x2, const int y, const int z, ROI& r);
 
-	se: structuring element.
-	trans_sign: the translation sign (-1 for erode or 1 for dilate).
+	/**
+	Applies the set operation op with b in a single pass over the planes and lines of both ROIs.
+	Planes and lines that are only in this ROI are moved to the result rather than copied, lines in both are merged by RLEroi::merge_line.
+	b may be this ROI.
 	*/
-	void _morph_shell(const ROI& se, int trans_sign);
+	void _merge(const ROI& b, const RLEop op);
 
-	void _morph_shell_temp(const ROI& se, int trans_sign);
-
-	/// Adds intervals from r that overlap the specified interval, and delete the intervals from r
-	void _add_overlap_interval(const int x1, const int x2, const int y, const int z, ROI& r);
+	/// Sets p to the result of the set operation op applied to the lines of a and b (lines only in a are moved from a)
+	void _merge_plane(Plane& a, const Plane& b, const RLEop op, Plane& p) const;
 
 };
 
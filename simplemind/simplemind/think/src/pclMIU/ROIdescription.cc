@@ -1,6 +1,37 @@
 #include "ROIdescription.h"
 
 
+/*
+Adds the voxels of an ellipsoid centered at the origin with the given radius in mm, or of an elliptic cylinder with the given radius and height in mm (cylinder set to 1).
+The x, y and z extents are converted to voxels separately using the column and row pixel spacings of the first image and the spacing between the first and second images, so the ellipse is a circle in mm for anisotropic voxels.
+If there is only 1 slice in the sequence the result is planar.
+*/
+static void add_ellipsoid(ROI& r, const float rad_mm, const float height_mm, const int cylinder, const MedicalImageSequence& mis)
+{
+	const float x_spacing = mis.column_pixel_spacing(0);
+	const float y_spacing = mis.row_pixel_spacing(0);
+	float z_spacing = 0;
+	if (mis.zdim()>=2)
+		z_spacing = fabs(mis.slice_location(0) - mis.slice_location(1));
+
+	int half_length_z = 0;
+	if (z_spacing>0)
+		half_length_z = cylinder ? (int)(height_mm/(2*z_spacing) + 0.5) : (int)(rad_mm/z_spacing);
+	const int half_length_y = (int)(rad_mm/y_spacing);
+
+	for(int z=-half_length_z; z<=half_length_z; z++) {
+		const float dz = cylinder ? 0 : z*z_spacing;
+		for(int y=-half_length_y; y<=half_length_y; y++) {
+			const float d2 = rad_mm*rad_mm - dz*dz - (y*y_spacing)*(y*y_spacing);
+			if (d2>=0) {
+				const int half_length_x = (int)(sqrt(d2)/x_spacing);
+				r.append_interval(-half_length_x, half_length_x, y, z);
+			}
+		}
+	}
+}
+
+
 ROIdescription::ROIdescription(const std::string& descr)
 	: _descr(descr)
 {
@@ -38,6 +69,20 @@ const int ROIdescription::roi(ROI& r, const MedicalImageSequence& mis) const
 			done = 1;
 		}
 	}
+	else if (se_type.compare("Sphere")==0) {
+		float rad_mm;
+		if (read_float(_descr, rad_mm, i) && (rad_mm>0)) {
+			add_ellipsoid(r, rad_mm, 0, 0, mis);
+			done = 1;
+		}
+	}
+	else if (se_type.compare("Cylinder")==0) {
+		float rad_mm, height_mm;
+		if (read_float(_descr, rad_mm, i) && (rad_mm>0) && advance_to(_descr, ' ', i) && skip_blanks(_descr, i) && read_float(_descr, height_mm, i) && (height_mm>=0)) {
+			add_ellipsoid(r, rad_mm, height_mm, 1, mis);
+			done = 1;
+		}
+	}
 	else if (se_type.compare("Line_X")==0) {
 		float length_mm;
 		if (read_float(_descr, length_mm, i) && (length_mm>0)) {
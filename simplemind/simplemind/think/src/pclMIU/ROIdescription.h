@@ -59,7 +59,7 @@ using std::ostream;
 
 /**
 A textual description of an ROI.
-Currently supports descriptions of the following forms: circle radius_mm.
+Currently supports descriptions of the following forms: Circle radius_mm, Sphere radius_mm, Cylinder radius_mm height_mm, Line_X length_mm, Line_Y length_mm, Line_Z length_mm, Box (x,y,z) (x,y,z).
 */ 
 class ROIdescription {
 public:
@@ -0,0 +1,364 @@
+#include "ROIfile.h"
+#include <pcl/misc/ZlibOstreamWriter.h>
+#include <zlib.h>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define ROIFILE_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Signature at the start of binary ROI files
+static const unsigned char ROIFILE_SIGNATURE[8] = { 0x89, 'R', 'O', 'I', '\r', '\n', 0x1a, '\n' };
+
+/// Size of the header
+static const size_t ROIFILE_HEADER_SIZE = 24;
+
+/// Size of a plane index entry
+static const size_t ROIFILE_ENTRY_SIZE = 24;
+
+static void put_u32(std::string& s, const uint32_t v)
+{
+	for(int i=0; i<4; i++)
+		s += (char)((v>>(8*i)) & 0xff);
+}
+
+static void put_u64(std::string& s, const uint64_t v)
+{
+	for(int i=0; i<8; i++)
+		s += (char)((v>>(8*i)) & 0xff);
+}
+
+static uint32_t get_u32(const unsigned char* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+	return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p+4)<<32);
+}
+
+static void put_varint(std::string& s, uint32_t v)
+{
+	while (v>=0x80) {
+		s += (char)((v & 0x7f) | 0x80);
+		v >>= 7;
+	}
+	s += (char)v;
+}
+
+static void put_svarint(std::string& s, const int v)
+{
+	put_varint(s, ((uint32_t)v<<1) ^ (uint32_t)(v>>31));
+}
+
+/// Reads a varint at p (not beyond end), returns false if it is truncated
+static bool get_varint(const unsigned char*& p, const unsigned char* end, uint32_t& v)
+{
+	v = 0;
+	for(int shift=0; (p<end) && (shift<35); shift+=7) {
+		const unsigned char b = *p++;
+		v |= (uint32_t)(b & 0x7f)<<shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static bool get_svarint(const unsigned char*& p, const unsigned char* end, int& v)
+{
+	uint32_t u;
+	if (!get_varint(p, end, u))
+		return false;
+	v = (int)(u>>1) ^ -(int)(u & 1);
+	return true;
+}
+
+
+ROIfile::ROIfile()
+	: _data(0), _size(0), _compressed(false)
+#ifdef ROIFILE_WIN32
+	, _file(INVALID_HANDLE_VALUE), _mapping(0)
+#endif
+{
+}
+
+ROIfile::~ROIfile()
+{
+	close();
+}
+
+const bool ROIfile::open(const std::string& path)
+{
+	close();
+	_path = path;
+
+#ifdef ROIFILE_WIN32
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (_file==INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || (size.QuadPart<(LONGLONG)ROIFILE_HEADER_SIZE)) {
+		close();
+		return false;
+	}
+	_mapping = CreateFileMappingA(_file, 0, PAGE_READONLY, 0, 0, 0);
+	if (_mapping)
+		_data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_data) {
+		close();
+		return false;
+	}
+	_size = (size_t)size.QuadPart;
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd<0)
+		return false;
+	struct stat st;
+	if ((fstat(fd, &st)!=0) || (st.st_size<(off_t)ROIFILE_HEADER_SIZE)) {
+		::close(fd);
+		return false;
+	}
+	void* data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data==MAP_FAILED)
+		return false;
+	_data = (const unsigned char*)data;
+	_size = st.st_size;
+#endif
+
+	if (memcmp(_data, ROIFILE_SIGNATURE, sizeof(ROIFILE_SIGNATURE))) {
+		close();
+		return false;
+	}
+	const uint32_t version = get_u32(_data+8);
+	if (version>ROIFILE_VERSION) {
+		cerr << "ERROR: ROIfile: " << path << " has format version " << version << ", only versions up to " << ROIFILE_VERSION << " can be read" << endl;
+		exit(1);
+	}
+	_compressed = (get_u32(_data+12) & ROIFILE_ZLIB)!=0;
+	const uint32_t num_planes = get_u32(_data+16);
+	if ((_size-ROIFILE_HEADER_SIZE)/ROIFILE_ENTRY_SIZE<num_planes) {
+		cerr << "ERROR: ROIfile: " << path << " is truncated" << endl;
+		exit(1);
+	}
+
+	_plane.resize(num_planes);
+	const unsigned char* p = _data+ROIFILE_HEADER_SIZE;
+	for(uint32_t i=0; i<num_planes; i++, p+=ROIFILE_ENTRY_SIZE) {
+		PlaneEntry& e = _plane[i];
+		e.z = (int)get_u32(p);
+		e.raw_size = get_u32(p+4);
+		e.offset = get_u64(p+8);
+		e.size = get_u64(p+16);
+		if ((e.offset>_size) || (e.size>_size-e.offset) || ((i>0) && (e.z<=_plane[i-1].z))) {
+			cerr << "ERROR: ROIfile: " << path << " has an invalid plane index" << endl;
+			exit(1);
+		}
+	}
+	return true;
+}
+
+void ROIfile::close()
+{
+#ifdef ROIFILE_WIN32
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+	if (_file!=INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+	_mapping = 0;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data)
+		munmap((void*)_data, _size);
+#endif
+	_data = 0;
+	_size = 0;
+	_plane.clear();
+	_compressed = false;
+}
+
+const int ROIfile::find_plane(const int z) const
+{
+	int lo=0, hi=(int)_plane.size()-1;
+	while (lo<=hi) {
+		const int mid = (lo+hi)/2;
+		if (_plane[mid].z==z)
+			return mid;
+		if (_plane[mid].z<z)
+			lo = mid+1;
+		else
+			hi = mid-1;
+	}
+	return -1;
+}
+
+void ROIfile::_append_plane(const int i, ROI& r) const
+{
+	const PlaneEntry& e = _plane[i];
+	const unsigned char* p = _data+e.offset;
+	std::vector<unsigned char> raw;
+	if (_compressed) {
+		raw.resize(e.raw_size);
+		uLongf raw_size = e.raw_size;
+		if ((uncompress(raw.data(), &raw_size, p, (uLong)e.size)!=Z_OK) || (raw_size!=e.raw_size)) {
+			cerr << "ERROR: ROIfile: " << _path << ": plane " << e.z << " cannot be decompressed" << endl;
+			exit(1);
+		}
+		p = raw.data();
+	}
+	const unsigned char* end = p+(_compressed ? e.raw_size : e.size);
+
+	uint32_t num_lines=0, num_ivls=0, len=0;
+	int dy=0, dx=0;
+	long long y=0;
+	bool ok = get_varint(p, end, num_lines);
+	Plane pl(e.z, r._ln_mod, r._ivl_mod);
+	for(uint32_t l=0; ok && (l<num_lines); l++) {
+		// Each Interval takes at least 2 bytes
+		ok = get_svarint(p, end, dy) && get_varint(p, end, num_ivls) && (num_ivls<=(uint32_t)(end-p)/2);
+		// Lines are in increasing y, coordinates fit an int
+		ok = ok && ((l==0) || (dy>0)) && (y+dy>=INT_MIN) && (y+dy<=INT_MAX);
+		if (!ok)
+			break;
+		y += dy;
+		Line ln((int)y);
+		ln.ivl.reserve(num_ivls);
+		long long x=0;
+		for(uint32_t k=0; ok && (k<num_ivls); k++) {
+			ok = get_svarint(p, end, dx) && get_varint(p, end, len);
+			// Intervals of a line are ordered and do not overlap
+			ok = ok && ((k==0) || (dx>0)) && (x+dx>=INT_MIN) && (x+dx+len<=INT_MAX);
+			if (!ok)
+				break;
+			x += dx;
+			ln.ivl.push_back(Interval((int)x, (int)(x+len)));
+			x += len;
+		}
+		pl.ln.push_last(std::move(ln));
+	}
+	if (!ok) {
+		cerr << "ERROR: ROIfile: " << _path << ": plane " << e.z << " is corrupt" << endl;
+		exit(1);
+	}
+	r._pl.push_last(std::move(pl));
+}
+
+const bool ROIfile::read_plane(const int z, ROI& r) const
+{
+	r.clear();
+	const int i = find_plane(z);
+	if (i<0)
+		return false;
+	_append_plane(i, r);
+	return true;
+}
+
+void ROIfile::read(ROI& r) const
+{
+	r.clear();
+	for(int i=0; i<num_planes(); i++)
+		_append_plane(i, r);
+}
+
+const bool ROIfile::is_binary(const std::string& path)
+{
+	std::ifstream in(path.c_str(), std::ifstream::binary);
+	char sig[sizeof(ROIFILE_SIGNATURE)];
+	return in.read(sig, sizeof(sig)) && !memcmp(sig, ROIFILE_SIGNATURE, sizeof(sig));
+}
+
+const bool ROIfile::read(const std::string& path, ROI& r)
+{
+	std::ifstream in(path.c_str(), std::ifstream::binary);
+	if (!in) {
+		r.clear();
+		return false;
+	}
+	if (in.peek()==ROIFILE_SIGNATURE[0]) {
+		in.close();
+		ROIfile f;
+		if (!f.open(path)) {
+			cerr << "ERROR: ROIfile: " << path << " is not a valid ROI file" << endl;
+			exit(1);
+		}
+		f.read(r);
+	}
+	else
+		in >> r;
+	return true;
+}
+
+void ROIfile::write(ostream& s, const ROI& r, const bool compress)
+{
+	const int num_planes = r._pl.N();
+	std::vector<std::string> block(num_planes);
+	std::vector<uint32_t> raw_size(num_planes);
+	std::string raw;
+	int i, j;
+	size_t k;
+	for(i=0; i<num_planes; i++) {
+		const Darray<Line>& lp = r._pl[i].ln;
+		raw.clear();
+		put_varint(raw, (uint32_t)lp.N());
+		int y=0;
+		for(j=0; j<lp.N(); j++) {
+			const std::vector<Interval>& ip = lp[j].ivl;
+			put_svarint(raw, lp[j].y-y);
+			y = lp[j].y;
+			put_varint(raw, (uint32_t)ip.size());
+			int x=0;
+			for(k=0; k<ip.size(); k++) {
+				put_svarint(raw, ip[k].x1-x);
+				put_varint(raw, (uint32_t)(ip[k].x2-ip[k].x1));
+				x = ip[k].x2;
+			}
+		}
+		raw_size[i] = (uint32_t)raw.size();
+		if (compress) {
+			std::ostringstream zs;
+			pcl::misc::ZlibOstreamWriter::Pointer writer = pcl::misc::ZlibOstreamWriter::New(zs, Z_BEST_SPEED, 1<<16);
+			writer->write(&raw[0], (long)raw.size(), true);
+			block[i] = zs.str();
+		}
+		else
+			block[i] = raw;
+	}
+
+	std::string header(reinterpret_cast<const char*>(ROIFILE_SIGNATURE), sizeof(ROIFILE_SIGNATURE));
+	put_u32(header, ROIFILE_VERSION);
+	put_u32(header, compress ? ROIFILE_ZLIB : 0);
+	put_u32(header, num_planes);
+	put_u32(header, 0);
+	uint64_t offset = ROIFILE_HEADER_SIZE+ROIFILE_ENTRY_SIZE*(uint64_t)num_planes;
+	for(i=0; i<num_planes; i++) {
+		put_u32(header, (uint32_t)r._pl[i].z);
+		put_u32(header, raw_size[i]);
+		put_u64(header, offset);
+		put_u64(header, block[i].size());
+		offset += block[i].size();
+	}
+	s.write(header.data(), header.size());
+	for(i=0; i<num_planes; i++)
+		s.write(block[i].data(), block[i].size());
+}
+
+const bool ROIfile::write(const std::string& path, const ROI& r, const bool compress)
+{
+	std::ofstream out(path.c_str(), std::ofstream::binary);
+	if (!out)
+		return false;
+	write(out, r, compress);
+	return out.good();
+}
@@ -0,0 +1,116 @@
+#ifndef __ROIfile_h_
+#define __ROIfile_h_
+
+#include "ROI.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+Binary ROI files, an alternative to the text written by operator<<(ostream&, const ROI&) for large ROIs.
+
+The file starts with a 24 byte header, followed by a plane index and one data block per plane (all integers little-endian):
+	- 8 byte signature "\x89ROI\r\n\x1a\n" (the first byte cannot start a text ROI, the others detect text mode conversions),
+	- uint32 format version (ROIFILE_VERSION), uint32 flags (ROIFILE_ZLIB: the blocks are zlib compressed), uint32 number of planes, uint32 reserved (0),
+	- for each plane in increasing z: int32 z, uint32 size of the decoded block, uint64 offset of the block from the start of the file, uint64 size of the stored block.
+
+A decoded block holds the lines of the plane as unsigned LEB128 varints, signed values being zigzag encoded:
+the number of lines, then for each line the y-coordinate minus that of the previous line (signed, 0 before the first line) and the number of Intervals,
+then for each Interval x1 minus x2 of the previous Interval of the line (signed, 0 before the first Interval) and x2-x1.
+Lines are in increasing y and the Intervals of a line in increasing x without overlapping, blocks that are not are corrupt.
+
+Because every plane is a separate block, a single plane can be read without decoding the others (see read_plane).
+Files are memory mapped for reading (see open).
+*/
+class ROIfile {
+public:
+	/// Constructor - no file is open
+	ROIfile();
+
+	/// Destructor - closes the file
+	~ROIfile();
+
+	/**
+	Maps a binary ROI file into memory and reads its plane index.
+	Returns false if the file cannot be opened or is not a binary ROI file, exits with an error message if it is corrupt or of a newer version.
+	*/
+	const bool open(const std::string& path);
+
+	/// Unmaps the file
+	void close();
+
+	/// Number of planes of the open file
+	inline const int num_planes() const { return (int)_plane.size(); };
+
+	/// z-coordinate of the i'th plane of the open file (in increasing z)
+	inline const int plane_z(const int i) const { return _plane[i].z; };
+
+	/// Index of the plane with z-coordinate z in the open file, -1 if the ROI has no points in that plane
+	const int find_plane(const int z) const;
+
+	/// Clears r and sets it to the points of the open file in plane z, returns false if there are none
+	const bool read_plane(const int z, ROI& r) const;
+
+	/// Clears r and sets it to the points of the open file
+	void read(ROI& r) const;
+
+	/**
+	Clears r and reads it from a file in the binary or the text format (operator>>), which is detected from the first byte.
+	Returns false if the file cannot be opened.
+	*/
+	static const bool read(const std::string& path, ROI& r);
+
+	/// Returns true if the file starts with the signature of a binary ROI file
+	static const bool is_binary(const std::string& path);
+
+	/// Writes r in the binary format (compress: zlib compression of the planes)
+	static void write(ostream& s, const ROI& r, const bool compress=true);
+
+	/// Writes r to a file in the binary format (compress: zlib compression of the planes), returns false if the file cannot be written
+	static const bool write(const std::string& path, const ROI& r, const bool compress=true);
+
+private:
+	/// Entry of the plane index
+	struct PlaneEntry {
+		/// z-coordinate
+		int z;
+		/// Size of the decoded block
+		uint32_t raw_size;
+		/// Offset of the block from the start of the file
+		uint64_t offset;
+		/// Size of the stored block
+		uint64_t size;
+	};
+
+	/// Decodes the block of the i'th plane and appends the plane to r
+	void _append_plane(const int i, ROI& r) const;
+
+	/// Path of the open file (for error messages)
+	std::string _path;
+
+	/// Contents of the open file (0 if no file is open)
+	const unsigned char* _data;
+
+	/// Size of the open file
+	size_t _size;
+
+	/// Plane index of the open file
+	std::vector<PlaneEntry> _plane;
+
+	/// The blocks of the open file are zlib compressed
+	bool _compressed;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+	/// File and file mapping handles
+	void* _file;
+	void* _mapping;
+#endif
+};
+
+/// Binary ROI file format version written by ROIfile
+const uint32_t ROIFILE_VERSION = 1;
+
+/// Flag of binary ROI files whose planes are zlib compressed
+const uint32_t ROIFILE_ZLIB = 1;
+
+#endif // !__ROIfile_h_
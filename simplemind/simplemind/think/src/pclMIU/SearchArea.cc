@@ -1,4 +1,5 @@
 #include "SearchArea.h"
+#include <sstream>
 
 // These functions are defined in roitk
 int conv_hull_direct(const Point& v1, const Point& v2, const Point& v3);
@@ -27,6 +28,55 @@ void SearchArea::write(ostream& s) const
 }
 
 
+const int SearchArea::relation_roi(MedicalImageSequence&, const Point&, const Darray<ImagePrimitive*>&, ROI&, const int num_threads)
+{
+	return 0;
+}
+
+
+const int SearchArea::relation_key(std::string&) const
+{
+	return 0;
+}
+
+
+const int SearchArea::cached_search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads, SearchAreaCache& cache, const int solel)
+{
+	std::string params;
+	if ((prim.N()==0) || !relation_key(params))
+		return search_area(mis, ss_factor, prim, roi, num_threads);
+
+	std::ostringstream key;
+	std::vector<const ROI*> sources;
+	key << name() << " " << params << " ss " << ss_factor.x << " " << ss_factor.y << " " << ss_factor.z;
+	for(int i=0; i<prim.N(); i++) {
+		if (strcmp(prim[i]->type(), "ImageRegion"))
+			return search_area(mis, ss_factor, prim, roi, num_threads);
+		key << " " << std::hex << ((ImageRegion*)prim[i])->digest() << std::dec;
+		sources.push_back(&((ImageRegion*)prim[i])->roi());
+	}
+
+	std::shared_ptr<const ROI> result = cache.find(key.str(), sources, solel);
+	if (!result) {
+		ROI r;
+		if (!relation_roi(mis, ss_factor, prim, r, num_threads))
+			return search_area(mis, ss_factor, prim, roi, num_threads);
+		result = cache.store(key.str(), sources, r, solel);
+	}
+	_combine(roi, *result);
+	return 1;
+}
+
+
+void SearchArea::_combine(ROI& roi, const ROI& result) const
+{
+	if (or_flag())
+		roi.OR(result);
+	else
+		roi.AND(result);
+}
+
+
 BetweenX::BetweenX(const std::string& rel_solel_name, const int rel_solel_ind, const int e_flag)
 	: SearchArea(e_flag)
 {
@@ -38,7 +88,7 @@ BetweenX::~BetweenX()
 {
 }
 
-const int BetweenX::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BetweenX::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -91,7 +141,7 @@ BoxRelCentroid::~BoxRelCentroid()
 }
 
 
-const int BoxRelCentroid::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelCentroid::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -173,7 +223,7 @@ BoxRelPlanarCentroid::~BoxRelPlanarCentroid()
 }
 
 
-const int BoxRelPlanarCentroid::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelPlanarCentroid::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -253,7 +303,7 @@ BoxRelPlanarYmin::~BoxRelPlanarYmin()
 }
 
 
-const int BoxRelPlanarYmin::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelPlanarYmin::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -334,7 +384,7 @@ BoxRelPlanarYmax::~BoxRelPlanarYmax()
 }
 
 
-const int BoxRelPlanarYmax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelPlanarYmax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -421,7 +471,7 @@ BoxRelZmin::~BoxRelZmin()
 }
 
 
-const int BoxRelZmin::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelZmin::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -515,7 +565,7 @@ BoxRelZmax::~BoxRelZmax()
 }
 
 
-const int BoxRelZmax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxRelZmax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -605,7 +655,7 @@ BoxSizeTlProp::~BoxSizeTlProp()
 }
 
 
-const int BoxSizeTlProp::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int BoxSizeTlProp::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
 	//cout << "BoxSizeTlProp " << _x_length << " " << _y_length << " " << _z_length << " " << _tlx_prop << " " << _tly_prop << " " << _tlz_prop << endl;
 
@@ -667,7 +717,7 @@ Clear::~Clear()
 }
 
 
-const int Clear::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int Clear::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 1;
   roi.clear();
@@ -718,7 +768,17 @@ int conv_hull_input(Contour& c, Point& v)
 }
 */
 
-const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
+{
+	ROI chull;
+	if (!relation_roi(mis, ss_factor, prim, chull, num_threads))
+		return 0;
+	_combine(roi, chull);
+	return 1;
+}
+
+
+const int ConvexHull::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
 {
   int done = 0;
 
@@ -731,7 +791,6 @@ const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_fac
 	ROI r;
 	subsample_roi(r0->roi(), r, ss_factor.x, ss_factor.y, ss_factor.z);
 
-	ROI chull;
 	Point p1, p2;
 	register int ok, triangle;
 
@@ -757,7 +816,7 @@ const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_fac
 			}
 			//cout << "chull here3c " << n << endl;
 
-			if (!chull.in_roi(bndy[mpi][0])) {
+			if (!result.in_roi(bndy[mpi][0])) {
 			    Contour h(bndy[mpi]);
 
 			    if (bndy[mpi].n()>=3) {
@@ -807,7 +866,7 @@ const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_fac
 				}
 			    }
 			    //cout << "chull here3i " << z << endl;
-			    chull.add_planar_polygon(h);
+			    result.add_planar_polygon(h);
 			    //cout << "chull here3j " << z << endl;
 			}
 			else
@@ -819,13 +878,24 @@ const int ConvexHull::search_area(MedicalImageSequence& mis, const Point& ss_fac
 	    //cout << "chull here3 " << z << endl;
 	    }
 	//cout << "chull here4" << endl;
-	chull.erode(se);
-	roi.AND(chull);
+	result.erode(se);
   }
   return done;
 }
 
 
+const int ConvexHull::relation_key(std::string& key) const
+{
+	return 1;
+}
+
+
+void ConvexHull::_combine(ROI& roi, const ROI& result) const
+{
+	roi.AND(result);
+}
+
+
 
 DistanceMap2D::DistanceMap2D(const std::string& rel_solel_name, const int rel_solel_ind, const float dist_thresh, const int e_flag)
 	: SearchArea(e_flag), _dist_thresh(dist_thresh)
@@ -838,7 +908,17 @@ DistanceMap2D::~DistanceMap2D()
 }
 
 
-const int DistanceMap2D::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int DistanceMap2D::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
+{
+	ROI result;
+	if (!relation_roi(mis, ss_factor, prim, result, num_threads))
+		return 0;
+	_combine(roi, result);
+	return 1;
+}
+
+
+const int DistanceMap2D::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
 {
   int done = 0;
 
@@ -846,7 +926,6 @@ const int DistanceMap2D::search_area(MedicalImageSequence& mis, const Point& ss_
     && !strcmp(prim[0]->type(), "ImageRegion")) {
 	done = 1;
 	ImageRegion* r0 = (ImageRegion*)prim[0];
-	ROI result;
 
 	Point fp;
 	if (!r0->roi().first_point(fp)) {
@@ -857,15 +936,19 @@ const int DistanceMap2D::search_area(MedicalImageSequence& mis, const Point& ss_
 	Point lp;
 	r0->roi().last_point(lp);
 
-	// Euclidean Distance Map algorithm from textbook by Russ
-
 	int xdim = mis.xdim();
 	float* dm;
 	int z, j;
 
+	// Maps of all planes in one distance transform
+	float** dms = new float* [lp.z+1];
+	for (z=0; z<=lp.z; z++)
+		dms[z] = 0;
+	distance_maps_2d(r0->roi(), dms, mis, num_threads);
+
 	for (z=fp.z; z<=lp.z; z++)
 	  if (!r0->roi().empty(z)) {
-		dm = distance_map_2d(r0->roi(), z, mis);
+		dm = dms[z];
 
 		ROItraverser rt(r0->roi(), z);
 		TravStatus s = rt.valid();
@@ -884,16 +967,22 @@ const int DistanceMap2D::search_area(MedicalImageSequence& mis, const Point& ss_
 
 		delete [] dm;
 	}
-
-	if (or_flag())
-		roi.OR(result);
-	else
-		roi.AND(result);
+	delete [] dms;
  }
  return done;
 }
 
 
+const int DistanceMap2D::relation_key(std::string& key) const
+{
+	std::ostringstream s;
+	s.precision(9);
+	s << _dist_thresh;
+	key.append(s.str());
+	return 1;
+}
+
+
 /*
 DistanceMap25DPercMax::DistanceMap25DPercMax(const std::string& rel_solel_name, const int rel_solel_ind, const float percentage, const int e_flag)
 	: SearchArea(e_flag), _perc(percentage)
@@ -906,7 +995,7 @@ DistanceMap25DPercMax::~DistanceMap25DPercMax()
 }
 
 
-const int DistanceMap25DPercMax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int DistanceMap25DPercMax::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -1047,7 +1136,17 @@ int bounding_area(Contour& c)
 	return ((maxx-minx)*(maxy-miny));
 }
 
-const int ExpandContractPlanar::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int ExpandContractPlanar::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
+{
+	ROI result;
+	if (!relation_roi(mis, ss_factor, prim, result, num_threads))
+		return 0;
+	_combine(roi, result);
+	return 1;
+}
+
+
+const int ExpandContractPlanar::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
 {
   int done = 0;
 
@@ -1055,7 +1154,6 @@ const int ExpandContractPlanar::search_area(MedicalImageSequence& mis, const Poi
     && !strcmp(prim[0]->type(), "ImageRegion")) {
 	done = 1;
 	ImageRegion* r0 = (ImageRegion*)prim[0];
-	ROI result;
 
 	Point p1, p2;
 	r0->roi().first_point(p1);
@@ -1124,22 +1222,23 @@ const int ExpandContractPlanar::search_area(MedicalImageSequence& mis, const Poi
 	if ((ss_factor.x*ss_factor.y*ss_factor.z)>1) {
 		ROI ss_result;
 		subsample_roi(result, ss_result, ss_factor.x, ss_factor.y, ss_factor.z);
-		if (or_flag())
-			roi.OR(ss_result);
-		else
-			roi.AND(ss_result);
-	}
-	else {
-		if (or_flag())
-			roi.OR(result);
-		else
-			roi.AND(result);
+		result = ss_result;
 	}
  }
  return done;
 }
 
 
+const int ExpandContractPlanar::relation_key(std::string& key) const
+{
+	std::ostringstream s;
+	s.precision(9);
+	s << _distance;
+	key.append(s.str());
+	return 1;
+}
+
+
 Inside2D::Inside2D(const std::string& rel_solel_name, const int rel_solel_ind, const int e_flag)
 	: SearchArea(e_flag)
 {
@@ -1150,7 +1249,17 @@ Inside2D::~Inside2D()
 {
 }
 
-const int Inside2D::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int Inside2D::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
+{
+	ROI result;
+	if (!relation_roi(mis, ss_factor, prim, result, num_threads))
+		return 0;
+	_combine(roi, result);
+	return 1;
+}
+
+
+const int Inside2D::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
 {
   int done = 0;
 
@@ -1159,27 +1268,28 @@ const int Inside2D::search_area(MedicalImageSequence& mis, const Point& ss_facto
 	done = 1;
 	ImageRegion* r0 = (ImageRegion*)prim[0];
 
-	ROI rcpy;
 	if ((ss_factor.x*ss_factor.y*ss_factor.z)>1)
-		subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
+		subsample_roi(r0->roi(), result, ss_factor.x, ss_factor.y, ss_factor.z);
 	else
-		rcpy.copy(r0->roi());
+		result.copy(r0->roi());
 
 	Point p1, p2;
-	if (rcpy.first_point(p1) && rcpy.last_point(p2)) {
+	if (result.first_point(p1) && result.last_point(p2)) {
 		int z;
 		for(z=p1.z; z<=p2.z; z++)
-			rcpy.fill_holes_2D(z);
+			result.fill_holes_2D(z);
 	}
-	if (or_flag())
-		roi.OR(rcpy);
-	else
-		roi.AND(rcpy);
   }
   return done;
 }
 
 
+const int Inside2D::relation_key(std::string& key) const
+{
+	return 1;
+}
+
+
 Morph::Morph(const std::string& rel_solel_name, const int rel_solel_ind, const std::string& struct_el_descr, const int e_flag)
 	: SearchArea(e_flag), _struct_el(struct_el_descr)
 {
@@ -1204,6 +1314,42 @@ const int Morph::struct_el(ROI& r, const MedicalImageSequence& mis) const
 }
 
 
+const int Morph::relation_key(std::string& key) const
+{
+	key.append(_struct_el.description());
+	return 1;
+}
+
+
+const int Morph::_struct_el_subsampled(ROI& se, const MedicalImageSequence& mis, const Point& ss_factor) const
+{
+	if ((ss_factor.x*ss_factor.y*ss_factor.z)<=1)
+		return struct_el(se, mis);
+
+	ROI se_temp;
+	int ok = struct_el(se_temp, mis);
+	if (ok) {
+		subsample_roi(se_temp, se, ss_factor.x, ss_factor.y, ss_factor.z);
+		ok = !se.empty();
+	}
+	return ok;
+}
+
+
+const int Morph::_related_region(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& se, ROI& rcpy) const
+{
+	if ((prim.N() != 1) || strcmp(prim[0]->type(), "ImageRegion") || !_struct_el_subsampled(se, mis, ss_factor))
+		return 0;
+
+	ImageRegion* r0 = (ImageRegion*)prim[0];
+	if ((ss_factor.x*ss_factor.y*ss_factor.z)>1)
+		subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
+	else
+		rcpy.copy(r0->roi());
+	return 1;
+}
+
+
 void Morph::write(ostream& s) const
 {
 	_write_start_attribute(s);
@@ -1231,47 +1377,34 @@ MorphErode::~MorphErode()
 }
 
 
-const int MorphErode::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int MorphErode::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
-  int done = 0;
-  ROI se;
-  int ok, use_subsampled = ((ss_factor.x*ss_factor.y*ss_factor.z)>1);
-  if (!use_subsampled)
-	ok = struct_el(se, mis);
-  else {
-	ROI se_temp;
-	ok = struct_el(se_temp, mis);
-	if (ok) {
-		subsample_roi(se_temp, se, ss_factor.x, ss_factor.y, ss_factor.z);
-		ok = !se.empty();
+	int done = 0;
+	if (prim.N() == 0) {
+		done = 1;
+		ROI se;
+		const int ok = _struct_el_subsampled(se, mis, ss_factor);
+		if (ok)
+			roi.erode(se);
 	}
-  }
-
-  if (prim.N() == 0) {
-	done = 1;
-	if (ok)
-		roi.erode(se);
-  }
-  else if ((prim.N() == 1)
-    && !strcmp(prim[0]->type(), "ImageRegion")) {
-	done = 1;
-	ImageRegion* r0 = (ImageRegion*)prim[0];
-
-	if (ok) {
+	else if ((prim.N() == 1)
+	  && !strcmp(prim[0]->type(), "ImageRegion")) {
+		done = 1;
 		ROI rcpy;
-		if (use_subsampled)
-			subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
-		else
-			rcpy.copy(r0->roi());
-
-		rcpy.erode(se);
-		if (or_flag())
-			roi.OR(rcpy);
-		else
-			roi.AND(rcpy);
+		if (relation_roi(mis, ss_factor, prim, rcpy, num_threads))
+			_combine(roi, rcpy);
 	}
-  }
-  return done;
+	return done;
+}
+
+
+const int MorphErode::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
+{
+	ROI se;
+	if (!_related_region(mis, ss_factor, prim, se, result))
+		return 0;
+	result.erode(se);
+	return 1;
 }
 
 
@@ -1286,51 +1419,37 @@ MorphOpen::~MorphOpen()
 }
 
 
-const int MorphOpen::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int MorphOpen::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
-  int done = 0;
-  ROI se;
-  int ok, use_subsampled = ((ss_factor.x*ss_factor.y*ss_factor.z)>1);
-  if (!use_subsampled)
-	ok = struct_el(se, mis);
-  else {
-	ROI se_temp;
-	ok = struct_el(se_temp, mis);
-	if (ok) {
-		subsample_roi(se_temp, se, ss_factor.x, ss_factor.y, ss_factor.z);
-		ok = !se.empty();
-	}
-  }
-
-  if (prim.N() == 0) {
-	done = 1;
-	if (ok) {
-		roi.erode(se);
-		roi.dilate(se);
+	int done = 0;
+	if (prim.N() == 0) {
+		done = 1;
+		ROI se;
+		const int ok = _struct_el_subsampled(se, mis, ss_factor);
+		if (ok) {
+			roi.erode(se);
+			roi.dilate(se);
+		}
 	}
-  }
-  else if ((prim.N() == 1)
-    && !strcmp(prim[0]->type(), "ImageRegion")) {
-	done = 1;
-	ImageRegion* r0 = (ImageRegion*)prim[0];
-
-	if (ok) {
+	else if ((prim.N() == 1)
+	  && !strcmp(prim[0]->type(), "ImageRegion")) {
+		done = 1;
 		ROI rcpy;
-		if (use_subsampled)
-			subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
-		else
-			rcpy.copy(r0->roi());
+		if (relation_roi(mis, ss_factor, prim, rcpy, num_threads))
+			_combine(roi, rcpy);
+	}
+	return done;
+}
 
-		rcpy.erode(se);
-		rcpy.dilate(se);
 
-		if (or_flag())
-			roi.OR(rcpy);
-		else
-			roi.AND(rcpy);
-	}
-  }
-  return done;
+const int MorphOpen::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
+{
+	ROI se;
+	if (!_related_region(mis, ss_factor, prim, se, result))
+		return 0;
+	result.erode(se);
+	result.dilate(se);
+	return 1;
 }
 
 
@@ -1349,59 +1468,37 @@ MorphClose::~MorphClose()
 }
 
 
-const int MorphClose::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int MorphClose::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
-	//std::cout << std::endl << "Entering MorphClose::search_area" << std::endl << std::flush;
-  int done = 0;
-  ROI se;
-  int ok, use_subsampled = ((ss_factor.x*ss_factor.y*ss_factor.z)>1);
-  if (!use_subsampled)
-	ok = struct_el(se, mis);
-  else {
-	ROI se_temp;
-	ok = struct_el(se_temp, mis);
-	if (ok) {
-		subsample_roi(se_temp, se, ss_factor.x, ss_factor.y, ss_factor.z);
-		ok = !se.empty();
-	}
-  }
-
-  if (prim.N() == 0) {
-	done = 1;
-	if (ok) {
-		roi.dilate(se);
-		roi.erode(se);
+	int done = 0;
+	if (prim.N() == 0) {
+		done = 1;
+		ROI se;
+		const int ok = _struct_el_subsampled(se, mis, ss_factor);
+		if (ok) {
+			roi.dilate(se);
+			roi.erode(se);
+		}
 	}
-  }
-  else if ((prim.N() == 1)
-    && !strcmp(prim[0]->type(), "ImageRegion")) {
-	done = 1;
-	ImageRegion* r0 = (ImageRegion*)prim[0];
-
-	if (ok) {
+	else if ((prim.N() == 1)
+	  && !strcmp(prim[0]->type(), "ImageRegion")) {
+		done = 1;
 		ROI rcpy;
-		if (use_subsampled)
-			subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
-		else
-			rcpy.copy(r0->roi());
-
-  //std::cout << std::endl << std::endl << "ORIGINAL" << std::endl;
-  //rcpy.print_all_points();
-		rcpy.dilate(se);
-  //std::cout << std::endl << std::endl << "DILATE" << std::endl;
-  //rcpy.print_all_points();
-		rcpy.erode(se);
-  //std::cout << std::endl << std::endl << "ERODE" << std::endl;
-  //rcpy.print_all_points();
-		if (or_flag())
-			roi.OR(rcpy);
-		else
-			roi.AND(rcpy);
-  //std::cout << std::endl << std::endl << "SEARCH AREA" << std::endl;
-  //roi.print_all_points();
+		if (relation_roi(mis, ss_factor, prim, rcpy, num_threads))
+			_combine(roi, rcpy);
 	}
-  }
-  return done;
+	return done;
+}
+
+
+const int MorphClose::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
+{
+	ROI se;
+	if (!_related_region(mis, ss_factor, prim, se, result))
+		return 0;
+	result.dilate(se);
+	result.erode(se);
+	return 1;
 }
 
 
@@ -1420,48 +1517,34 @@ MorphDilate::~MorphDilate()
 }
 
 
-const int MorphDilate::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int MorphDilate::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
-  int done = 0;
-  ROI se;
-  int ok, use_subsampled = ((ss_factor.x*ss_factor.y*ss_factor.z)>1);
-  if (!use_subsampled)
-	ok = struct_el(se, mis);
-  else {
-	ROI se_temp;
-	ok = struct_el(se_temp, mis);
-	if (ok) {
-		subsample_roi(se_temp, se, ss_factor.x, ss_factor.y, ss_factor.z);
-		ok = !se.empty();
+	int done = 0;
+	if (prim.N() == 0) {
+		done = 1;
+		ROI se;
+		const int ok = _struct_el_subsampled(se, mis, ss_factor);
+		if (ok)
+			roi.dilate(se);
 	}
-  }
-
-  if (prim.N() == 0) {
-	done = 1;
-	if (ok)
-		roi.dilate(se);
-  }
-  else if ((prim.N() == 1)
-    && !strcmp(prim[0]->type(), "ImageRegion")) {
-	done = 1;
-	ImageRegion* r0 = (ImageRegion*)prim[0];
-
-	if (ok) {
+	else if ((prim.N() == 1)
+	  && !strcmp(prim[0]->type(), "ImageRegion")) {
+		done = 1;
 		ROI rcpy;
-		if (use_subsampled)
-			subsample_roi(r0->roi(), rcpy, ss_factor.x, ss_factor.y, ss_factor.z);
-		else
-			rcpy.copy(r0->roi());
-
-		rcpy.dilate(se);
-		if (or_flag())
-			roi.OR(rcpy);
-		else
-			roi.AND(rcpy);
+		if (relation_roi(mis, ss_factor, prim, rcpy, num_threads))
+			_combine(roi, rcpy);
 	}
-  }
-  //roi.print_all_points();
-  return done;
+	return done;
+}
+
+
+const int MorphDilate::relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads)
+{
+	ROI se;
+	if (!_related_region(mis, ss_factor, prim, se, result))
+		return 0;
+	result.dilate(se);
+	return 1;
 }
 
 
@@ -1475,7 +1558,7 @@ Found::~Found()
 {
 }
 
-const int Found::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int Found::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -1499,7 +1582,7 @@ NotPartOf::~NotPartOf()
 {
 }
 
-const int NotPartOf::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int NotPartOf::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -1530,7 +1613,7 @@ PartOf::~PartOf()
 {
 }
 
-const int PartOf::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi)
+const int PartOf::search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads)
 {
   int done = 0;
 
@@ -54,6 +54,7 @@
 #include "ImageRegion.h"
 #include "MedicalImageSequence.h"
 #include "ROIdescription.h"
+#include "SearchAreaCache.h"
 
 //const double PI_DBL = fabs(atan2(0,-1));
 
@@ -83,8 +84,31 @@ public:
 	If the derived type of the image primitive is appropriate the ROI in the referenced argument val is modified and 1 is returned, otherwise 0 is returned and val is not modified.
 	The Darray of image primitives are from related solution elements.
 	The ss_factor indicates the x, y and z subsampling factors to be applied to the output ROI - the image data and the primitives supplied as arguments are NOT subsampled.
+	num_threads is the number of threads the computation may use (e.g. for distance maps).
 	*/
-	virtual const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi) = 0;
+	virtual const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads) = 0;
+
+	/**
+	For search areas that combine the current search area with an ROI derived only from the related primitives (e.g. the dilated related region):
+	sets result (assumed empty) to that ROI and returns 1, so that search_area is equivalent to combining the current search area with it (see _combine).
+	Returns 0 if the search area is not derived this way (the default) or the primitives are not appropriate, in which case result is not modified.
+	*/
+	virtual const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
+
+	/**
+	Returns 1 if relation_roi is implemented, in which case the parameters on which the ROI depends (other than the primitives and subsampling factors) are appended to key.
+	Returns 0 by default.
+	*/
+	virtual const int relation_key(std::string& key) const;
+
+	/**
+	As search_area, but the ROI of relation_roi is looked up in the cache (and stored if not found), keyed by the name of the search area, relation_key, the subsampling factors and the digests of the primitives,
+	and checked against the ROIs of the primitives.
+	Falls back to search_area if there are no primitives, relation_key returns 0 or a primitive is not an ImageRegion.
+	num_threads is passed to search_area and relation_roi (the cached ROI does not depend on it).
+	The hits and misses are counted for solution element solel.
+	*/
+	const int cached_search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads, SearchAreaCache& cache, const int solel);
 
 	/**
 	Write search area attribute to an output stream operator.
@@ -93,6 +117,10 @@ public:
 	*/
 	void write(ostream& s) const;
 
+protected:
+	/// Combines the current search area roi with the ROI of relation_roi: OR if the or flag is set, AND otherwise
+	virtual void _combine(ROI& roi, const ROI& result) const;
+
 private:
 
 	/// OR flag is set to 1 if OR should be used to combine search area (0 by default)
@@ -116,7 +144,7 @@ public:
 	const char* const name() const { return "BetweenX"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 };
 
 
@@ -144,7 +172,7 @@ public:
 	const char* const name() const { return "BoxRelCentroid"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -192,7 +220,7 @@ public:
 	const char* const name() const { return "BoxRelPlanarCentroid"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -235,7 +263,7 @@ public:
 	const char* const name() const { return "BoxRelPlanarYmin"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -279,7 +307,7 @@ public:
 	const char* const name() const { return "BoxRelPlanarYmax"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -322,7 +350,7 @@ public:
 	const char* const name() const { return "BoxRelZmin"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -371,7 +399,7 @@ public:
 	const char* const name() const { return "BoxRelZmax"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -414,7 +442,7 @@ public:
 	const char* const name() const { return "BoxSizeTlProp"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 	/// Length of box in x-direction (mm)
@@ -453,7 +481,7 @@ public:
 	const char* const name() const { return "Clear"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 };
 
 
@@ -476,7 +504,17 @@ public:
 	const char* const name() const { return "ConvexHull"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the convex hull of the related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
+
+	/// Returns 1 (there are no parameters)
+	const int relation_key(std::string& key) const;
+
+protected:
+	/// Always takes the AND
+	void _combine(ROI& roi, const ROI& result) const;
 };
 
 
@@ -498,7 +536,13 @@ public:
 	const char* const name() const { return "DistanceMap2D"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the points of the related primitive whose distance is above the threshold
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
+
+	/// Appends the distance threshold
+	const int relation_key(std::string& key) const;
 
 private:
 
@@ -527,7 +571,7 @@ public:
 	const char* const name() const { return "DistanceMap25DPercMax"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 
@@ -559,7 +603,13 @@ public:
 	const char* const name() const { return "ExpandContractPlanar"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the expanded or contracted related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
+
+	/// Appends the distance
+	const int relation_key(std::string& key) const;
 
 private:
 
@@ -589,7 +639,7 @@ public:
 	const char* const name() const { return "Found"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 
 private:
 	/// Flag indicating whether the related solution element should be matched or not
@@ -613,7 +663,13 @@ public:
 	const char* const name() const { return "Inside2D"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the related primitive with its holes filled in each plane
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
+
+	/// Returns 1 (there are no parameters)
+	const int relation_key(std::string& key) const;
 };
 
 
@@ -633,7 +689,7 @@ public:
 	const char* const name() const { return "NotPartOf"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 };
 
 
@@ -653,7 +709,7 @@ public:
 	const char* const name() const { return "PartOf"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 };
 
 
@@ -672,7 +728,7 @@ public:
 	const char* const name() const { return "PartOfOR"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
 };
 */
 
@@ -697,6 +753,9 @@ public:
 	/// Sets ROI argument to be the structuring element (assumed empty) and returns 1 if ROI description is valid, 0 otherwise
 	const int struct_el(ROI&, const MedicalImageSequence&) const;
 
+	/// Appends the structuring element description
+	const int relation_key(std::string& key) const;
+
 	/**
 	Write search area attribute to an output stream operator.
 	Format of output is as follows.
@@ -704,6 +763,13 @@ public:
 	*/
 	void write(ostream& s) const;
 
+protected:
+	/// As struct_el, subsampled by ss_factor (the subsampled element must not be empty)
+	const int _struct_el_subsampled(ROI& se, const MedicalImageSequence& mis, const Point& ss_factor) const;
+
+	/// Sets se to the structuring element and rcpy to the (subsampled) related region, returns 0 if the primitives are not appropriate or the structuring element is invalid
+	const int _related_region(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& se, ROI& rcpy) const;
+
 private:
 	/// Structuring element
 	ROIdescription _struct_el;
@@ -730,7 +796,10 @@ public:
 	const char* const name() const { return "MorphErode"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the eroded related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
 };
 
 /**
@@ -753,7 +822,10 @@ public:
 	const char* const name() const { return "MorphDilate"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the dilated related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
 };
 
 /**
@@ -773,7 +845,10 @@ public:
 	const char* const name() const { return "MorphOpen"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the opened related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
 };
 
 /**
@@ -794,7 +869,10 @@ public:
 	const char* const name() const { return "MorphClose"; };
 
 	/// Vector must contain one primitive from the related solution element
-	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi);
+	const int search_area(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& roi, const int num_threads);
+
+	/// Sets result to the closed related primitive
+	const int relation_roi(MedicalImageSequence& mis, const Point& ss_factor, const Darray<ImagePrimitive*>& prim, ROI& result, const int num_threads);
 };
 
 #endif // !__SearchArea_h_
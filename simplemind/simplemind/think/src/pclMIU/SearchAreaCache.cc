@@ -0,0 +1,139 @@
+#include "SearchAreaCache.h"
+#include "ROItraverser.h"
+
+SearchAreaCache::SearchAreaCache(const long max_intervals)
+	: _max_intervals(max_intervals), _num_intervals(0), _num_hits(0), _num_misses(0)
+{
+}
+
+SearchAreaCache::~SearchAreaCache()
+{
+}
+
+std::shared_ptr<const ROI> SearchAreaCache::find(const std::string& key, const std::vector<const ROI*>& sources, const int solel)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::map<std::string, Entry>::const_iterator it = _roi.find(key);
+	if ((it==_roi.end()) || !_same_sources(it->second, sources))
+		return std::shared_ptr<const ROI>();
+	_solel_stats[solel].first++;
+	_num_hits++;
+	return it->second.roi;
+}
+
+std::shared_ptr<const ROI> SearchAreaCache::store(const std::string& key, const std::vector<const ROI*>& sources, const ROI& roi, const int solel)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_solel_stats[solel].second++;
+	_num_misses++;
+	std::map<std::string, Entry>::iterator it = _roi.find(key);
+	if (it!=_roi.end()) {
+		if (_same_sources(it->second, sources))
+			return it->second.roi;
+		_num_intervals -= it->second.num_intervals;
+	}
+	else {
+		it = _roi.insert(std::make_pair(key, Entry())).first;
+		_order.push_back(key);
+	}
+	Entry& entry = it->second;
+	entry.roi = std::make_shared<const ROI>(roi);
+	entry.sources.clear();
+	entry.num_intervals = roi.num_intervals();
+	for(size_t i=0; i<sources.size(); i++) {
+		entry.sources.push_back(*sources[i]);
+		entry.num_intervals += sources[i]->num_intervals();
+	}
+	_num_intervals += entry.num_intervals;
+	std::shared_ptr<const ROI> result = entry.roi;
+	_evict(key);
+	return result;
+}
+
+void SearchAreaCache::reset_stats(const int solel)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_solel_stats.erase(solel);
+}
+
+const int SearchAreaCache::stats(const int solel, long& hits, long& misses) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::map<int, std::pair<long, long> >::const_iterator it = _solel_stats.find(solel);
+	if (it==_solel_stats.end())
+		return 0;
+	hits = it->second.first;
+	misses = it->second.second;
+	return 1;
+}
+
+const long SearchAreaCache::num_hits() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _num_hits;
+}
+
+const long SearchAreaCache::num_misses() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _num_misses;
+}
+
+const int SearchAreaCache::num_entries() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_roi.size();
+}
+
+void SearchAreaCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_roi.clear();
+	_order.clear();
+	_num_intervals = 0;
+	_solel_stats.clear();
+	_num_hits = _num_misses = 0;
+}
+
+const int SearchAreaCache::_same_sources(const Entry& entry, const std::vector<const ROI*>& sources)
+{
+	if (entry.sources.size()!=sources.size())
+		return 0;
+	for(size_t i=0; i<sources.size(); i++)
+		if (!_same_points(entry.sources[i], *sources[i]))
+			return 0;
+	return 1;
+}
+
+const int SearchAreaCache::_same_points(const ROI& a, const ROI& b)
+{
+	if (a.num_intervals()!=b.num_intervals())
+		return 0;
+	ROItraverser ta(a), tb(b);
+	Point a1, a2, b1, b2;
+	TravStatus sa = ta.valid(), sb = tb.valid();
+	while((sa<END_ROI) && (sb<END_ROI)) {
+		ta.current_interval(a1, a2);
+		tb.current_interval(b1, b2);
+		if ((a1.x!=b1.x) || (a2.x!=b2.x) || (a1.y!=b1.y) || (a1.z!=b1.z))
+			return 0;
+		sa = ta.next_interval();
+		sb = tb.next_interval();
+	}
+	return (sa<END_ROI)==(sb<END_ROI);
+}
+
+void SearchAreaCache::_evict(const std::string& key)
+{
+	while((_num_intervals>_max_intervals) && (_order.size()>1)) {
+		const std::string oldest = _order.front();
+		_order.pop_front();
+		if (oldest==key) {
+			_order.push_back(oldest);
+			continue;
+		}
+		std::map<std::string, Entry>::iterator it = _roi.find(oldest);
+		_num_intervals -= it->second.num_intervals;
+		_roi.erase(it);
+	}
+}
@@ -0,0 +1,107 @@
+#ifndef __SearchAreaCache_h_
+#define __SearchAreaCache_h_
+
+#include "ROI.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+Stores the ROIs that search areas derive from related primitives (see SearchArea::relation_roi), so that solution elements applying the same relation
+with the same parameters to the same primitives (e.g., MorphDilate with the same structuring element of the same node) compute it once per case.
+Keys are built by SearchArea::cached_search_area from the name of the search area, its parameters, the subsampling factors and the digests of the primitives (see ImageRegion::digest).
+A copy of the ROIs of the primitives is stored with each entry and compared on lookup, so a digest collision is a miss rather than the ROI of other primitives,
+and stored ROIs remain valid when a primitive is replaced by one with the same points.
+The cache belongs to the blackboard of a case. It holds at most max_intervals intervals (stored and source ROIs), beyond which the oldest entries are removed.
+The number of hits and misses is kept for each solution element and for the whole cache.
+Methods may be called concurrently (solution elements segmented in parallel share the cache of the blackboard).
+*/
+class SearchAreaCache {
+public:
+	/// Default maximum number of intervals of the stored ROIs (about 64 MB)
+	static const long DefaultMaxIntervals = 1L<<22;
+
+	/// Constructor
+	SearchAreaCache(const long max_intervals=DefaultMaxIntervals);
+
+	/// Destructor
+	~SearchAreaCache();
+
+	/**
+	Returns the ROI stored with the key and derived from ROIs with the same points as sources, counting a hit for solution element solel.
+	Returns 0 if no such ROI is stored.
+	The returned ROI remains valid while it is referenced, even if it is removed from the cache.
+	*/
+	std::shared_ptr<const ROI> find(const std::string& key, const std::vector<const ROI*>& sources, const int solel);
+
+	/**
+	Stores a copy of roi, derived from sources, with the key, counting a miss for solution element solel, and returns the stored ROI.
+	If an ROI derived from the same sources is already stored with the key (computed concurrently) it is kept and returned.
+	An entry with the key and other sources (a digest collision) is replaced.
+	*/
+	std::shared_ptr<const ROI> store(const std::string& key, const std::vector<const ROI*>& sources, const ROI& roi, const int solel);
+
+	/// Resets the hits and misses of solution element solel (called before its search area is computed)
+	void reset_stats(const int solel);
+
+	/// Sets the hits and misses of solution element solel since reset_stats and returns 1, returns 0 if nothing was looked up for it
+	const int stats(const int solel, long& hits, long& misses) const;
+
+	/// Total number of hits
+	const long num_hits() const;
+
+	/// Total number of misses
+	const long num_misses() const;
+
+	/// Number of stored ROIs
+	const int num_entries() const;
+
+	/// Removes the stored ROIs and resets the counts
+	void clear();
+
+private:
+	/// Stored ROI and copies of the ROIs it was derived from
+	struct Entry {
+		std::shared_ptr<const ROI> roi;
+		std::vector<ROI> sources;
+		long num_intervals;
+	};
+
+	/// Returns 1 if the entry was derived from ROIs with the same points as sources
+	static const int _same_sources(const Entry& entry, const std::vector<const ROI*>& sources);
+
+	/// Returns 1 if the ROIs have the same intervals
+	static const int _same_points(const ROI& a, const ROI& b);
+
+	/// Removes the oldest entries, other than key, while more than _max_intervals intervals are stored
+	void _evict(const std::string& key);
+
+	/// Stored ROIs
+	std::map<std::string, Entry> _roi;
+
+	/// Keys in the order they were stored
+	std::deque<std::string> _order;
+
+	/// Maximum number of stored intervals
+	long _max_intervals;
+
+	/// Number of stored intervals
+	long _num_intervals;
+
+	/// Hits and misses of each solution element
+	std::map<int, std::pair<long, long> > _solel_stats;
+
+	/// Total number of hits
+	long _num_hits;
+
+	/// Total number of misses
+	long _num_misses;
+
+	/// Guards all members
+	mutable std::mutex _mutex;
+};
+
+#endif // !__SearchAreaCache_h_
@@ -658,13 +658,13 @@ void NeuralNetKeras::_update_augmentation_ini_param() {
 	set_parameter("model_info", "augmentation", instr);
 }
 
-PlatenessThreshRegGrow::PlatenessThreshRegGrow(const float low, const float high)
-	: SegParam(), _low(low), _high(high)
+PlatenessThreshRegGrow::PlatenessThreshRegGrow(const float low, const float high, const bool in_process)
+	: SegParam(), _low(low), _high(high), _in_process(in_process)
 {
 }
 
 PlatenessThreshRegGrow::PlatenessThreshRegGrow(const PlatenessThreshRegGrow& tr)
-	: SegParam(tr), _low(tr._low), _high(tr._high)
+	: SegParam(tr), _low(tr._low), _high(tr._high), _in_process(tr._in_process)
 {
 }
 
@@ -683,6 +683,11 @@ const float PlatenessThreshRegGrow::high() const
 	return _high;
 }
 
+const bool PlatenessThreshRegGrow::in_process() const
+{
+	return _in_process;
+}
+
 void PlatenessThreshRegGrow::write(ostream& s) const
 {
 	_write_start_attribute(s);
@@ -590,7 +590,7 @@ private:
 class PlatenessThreshRegGrow : public SegParam {
 public:
 	/// Constructor
-	PlatenessThreshRegGrow(const float low, const float high);
+	PlatenessThreshRegGrow(const float low, const float high, const bool in_process=false);
 
 	/// Copy constructor
 	PlatenessThreshRegGrow(const PlatenessThreshRegGrow&);
@@ -607,6 +607,9 @@ public:
 	/// High value for thresholding
 	const float high() const;
 
+	/// Whether the plateness is computed in-process when the raw plateness files are not in the ROI directory
+	const bool in_process() const;
+
 	/**
 	Write segmentation parameter to an output stream operator.
 	Format of output is as follows.
@@ -621,6 +624,9 @@ private:
 
 	/// High value for thresholding
 	float _high;
+
+	/// Plateness computed in-process if the raw files are missing
+	bool _in_process;
 };
 
 /// Use same candidates as another solution element or multiple elements
@@ -1,6 +1,17 @@
 #include "SegmentationKS.h"
+#include "CnnPredictWorker.h"
+#include "KSprofiler.h"
+#include "ROIfile.h"
+#include "IntensityVolume.h"
+#include "DistanceMap.h"
+#include "HessianMap.h"
 #include <sys/stat.h>
 #include <boost/filesystem.hpp>
+#include <pcl/image.h>
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/filter2/image/EuclideanDistanceTransformFilter.h>
+#include <pcl/filter2/image/ImageGaussianFilter.h>
+#include <pcl/filter2/image/PriorityFloodWatershed.h>
 
 #define MIN2(A, B) (((A) < (B)) ? (A) : (B))
 #define MIN3(A, B, C) MIN2(MIN2(A, B), C)
@@ -18,6 +29,12 @@ void SegmentationR(Blackboard& bb)
 	char mess[100];
 	sprintf(mess, "Solution element index: %d", bb.next_solel());
 	bb.add_message_to_last_act_rec(mess);
+
+	long hits, misses;
+	if (bb.search_area_cache().stats(bb.next_solel(), hits, misses)) {
+		sprintf(mess, "Search area cache: %ld hits, %ld misses (hit rate %.1f%%)", hits, misses, 100.0*hits/(hits+misses));
+		bb.add_message_to_last_act_rec(mess);
+	}
 }
 
 
@@ -38,6 +55,8 @@ void compute_segmentation_parameters(ROI& search_area, int& use_subsampled, Poin
 
 	int i, j;
 
+	bb.search_area_cache().reset_stats(bb.next_solel());
+
 	use_subsampled = 0;
 	ss_factor.x = ss_factor.y = ss_factor.z = 1;
 	for(i=0; (i<se.num_attributes() && !use_subsampled); i++) {
@@ -76,7 +95,7 @@ void compute_segmentation_parameters(ROI& search_area, int& use_subsampled, Poin
 			}
 			cout << ".... " << flush;
 
-			((SearchArea*)a)->search_area(bb.med_im_seq(), ss_factor, prim, search_area);
+			((SearchArea*)a)->cached_search_area(bb.med_im_seq(), ss_factor, prim, search_area, bb.activation_threads(), bb.search_area_cache(), bb.next_solel());
 			cout << "done" << endl;
 		    }
 		    else if (a->e_flag()) {
@@ -168,6 +187,36 @@ void compute_segmentation_parameters(ROI& search_area, int& use_subsampled, Poin
 }
 
 
+/*
+Splits r into the regions from which candidates are formed and returns them as an array of n ROIs (to be deleted by the caller with delete []).
+If include_all_vox is set the regions are the slices of r (segment_2d) or r itself, otherwise they are the components of r, 8-connected within slices (segment_2d) or 26-connected in 3-D.
+The components are labelled in a single pass and those with fewer than min_num_vox points are dropped.
+*/
+ROI* form_candidate_regions(const ROI& r, const int segment_2d, const int include_all_vox, const int min_num_vox, int& n)
+{
+	if (include_all_vox && segment_2d) {
+		Point tl, br;
+		n = 0;
+		if (!r.bounding_cube(tl, br))
+			return new ROI [0];
+		ROI* blob = new ROI [br.z-tl.z+1];
+		for(int z=tl.z; z<=br.z; z++)
+			if (r.num_pix(z))
+				blob[n++].copy(r, z);
+		return blob;
+	}
+	if (include_all_vox) {
+		n = !r.empty();
+		ROI* blob = new ROI [n];
+		if (n)
+			blob[0].copy(r);
+		return blob;
+	}
+	std::vector<int> num_vox;
+	return r.connected_components(n, num_vox, segment_2d ? 8 : 26, min_num_vox);
+}
+
+
 float AddMatchedCandidatesS(Blackboard& bb)
 {
     float score=0.0;
@@ -355,11 +404,12 @@ void getMaxDist(float* edm, ROItraverser& rt, float& max, Point& max_pt, const i
 
 char* createBinaryMask(ROItraverser& sat, const int imSize, const int xdim, const int ydim) {
 	char* binaryMaskSA = new char [imSize];
+	memset(binaryMaskSA, 0, imSize);
 	TravStatus sas = sat.reset();
 	Point sap1, sap2;
 	while(sas<END_ROI) {
 		sat.current_interval(sap1, sap2);
-		int j = sap1.z*xdim*ydim + sap1.y*ydim + sap1.x;
+		int j = sap1.z*xdim*ydim + sap1.y*xdim + sap1.x;
 		for(; sap1.x<=sap2.x; sap1.x++) {
 			// Set voxel in char image
 			binaryMaskSA[j] = (char) 1;
@@ -371,6 +421,62 @@ char* createBinaryMask(ROItraverser& sat, const int imSize, const int xdim, cons
 }
 
 
+typedef pcl::Image<int> EDMlabelImage;
+
+/*
+Computes the watershed regions of a distance map from mask_distance_map.
+Replaces the -w and -smooth options of MyDistanceTransform.exe: the distance map is smoothed with a Gaussian of standard deviation smoothing (mm),
+and each local maximum of the smoothed map forms one region (26-connected) within the mask.
+The smoothed distance map is returned in smoothed_edm.
+Labels start at 1, voxels outside the mask are 0.
+The smoothing and the flood use num_threads threads; the flood is split into slabs of a fixed number of slices, so the regions do not depend on num_threads.
+*/
+EDMlabelImage::Pointer computeEDMwatershed(const EDMmaskImage::Pointer& mask, const EDMimage::Pointer& edm, const float smoothing, EDMimage::Pointer& smoothed_edm, const int num_threads) {
+	typedef pcl::filter2::ZeroFluxBoundary<EDMimage> BoundaryType;
+	// Do not smooth across slices if the mask is a single slice
+	float smoothing_z = (mask->getSize().z()>1) ? smoothing : 0;
+	smoothed_edm = pcl::filter2::ImageGaussianFilter<BoundaryType, EDMimage>::Compute(BoundaryType(edm), smoothing, smoothing, smoothing_z, true, pcl::Region3D<int>().reset(), num_threads);
+
+	// The watershed flows to minima, so the smoothed distance map is negated
+	EDMimage::Pointer inverted = EDMimage::New(smoothed_edm);
+	const pcl::Point3D<int>& sz = smoothed_edm->getSize();
+	long n = (long)sz.x()*sz.y()*sz.z();
+	for(long i=0; i<n; i++) inverted->set(i, -smoothed_edm->get(i));
+
+	pcl::iterator::ImageNeighborIterator::OffsetListPointer offsets = pcl::iterator::ImageNeighborIterator::CreateConnect26Offset();
+	pcl::iterator::ImageNeighborIterator::FilterOffsetList(offsets, sz);
+	pcl::filter2::PriorityFloodWatershed<EDMimage, EDMlabelImage, EDMmaskImage> watershed;
+	watershed.setInput(inverted);
+	watershed.setMask(mask);
+	watershed.setNeighborhood(offsets);
+	watershed.setNumberOfLevels(4096);
+	watershed.setSlabThickness(32);
+	watershed.setNumberOfThreads(num_threads);
+	watershed.update();
+	return watershed.getOutput();
+}
+
+/*
+Computes the Euclidean distance map (in mm) of the ROI in-process.
+Returns an array of size xdim*ydim*zdim in raster order (same layout as the MyDistanceTransform.exe output), which the caller must delete.
+*/
+float* computeEDM(const ROI& roi, const int xdim, const int ydim, const int zdim, const float xsize, const float ysize, const float zsize, const int num_threads) {
+	long imSize = (long)xdim*ydim*zdim;
+	float* edm = new float [imSize];
+	memset(edm, 0, imSize*sizeof(float));
+	EDMimage::Pointer edm_image = roi_distance_map(roi, xdim, ydim, zdim, xsize, ysize, zsize, false, false, num_threads);
+	if (edm_image) copy_to_raster_array(edm_image, edm, xdim, ydim, zdim);
+	return edm;
+}
+
+/// Writes nbytes of data to a raw binary file.
+void writeRawFile(const char* const fn, const void* const data, const long nbytes) {
+	ofstream outfile (fn,ofstream::binary);
+	outfile.write((const char*)data,nbytes);
+	outfile.close();
+}
+
+
 void dmRegGrow(float* edm, Point& max_pt, float max, float perc, int xdim, int ydim, int zdim, float xsize, float ysize, float zsize, ROI& search_area, ROI& lresult) {
 	// Compute distance threshold
 	float thresh_low;
@@ -525,6 +631,7 @@ void GrowPartSolidA(Blackboard& bb)
 				HU_to_GL(mhu/2 - 500, adaptiveThresholdGL, medseq);
 
 				ccRT.reinitialize(comp);
+				const IntensityVolume& vol = medseq.hu_volume();
 				register Point p;
 				register short gl;
 				register TravStatus s = ccRT.reset();
@@ -535,8 +642,9 @@ void GrowPartSolidA(Blackboard& bb)
 				while(s<END_ROI) {
 					ccRT.current_interval(p1, p2);
 					x1 = p2.x+1;
+					const short* gl_row = vol.gl_row(p1.y, p1.z);
 					for(; p1.x<=p2.x; p1.x++) {
-						gl = medseq.fast_pix_val(p1.x, p1.y, p1.z);
+						gl = gl_row[p1.x];
 						if (gl>=adaptiveThresholdGL) {
 							if (x1>p2.x) x1=p1.x;
 						}
@@ -604,7 +712,14 @@ void GrowPartSolidA(Blackboard& bb)
 				cout << "edmInputMaskFileName = " << edmInputMaskFileName << endl;
 			}
 
-			if (!exists) { // Need to recompute EDM files	
+			float* edm2 = 0;
+			if (!exists && !bb.external_edm()) { // Compute EDM in-process
+				writeRawFile(edmInputMaskFileName, binaryMaskSA, imSize);
+				edm2 = computeEDM(partSolidROI, xdim, ydim, zdim, xsize, ysize, zsize, bb.num_threads());
+				writeRawFile(edmOutputFileName, edm2, imSize*sizeof(float));
+				cout << "Distance transform computed in-process (" << bb.num_threads() << " threads)" << endl;
+			}
+			else if (!exists) { // Need to recompute EDM files with MyDistanceTransform.exe
 	
 				ofstream outfileBinaryMaskSA (edmInputMaskFileName,ofstream::binary);
 				outfileBinaryMaskSA.write(binaryMaskSA,imSize);
@@ -634,12 +749,14 @@ void GrowPartSolidA(Blackboard& bb)
 					sprintf (command, "Q:\\nodule_detection\\Executables\\MyDistanceTransform.exe %s %s -s %d %d %d -v %f %f %f", edmInputMaskFileName, edmOutputFileName, xdim, ydim, zdim, xsize, ysize, zsize);
 				}
 
-				int retVal = system(command);
+				int retVal = KSprofiler::system(command);
 				cout << command << endl << "MyDistanceTransform completed with return value = " << retVal << endl;
 			}	
 
-			float* edm2;
-			if (bb.edm_directory().length()==0) {
+			if (edm2) {
+				// Already computed in-process
+			}
+			else if (bb.edm_directory().length()==0) {
 				edm2 = readEDM(imSize, 'p', 's', bb);
 				//edm2 = readEDM(medseq.series_instance_uid(), imSize, 'p', 's', bb);
 			}
@@ -667,6 +784,7 @@ void GrowPartSolidA(Blackboard& bb)
 			delete [] edmInputMaskFileName;
 			delete [] edmOutputFileName;
 			delete [] edm2;	
+			delete [] originalEDM;
 		}
 	}
 	cout << "done" << endl;
@@ -701,6 +819,9 @@ float PlatenessThreshRegGrowS(Blackboard& bb)
 }
 
 
+/// Scale (mm) of the plateness computed in-process by PlatenessThreshRegGrowA (PlatenessRegionGrowing_InProcess) when the plateness raw files are not in the ROI directory
+static const float PLATENESS_SIGMA_MM = 1.0;
+
 void PlatenessThreshRegGrowA(Blackboard& bb)
 {
 	SolElement& se = bb.sol_element(bb.next_solel());
@@ -730,39 +851,58 @@ void PlatenessThreshRegGrowA(Blackboard& bb)
 		float ysize = medseq.column_pixel_spacing(0);
 		float zsize = fabs(medseq.slice_location(1)-medseq.slice_location(0));
 			
-		// Read the axial plateness raw image file
-		if (bb.roi_directory().length()==0) {
-			cerr << "ERROR: PlatenessThreshRegGrowA: no ROI directory specified for the raw plateness image file" << endl;
+		// Read the plateness raw image files (axial, coronal and sagittal) if they are in the ROI directory, otherwise use the plateness computed in-process if the model allows it
+		float* pltns = 0;
+		const float* pltns_values = 0;
+		const char* const pltnsPlanes[3] = {"axial", "coronal", "sagittal"};
+		int pltnsFilesFound = (bb.roi_directory().length()>0);
+		int i;
+		for(i=0; pltnsFilesFound && (i<3); i++) {
+			char pltnsFileName[500];
+			sprintf(pltnsFileName, "%s/plateness_%s.raw", bb.roi_directory().c_str(), pltnsPlanes[i]);
+			pltnsFilesFound = boost::filesystem::exists(pltnsFileName);
+		}
+		if (pltnsFilesFound) {
+			pltns = new float [imSize];
+			char* pltnsFileName = new char [500];
+			sprintf(pltnsFileName, "%s/plateness_axial.raw", bb.roi_directory().c_str());
+			//sprintf(pltnsFileName, "%s\\plateness_axial.raw", bb.roi_directory().c_str());
+			ifstream pltnsFile (pltnsFileName,ifstream::binary);
+			pltnsFile.read ((char*)pltns,imSize*sizeof(float));
+			pltnsFile.close();
+
+			sprintf(pltnsFileName, "%s/plateness_coronal.raw", bb.roi_directory().c_str());	
+			//sprintf(pltnsFileName, "%s\\plateness_coronal.raw", bb.roi_directory().c_str());
+			float* pltns_add = new float [imSize];
+			pltnsFile.open (pltnsFileName,ifstream::binary);
+			pltnsFile.read ((char*)pltns_add,imSize*sizeof(float));
+			pltnsFile.close();
+			for(i=0; i<imSize; i++) pltns[i] += pltns_add[i];
+
+			sprintf(pltnsFileName, "%s/plateness_sagittal.raw", bb.roi_directory().c_str());
+			//sprintf(pltnsFileName, "%s\\plateness_sagittal.raw", bb.roi_directory().c_str());	
+			pltnsFile.open (pltnsFileName,ifstream::binary);
+			pltnsFile.read ((char*)pltns_add,imSize*sizeof(float));
+			pltnsFile.close();
+			for(i=0; i<imSize; i++) pltns[i] += pltns_add[i];
+			delete [] pltns_add;
+			delete [] pltnsFileName;
+			pltns_values = pltns;
+		}
+		else if (pla->in_process()) {
+			// Sum of the 2D plateness of the three planes, with the range of the raw files but not their values
+			// Computed once per image sequence and shared by the solution elements (on a single thread if this one is segmented in parallel with others)
+			cerr << "WARNING: PlatenessThreshRegGrowA: plateness raw files not found in the ROI directory, the plateness of " << se.name() << " is computed in-process (" << PLATENESS_SIGMA_MM << " mm scale)" << endl;
+			pltns_values = medseq.plane_plateness(PLATENESS_SIGMA_MM, bb.activation_threads());
+		}
+		else {
+			cerr << "ERROR: PlatenessThreshRegGrowA: plateness_axial.raw, plateness_coronal.raw and plateness_sagittal.raw are not in the ROI directory (use PlatenessRegionGrowing_InProcess to compute the plateness in-process)" << endl;
 			exit(1);
 		}
-		char* pltnsFileName = new char [500];
-		sprintf(pltnsFileName, "%s/plateness_axial.raw", bb.roi_directory().c_str());
-		//sprintf(pltnsFileName, "%s\\plateness_axial.raw", bb.roi_directory().c_str());
-		float* pltns = new float [imSize];
-		ifstream pltnsFile (pltnsFileName,ifstream::binary);
-		pltnsFile.read ((char*)pltns,imSize*sizeof(float));
-		pltnsFile.close();
-
-		sprintf(pltnsFileName, "%s/plateness_coronal.raw", bb.roi_directory().c_str());	
-		//sprintf(pltnsFileName, "%s\\plateness_coronal.raw", bb.roi_directory().c_str());
-		float* pltns_add = new float [imSize];
-		pltnsFile.open (pltnsFileName,ifstream::binary);
-		pltnsFile.read ((char*)pltns_add,imSize*sizeof(float));
-		pltnsFile.close();
-		int i;
-		for(i=0; i<imSize; i++) pltns[i] += pltns_add[i];
-
-		sprintf(pltnsFileName, "%s/plateness_sagittal.raw", bb.roi_directory().c_str());
-		//sprintf(pltnsFileName, "%s\\plateness_sagittal.raw", bb.roi_directory().c_str());	
-		pltnsFile.open (pltnsFileName,ifstream::binary);
-		pltnsFile.read ((char*)pltns_add,imSize*sizeof(float));
-		pltnsFile.close();
-		for(i=0; i<imSize; i++) pltns[i] += pltns_add[i];
-		delete [] pltns_add;
 
 		float pmax = 0;
 		for(i=0; i<imSize; i++)
-			if (pltns[i] > pmax) pmax = pltns[i];
+			if (pltns_values[i] > pmax) pmax = pltns_values[i];
 		//cout << "pmax=" << pmax << endl;
 
 		register Point p;
@@ -789,7 +929,7 @@ void PlatenessThreshRegGrowA(Blackboard& bb)
 			x1 = p2.x+1;
 			int i = p1.z*xySize + p1.y*xdim;
 			for(; p1.x<=p2.x; p1.x++) {
-				if ((pltns[i]>=low) && (pltns[i]<=high)) {
+				if ((pltns_values[i]>=low) && (pltns_values[i]<=high)) {
 					if (x1>p2.x)
 						x1=p1.x;
 				}
@@ -810,35 +950,17 @@ void PlatenessThreshRegGrowA(Blackboard& bb)
 
 		cout << "Forming candidates....." << endl;
 		// Form candidates
-		while (!thresh_res.empty()) {
-			Point start;
-			thresh_res.first_point(start);
-
-			ROI blob;
-			if (include_all_vox && segment_2d) {
-				blob.copy(thresh_res, start.z);
-				thresh_res.clear(start.z);
-			}
-			else if (include_all_vox) {
-				blob.copy(thresh_res);
-				thresh_res.clear();
-			}
-			else if (segment_2d) {
-				blob.add_contig(thresh_res, start, 1);
-				//thresh_res.subtract(blob);
-			}
-			else {
-				blob.add_contig_3d(thresh_res, start, 1);
-				//thresh_res.subtract(blob);
-			}
-
+		int num_blobs, b;
+		ROI* blob = form_candidate_regions(thresh_res, segment_2d, include_all_vox, min_num_vox, num_blobs);
+		for(b=0; b<num_blobs; b++) {
 			// min_num_vox is already scaled to account for subsampling
-			if (!min_num_vox || blob.num_pix_grequal(min_num_vox)) {
-				ImageRegion *ir = new ImageRegion (blob, bb.med_im_seq());
+			if (!min_num_vox || blob[b].num_pix_grequal(min_num_vox)) {
+				ImageRegion *ir = new ImageRegion (blob[b], bb.med_im_seq());
 				se.add_candidate(ir);
 				if (se.num_candidates()%100000==0) cout << "Number of candidates generated = " << se.num_candidates() << endl;
 			}
 		}
+		delete [] blob;
 		delete [] pltns;	
 	}
 	cout << "done" << endl;
@@ -1097,7 +1219,38 @@ void DistanceMapWatershedA(Blackboard& bb)
 				bb.add_message_to_last_act_rec(s2);
 			}
 
-			if (!exists) { // Need to recompute EDM files		
+			int* wsSeg = 0;
+			if (!exists && !bb.external_edm()) { // Compute EDM and watershed in-process
+				writeRawFile(edmInputMaskFileName, binaryMaskSA, imSize);
+
+				// Cannot apply too much smoothing otherwise lesion on slice #56 of LIDC 0002 is merged in with the mediastinum
+				float smoothing_parameter = recon_interval;
+				float* edm = new float [imSize];
+				float* edmSmoothed = new float [imSize];
+				wsSeg = new int [imSize];
+				memset(edm, 0, imSize*sizeof(float));
+				memset(edmSmoothed, 0, imSize*sizeof(float));
+				memset(wsSeg, 0, imSize*sizeof(int));
+
+				EDMmaskImage::Pointer edmMask = roi_mask_image(rel_region, xdim, ydim, zdim, medseq.row_pixel_spacing(0), medseq.column_pixel_spacing(0), recon_interval);
+				if (edmMask) {
+					EDMimage::Pointer edmImage = mask_distance_map(edmMask, false, bb.num_threads());
+					EDMimage::Pointer edmSmoothedImage;
+					EDMlabelImage::Pointer wsImage = computeEDMwatershed(edmMask, edmImage, smoothing_parameter, edmSmoothedImage, bb.num_threads());
+					copy_to_raster_array(edmImage, edm, xdim, ydim, zdim);
+					copy_to_raster_array(edmSmoothedImage, edmSmoothed, xdim, ydim, zdim);
+					copy_to_raster_array(wsImage, wsSeg, xdim, ydim, zdim);
+				}
+
+				// Written for later reads by readEDM and readEDM_DMWS, and for reuse from the EDM directory
+				writeRawFile(edmOutputFileName, edm, imSize*sizeof(float));
+				writeRawFile(edmSmoothedOutputFileName, edmSmoothed, imSize*sizeof(float));
+				writeRawFile(watershedOutputFileName, wsSeg, imSize*sizeof(int));
+				cout << "Distance transform and watershed computed in-process (" << bb.num_threads() << " threads)" << endl;
+				delete [] edm;
+				delete [] edmSmoothed;
+			}
+			else if (!exists) { // Need to recompute EDM files with MyDistanceTransform.exe
 				ofstream outfileBinaryMaskSA (edmInputMaskFileName,ofstream::binary);
 				outfileBinaryMaskSA.write(binaryMaskSA,imSize);
 				outfileBinaryMaskSA.close();
@@ -1138,17 +1291,19 @@ void DistanceMapWatershedA(Blackboard& bb)
 				}
 
 				// sprintf (command, "/bin/%s %s/MyDistanceTransform.exe %s %s -w %s -s %d %d %d -v %f %f %f -smooth %f -save_smooth %s;", wine, full_path.c_str(), edmInputMaskFileName, edmOutputFileName, watershedOutputFileName, xdim, ydim, zdim, medseq.row_pixel_spacing(0), medseq.column_pixel_spacing(0), recon_interval, smoothing_parameter, edmSmoothedOutputFileName);
-				int retVal = system(command);
+				int retVal = KSprofiler::system(command);
 				cout << command << endl << "MyDistanceTransform completed with return value = " << retVal << endl;
 				// retVal = system(NULL);
 				// cout << command << endl << "NULL completed with return value = " << retVal << endl;
 			}
 			
-			// Read the watershed segmentation result
-			int* wsSeg = new int [imSize];
-			ifstream wsResultFile (watershedOutputFileName,ifstream::binary);
-			wsResultFile.read ((char*)wsSeg,imSize*sizeof(int));
-			wsResultFile.close();			
+			if (!wsSeg) {
+				// Read the watershed segmentation result
+				wsSeg = new int [imSize];
+				ifstream wsResultFile (watershedOutputFileName,ifstream::binary);
+				wsResultFile.read ((char*)wsSeg,imSize*sizeof(int));
+				wsResultFile.close();			
+			}
 
 			// Within the search area form candidates from each of the watershed ROIs
 			Point fp, lp, lpl;
@@ -1163,7 +1318,7 @@ void DistanceMapWatershedA(Blackboard& bb)
 				Point nzmp1, nzmp2;
 				while((sacs<END_ROI) && !wsMaskVal) {
 					sact.current_interval(nzmp1, nzmp2);
-					int j = nzmp1.z*xdim*ydim + nzmp1.y*ydim + nzmp1.x;
+					int j = nzmp1.z*xdim*ydim + nzmp1.y*xdim + nzmp1.x;
 					int inReg = 0;
 					int x1=0, x2=0;
 					for(; (nzmp1.x<=nzmp2.x) && !wsMaskVal; nzmp1.x++) {
@@ -1179,7 +1334,7 @@ void DistanceMapWatershedA(Blackboard& bb)
 				int lastZ = nzmp1.z;
 				while(sacs<END_ROI) {
 					sact.current_interval(sacp1, sacp2);
-					int j = sacp1.z*xdim*ydim + sacp1.y*ydim + sacp1.x;
+					int j = sacp1.z*xdim*ydim + sacp1.y*xdim + sacp1.x;
 					int inReg = 0;
 					int x1=0, x2=0;
 					for(; sacp1.x<=sacp2.x; sacp1.x++) {
@@ -1268,6 +1423,7 @@ void DistanceMap2DPercLocal3DMaxA(Blackboard& bb)
 
 	if (!stop) {
 		MedicalImageSequence& medseq = bb.med_im_seq();
+		const IntensityVolume& vol = medseq.hu_volume();
 		const DistanceMap25DPercMax* const dma = (DistanceMap25DPercMax*) se.find_attribute("DistanceMap25DPercMax");
 
 		// If the local maximum is below this threshold no candidate is formed (this stops candidates being formed that are only a couple of voxels thick at their widest from noise).
@@ -1342,7 +1498,7 @@ void DistanceMap2DPercLocal3DMaxA(Blackboard& bb)
 					for(i=fp.z; i<=lpl.z; i++) {
 						if (!edms[i]) {
 							//cout << "edm for z=" << i << endl;
-							edms[i] = distance_map_2d(search_area, i, medseq);
+							edms[i] = distance_map_2d(search_area, i, medseq, bb.activation_threads());
 						}
 					}
 
@@ -1360,7 +1516,7 @@ void DistanceMap2DPercLocal3DMaxA(Blackboard& bb)
 							if (edms[p1.z][j]>=max) {
 								max=edms[p1.z][j];
 								max_pt = p1;
-								GL_to_HU(medseq.fast_pix_val(max_pt.x, max_pt.y, max_pt.z), gl_at_max, medseq);
+								gl_at_max = vol.hu(max_pt.x, max_pt.y, max_pt.z);
 							}
 							++j;
 						}
@@ -1413,7 +1569,7 @@ void DistanceMap2DPercLocal3DMaxA(Blackboard& bb)
 						int too_big=0;
 						while(to_check.pop_first_interval(xi1, xi2, yi, zi) && !too_big) {
 							j=yi*xdim+xi1;
-							const short *pix_data = medseq.pixel_data(zi);
+							const short *hu_data = vol.hu_plane(zi);
 
 							while (xi1<=xi2) {
 								while (((edms_copy[zi][j]<thresh)) && (xi1<=xi2)) {
@@ -1426,14 +1582,13 @@ void DistanceMap2DPercLocal3DMaxA(Blackboard& bb)
 									xi12 = xi1+1;
 									j++;
 
-									int hu_value;
-									GL_to_HU(pix_data[j], hu_value, medseq);
+									int hu_value = hu_data[j];
 									while ((edms_copy[zi][j]>=thresh) && (abs(hu_value-gl_at_max)<=hu_diff_threshold) && (xi12<=xi2)) {
 										edms_copy[zi][j]=0;
 
 										xi12++;
 										j++;
-										GL_to_HU(pix_data[j], hu_value, medseq);
+										hu_value = hu_data[j];
 									}
 
 									lresult.add_interval(xi1, xi12-1, yi, zi);
@@ -1565,46 +1720,26 @@ void FormCandsFromSearchAreaA(Blackboard& bb)
   //search_area.print_all_points();
 
 		// Form candidates
-		while (!search_area.empty()) {
-			Point start;
-			search_area.first_point(start);
-
-			ROI blob;
-			if (include_all_vox && segment_2d) {
-				blob.copy(search_area, start.z);
-				search_area.clear(start.z);
-			}
-			else if (include_all_vox) {
-				blob.copy(search_area);
-				search_area.clear();
-			}
-			else if (segment_2d) {
-				blob.add_contig(search_area, start, 1);
-			}
-			else {
-				blob.add_contig_3d(search_area, start, 1);
-//std::cout << std::endl << std::endl << "BLOB" << std::endl;
-//blob.print_all_points();
-//std::cout << std::endl << std::endl << "SEARCH AREA" << std::endl;
-//search_area.print_all_points();
-			}
-
+		int num_blobs, b;
+		ROI* blob = form_candidate_regions(search_area, segment_2d, include_all_vox, min_num_vox, num_blobs);
+		for(b=0; b<num_blobs; b++) {
 			// min_num_vox is already scaled to account for subsampling
-			if (!min_num_vox || blob.num_pix_grequal(min_num_vox)) {
+			if (!min_num_vox || blob[b].num_pix_grequal(min_num_vox)) {
 				ImageRegion *ir;
 				if (use_subsampled) {
 					ROI expanded_blob;
-					expand_roi(blob, expanded_blob, ss_factor.x, ss_factor.y, ss_factor.z, bb.overall_search_area());
+					expand_roi(blob[b], expanded_blob, ss_factor.x, ss_factor.y, ss_factor.z, bb.overall_search_area());
 		 			ir = new ImageRegion (expanded_blob, bb.med_im_seq());
 				}
 				else {
-		 			ir = new ImageRegion (blob, medseq);
+		 			ir = new ImageRegion (blob[b], medseq);
 		 		}
 				se.add_candidate(ir);
 
 				if (se.num_candidates()%100000==0) cout << "Number of candidates generated = " << se.num_candidates() << endl;
 			}
 		}
+		delete [] blob;
 	}
 }
 
@@ -2186,17 +2321,16 @@ void NeuralNetKerasA(Blackboard& bb)
 		char roi_path[5000];
 		sprintf (roi_path, "%s%s%s%s", bb.roi_directory().c_str(), "/pred_", se.name().c_str(), ".roi");
 		cout << "Attempting roi from " << roi_path << endl;
-		ifstream roiFile(roi_path);
-		if (!roiFile) {
+		ROI r;
+		bool found = ROIfile::read(roi_path, r);
+		if (!found) {
 			sprintf (roi_path, "%s%s%s%s", bb.roi_directory().c_str(), "\\pred_", se.name().c_str(), ".roi");
 			cout << "Attempting roi from " << roi_path << endl;
-			roiFile.open(roi_path);
+			found = ROIfile::read(roi_path, r);
 		}
-		if (roiFile) {
+		if (found) {
 			cout << "Reading roi from " << roi_path << endl;
 			MedicalImageSequence& medseq = bb.med_im_seq();
-			ROI r;
-			roiFile >> r;
 			
 			if (!r.empty()) {
 				ImageRegion* ir = new ImageRegion (r, medseq);
@@ -2405,7 +2539,7 @@ void NeuralNetKerasA(Blackboard& bb)
 
 				cout << command << endl << flush;
 				
-				int retVal = system(command.c_str());
+				int retVal = KSprofiler::system(command.c_str());
 				cout << command << endl << "cnn_train.py completed with return value = " << retVal << endl;				
 			}
 		}
@@ -2504,27 +2638,41 @@ void NeuralNetKerasA(Blackboard& bb)
 				sprintf(logging_level, " --verbose %d", 2);
 				command.append(logging_level);
 
-				cout << command << endl;
-				
-				int retVal = system(command.c_str());
-				cout << command << endl << "cnn_predict.py completed with return value = " << retVal << endl;				
+				// The persistent worker keeps tensorflow and the network weights loaded between predictions
+				std::string server_path(pypath);
+				server_path = server_path.substr(0, server_path.length()-3) + "_server.py";
+				ifstream serverScript(server_path.c_str(), ifstream::binary);
+				std::shared_ptr<CnnPredictWorker> worker;
+				if (!serverScript.fail())
+					worker = CnnPredictWorker::get(server_path);
+				int retVal = -1;
+				if (worker) {
+					cout << "cnn_predict_server.py: " << config_path << endl;
+					retVal = worker->predict(config_path, source_config_path);
+					cout << "cnn_predict_server.py completed with return value = " << retVal << endl;
+				}
+				if (retVal<0) {
+					cout << command << endl;
+
+					retVal = KSprofiler::system(command.c_str());
+					cout << command << endl << "cnn_predict.py completed with return value = " << retVal << endl;				
+				}
 				
 				char roi_path[5000];
 				sprintf (roi_path, "%s%s", bb.temp_file_path(), "/pred.roi");
 				//sprintf (roi_path, "%s%s", bb.temp_file_path(), "\\pred.roi");
 				cout << "pred path: " << roi_path << endl;
 
-				ifstream roiFile(roi_path);
-				if (!roiFile) {
+				ROI r;
+				bool found = (retVal == 0) && ROIfile::read(roi_path, r);
+				if ((retVal == 0) && !found) {
 					sprintf (roi_path, "%s%s", bb.temp_file_path(), "\\pred.roi");
 					cout << "pred path: " << roi_path << endl;
-					roiFile.open(roi_path);
+					found = ROIfile::read(roi_path, r);
 				}
-				if ((retVal == 0) && roiFile) {
+				if (found) {
 					cout << "pred found" << endl;
 					MedicalImageSequence& medseq = bb.med_im_seq();
-					ROI r;
-					roiFile >> r;
 					
 					if (!r.empty()) {
 						ImageRegion* ir = new ImageRegion (r, medseq);
@@ -2581,14 +2729,11 @@ void ReadMatchedRoiA(Blackboard& bb)
 	SolElement& se = bb.sol_element(bb.next_solel());
 	cout << endl << endl << "Reading ROI from external file for " << se.name() << " using ReadMatchedRoi" << endl;
 
-	ifstream roiFile(bb.roi_directory()+"/"+se.name()+".roi");
-	if (!roiFile) cout << "ERROR: could not open file "+bb.roi_directory()+"/"+se.name()+".roi" << endl;
+	ROI r;
+	if (!ROIfile::read(bb.roi_directory()+"/"+se.name()+".roi", r)) cout << "ERROR: could not open file "+bb.roi_directory()+"/"+se.name()+".roi" << endl;
 	else {
 		MedicalImageSequence& medseq = bb.med_im_seq();
 
-		ROI r;
-		roiFile >> r;
-
 		Point tl, br;
 		r.bounding_cube(tl, br);
 		cout << "tl=" << tl << "   br=" << br << endl;
@@ -2622,7 +2767,6 @@ void ReadMatchedRoiA(Blackboard& bb)
 		cout << "tl=" << tl << "   br=" << br << endl;
 		se.add_candidate(ir);
 	}
-	roiFile.close();
 }
 
 
@@ -2670,7 +2814,7 @@ void ThreshRegGrowA(Blackboard& bb)
 		register int low_gray = (int)trgl->lowGL();
 		register int high_gray = (int)trgl->highGL();
 
-		MedicalImageSequence& medseq = bb.med_im_seq();
+		const IntensityVolume& vol = bb.med_im_seq().hu_volume();
 		// If segmentation is to be performed on subsampled data then computed search area will already be subsampled
 		ROItraverser rt(search_area);
 
@@ -2689,8 +2833,9 @@ void ThreshRegGrowA(Blackboard& bb)
 			rt.current_interval(p1, p2);
 			x1 = p2.x+1;
 			//x2 = p1.x;
+			const short* gl_row = vol.gl_row(p1.y, p1.z);
 			for(; p1.x<=p2.x; p1.x++) {
-				gl = medseq.fast_pix_val(p1.x, p1.y, p1.z);
+				gl = gl_row[p1.x];
 				if ((gl>=low_gray) && (gl<=high_gray)) {
 					if (x1>p2.x)
 						x1=p1.x;
@@ -2711,8 +2856,9 @@ while(s<END_ROI) {
 			rt.current_interval(p1, p2);
 			x1 = p2.x+1;
 			//x2 = p1.x;
+			const short* gl_row = vol.gl_row(p1.y*ss_factor.y, p1.z*ss_factor.z);
 			for(; p1.x<=p2.x; p1.x++) {
-				gl = medseq.fast_pix_val(p1.x*ss_factor.x, p1.y*ss_factor.y, p1.z*ss_factor.z);
+				gl = gl_row[p1.x*ss_factor.x];
 				if ((gl>=low_gray) && (gl<=high_gray)) {
 					if (x1>p2.x)
 						x1=p1.x;
@@ -2732,44 +2878,26 @@ while(s<END_ROI) {
 
 		cout << "Forming candidates....." << endl;
 		// Form candidates
-		while (!thresh_res.empty()) {
-			Point start;
-			thresh_res.first_point(start);
-
-			ROI blob;
-			if (include_all_vox && segment_2d) {
-				blob.copy(thresh_res, start.z);
-				thresh_res.clear(start.z);
-			}
-			else if (include_all_vox) {
-				blob.copy(thresh_res);
-				thresh_res.clear();
-			}
-			else if (segment_2d) {
-				blob.add_contig(thresh_res, start, 1);
-				//thresh_res.subtract(blob);
-			}
-			else {
-				blob.add_contig_3d(thresh_res, start, 1);
-				//thresh_res.subtract(blob);
-			}
-
+		int num_blobs, b;
+		ROI* blob = form_candidate_regions(thresh_res, segment_2d, include_all_vox, min_num_vox, num_blobs);
+		for(b=0; b<num_blobs; b++) {
 			// min_num_vox is already scaled to account for subsampling
-			if (!min_num_vox || blob.num_pix_grequal(min_num_vox)) {
+			if (!min_num_vox || blob[b].num_pix_grequal(min_num_vox)) {
 				ImageRegion *ir;
 				if (use_subsampled) {
 
 					ROI expanded_blob;
-					expand_roi(blob, expanded_blob, ss_factor.x, ss_factor.y, ss_factor.z, bb.overall_search_area());
+					expand_roi(blob[b], expanded_blob, ss_factor.x, ss_factor.y, ss_factor.z, bb.overall_search_area());
 		 			ir = new ImageRegion (expanded_blob, bb.med_im_seq());
 				}
 				else {
-		 			ir = new ImageRegion (blob, bb.med_im_seq());
+		 			ir = new ImageRegion (blob[b], bb.med_im_seq());
 				}
 				se.add_candidate(ir);
 				if (se.num_candidates()%100000==0) cout << "Number of candidates generated = " << se.num_candidates() << endl;
 			}
 		}
+		delete [] blob;
 		cout << "done" << endl;
 	}
 }
@@ -0,0 +1,214 @@
+#include "SolelMemo.h"
+#include "SegParam.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <time.h>
+
+SolelMemo::SolelMemo(const std::string& directory)
+	: _directory(directory), _num_replayed(0), _num_stored(0)
+{
+}
+
+SolelMemo::~SolelMemo()
+{
+	std::map<std::string, std::vector<ImagePrimitive*> >::iterator it;
+	for(it=_cand.begin(); it!=_cand.end(); ++it)
+		for(size_t i=0; i<it->second.size(); i++)
+			delete it->second[i];
+	if (!_files.empty()) {
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(_directory, ec);
+	}
+}
+
+void SolelMemo::new_blackboard()
+{
+	_signature.clear();
+	_signature_set.clear();
+}
+
+void SolelMemo::_add_bits_used(const SolElement& se, std::vector<bool>& bits_used)
+{
+	for(int m=0; m<se.num_attributes(); m++) {
+		const Attribute* att = se.attribute(m);
+		const NeuralNetKeras* nnk = strcmp(att->name(), "NeuralNetKeras") ? 0 : (const NeuralNetKeras*)att;
+		for(size_t index=0; index<bits_used.size(); index++)
+			if (att->chromosome_bit_used(index) || (nnk && (nnk->normalization_bit_used(index) || nnk->augmentation_bit_used(index))))
+				bits_used[index] = true;
+	}
+}
+
+const std::string& SolelMemo::signature(Blackboard& bb, const int s)
+{
+	if ((int)_signature.size()<bb.num_sol_elements()) {
+		_signature.resize(bb.num_sol_elements());
+		_signature_set.resize(bb.num_sol_elements(), false);
+	}
+	if (_signature_set[s])
+		return _signature[s];
+
+	// Ancestors, and the groups of ancestors (matched together) with their ancestors
+	std::vector<int> dep;
+	bb.add_ancestors(bb.sol_element(s), dep);
+	size_t i;
+	int j;
+	for(i=0; i<dep.size(); i++) {
+		const int g = bb.find_group(dep[i]);
+		if (g<0)
+			continue;
+		const SEgroup& grp = bb.group_const(g);
+		for(j=0; j<grp.num_sol_els(); j++) {
+			const int gs = grp.sol_el_index(j);
+			if ((gs!=s) && (std::find(dep.begin(), dep.end(), gs)==dep.end())) {
+				dep.push_back(gs);
+				bb.add_ancestors(bb.sol_element(gs), dep);
+			}
+		}
+	}
+	std::sort(dep.begin(), dep.end());
+
+	const std::string& chromosome = bb.model().chromosome();
+	std::vector<bool> bits_used(chromosome.length(), false);
+	_add_bits_used(bb.sol_element(s), bits_used);
+	for(i=0; i<dep.size(); i++)
+		if (dep[i]!=s)
+			_add_bits_used(bb.sol_element(dep[i]), bits_used);
+
+	std::ostringstream sig;
+	for(i=0; i<bits_used.size(); i++)
+		if (bits_used[i])
+			sig << i << "=" << chromosome[i] << " ";
+
+	_signature[s] = sig.str();
+	_signature_set[s] = true;
+	return _signature[s];
+}
+
+const std::string SolelMemo::_key(const KnowledgeSource& ks, Blackboard& bb)
+{
+	const int s = bb.next_solel();
+	return ks.name() + "\t" + bb.sol_element(s).name() + "\t" + signature(bb, s);
+}
+
+const unsigned long long SolelMemo::_file_hash(const std::string& path)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	std::ifstream in(path.c_str(), std::ios::binary);
+	char buf[65536];
+	while (in) {
+		in.read(buf, sizeof(buf));
+		const std::streamsize n = in.gcount();
+		for(std::streamsize i=0; i<n; i++) {
+			h ^= (unsigned char)buf[i];
+			h *= 1099511628211ULL;
+		}
+	}
+	return h;
+}
+
+void SolelMemo::_list_files(const std::string& directory, FileList& files, const time_t hash_since)
+{
+	files.clear();
+	boost::system::error_code ec;
+	boost::filesystem::directory_iterator it(directory, ec), end;
+	for(; !ec && (it!=end); it.increment(ec))
+		if (boost::filesystem::is_regular_file(it->status())) {
+			boost::system::error_code ec_size, ec_time;
+			FileState& f = files[it->path().filename().string()];
+			f.size = boost::filesystem::file_size(it->path(), ec_size);
+			f.time = boost::filesystem::last_write_time(it->path(), ec_time);
+			f.hashed = (f.time>=hash_since);
+			f.hash = f.hashed ? _file_hash(it->path().string()) : 0;
+		}
+}
+
+const bool SolelMemo::stored(const KnowledgeSource& ks, Blackboard& bb)
+{
+	if ((bb.next_solel()<0) || ks.type().compare("SegmentationKS"))
+		return false;
+	return _cand.count(_key(ks, bb))>0;
+}
+
+const bool SolelMemo::replay(const KnowledgeSource& ks, Blackboard& bb)
+{
+	if ((bb.next_solel()<0) || ks.type().compare("SegmentationKS"))
+		return false;
+	SolElement& se = bb.sol_element(bb.next_solel());
+	if (se.num_candidates()!=0)
+		return false;
+	std::map<std::string, std::vector<ImagePrimitive*> >::const_iterator it = _cand.find(_key(ks, bb));
+	if (it==_cand.end())
+		return false;
+
+	cout << "Reusing " << it->second.size() << " candidates of " << se.name() << " formed by " << ks.name() << " with the same chromosome bits" << endl;
+	for(size_t i=0; i<it->second.size(); i++)
+		se.add_candidate(it->second[i]->create_copy());
+
+	std::map<std::string, std::vector<std::pair<std::string, std::string> > >::const_iterator f = _files.find(it->first);
+	if (f!=_files.end())
+		for(size_t i=0; i<f->second.size(); i++) {
+			const std::string path = std::string(bb.temp_file_path()) + "/" + f->second[i].first;
+			boost::system::error_code ec;
+			boost::filesystem::remove(path, ec);
+			boost::filesystem::copy_file(f->second[i].second, path, ec);
+			if (ec)
+				cerr << "WARNING: SolelMemo: could not copy " << f->second[i].second << ": " << ec.message() << endl;
+		}
+	_num_replayed++;
+	return true;
+}
+
+void SolelMemo::begin(Blackboard& bb)
+{
+	// A file rewritten with the same size keeps its last write time (in seconds) only if it was last written in the current second,
+	// the content of those is compared (one second earlier in case the file system clock lags)
+	_list_files(bb.temp_file_path(), _temp_files, time(0)-1);
+}
+
+void SolelMemo::store(const KnowledgeSource& ks, Blackboard& bb, const int num_act_recs, const int num_messages)
+{
+	if ((bb.next_solel()<0) || ks.type().compare("SegmentationKS"))
+		return;
+	// Activations that leave information in the activation records (e.g., DistanceMapWatershed) cannot be replayed
+	if ((bb.num_act_recs()!=num_act_recs) || (bb.last_act_rec() && (bb.last_act_rec()->num_messages()!=num_messages)))
+		return;
+
+	const std::string key = _key(ks, bb);
+	if (_cand.count(key))
+		return;
+	SolElement& se = bb.sol_element(bb.next_solel());
+	std::vector<ImagePrimitive*>& cand = _cand[key];
+	for(int i=0; i<se.num_candidates(); i++)
+		cand.push_back(se.candidate(i)->primitive()->create_copy());
+
+	// Files written by the activation: the search area file of the solution element (possibly written ahead by the SolelPrefetcher)
+	// and the other files changed since begin, except search area files of other solution elements (written by the SolelPrefetcher meanwhile)
+	const std::string search_area = std::string("search_area_") + se.name() + ".roi";
+	FileList files;
+	_list_files(bb.temp_file_path(), files, std::numeric_limits<time_t>::max());
+	FileList::const_iterator it;
+	for(it=files.begin(); it!=files.end(); ++it) {
+		if (it->first.compare(search_area)) {
+			if (it->first.compare(0, 12, "search_area_")==0)
+				continue;
+			FileList::const_iterator before = _temp_files.find(it->first);
+			if ((before!=_temp_files.end()) && (before->second.size==it->second.size) && (before->second.time==it->second.time) &&
+				(!before->second.hashed || (before->second.hash==_file_hash(std::string(bb.temp_file_path()) + "/" + it->first))))
+				continue;
+		}
+		std::ostringstream copy;
+		copy << _directory << "/" << _num_stored << "_" << it->first;
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(_directory, ec);
+		boost::filesystem::remove(copy.str(), ec);
+		boost::filesystem::copy_file(std::string(bb.temp_file_path()) + "/" + it->first, copy.str(), ec);
+		if (ec)
+			cerr << "WARNING: SolelMemo: could not copy " << it->first << ": " << ec.message() << endl;
+		else
+			_files[key].push_back(std::make_pair(it->first, copy.str()));
+	}
+	_num_stored++;
+}
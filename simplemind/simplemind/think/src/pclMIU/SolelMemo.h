@@ -0,0 +1,116 @@
+#ifndef __SolelMemo_h_
+#define __SolelMemo_h_
+
+#include "KnowledgeSource.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+Reuses the candidates formed for solution elements across segmentations of the same image with different chromosomes (see KSscheduler::memo).
+The candidates a segmentation knowledge source forms for a solution element only depend on the image, the model and the values of the chromosome bits
+used by the attributes of the solution element and of the solution elements it depends on (see signature).
+After a segmentation knowledge source is activated, copies of the candidates are stored with the signature of the solution element.
+When the same knowledge source is activated for a solution element with a stored signature, the copies are added instead (see replay),
+and the remaining knowledge sources (candidate confidences, matching) are activated as usual.
+The files the activation writes to the temporary file path of the blackboard (e.g., search_area_NAME.roi, watershed distance maps) are copied to the memo directory
+and copied back when the candidates are reused, for the knowledge sources that read them later.
+The search area file of the solution element is always copied, other files are detected as written by their size and last write time,
+and by their content for files last written in the second the activation began, whose rewrite may keep both (see begin).
+Activations that change the activation records (other than the scheduler adding the record of the knowledge source) are not stored.
+The stored candidates are kept until the SolelMemo is destroyed, it must only be used with blackboards of the same image and model files.
+The methods must be called from the scheduler thread.
+*/
+class SolelMemo {
+public:
+	/// Constructor - directory: where the files written by the stored activations are copied (created when needed)
+	SolelMemo(const std::string& directory);
+
+	/// Destructor - frees the stored candidates and removes the copied files
+	~SolelMemo();
+
+	/// Clears the signatures computed for the previous blackboard (to be called before a new blackboard is used)
+	void new_blackboard();
+
+	/**
+	Returns the signature of the s'th solution element: the indices and values of the chromosome bits used by the attributes (including NeuralNetKeras normalization and augmentation bits)
+	of the solution element, of its ancestors (see Blackboard::add_ancestors), and of the groups of its ancestors with their ancestors.
+	Signatures are computed once per blackboard.
+	*/
+	const std::string& signature(Blackboard& bb, const int s);
+
+	/// Returns true if candidates are stored for the knowledge source and the next solution element of the blackboard
+	const bool stored(const KnowledgeSource& ks, Blackboard& bb);
+
+	/**
+	Called by the scheduler before activating a knowledge source.
+	Returns true if ks is a segmentation knowledge source, the next solution element has no candidates and candidates are stored for them,
+	in which case copies of the candidates have been added to the solution element and the knowledge source must not be activated (its activation record must still be added).
+	*/
+	const bool replay(const KnowledgeSource& ks, Blackboard& bb);
+
+	/// Called by the scheduler before activating a knowledge source whose activation may be stored: lists the files of the temporary file path
+	void begin(Blackboard& bb);
+
+	/**
+	Called by the scheduler after activating a segmentation knowledge source for the next solution element, that had no candidates before the activation.
+	num_act_recs and num_messages are the number of activation records and the number of messages of the last activation record before the activation.
+	*/
+	void store(const KnowledgeSource& ks, Blackboard& bb, const int num_act_recs, const int num_messages);
+
+	/// Number of activations replaced by stored candidates
+	inline const long num_replayed() const { return _num_replayed; };
+
+	/// Number of activations whose candidates were stored
+	inline const long num_stored() const { return _num_stored; };
+
+private:
+	/// Key of the candidates stored for the knowledge source and the next solution element
+	const std::string _key(const KnowledgeSource& ks, Blackboard& bb);
+
+	/// Size, last write time and content hash (if computed) of a file of the temporary file path
+	struct FileState {
+		uintmax_t size;
+		time_t time;
+		bool hashed;
+		unsigned long long hash;
+	};
+
+	/// Files of the temporary file path by name
+	typedef std::map<std::string, FileState> FileList;
+
+	/// Lists the files of a directory, with the content hash of the files last written at hash_since or later
+	static void _list_files(const std::string& directory, FileList& files, const time_t hash_since);
+
+	/// Returns the FNV-1a hash of the content of a file
+	static const unsigned long long _file_hash(const std::string& path);
+
+	/// Adds the chromosome bits used by the attributes of a solution element
+	static void _add_bits_used(const SolElement& se, std::vector<bool>& bits_used);
+
+	/// Stored candidate primitives
+	std::map<std::string, std::vector<ImagePrimitive*> > _cand;
+
+	/// Files written by the stored activation: name in the temporary file path and path of the copy
+	std::map<std::string, std::vector<std::pair<std::string, std::string> > > _files;
+
+	/// Directory of the copied files
+	std::string _directory;
+
+	/// Files of the temporary file path before the activation (see begin)
+	FileList _temp_files;
+
+	/// Signature of each solution element of the current blackboard (computed when first needed)
+	std::vector<std::string> _signature;
+
+	/// Flags indicating which signatures have been computed
+	std::vector<bool> _signature_set;
+
+	/// Number of activations replaced by stored candidates
+	long _num_replayed;
+
+	/// Number of activations whose candidates were stored
+	long _num_stored;
+};
+
+#endif // !__SolelMemo_h_
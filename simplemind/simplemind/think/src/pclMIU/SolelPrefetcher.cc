@@ -0,0 +1,260 @@
+#include "SolelPrefetcher.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+/// Buffers of the activation run by the calling thread (0 if none), for cout (0) and cerr (1)
+thread_local std::stringbuf* activation_buf[2] = {0, 0};
+
+/// Stream buffers of cout and cerr before they were routed (set once, see route_output)
+std::streambuf* console_buf[2] = {0, 0};
+
+/// Writes to the buffer of the activation run by the calling thread if there is one, otherwise to the console
+class RoutingBuf : public std::streambuf {
+public:
+	RoutingBuf(const int stream) : _stream(stream) {}
+
+protected:
+	virtual int overflow(int c) {
+		if (c==traits_type::eof())
+			return traits_type::not_eof(c);
+		return target()->sputc(traits_type::to_char_type(c));
+	}
+	virtual std::streamsize xsputn(const char* s, std::streamsize n) { return target()->sputn(s, n); }
+	virtual int sync() { return target()->pubsync(); }
+
+private:
+	std::streambuf* target() const { return activation_buf[_stream] ? activation_buf[_stream] : console_buf[_stream]; }
+
+	const int _stream;
+};
+
+/// Writes the output of an activation that exits the program (e.g. after an error message) to the console
+void write_activation_output()
+{
+	for(int i=0; i<2; i++)
+		if (activation_buf[i] && console_buf[i]) {
+			const std::string text = activation_buf[i]->str();
+			activation_buf[i] = 0;
+			console_buf[i]->sputn(text.data(), text.size());
+			console_buf[i]->pubsync();
+		}
+}
+
+/**
+Routes cout and cerr through a RoutingBuf, once for the process: the routing is never undone, so that every prefetcher (e.g. of the cases of a batch) shares it
+and only the thread_local activation buffers differ. The RoutingBufs are never deleted, as cout and cerr may be written until the end of the program.
+*/
+const bool route_output()
+{
+	std::ostream* streams[2] = {&cout, &cerr};
+	for(int i=0; i<2; i++) {
+		streams[i]->flush();
+		console_buf[i] = streams[i]->rdbuf();
+		streams[i]->rdbuf(new RoutingBuf(i));
+	}
+	return (std::atexit(write_activation_output)==0);
+}
+
+}
+
+SolelPrefetcher::SolelPrefetcher(const Darray<KnowledgeSource>& ks, Blackboard& bb, const int num_threads)
+	: _ks(ks), _bb(bb), _stop(false), _profiler(0), _memo(0), _num_replayed(0), _num_discarded(0)
+{
+	static const bool routed = route_output();
+	(void) routed;
+	for(int i=0; i<num_threads; i++)
+		_thread.push_back(std::thread(&SolelPrefetcher::work, this));
+}
+
+SolelPrefetcher::~SolelPrefetcher()
+{
+	stop();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_cond.notify_all();
+	for(size_t i=0; i<_thread.size(); i++)
+		_thread[i].join();
+}
+
+void SolelPrefetcher::prefetch()
+{
+	if (_bb.next_group()<0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if ((int)_task.size()<_bb.num_sol_elements()) {
+			_task.resize(_bb.num_sol_elements(), 0);
+			_queued.resize(_bb.num_sol_elements(), false);
+		}
+	}
+
+	int g, i, j, num_queued=0;
+	for(g=0; g<_bb.num_groups(); g++) {
+		// Groups other than the next group are ready if all related groups have been processed
+		const SEgroup& grp = _bb.group_const(g);
+		if ((g!=_bb.next_group()) && (grp.priority()!=1.0))
+			continue;
+
+		for(i=0; i<grp.num_sol_els(); i++) {
+			const int s = grp.sol_el_index(i);
+			if (_queued[s])
+				continue;
+			_queued[s] = true;
+
+			// Segmentation knowledge source the scheduler will select for the solution element
+			_bb.thread_solel(s);
+			int seg_ind = -1;
+			float score, best_score = 0.0;
+			for(j=0; j<_ks.N(); j++)
+				if (!_ks[j].type().compare("SegmentationKS")) {
+					score = _ks[j].activation_score(_bb);
+					if (score>best_score) {
+						best_score = score;
+						seg_ind = j;
+					}
+				}
+			const bool stored = (seg_ind>=0) && _memo && _memo->stored(_ks[seg_ind], _bb);
+			_bb.thread_solel(-1);
+			if ((seg_ind<0) || !_ks[seg_ind].parallel() || stored)
+				continue;
+
+			Task* t = new Task;
+			t->ks_index.push_back(seg_ind);
+			for(j=0; j<_ks.N(); j++)
+				if (_ks[j].parallel() && _ks[j].type().compare("SegmentationKS"))
+					t->ks_index.push_back(j);
+			t->num_replayed = 0;
+			t->num_act_recs = 0;
+			t->done = false;
+			t->out.resize(t->ks_index.size());
+			t->err.resize(t->ks_index.size());
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_task[s] = t;
+			_pending.push_back(s);
+			num_queued++;
+		}
+	}
+	if (num_queued) {
+		cout << "Segmenting " << num_queued << " solution elements in parallel" << endl;
+		_cond.notify_all();
+	}
+}
+
+void SolelPrefetcher::run(const int s, Task* t)
+{
+	_bb.thread_solel(s);
+	for(size_t k=0; k<t->ks_index.size(); k++) {
+		std::stringbuf out, err;
+		activation_buf[0] = &out;
+		activation_buf[1] = &err;
+		{
+			KSprofiler::Scope scope(_profiler, _ks[t->ks_index[k]], _bb, true);
+			_ks[t->ks_index[k]].activate(_bb);
+		}
+		activation_buf[0] = activation_buf[1] = 0;
+		t->out[k] = out.str();
+		t->err[k] = err.str();
+	}
+	_bb.thread_solel(-1);
+}
+
+void SolelPrefetcher::work()
+{
+	for(;;) {
+		int s;
+		Task* t;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cond.wait(lock, [this] { return _stop || !_pending.empty(); });
+			if (_stop)
+				return;
+			s = _pending.front();
+			_pending.pop_front();
+			t = _task[s];
+		}
+
+		run(s, t);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			t->done = true;
+		}
+		_cond.notify_all();
+	}
+}
+
+void SolelPrefetcher::finish(const int s, const bool run_pending)
+{
+	Task* t = _task[s];
+	bool pending;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		std::deque<int>::iterator it = std::find(_pending.begin(), _pending.end(), s);
+		pending = (it!=_pending.end());
+		if (pending)
+			_pending.erase(it);
+		else
+			_cond.wait(lock, [t] { return t->done; });
+	}
+
+	if (pending) {
+		if (run_pending)
+			run(s, t);
+		t->done = true;
+	}
+}
+
+void SolelPrefetcher::discard(const int s)
+{
+	finish(s, false);
+	Task* t = _task[s];
+	if (t->num_replayed==0) {
+		_bb.sol_element(s).free_staged_candidates();
+		_num_discarded++;
+	}
+	delete t;
+	_task[s] = 0;
+}
+
+const bool SolelPrefetcher::replay(const int i)
+{
+	const int s = _bb.next_solel();
+	if ((s<0) || (s>=(int)_task.size()) || !_task[s])
+		return false;
+
+	finish(s, true);
+	Task* t = _task[s];
+	SolElement& se = _bb.sol_element(s);
+
+	// The activations must follow each other as on the worker thread, starting with no candidates
+	if ((t->num_replayed<(int)t->ks_index.size()) && (t->ks_index[t->num_replayed]==i)
+		&& ((t->num_replayed==0) ? (se.num_candidates()==0) : (_bb.num_act_recs()==t->num_act_recs))) {
+		if (t->num_replayed==0) {
+			se.commit_staged_candidates();
+			_num_replayed++;
+		}
+		cout << t->out[t->num_replayed] << std::flush;
+		cerr << t->err[t->num_replayed] << std::flush;
+		t->num_replayed++;
+		// The scheduler adds one activation record for the replayed knowledge source
+		t->num_act_recs = _bb.num_act_recs()+1;
+		return true;
+	}
+
+	discard(s);
+	return false;
+}
+
+void SolelPrefetcher::stop()
+{
+	for(int s=0; s<(int)_task.size(); s++)
+		if (_task[s])
+			discard(s);
+}
@@ -0,0 +1,126 @@
+#ifndef __SolelPrefetcher_h_
+#define __SolelPrefetcher_h_
+
+#include "KnowledgeSource.h"
+#include "KSprofiler.h"
+#include "SolelMemo.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+Segments independent solution elements in parallel while the scheduler stays serial.
+When a group is selected, the solution elements of every group that does not depend on an unprocessed group (the selected group and groups with priority 1.0) are queued.
+For each one the segmentation knowledge source the scheduler would select is activated on a worker thread, followed by the non-segmentation knowledge sources marked parallel (e.g. ImCandConf).
+Candidates are staged in the solution element (see Blackboard::thread_solel) and are only committed when the scheduler activates the same knowledge sources for the solution element, in the same order.
+Otherwise they are discarded and the knowledge source is activated as usual, so the blackboard is the same as with serial processing.
+Only knowledge sources marked parallel (see KnowledgeSource::parallel) are activated from worker threads.
+cout and cerr of the activations run by worker threads are buffered per thread, and written when the scheduler replays the activation (dropped if it is discarded, written at once if the activation exits the program),
+so the output is in the same order as with serial processing. The first prefetcher routes cout and cerr through these buffers for the rest of the program; output of other threads is written unchanged.
+*/
+class SolelPrefetcher {
+public:
+	/// Constructor - starts num_threads worker threads (the knowledge sources must not be modified while the prefetcher is used)
+	SolelPrefetcher(const Darray<KnowledgeSource>& ks, Blackboard& bb, const int num_threads);
+
+	/// Destructor - waits for running activations and discards staged candidates
+	~SolelPrefetcher();
+
+	/// Queues the solution elements of the groups that are ready to be processed (to be called after the next group changed)
+	void prefetch();
+
+	/**
+	Called by the scheduler before activating the i'th knowledge source.
+	Returns true if the activation was already done by a worker thread, in which case its staged candidates have been committed and the knowledge source must not be activated again (its activation record must still be added).
+	*/
+	const bool replay(const int i);
+
+	/// Waits for running activations and discards all staged candidates
+	void stop();
+
+	/// Records the activations of the worker threads with the profiler (0 to stop profiling, to be set while no solution elements are queued)
+	inline void profile(KSprofiler* p) { _profiler = p; };
+
+	/// Solution elements whose candidates are stored in the memo are not queued (0 to queue all, to be set while no solution elements are queued)
+	inline void memo(SolelMemo* m) { _memo = m; };
+
+	/// Number of solution elements whose staged candidates were committed
+	inline const long num_replayed() const { return _num_replayed; };
+
+	/// Number of solution elements whose staged candidates were discarded
+	inline const long num_discarded() const { return _num_discarded; };
+
+private:
+	/// Activations queued for a solution element
+	struct Task {
+		/// Knowledge sources activated, in order (the segmentation knowledge source first)
+		std::vector<int> ks_index;
+		/// Number of activations replayed so far
+		int num_replayed;
+		/// Number of activation records on the blackboard after the last replay
+		int num_act_recs;
+		/// Activations finished on the worker thread
+		bool done;
+		/// Output of each activation to cout and cerr
+		std::vector<std::string> out, err;
+	};
+
+	/// Worker thread loop
+	void work();
+
+	/// Activates the knowledge sources of a task for solution element s on the calling thread
+	void run(const int s, Task* t);
+
+	/**
+	Waits until the task of solution element s is finished.
+	A task that has not been started by a worker thread is run on the calling thread if run_pending is true and is dropped otherwise.
+	*/
+	void finish(const int s, const bool run_pending);
+
+	/// Removes the task of solution element s, freeing candidates that were not committed (waits for it first)
+	void discard(const int s);
+
+	/// Knowledge sources
+	const Darray<KnowledgeSource>& _ks;
+
+	/// Blackboard
+	Blackboard& _bb;
+
+	/// Task of each solution element (0 if none)
+	std::vector<Task*> _task;
+
+	/// Solution elements already queued once (never queued again)
+	std::vector<bool> _queued;
+
+	/// Solution elements waiting for a worker thread
+	std::deque<int> _pending;
+
+	/// Guards _task contents, _pending and _stop
+	std::mutex _mutex;
+
+	/// Signals new pending tasks and finished tasks
+	std::condition_variable _cond;
+
+	/// Worker threads
+	std::vector<std::thread> _thread;
+
+	/// Set to stop the worker threads
+	bool _stop;
+
+	/// Profiler of the activations (0 if not used)
+	KSprofiler* _profiler;
+
+	/// Candidates reused across chromosomes (0 if not used)
+	SolelMemo* _memo;
+
+	/// Number of solution elements whose staged candidates were committed
+	long _num_replayed;
+
+	/// Number of solution elements whose staged candidates were discarded
+	long _num_discarded;
+};
+
+#endif // !__SolelPrefetcher_h_
@@ -0,0 +1,443 @@
+/**
+Benchmarks of the ROI engine: set algebra, connected components, morphology, convex hull, boundaries, resampling and text serialization,
+the same set algebra and morphology on the run-length encoded RLEroi, and binary ROI files (ROIfile).
+
+The ROIs are synthetic shapes (spheres, shells, noise blobs and OCT-like layers) built in a cube of the size given as the benchmark argument.
+Shapes are generated from a fixed seed, so every run measures the same ROIs; the counter "result_pix" (number of points of the result)
+makes changes of behavior visible next to changes of speed.
+
+Example (JSON output for tracking regressions):
+	sm_roi_benchmark --benchmark_out=roi_benchmark.json --benchmark_out_format=json --benchmark_repetitions=5
+*/
+#include "RLEroi.h"
+#include "ROI.h"
+#include "ROIfile.h"
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+#include <math.h>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// Seed of the random shapes
+const unsigned int kSeed = 20240601;
+
+enum ShapeKind { SPHERE=0, SHELL=1, BLOBS=2, LAYERS=3 };
+
+const char* shape_name(const int kind) {
+	static const char* names[] = {"sphere", "shell", "blobs", "layers"};
+	return names[kind];
+}
+
+/// Adds a ball of radius r centered at (xc, yc, zc)
+void add_ball(ROI& roi, const int r, const int xc, const int yc, const int zc) {
+	for(int dz=-r; dz<=r; dz++) {
+		int rz = (int)floor(sqrt((double)(r*r-dz*dz)));
+		roi.add_circle(rz, xc, yc, zc+dz);
+	}
+}
+
+/**
+Builds a shape in a cube of the given size.
+The shift moves the shape along x so that the second operand of the set operations overlaps the first one partially.
+*/
+void make_shape(ROI& roi, const int kind, const int size, const int shift=0) {
+	roi.clear();
+	const int c = size/2;
+	switch (kind) {
+	case SPHERE:
+		add_ball(roi, size*3/8, c+shift, c, c);
+		break;
+	case SHELL: {
+		add_ball(roi, size*3/8, c+shift, c, c);
+		ROI inner;
+		add_ball(inner, size*3/8-2, c+shift, c, c);
+		roi.subtract(inner);
+		break;
+	}
+	case BLOBS: {
+		std::mt19937 rng(kSeed+shift);
+		std::uniform_int_distribution<int> pos(4, size-5), rad(1, 3);
+		int n = size*size*size/512;
+		for(int i=0; i<n; i++) add_ball(roi, rad(rng), pos(rng), pos(rng), pos(rng));
+		break;
+	}
+	case LAYERS: {
+		// Retinal-like layers: surfaces y = f(x, z) that undulate slowly, each a few voxels thick, as in a stack of OCT B-scans
+		const int num_layers = 4, thickness = 2+size/64;
+		for(int z=0; z<size; z++) {
+			for(int y=0; y<size; y++) {
+				int start = -1;
+				for(int x=0; x<=size; x++) {
+					bool in = false;
+					if (x<size) {
+						for(int l=0; l<num_layers && !in; l++) {
+							double f = size*(0.25+0.15*l) + size*0.05*sin(0.1*(x+shift)+0.07*z+l);
+							in = (y>=f) && (y<f+thickness);
+						}
+					}
+					if (in && start<0) start = x;
+					if (!in && start>=0) {
+						roi.append_interval(start, x-1, y, z);
+						start = -1;
+					}
+				}
+			}
+		}
+		break;
+	}
+	}
+}
+
+void set_labels(benchmark::State& state, const int kind) {
+	state.SetLabel(shape_name(kind));
+}
+
+void BM_OR(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, b, r;
+	make_shape(a, kind, size);
+	make_shape(b, kind, size, size/8);
+	for (auto _ : state) {
+		r = a;
+		r.OR(b);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_AND(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, b, r;
+	make_shape(a, kind, size);
+	make_shape(b, kind, size, size/8);
+	for (auto _ : state) {
+		r = a;
+		r.AND(b);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_subtract(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, b, r;
+	make_shape(a, kind, size);
+	make_shape(b, kind, size, size/8);
+	for (auto _ : state) {
+		r = a;
+		r.subtract(b);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+/// Extracts every 3D component, as the search areas and segmentations that split an ROI into its components do
+void BM_add_contig_3d(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a;
+	make_shape(a, kind, size);
+	int num_components = 0;
+	for (auto _ : state) {
+		ROI r(a);
+		Point fp;
+		num_components = 0;
+		while (r.first_point(fp)) {
+			ROI component;
+			component.add_contig_3d(r, fp, 1);
+			num_components++;
+		}
+	}
+	state.counters["components"] = num_components;
+	set_labels(state, kind);
+}
+
+/// Labels every 3D component in a single pass, to compare with BM_add_contig_3d
+void BM_connected_components(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a;
+	make_shape(a, kind, size);
+	int num_components = 0;
+	for (auto _ : state) {
+		std::vector<int> num_vox;
+		ROI* c = a.connected_components(num_components, num_vox, 26);
+		delete [] c;
+	}
+	state.counters["components"] = num_components;
+	set_labels(state, kind);
+}
+
+void BM_erode(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, se, r;
+	make_shape(a, kind, size);
+	add_ball(se, 1, 0, 0, 0);
+	for (auto _ : state) {
+		r = a;
+		r.erode(se);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_dilate(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, se, r;
+	make_shape(a, kind, size);
+	add_ball(se, 1, 0, 0, 0);
+	for (auto _ : state) {
+		r = a;
+		r.dilate(se);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_convex_hull(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	for (auto _ : state) {
+		r = a;
+		r.convex_hull();
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_boundaries(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a;
+	make_shape(a, kind, size);
+	Point fp, lp;
+	a.first_point(fp);
+	a.last_point(lp);
+	long num_contours = 0;
+	for (auto _ : state) {
+		num_contours = 0;
+		for(int z=fp.z; z<=lp.z; z++) {
+			int n;
+			Contour* c = a.boundaries(n, z);
+			num_contours += n;
+			delete [] c;
+		}
+	}
+	state.counters["contours"] = num_contours;
+	set_labels(state, kind);
+}
+
+void BM_subsample(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	for (auto _ : state) {
+		r.clear();
+		a.subsample(r, 2, 2, 1, false);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_upsample(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, sub, r;
+	make_shape(a, kind, size);
+	a.subsample(sub, 2, 2, 1, false);
+	for (auto _ : state) {
+		r.clear();
+		sub.upsample(r, 2, 2, 1, false);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+/// Writes and reads back the text format of .roi files
+void BM_text_serialization(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	long num_bytes = 0;
+	for (auto _ : state) {
+		std::stringstream ss;
+		ss << a;
+		num_bytes = (long)ss.tellp();
+		r.clear();
+		ss >> r;
+	}
+	state.counters["result_pix"] = r.num_pix();
+	state.SetBytesProcessed((int64_t)state.iterations()*num_bytes*2);
+	set_labels(state, kind);
+}
+
+/// Set operations of RLEroi, the ROIs being converted outside of the timed loop (compare with BM_OR, BM_AND and BM_subtract)
+void rle_set_operation(benchmark::State& state, const RLEop op) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, b;
+	make_shape(a, kind, size);
+	make_shape(b, kind, size, size/8);
+	RLEroi ra(a), rb(b), r;
+	for (auto _ : state) {
+		RLEroi::merge(ra, rb, op, r);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_RLE_OR(benchmark::State& state) {
+	rle_set_operation(state, RLE_OR);
+}
+
+void BM_RLE_AND(benchmark::State& state) {
+	rle_set_operation(state, RLE_AND);
+}
+
+void BM_RLE_subtract(benchmark::State& state) {
+	rle_set_operation(state, RLE_SUBTRACT);
+}
+
+void BM_RLE_erode(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, se;
+	make_shape(a, kind, size);
+	add_ball(se, 1, 0, 0, 0);
+	RLEroi ra(a), rse(se), r;
+	for (auto _ : state) {
+		r = ra;
+		r.erode(rse);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+void BM_RLE_dilate(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, se;
+	make_shape(a, kind, size);
+	add_ball(se, 1, 0, 0, 0);
+	RLEroi ra(a), rse(se), r;
+	for (auto _ : state) {
+		r = ra;
+		r.dilate(rse);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+/// Converts an ROI to an RLEroi and back
+void BM_RLE_conversion(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	RLEroi ra;
+	for (auto _ : state) {
+		ra.copy(a);
+		r.clear();
+		ra.to_roi(r);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+/// Temporary file for the ROIfile benchmarks, removed when it goes out of scope
+class TempFile {
+public:
+	TempFile() : _path((boost::filesystem::temp_directory_path()/boost::filesystem::unique_path("roi_benchmark_%%%%%%%%.roi")).string()) {};
+	~TempFile() { boost::system::error_code ec; boost::filesystem::remove(_path, ec); };
+	const std::string& path() const { return _path; };
+private:
+	std::string _path;
+};
+
+/// Writes and reads back a binary ROI file (compressed as by default), to compare with BM_text_serialization
+void BM_binary_file(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	TempFile file;
+	for (auto _ : state) {
+		if (!ROIfile::write(file.path(), a)) {
+			state.SkipWithError("cannot write the temporary ROI file");
+			break;
+		}
+		ROIfile::read(file.path(), r);
+	}
+	state.counters["result_pix"] = r.num_pix();
+	state.counters["file_bytes"] = (double)boost::filesystem::file_size(file.path());
+	set_labels(state, kind);
+}
+
+/// Reads the middle plane of an open binary ROI file, which does not decode the other planes
+void BM_binary_file_read_plane(benchmark::State& state) {
+	const int kind = state.range(0), size = state.range(1);
+	ROI a, r;
+	make_shape(a, kind, size);
+	TempFile file;
+	ROIfile f;
+	if (!ROIfile::write(file.path(), a) || !f.open(file.path())) {
+		state.SkipWithError("cannot write the temporary ROI file");
+		return;
+	}
+	const int z = f.plane_z(f.num_planes()/2);
+	for (auto _ : state) {
+		f.read_plane(z, r);
+		benchmark::ClobberMemory();
+	}
+	state.counters["result_pix"] = r.num_pix();
+	set_labels(state, kind);
+}
+
+/// Every shape at cube sizes 32, 64 and 128
+void shape_args(benchmark::internal::Benchmark* b) {
+	b->ArgNames({"shape", "size"});
+	for (int kind=SPHERE; kind<=LAYERS; kind++)
+		for (int size=32; size<=128; size*=2)
+			b->Args({kind, size});
+	b->Unit(benchmark::kMicrosecond);
+}
+
+}
+
+BENCHMARK(BM_OR)->Apply(shape_args);
+BENCHMARK(BM_AND)->Apply(shape_args);
+BENCHMARK(BM_subtract)->Apply(shape_args);
+BENCHMARK(BM_add_contig_3d)->Apply(shape_args);
+BENCHMARK(BM_connected_components)->Apply(shape_args);
+BENCHMARK(BM_erode)->Apply(shape_args);
+BENCHMARK(BM_dilate)->Apply(shape_args);
+BENCHMARK(BM_convex_hull)->Apply(shape_args);
+BENCHMARK(BM_boundaries)->Apply(shape_args);
+BENCHMARK(BM_subsample)->Apply(shape_args);
+BENCHMARK(BM_upsample)->Apply(shape_args);
+BENCHMARK(BM_text_serialization)->Apply(shape_args);
+BENCHMARK(BM_RLE_OR)->Apply(shape_args);
+BENCHMARK(BM_RLE_AND)->Apply(shape_args);
+BENCHMARK(BM_RLE_subtract)->Apply(shape_args);
+BENCHMARK(BM_RLE_erode)->Apply(shape_args);
+BENCHMARK(BM_RLE_dilate)->Apply(shape_args);
+BENCHMARK(BM_RLE_conversion)->Apply(shape_args);
+BENCHMARK(BM_binary_file)->Apply(shape_args);
+BENCHMARK(BM_binary_file_read_plane)->Apply(shape_args);
+
+int main(int argc, char** argv) {
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+	// Recorded in the context of the JSON output, so that results are only compared for the same inputs
+	benchmark::AddCustomContext("roi_benchmark_seed", std::to_string(kSeed));
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -13,6 +13,11 @@
 #include "SchedulerKS.h"
 #include "InferencingKS.h"
 #include "MemManageKS.h"
+#include "KSscheduler.h"
+#include "KSprofiler.h"
+#include "SolelMemo.h"
+#include "ROIfile.h"
+#include "CnnPredictWorker.h"
 
 #include "ImageRegion.h"
 #include "ImageContour.h"
@@ -25,6 +30,9 @@
 #include <pcl/misc/FileHelper.h>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#include <chrono>
+#include <mutex>
+#include <thread>
 //using namespace boost::filesystem;
 
 // ***** MASK TEST ****
@@ -33,136 +41,11 @@
 //#include <boost/thread/thread.hpp>
 //#include <boost/date_time/posix_time/posix_time.hpp>
 
-int do_segmentation(const char *image_file, const char* model_file, const char *exec_directory, const char *output_directory, 
-                    const char *roi_directory, const char *edm_directory, const char *chromosome, const char *stop_at_node, 
-					const char *user_resource_directory, const char *condor_job_directory, 
-					const bool skip_normalized_image_png, const bool skip_normalized_image_png_training, const bool skip_tensorboard_logging, 
-					const bool predict_cpu_only) {
-	if (roi_directory) cout << "ROI directory = " << roi_directory << endl;
-	else cout << "ROI directory not specified" << endl;
-	if (edm_directory) cout << "EDM directory = " << edm_directory << endl;
-	else cout << "EDM directory not specified" << endl;
-	if (chromosome) cout << "Chromosome = " << chromosome << endl;
-	else cout << "Chromosome not specified" << endl;
-	if (stop_at_node) cout << "Stop at Node = " << stop_at_node << endl;
-	else cout << "Stop at Node not specified" << endl;
-	if (user_resource_directory) cout << "User Resource Directory  = " << user_resource_directory << endl;
-	else cout << "User Resource Directory not specified" << endl;
-	if (condor_job_directory) cout << "Condor Job Directory  = " << condor_job_directory << endl;
-	else cout << "MIU will be run by locally" << endl;
-
-	std::string write_bb_fn = std::string(output_directory) + "/blackboard.out";
-	//boost::filesystem::path write_bb_fn = std::string(output_directory) / std::string("blackboard.out");
-
-	Point os_tl(-1,-1,-1), os_br(-1,-1,-1);
-	int* im_inst_nums;
-	int num_slices_z;
-
-	int ok = 0;
-
-	std::string extension = pcl::FileNameTokenizer(image_file).getExtensionWithoutDot();
-	boost::shared_ptr<MedicalImageSequence> mis_ptr;
-	if (extension.compare("txt")==0 || extension.compare("seri")==0 || extension.compare("ser")==0 || extension.compare("sers")==0) {
-		cout << "Reading dicom image data..." << endl;
-		std::vector<std::string> im_fname; 
-		// std::ofstream os(std::string(output_directory) + "\\dicom.seri"); //MWW 03282020
-		std::ofstream os(std::string(output_directory) + "/dicom.seri");
-		std::ifstream fp(image_file);
-		if (!fp) {
-			cerr << "ERROR: unable to open input file: " << image_file << endl;
-			exit(1);
-		}
-		char dummy[300];
-		while(!fp.eof()) {
-			fp.getline(dummy, 300);
-			std::string file = std::string(dummy);
-			boost::algorithm::trim(file);
-			if (!file.empty()) {
-				im_fname.push_back(std::string(dummy));
-				os << std::string(dummy) << endl;
-			}
-		}
-		fp.close();
-		os.close();
-		num_slices_z = im_fname.size();
-		cout << "im_fname = " << im_fname[0] << endl;
-		mis_ptr.reset(new DICOMsequence(im_fname));
-	} else {
-		mis_ptr.reset(new PCLsequence(image_file));
-		// std::ofstream os(std::string(output_directory) + "\\source_image.txt"); //MWW 03282020
-		std::ofstream os(std::string(output_directory) + "/source_image.txt");
-		std::string abs_image = boost::filesystem::absolute(image_file).string(),
-			// abs_out = boost::filesystem::absolute(output_directory).string()+"\\";
-			abs_out = boost::filesystem::absolute(output_directory).string()+"/";
-		if (boost::starts_with(abs_image, abs_out)) {
-			os << abs_image.substr(abs_out.length());
-		} else os << abs_image;
-		os.close();
-		num_slices_z = mis_ptr->num_images();
-	}
-	MedicalImageSequence &mis = *mis_ptr;
-
-	cout << "Done reading " << num_slices_z << " slices" << endl;
-
-	int i;
-	im_inst_nums = new int [num_slices_z];
-	for(i=0; i<num_slices_z; i++) {
-		im_inst_nums[i] = mis.instance_number(i);
-	}
-
-	cout << "checking slice locations....." << endl;
-	// Check that slice locations are valid and reorder if necessary
-	int prevLocSet=0, prevDiffSet=0;
-	float currDiff=0, prevLoc=0, prevDiff=0;
-	int slice_loc_ok=1;
-	float* sliceLocs = new float [mis.zdim()];
-	for(i=0; i<mis.zdim() && slice_loc_ok; i++) {
-		float ih_location = mis.slice_location(i);
-		//cout << "i=" << i << endl;
-		//cout << "inst num=" << mis.image(i).instance_number() << endl;
-		//cout << "loc=" << ih_location << endl;
-
-        if (prevLocSet) {
-  			currDiff = ih_location - prevLoc;
-
-  			if (prevDiffSet) slice_loc_ok = ((currDiff*prevDiff)>0);
-  			prevDiff = currDiff;
-  			prevDiffSet = 1;
-  		}
-  		//cout << "diff=" << currDiff << endl;
-  		prevLoc = ih_location;
-  		prevLocSet = 1;
-  		if (currDiff<0) sliceLocs[i] = -ih_location;
-        else sliceLocs[i] = ih_location;
-        //cout << "ok=" << slice_loc_ok << endl;
-      }
-      if (!slice_loc_ok) {
-	  	cerr << "ERROR: miu.cc: problem with slice locations: " << endl;
-	  	cerr << "near image with instance number " << mis.image(i-1).instance_number() << endl;
-	  	exit(1);
-	  }
-	  // **** MIU code assumes that slice location increases as z increases, so need this ****
-      if ((currDiff<0)&&(mis.zdim()>0)) sliceLocs[0] = -1*sliceLocs[0];
-      for(i=0; i<mis.zdim(); i++) {
-		  mis.slice_location(i, sliceLocs[i]);
-		//  cout << "slice location " << i << ": " << sliceLocs[i] << endl;
-	  }
-      delete [] sliceLocs;
-	  cout << "Done checking slice locations." << endl;
-
-	if (os_tl.x<0) os_tl.x = 0;
-	if (os_tl.y<0) os_tl.y = 0;
-	if (os_tl.z<0) os_tl.z = 0;
-	if (os_br.x<0) os_br.x = mis.xdim()-1;
-	if (os_br.y<0) os_br.y = mis.ydim()-1;
-	if (os_br.z<0) os_br.z = mis.zdim()-1;
-
-	// Unload (free) images that are outside bounding box given in input file
-	for (int z=0; z<mis.zdim(); z++)
-		if ((z<os_tl.z) || (z>os_br.z)) {
-			delete [] mis.image(z).pixel_data();
-		}
-
+/**
+Reads the model (the chromosome may be 0).
+Memory for the model is allocated in the function and must be deleted by the caller.
+*/
+Model* read_model(const char* model_file, const char *chromosome) {
 	std::cout << "Test: " << model_file << std::endl;
 	int s_ind;
 	for(s_ind=strlen(model_file)-1; (s_ind>0) && (model_file[s_ind]!='/' && model_file[s_ind]!='\\'); s_ind--);
@@ -177,12 +60,11 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 		strcpy(model_name, model_file);
 	}
 
-	Model* m;
 	cout << "Model name: " << model_name << endl;
 	cout << "Model path: " << path << endl;
 
 	//m = new Model (model_file, roi_directory, chromosome);
-	m = new Model (model_file,chromosome);
+	Model* m = new Model (model_file,chromosome);
 	//cout << "Model roi_directory = " << m->roi_directory() << endl;
 	cout << "Model chromosome = " << m->chromosome() << endl;
 
@@ -202,57 +84,84 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 	m->read();
 	//cout << *m;
 
-	ROI overall_sarea;
-	overall_sarea.add_box(os_tl, os_br);
-	Blackboard bb(mis, *m, overall_sarea, image_file, exec_directory, output_directory, roi_directory, edm_directory, 
-	            stop_at_node, user_resource_directory, condor_job_directory,
-				skip_normalized_image_png, skip_normalized_image_png_training,
-				skip_tensorboard_logging, predict_cpu_only);
-	overall_sarea.clear();
-
-	//cout << "here: " << bb.exec_directory() << endl;
+	return m;
+}
 
-	Darray<KnowledgeSource> ks(5);
+/**
+Adds the knowledge sources to the array.
+The knowledge sources are not modified while segmenting, so one array can be used for any number of (concurrent) cases.
+*/
+void create_knowledge_sources(Darray<KnowledgeSource>& ks) {
 	KnowledgeSource ModelMapper("ModelMapper", "ModelKS", ModelMapperS, ModelMapperA);
+	ModelMapper.rescore_on(KS_ACT_REC_ADDED);
 	ks.push_last(ModelMapper);
 
 	KnowledgeSource GroupFormer("GroupFormer", "SchedulerKS", GroupFormerS, GroupFormerA);
+	GroupFormer.rescore_on(KS_STRUCTURE_CHANGED);
 	ks.push_last(GroupFormer);
 
 	KnowledgeSource NextGroup("NextGroup", "SchedulerKS", NextGroupS, NextGroupA);
+	NextGroup.rescore_on(KS_ACT_REC_ADDED);
 	ks.push_last(NextGroup);
 
 	KnowledgeSource NextSolel("NextSolel", "SchedulerKS", NextSolelS, NextSolelA);
+	NextSolel.rescore_on(KS_NEXT_GROUP_CHANGED);
 	ks.push_last(NextSolel);
 
 	KnowledgeSource AddMatchedCandidates("AddMatchedCandidates", "SegmentationKS", AddMatchedCandidatesS, AddMatchedCandidatesA, SegmentationR);
+	AddMatchedCandidates.rescore_on(KS_NEXT_SOLEL_CHANGED | KS_NEXT_GROUP_CHANGED);
+	AddMatchedCandidates.rescore_after("NextGroup");
 	ks.push_last(AddMatchedCandidates);
 
 	KnowledgeSource DistanceMap2DPercLocal3DMax("DistanceMap2DPercLocal3DMax", "SegmentationKS", DistanceMap2DPercLocal3DMaxS, DistanceMap2DPercLocal3DMaxA, SegmentationR);
+	DistanceMap2DPercLocal3DMax.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	DistanceMap2DPercLocal3DMax.rescore_after("NextGroup");
+	DistanceMap2DPercLocal3DMax.parallel(true);
 	ks.push_last(DistanceMap2DPercLocal3DMax);
 
 	KnowledgeSource DistanceMapRegionGrowing("DistanceMapRegionGrowing", "SegmentationKS", DistanceMapRegionGrowingS, DistanceMapRegionGrowingA, SegmentationR);
+	DistanceMapRegionGrowing.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	DistanceMapRegionGrowing.rescore_after("NextGroup");
 	ks.push_last(DistanceMapRegionGrowing);
 	
 	KnowledgeSource DistanceMapWatershed("DistanceMapWatershed", "SegmentationKS", DistanceMapWatershedS, DistanceMapWatershedA, SegmentationR);
+	DistanceMapWatershed.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	DistanceMapWatershed.rescore_after("NextGroup");
 	ks.push_last(DistanceMapWatershed);
 
 	KnowledgeSource FormCandsFromSearchArea("FormCandsFromSearchArea", "SegmentationKS", FormCandsFromSearchAreaS, FormCandsFromSearchAreaA, SegmentationR);
+	FormCandsFromSearchArea.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	FormCandsFromSearchArea.rescore_after("SegmentationKS");
+	FormCandsFromSearchArea.rescore_after("NextGroup");
+	FormCandsFromSearchArea.parallel(true);
 	ks.push_last(FormCandsFromSearchArea);
 
 	KnowledgeSource GrowPartSolid("GrowPartSolid", "SegmentationKS", GrowPartSolidS, GrowPartSolidA, SegmentationR);
+	GrowPartSolid.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	GrowPartSolid.rescore_after("NextGroup");
 	ks.push_last(GrowPartSolid);
     
 	KnowledgeSource LineToDots("LineToDots", "SegmentationKS", LineToDotsS, LineToDotsA, SegmentationR);
+	LineToDots.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	LineToDots.rescore_after("NextGroup");
+	LineToDots.parallel(true);
 	ks.push_last(LineToDots);
 
 	KnowledgeSource MaxCostPath("MaxCostPath", "SegmentationKS", MaxCostPathS, MaxCostPathA, SegmentationR);
+	MaxCostPath.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	MaxCostPath.rescore_after("NextGroup");
+	MaxCostPath.parallel(true);
 	ks.push_last(MaxCostPath);
 
 	KnowledgeSource NeuralNetKeras("NeuralNetKeras", "SegmentationKS", NeuralNetKerasS, NeuralNetKerasA, SegmentationR);
+	NeuralNetKeras.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	NeuralNetKeras.rescore_after("NextGroup");
 	ks.push_last(NeuralNetKeras);
 
 	KnowledgeSource PlatenessThreshRegGrow("PlatenessThreshRegGrow", "SegmentationKS", PlatenessThreshRegGrowS, PlatenessThreshRegGrowA, SegmentationR);
+	PlatenessThreshRegGrow.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	PlatenessThreshRegGrow.rescore_after("NextGroup");
+	PlatenessThreshRegGrow.parallel(true);
 	ks.push_last(PlatenessThreshRegGrow);
 
 	// MWW 082920 - defined twice identically
@@ -266,57 +175,290 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 	// ks.push_last(PlatenessThreshRegGrow);
 
 	KnowledgeSource ReadMatchedRoi("ReadMatchedRoi", "SegmentationKS", ReadMatchedRoiS, ReadMatchedRoiA, SegmentationR);
+	ReadMatchedRoi.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	ReadMatchedRoi.rescore_after("SegmentationKS");
+	ReadMatchedRoi.rescore_after("NextGroup");
 	ks.push_last(ReadMatchedRoi);
 
 	KnowledgeSource SameCandidatesAs("SameCandidatesAs", "SegmentationKS", SameCandidatesAsS, SameCandidatesAsA, SegmentationR);
+	SameCandidatesAs.rescore_on(KS_NEXT_SOLEL_CHANGED | KS_NEXT_GROUP_CHANGED);
+	SameCandidatesAs.rescore_after("NextGroup");
 	ks.push_last(SameCandidatesAs);
     
 	KnowledgeSource ThreshRegGrow("ThreshRegGrow", "SegmentationKS", ThreshRegGrowS, ThreshRegGrowA, SegmentationR);
+	ThreshRegGrow.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	ThreshRegGrow.rescore_after("NextGroup");
+	ThreshRegGrow.parallel(true);
 	ks.push_last(ThreshRegGrow);
 
 	KnowledgeSource ImCandConf("ImCandConf", "InferencingKS", ImCandConfS, ImCandConfA, ImCandConfR);
+	ImCandConf.rescore_on(KS_ACT_REC_ADDED);
+	ImCandConf.parallel(true);
 	ks.push_last(ImCandConf);
 
 	KnowledgeSource FormGroupCands("FormGroupCands", "InferencingKS", FormGroupCandsS, FormGroupCandsA);
+	FormGroupCands.rescore_on(KS_ACT_REC_ADDED);
 	ks.push_last(FormGroupCands);
 
 	KnowledgeSource GroupCandConf("GroupCandConf", "InferencingKS", GroupCandConfS, GroupCandConfA);
+	GroupCandConf.rescore_on(KS_ACT_REC_ADDED);
 	ks.push_last(GroupCandConf);
 
 	KnowledgeSource MatchCands("MatchCands", "InferencingKS", MatchCandsS, MatchCandsA, MatchCandsR);
+	MatchCands.rescore_on(KS_ACT_REC_ADDED);
 	ks.push_last(MatchCands);
 
 	KnowledgeSource FreeCandidates("FreeCandidates", "MemManageKS", FreeCandidatesS, FreeCandidatesA, FreeCandidatesR);
+	FreeCandidates.rescore_on(KS_NEXT_SOLEL_CHANGED);
+	FreeCandidates.rescore_after("MatchCands");
+	FreeCandidates.rescore_after("NextGroup");
 	ks.push_last(FreeCandidates);
+}
 
-	
-	int best_ind = 0;
-	float act_score, best_score=1.0;
-	while (best_score>0.0) {
-		best_score = 0.0;
-//cout << "computing activation scores" << endl;
-		for(i=0; i<ks.N(); i++) {
-			act_score = ks[i].activation_score(bb);
-//cout << ks[i].name() << "   " << act_score << endl;
-			if (act_score>best_score) {
-				best_score = act_score;
-				best_ind = i;
-			}
+/**
+Writes the essential part of a primitive (see ImagePrimitive::writeEssentialOnly) to output_directory/primitive_file.
+If binary_roi is true, the ROIs of ImageRegions are written in the compressed binary ROI format (see ROIfile).
+*/
+void write_primitive_file(const char *output_directory, const std::string& primitive_file, const ImagePrimitive& prim, const bool binary_roi) {
+	if (binary_roi && !strcmp(prim.type(), "ImageRegion")) {
+		if (!ROIfile::write(std::string(output_directory)+"/"+primitive_file, ((const ImageRegion&)prim).roi()))
+			ROIfile::write(std::string(output_directory)+"\\"+primitive_file, ((const ImageRegion&)prim).roi());
+		return;
+	}
+	ofstream os(std::string(output_directory)+"/"+primitive_file); //MWW 03282020
+	if (!os) os.open(std::string(output_directory)+"\\"+primitive_file); //MB 210121
+	prim.writeEssentialOnly(os);
+	os.close();
+}
+
+/**
+Options of the segmentation of a case, set from the command line (see main).
+Directories and the stop-at node are null if not specified.
+*/
+struct SegmentationOptions {
+	const char* roi_directory;
+	const char* edm_directory;
+	const char* stop_at_node;
+	const char* user_resource_directory;
+	const char* condor_job_directory;
+	bool skip_normalized_image_png;
+	bool skip_normalized_image_png_training;
+	bool skip_tensorboard_logging;
+	bool predict_cpu_only;
+	/// Threads of the blackboard and of parallel solution elements
+	int num_threads;
+	/// Distance maps and watersheds by the external MyDistanceTransform.exe
+	bool external_edm;
+	/// Also polls all activation scores to check the scheduler
+	bool verify_scheduler;
+	/// Segments solution elements serially even with more than one thread
+	bool serial_solels;
+	/// Writes the knowledge source profile to the output directory
+	bool profile;
+	/// Beam width of the group candidate search, 0 for the exact search
+	int group_beam_width;
+	/// Writes candidate and matched ROIs in the binary ROI format
+	bool binary_roi;
+
+	SegmentationOptions()
+		: roi_directory(0), edm_directory(0), stop_at_node(0), user_resource_directory(0), condor_job_directory(0),
+		skip_normalized_image_png(false), skip_normalized_image_png_training(false), skip_tensorboard_logging(false), predict_cpu_only(false),
+		num_threads(1), external_edm(false), verify_scheduler(false), serial_solels(false), profile(false), group_beam_width(0), binary_roi(false) {}
+};
+
+/**
+Reads the image of a case: IMAGE_FILE lists DICOM files, one per line, if its extension is txt, seri, ser or sers, otherwise it is read by PCLsequence.
+The DICOM file names are appended to dicom_files.
+The slice locations are checked, and negated if they decrease with z (see do_segmentation).
+*/
+boost::shared_ptr<MedicalImageSequence> read_image(const char *image_file, std::vector<std::string>& dicom_files) {
+	std::string extension = pcl::FileNameTokenizer(image_file).getExtensionWithoutDot();
+	boost::shared_ptr<MedicalImageSequence> mis_ptr;
+	if (extension.compare("txt")==0 || extension.compare("seri")==0 || extension.compare("ser")==0 || extension.compare("sers")==0) {
+		cout << "Reading dicom image data..." << endl;
+		std::ifstream fp(image_file);
+		if (!fp) {
+			cerr << "ERROR: unable to open input file: " << image_file << endl;
+			exit(1);
 		}
+		char dummy[300];
+		while(!fp.eof()) {
+			fp.getline(dummy, 300);
+			std::string file = std::string(dummy);
+			boost::algorithm::trim(file);
+			if (!file.empty())
+				dicom_files.push_back(std::string(dummy));
+		}
+		fp.close();
+		cout << "im_fname = " << dicom_files[0] << endl;
+		mis_ptr.reset(new DICOMsequence(dicom_files));
+	} else
+		mis_ptr.reset(new PCLsequence(image_file));
+	MedicalImageSequence &mis = *mis_ptr;
+
+	cout << "Done reading " << mis.num_images() << " slices" << endl;
+
+	int i;
+	cout << "checking slice locations....." << endl;
+	// Check that slice locations are valid and reorder if necessary
+	int prevLocSet=0, prevDiffSet=0;
+	float currDiff=0, prevLoc=0, prevDiff=0;
+	int slice_loc_ok=1;
+	float* sliceLocs = new float [mis.zdim()];
+	for(i=0; i<mis.zdim() && slice_loc_ok; i++) {
+		float ih_location = mis.slice_location(i);
+		//cout << "i=" << i << endl;
+		//cout << "inst num=" << mis.image(i).instance_number() << endl;
+		//cout << "loc=" << ih_location << endl;
+
+        if (prevLocSet) {
+  			currDiff = ih_location - prevLoc;
 
-		if (best_score>0.0) {
-			cout << "Activating " << ks[best_ind].name() << "...." << endl;
-			ks[best_ind].activate(bb);
-			cout << "Done" << endl;
-			ks[best_ind].add_activation_rec(bb);
+  			if (prevDiffSet) slice_loc_ok = ((currDiff*prevDiff)>0);
+  			prevDiff = currDiff;
+  			prevDiffSet = 1;
+  		}
+  		//cout << "diff=" << currDiff << endl;
+  		prevLoc = ih_location;
+  		prevLocSet = 1;
+  		if (currDiff<0) sliceLocs[i] = -ih_location;
+        else sliceLocs[i] = ih_location;
+        //cout << "ok=" << slice_loc_ok << endl;
+      }
+      if (!slice_loc_ok) {
+	  	cerr << "ERROR: miu.cc: problem with slice locations: " << endl;
+	  	cerr << "near image with instance number " << mis.image(i-1).instance_number() << endl;
+	  	exit(1);
+	  }
+	  // **** MIU code assumes that slice location increases as z increases, so need this ****
+      if ((currDiff<0)&&(mis.zdim()>0)) sliceLocs[0] = -1*sliceLocs[0];
+      for(i=0; i<mis.zdim(); i++) {
+		  mis.slice_location(i, sliceLocs[i]);
+		//  cout << "slice location " << i << ": " << sliceLocs[i] << endl;
+	  }
+      delete [] sliceLocs;
+	  cout << "Done checking slice locations." << endl;
+
+	return mis_ptr;
+}
+
+/**
+Writes the source of the image to the output directory: dicom.seri listing the DICOM files read by read_image,
+or source_image.txt holding the image file (relative to the output directory if it is in it).
+*/
+void write_image_source(const char *image_file, const std::vector<std::string>& dicom_files, const char *output_directory) {
+	if (!dicom_files.empty()) {
+		// std::ofstream os(std::string(output_directory) + "\\dicom.seri"); //MWW 03282020
+		std::ofstream os(std::string(output_directory) + "/dicom.seri");
+		for(size_t i=0; i<dicom_files.size(); i++)
+			os << dicom_files[i] << endl;
+		os.close();
+	} else {
+		// std::ofstream os(std::string(output_directory) + "\\source_image.txt"); //MWW 03282020
+		std::ofstream os(std::string(output_directory) + "/source_image.txt");
+		std::string abs_image = boost::filesystem::absolute(image_file).string(),
+			// abs_out = boost::filesystem::absolute(output_directory).string()+"\\";
+			abs_out = boost::filesystem::absolute(output_directory).string()+"/";
+		if (boost::starts_with(abs_image, abs_out)) {
+			os << abs_image.substr(abs_out.length());
+		} else os << abs_image;
+		os.close();
+	}
+}
+
+/**
+Segments one case with a model read by read_model and knowledge sources from create_knowledge_sources.
+mis and dicom_files are the image read from image_file by read_image, which is not modified (it can be segmented with several models).
+The output directory must exist.
+If a memo is given, candidates stored in it by segmentations of the same image with other chromosomes are reused (see SolelMemo).
+*/
+int do_segmentation(const char *image_file, MedicalImageSequence& mis, const std::vector<std::string>& dicom_files, Model& model, const Darray<KnowledgeSource>& ks,
+					const char *exec_directory, const char *output_directory, const SegmentationOptions& opt, SolelMemo* memo=0) {
+	if (opt.roi_directory) cout << "ROI directory = " << opt.roi_directory << endl;
+	else cout << "ROI directory not specified" << endl;
+	if (opt.edm_directory) cout << "EDM directory = " << opt.edm_directory << endl;
+	else cout << "EDM directory not specified" << endl;
+	if (opt.stop_at_node) cout << "Stop at Node = " << opt.stop_at_node << endl;
+	else cout << "Stop at Node not specified" << endl;
+	if (opt.user_resource_directory) cout << "User Resource Directory  = " << opt.user_resource_directory << endl;
+	else cout << "User Resource Directory not specified" << endl;
+	if (opt.condor_job_directory) cout << "Condor Job Directory  = " << opt.condor_job_directory << endl;
+	else cout << "MIU will be run by locally" << endl;
+
+	write_image_source(image_file, dicom_files, output_directory);
+
+	std::string write_bb_fn = std::string(output_directory) + "/blackboard.out";
+	//boost::filesystem::path write_bb_fn = std::string(output_directory) / std::string("blackboard.out");
+
+	Point os_tl(-1,-1,-1), os_br(-1,-1,-1);
+	int* im_inst_nums;
+	int num_slices_z = mis.num_images();
+
+	int ok = 0;
+
+
+	int i;
+	im_inst_nums = new int [num_slices_z];
+	for(i=0; i<num_slices_z; i++) {
+		im_inst_nums[i] = mis.instance_number(i);
+	}
+
+
+	if (os_tl.x<0) os_tl.x = 0;
+	if (os_tl.y<0) os_tl.y = 0;
+	if (os_tl.z<0) os_tl.z = 0;
+	if (os_br.x<0) os_br.x = mis.xdim()-1;
+	if (os_br.y<0) os_br.y = mis.ydim()-1;
+	if (os_br.z<0) os_br.z = mis.zdim()-1;
+
+	// Unload (free) images that are outside bounding box given in input file
+	for (int z=0; z<mis.zdim(); z++)
+		if ((z<os_tl.z) || (z>os_br.z)) {
+			delete [] mis.image(z).pixel_data();
 		}
 
+	ROI overall_sarea;
+	overall_sarea.add_box(os_tl, os_br);
+	Blackboard bb(mis, model, overall_sarea, image_file, exec_directory, output_directory, opt.roi_directory, opt.edm_directory, 
+	            opt.stop_at_node, opt.user_resource_directory, opt.condor_job_directory,
+				opt.skip_normalized_image_png, opt.skip_normalized_image_png_training,
+				opt.skip_tensorboard_logging, opt.predict_cpu_only);
+	bb.num_threads(opt.num_threads);
+	bb.external_edm(opt.external_edm);
+	bb.group_beam_width(opt.group_beam_width);
+	overall_sarea.clear();
+
+	//cout << "here: " << bb.exec_directory() << endl;
+
+	// Activation scores are recomputed only after the blackboard events each knowledge source was registered for (rescore_on, rescore_after)
+	KSscheduler scheduler(ks);
+	scheduler.verify(opt.verify_scheduler);
+	KSprofiler profiler;
+	if (opt.profile)
+		scheduler.profile(&profiler);
+	scheduler.memo(memo);
+	// Knowledge sources marked parallel segment independent solution elements on worker threads, the results are used in the serial activation order
+	// Not used with a stop-at node since solution elements after it would write search areas that serial processing does not
+	if ((opt.num_threads>1) && !opt.serial_solels && (bb.stop_at_node().length()==0))
+		scheduler.parallel_solels(bb, opt.num_threads);
+	int best_ind;
+	while ((best_ind = scheduler.next(bb))>-1) {
+		cout << "Activating " << ks[best_ind].name() << "...." << endl;
+		scheduler.activate(best_ind, bb);
+		cout << "Done" << endl;
+
 		// *******
 		// if a lung ROI was passed into do_segmentation and the BB contains a (lung_prone_model with an unmatched air_containing SE) OR a (lung_model with an unmatched lung SE)
 		// then set the best candidate of the SE to be the ROI => set the matched candidate of the SE (see InferencingKS.MatchCandsA) find the group containing the SE and set its priority to -1.0 so that it won't be processed any further (see SchedulerKS.NextGroupA), also make sure it is the only SE in the group (otherwise throw an exception?)
 		// set the lung ROI argument to null
 		// *******
 	}
+	scheduler.print_timing(cout);
+	cout << "Search area cache: " << bb.search_area_cache().num_hits() << " hits, " << bb.search_area_cache().num_misses() << " misses, " << bb.search_area_cache().num_entries() << " stored" << endl;
+	scheduler.profile(0);
+	scheduler.memo(0);
+	if (opt.profile)
+		profiler.write(output_directory, image_file);
 
 	// Modify Rois to accommodate image instance numbers
 	// check if image instance numbers are continuous to decide whether ROIs can be translated using their own method or whether the translation method defined in this class is required
@@ -462,11 +604,7 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 				if (is_matched[i]) primitive_file += "_m";
 				primitive_file += candidate->primitive()->extension();
 				std::cout << "Saving: " << primitive_file << "...";  std::cout << std::flush;
-				// ofstream os(std::string(output_directory)+"\\"+primitive_file); //MWW 03282020
-				ofstream os(std::string(output_directory)+"/"+primitive_file); //MWW 03282020
-				if (!os) os.open(std::string(output_directory)+"\\"+primitive_file); //MB 210121
-				candidate->primitive()->writeEssentialOnly(os);
-				os.close();
+				write_primitive_file(output_directory, primitive_file, *candidate->primitive(), opt.binary_roi);
 				std::cout << "Done" << std::endl;  std::cout << std::flush;
 				outfile << "RoiFile: " << primitive_file << std::endl;
 				file_list_out << primitive_file << std::endl;
@@ -478,11 +616,7 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 				std::cout << "#";  std::cout << std::flush;
 				std::string primitive_file = sol_elem.name()+sol_elem.matched_prim()->extension();
 				std::cout << "Saving: " << primitive_file << "...";  std::cout << std::flush;
-				// ofstream os(std::string(output_directory)+"\\"+primitive_file); //MWW 03282020
-				ofstream os(std::string(output_directory)+"/"+primitive_file); //MWW 03282020
-				if (!os) os.open(std::string(output_directory)+"\\"+primitive_file); //MB 210121
-				sol_elem.matched_prim()->writeEssentialOnly(os);
-				os.close();
+				write_primitive_file(output_directory, primitive_file, *sol_elem.matched_prim(), opt.binary_roi);
 				std::cout << "Done" << std::endl;  std::cout << std::flush;
 				file_list_out << primitive_file << std::endl;
 				outfile << "MatchedPrimitiveRoiFile: " << primitive_file << std::endl;
@@ -507,7 +641,6 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 	//bb.write_act_recs(cout);
 
 	cout << "Almost Done - do_segmentation" << endl;
-	delete m;
 	delete im_inst_nums;
 	cout << "Done - do_segmentation" << endl;
 
@@ -520,6 +653,14 @@ int do_segmentation(const char *image_file, const char* model_file, const char *
 	return 0;
 }
 
+/// Reads the image of the case (see read_image) and segments it (see the other form of do_segmentation)
+int do_segmentation(const char *image_file, Model& model, const Darray<KnowledgeSource>& ks, const char *exec_directory, const char *output_directory, 
+					const SegmentationOptions& opt) {
+	std::vector<std::string> dicom_files;
+	boost::shared_ptr<MedicalImageSequence> mis = read_image(image_file, dicom_files);
+	return do_segmentation(image_file, *mis, dicom_files, model, ks, exec_directory, output_directory, opt);
+}
+
 bool is_directory_used(const std::string& path)
 {
 	if(!boost::filesystem::is_directory(path)) return false;
@@ -558,6 +699,205 @@ bool isBinary (const char* s) {
 }
 
 
+/**
+Creates the output directory if it does not exist.
+If it exists and is not empty, it is deleted and recreated when force is true, otherwise false is returned (the case is skipped).
+*/
+bool prepare_output_directory(const std::string& output_directory, const bool force)
+{
+	if (!boost::filesystem::exists(output_directory)) boost::filesystem::create_directories(output_directory);
+	else {
+		if (is_directory_used(output_directory)) {
+			if (force) {
+				std::cout << "Deleting " << output_directory << std::endl;
+				boost::filesystem::remove_all(output_directory);
+				std::cout << "Recreating " << output_directory << std::endl;
+				bool error = true;
+				while (error) {
+					error = false;
+					try {
+						boost::filesystem::create_directories(output_directory);
+					} catch (...) {
+						error = true;
+						//boost::this_thread::sleep(boost::posix_time::millisec(2000));
+					}
+				}
+			} else {
+				std::cout << "Skipping as output directory " << output_directory << " is not empty!" << std::endl;
+				std::cout << "Please delete the contents in " << output_directory << " if you wish or use -f option (WARNING: will delete whatever files or directories in OUTPUT_DIRECTORY!) to reuse it." << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+Segments the cases listed in case_list_file (or read from standard input if it is "-"), one case per line: IMAGE_FILE, optionally followed by a tab and a case name.
+The model and knowledge sources are shared by all cases, each case gets its own Blackboard.
+Outputs are written to output_directory/CASE_NAME, where the case name defaults to the image file name without extension.
+If roi_directory or edm_directory are given, the case name subdirectories of them are used.
+num_cases cases are segmented concurrently, each using num_threads/num_cases threads.
+With more than one concurrent case the solution elements of each case are segmented serially: the parallelism is across cases, and the prefetchers of concurrent cases would compete for the same threads.
+Lines are read as cases are started, so cases can be streamed on standard input.
+*/
+int do_batch(const char *case_list_file, Model& model, const Darray<KnowledgeSource>& ks, const char *exec_directory, const char *output_directory, const bool force, const int num_cases,
+					const SegmentationOptions& opt) {
+	std::ifstream list_file;
+	const bool use_stdin = !strcmp(case_list_file, "-");
+	if (!use_stdin) {
+		list_file.open(case_list_file);
+		if (!list_file) {
+			cerr << "ERROR: do_batch: unable to open case list file: " << case_list_file << endl;
+			exit(1);
+		}
+	}
+	std::istream& in = use_stdin ? std::cin : list_file;
+
+	if (!boost::filesystem::exists(output_directory)) boost::filesystem::create_directories(output_directory);
+
+	const int case_threads = (opt.num_threads/num_cases>1) ? opt.num_threads/num_cases : 1;
+	std::mutex mutex;
+	int num_read=0, num_done=0, num_skipped=0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	auto segment_cases = [&]() {
+		std::string line;
+		for(;;) {
+			int case_number;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				do {
+					if (!std::getline(in, line))
+						return;
+					boost::algorithm::trim(line);
+				} while (line.empty() || (line[0]=='#'));
+				case_number = ++num_read;
+			}
+
+			std::string image_file = line, case_name;
+			size_t tab = line.find('\t');
+			if (tab!=std::string::npos) {
+				image_file = line.substr(0, tab);
+				case_name = line.substr(tab+1);
+				boost::algorithm::trim(image_file);
+				boost::algorithm::trim(case_name);
+			}
+			if (case_name.empty())
+				case_name = boost::filesystem::path(image_file).stem().string();
+
+			std::string case_output = std::string(output_directory) + "/" + case_name;
+			std::string case_roi = opt.roi_directory ? std::string(opt.roi_directory) + "/" + case_name : std::string();
+			std::string case_edm = opt.edm_directory ? std::string(opt.edm_directory) + "/" + case_name : std::string();
+			if (opt.edm_directory && !boost::filesystem::exists(case_edm)) boost::filesystem::create_directories(case_edm);
+
+			cout << "Case " << case_number << ": " << image_file << " -> " << case_output << endl;
+			if (!prepare_output_directory(case_output, force)) {
+				std::lock_guard<std::mutex> lock(mutex);
+				num_skipped++;
+				continue;
+			}
+
+			SegmentationOptions case_opt = opt;
+			case_opt.roi_directory = opt.roi_directory ? case_roi.c_str() : 0;
+			case_opt.edm_directory = opt.edm_directory ? case_edm.c_str() : 0;
+			case_opt.num_threads = case_threads;
+			if (num_cases>1)
+				case_opt.serial_solels = true;
+			do_segmentation(image_file.c_str(), model, ks, exec_directory, case_output.c_str(), case_opt);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			num_done++;
+			cout << "Case " << case_number << " done (" << case_name << ")" << endl;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(int i=1; i<num_cases; i++)
+		workers.push_back(std::thread(segment_cases));
+	segment_cases();
+	for(size_t i=0; i<workers.size(); i++)
+		workers[i].join();
+
+	cout << "Batch done: " << num_done << " cases segmented, " << num_skipped << " skipped, "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() << " seconds" << endl;
+
+	return 0;
+}
+
+/**
+Segments one case with each chromosome listed in chromosome_list_file, one chromosome (binary or hexadecimal) per line, optionally followed by a tab and a name.
+The image and the model are read once, and each chromosome is applied to a copy of the model. The outputs are stored in output_directory/NAME, where the name defaults to chromosome_N (N counts the chromosomes from 1).
+The chromosomes are segmented one after the other. Solution elements whose chromosome bits, and those of the solution elements they depend on, are the same as for an earlier chromosome
+reuse the candidates formed for it instead of being segmented again (see SolelMemo).
+*/
+int do_chromosomes(const char *image_file, const char *model_file, const char *chromosome_list_file, const Darray<KnowledgeSource>& ks, const char *exec_directory, const char *output_directory, const bool force,
+					const SegmentationOptions& opt) {
+	std::ifstream list_file(chromosome_list_file);
+	if (!list_file) {
+		cerr << "ERROR: do_chromosomes: unable to open chromosome list file: " << chromosome_list_file << endl;
+		exit(1);
+	}
+
+	if (!boost::filesystem::exists(output_directory)) boost::filesystem::create_directories(output_directory);
+
+	std::vector<std::string> dicom_files;
+	boost::shared_ptr<MedicalImageSequence> mis = read_image(image_file, dicom_files);
+	Model* model = read_model(model_file, 0);
+
+	SolelMemo memo(std::string(output_directory) + "/solel_memo");
+	int num_read=0, num_done=0, num_skipped=0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::string line;
+	while (std::getline(list_file, line)) {
+		boost::algorithm::trim(line);
+		if (line.empty() || (line[0]=='#'))
+			continue;
+		num_read++;
+
+		std::string chromosome = line, name;
+		size_t tab = line.find('\t');
+		if (tab!=std::string::npos) {
+			chromosome = line.substr(0, tab);
+			name = line.substr(tab+1);
+			boost::algorithm::trim(chromosome);
+			boost::algorithm::trim(name);
+		}
+		if (name.empty())
+			name = "chromosome_" + boost::lexical_cast<std::string>(num_read);
+		char* chromosome_bin;
+		if (isBinary(chromosome.c_str())) {
+			chromosome_bin = new char [chromosome.length()+1];
+			strcpy(chromosome_bin, chromosome.c_str());
+		}
+		else
+			chromosome_bin = hexToBinary(chromosome.c_str());
+
+		std::string chromosome_output = std::string(output_directory) + "/" + name;
+		cout << "Chromosome " << num_read << ": " << chromosome << " -> " << chromosome_output << endl;
+		if (!prepare_output_directory(chromosome_output, force)) {
+			num_skipped++;
+			delete [] chromosome_bin;
+			continue;
+		}
+
+		Model m(*model, chromosome_bin);
+		cout << "Model chromosome = " << m.chromosome() << endl;
+		do_segmentation(image_file, *mis, dicom_files, m, ks, exec_directory, chromosome_output.c_str(), opt, &memo);
+		delete [] chromosome_bin;
+
+		num_done++;
+		cout << "Chromosome " << num_read << " done (" << name << ")" << endl;
+	}
+
+	delete model;
+
+	cout << "Chromosomes done: " << num_done << " segmented, " << num_skipped << " skipped, " << memo.num_replayed() << " segmentations reused, "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() << " seconds" << endl;
+
+	return 0;
+}
+
 int main(int argc, char *argv[]) pcl_MainStart {
 					//std::cout << "Number of arguments " << argc << std::endl;
 					//for (int m=0; m<argc; m++) std::cout << "Argument " << m << ": " << argv[m] << std::endl;
@@ -620,9 +960,20 @@ int main(int argc, char *argv[]) pcl_MainStart {
 	parser.addOption<std::string>(1, "-u", "-u USER_RESOURCE_DIRECTORY", "Directory where the resource configuration files for CNN nodes are stored. If this is not specified, default resource (a single-core CPU) will be used instead.");
 	parser.addOption<std::string>(1, "-w", "-w CONDOR_JOB_DIRECTORY", "Directory where the condor job and resource configuration files for CNN nodes are stored. If this is not specified, it will be run by locally instead of using Condor.");
 	parser.addOption("-p", "Prediction only with a single-core CPU");
+	parser.addOption("-ps", "Run cnn_predict.py in a new python process for every CNN prediction, instead of the persistent prediction worker (script/cnn_predict_server.py) that keeps tensorflow and the network weights loaded");
 	parser.addOption("-i", "Skip generating png image to review the normalized input");
 	parser.addOption("-it", "Skip generating png image to review the normalized input for training phase");
 	parser.addOption("-t", "Skip generating tensorboard logging");
+	parser.addOption<int>(1, "-j", "-j NUM_THREADS", "Number of threads used for in-process image computations (e.g., distance maps) and for segmenting independent solution elements in parallel. Default is the number of hardware threads.");
+	parser.addOption("-x", "Use the external MyDistanceTransform.exe (legacy) to compute distance maps and watersheds instead of computing them in-process");
+	parser.addOption("-sv", "Verify the knowledge source scheduler by also polling all activation scores (slow, for debugging)");
+	parser.addOption("-ss", "Segment solution elements serially even if more than one thread is used");
+	parser.addOption("-b", "Batch mode: IMAGE_FILE is a list of cases (\"-\" for standard input), one IMAGE_FILE per line optionally followed by a tab and a case name. The model is read once, and the outputs of each case are stored in OUTPUT_DIRECTORY/CASE_NAME (default case name is the image file name without extension). ROI_DIRECTORY and WORKING_DIRECTORY also refer to CASE_NAME subdirectories.");
+	parser.addOption<std::string>(1, "-cl", "-cl CHROMOSOME_LIST", "Segments IMAGE_FILE with each chromosome listed in the CHROMOSOME_LIST file, one chromosome per line optionally followed by a tab and a name. The outputs of each chromosome are stored in OUTPUT_DIRECTORY/NAME (default name is chromosome_N, N counting from 1). Nodes whose chromosome bits, and those of the nodes they depend on, are the same as for an earlier chromosome reuse its candidates instead of being segmented again.");
+	parser.addOption("-prof", "Profile the knowledge source activations: wall and CPU time, peak memory increase, external process time and candidates formed are written to ks_profile.csv and ks_profile.json in OUTPUT_DIRECTORY, and as a Chrome trace to ks_trace.json");
+	parser.addOption("-rb", "Write the candidate and matched ROI files (NODE-N.roi, NODE.roi) in the compressed binary ROI format, which is smaller and faster to read than the text format (ROI files read by miu may be in either format)");
+	parser.addOption<int>(1, "-gb", "-gb BEAM_WIDTH", "Approximate group candidate search: only the BEAM_WIDTH partial group candidates with the highest confidences are extended for each node of a group (default is the exact branch-and-bound search). Bounds the time and memory used for groups of nodes with many candidates.");
+	parser.addOption<int>(1, "-n", "-n NUM_CASES", "Number of cases segmented concurrently in batch mode (default 1). The NUM_THREADS threads are divided among the cases.");
 	parser.update();
 
 	//cout << argv[0] << endl;
@@ -642,30 +993,15 @@ int main(int argc, char *argv[]) pcl_MainStart {
 	//std::cout << exec_directory << std::endl;
 	//std::cout << output_directory << std::endl;
 
-	if (!boost::filesystem::exists(output_directory)) boost::filesystem::create_directories(output_directory);
-	else {
-		if (is_directory_used(output_directory)) {
-			if (parser.get("-f")->declared()) {
-				std::cout << "Deleting " << output_directory << std::endl;
-				boost::filesystem::remove_all(output_directory);
-				std::cout << "Recreating " << output_directory << std::endl;
-				bool error = true;
-				while (error) {
-					error = false;
-					try {
-						boost::filesystem::create_directories(output_directory);
-					} catch (...) {
-						error = true;
-						//boost::this_thread::sleep(boost::posix_time::millisec(2000));
-					}
-				}
-			} else {
-				std::cout << "Skipping as output directory " << output_directory << " is not empty!" << std::endl;
-				std::cout << "Please delete the contents in " << output_directory << " if you wish or use -f option (WARNING: will delete whatever files or directories in OUTPUT_DIRECTORY!) to reuse it." << std::endl;
-				return 0;
-			}
-		}
+	bool force = parser.get("-f")->declared();
+	bool batch = parser.get("-b")->declared();
+	bool chromosome_list = parser.get("-cl")->declared();
+	if (batch && chromosome_list) {
+		cerr << "ERROR: miu_nod: -b and -cl cannot be used together" << endl;
+		exit(1);
 	}
+	if (!batch && !chromosome_list && !prepare_output_directory(output_directory, force))
+		return 0;
 
 	//if (parser.get("-c")->declared()) {
 	//	return do_segmentation(image_file.c_str(), model_file.c_str(), output_directory.c_str(), parser.get("-c")->getElementDatum().c_str());
@@ -679,10 +1015,10 @@ int main(int argc, char *argv[]) pcl_MainStart {
 	char* stop_at_node = 0;
 	char* user_resource_directory = 0;
 	char* condor_job_directory = 0;
-	bool skip_normalized_image_png = false;
-	bool skip_normalized_image_png_training = false;
-	bool skip_tensorboard_logging = false;
-	bool predict_cpu_only = false;
+	SegmentationOptions opt;
+	opt.num_threads = std::thread::hardware_concurrency();
+	if (opt.num_threads<1) opt.num_threads = 1;
+	int num_cases = 1;
 	if (parser.get("-r")->declared()) {
 		//std::cout <<  parser.get("-r")->getElementDatum().c_str() << std::endl;
 		roi_directory = new char [strlen(parser.get("-r")->getElementDatum().c_str())+1];
@@ -716,25 +1052,84 @@ int main(int argc, char *argv[]) pcl_MainStart {
 	}
 	if (parser.get("-p")->declared()) {
 		std::cout << "Prediction only with a single-core CPU" << std::endl;
-		predict_cpu_only = true;
+		opt.predict_cpu_only = true;
+	}
+	if (parser.get("-ps")->declared()) {
+		std::cout << "Running cnn_predict.py for every CNN prediction" << std::endl;
+		CnnPredictWorker::disable();
 	}
 	if (parser.get("-i")->declared()) {
 		std::cout << "Skipping generate png normalized input " << std::endl;
-		skip_normalized_image_png = true;
+		opt.skip_normalized_image_png = true;
 	}
 	if (parser.get("-it")->declared()) {
 		std::cout << "Skipping generate png normalized input for training" << std::endl;
-		skip_normalized_image_png_training = true;
+		opt.skip_normalized_image_png_training = true;
 	}
 	if (parser.get("-t")->declared()) {
 		std::cout << "Skipping generate tensorboard logging " << std::endl;
-		skip_tensorboard_logging = true;
+		opt.skip_tensorboard_logging = true;
+	}
+	if (parser.get("-j")->declared()) {
+		opt.num_threads = parser.get("-j")->getElementDatum<int>();
+		if (opt.num_threads<1) opt.num_threads = 1;
+	}
+	std::cout << "Number of threads = " << opt.num_threads << std::endl;
+	if (parser.get("-x")->declared()) {
+		std::cout << "Using external MyDistanceTransform.exe for distance maps" << std::endl;
+		opt.external_edm = true;
+	}
+	if (parser.get("-sv")->declared()) {
+		std::cout << "Verifying knowledge source scheduler" << std::endl;
+		opt.verify_scheduler = true;
+	}
+	if (parser.get("-ss")->declared()) {
+		std::cout << "Segmenting solution elements serially" << std::endl;
+		opt.serial_solels = true;
+	}
+	if (parser.get("-prof")->declared()) {
+		std::cout << "Profiling knowledge source activations" << std::endl;
+		opt.profile = true;
+	}
+	if (parser.get("-rb")->declared()) {
+		std::cout << "Writing binary ROI files" << std::endl;
+		opt.binary_roi = true;
 	}
+	if (parser.get("-gb")->declared()) {
+		opt.group_beam_width = parser.get("-gb")->getElementDatum<int>();
+		if (opt.group_beam_width<1) {
+			cerr << "ERROR: -gb: the beam width must be at least 1" << endl;
+			exit(1);
+		}
+		std::cout << "Group candidate search beam width = " << opt.group_beam_width << std::endl;
+	}
+	if (parser.get("-n")->declared()) {
+		num_cases = parser.get("-n")->getElementDatum<int>();
+		if (num_cases<1) num_cases = 1;
+	}
+
+	opt.roi_directory = roi_directory;
+	opt.edm_directory = working_directory;
+	opt.stop_at_node = stop_at_node;
+	opt.user_resource_directory = user_resource_directory;
+	opt.condor_job_directory = condor_job_directory;
 
-	int stat = do_segmentation(image_file.c_str(), model_file.c_str(), exec_directory.c_str(), output_directory.c_str(), 
-	                        roi_directory, working_directory, chromosome, stop_at_node, 
-							user_resource_directory, condor_job_directory,
-							skip_normalized_image_png, skip_normalized_image_png_training, skip_tensorboard_logging, predict_cpu_only);
+	// The model is read and the knowledge sources are created once, also for a batch of cases (do_chromosomes reads the model and the image once for all chromosomes)
+	Model* m = chromosome_list ? 0 : read_model(model_file.c_str(), chromosome);
+	Darray<KnowledgeSource> ks(5);
+	create_knowledge_sources(ks);
+
+	int stat;
+	if (chromosome_list) {
+		if (chromosome)
+			cout << "WARNING: -c is ignored, the chromosomes are read from " << parser.get("-cl")->getElementDatum() << endl;
+		stat = do_chromosomes(image_file.c_str(), model_file.c_str(), parser.get("-cl")->getElementDatum().c_str(), ks, exec_directory.c_str(), output_directory.c_str(), force, opt);
+	}
+	else if (batch)
+		stat = do_batch(image_file.c_str(), *m, ks, exec_directory.c_str(), output_directory.c_str(), force, num_cases, opt);
+	else
+		stat = do_segmentation(image_file.c_str(), *m, ks, exec_directory.c_str(), output_directory.c_str(), opt);
+	delete m;
 
 	// ***** MASK TEST ****
 	//int stat = 1; 
@@ -0,0 +1,94 @@
+#ifndef __simd_miu_h_
+#define __simd_miu_h_
+
+/**
+Small portable layer over the SSE2 and AVX2 intrinsics used for vectorized pixel conversions.
+The instruction set is selected at compile time (-mavx2 or /arch:AVX2 for AVX2, SSE2 is always available on x86-64);
+with NO_SIMD defined, or on other architectures, the scalar code is used.
+All paths give identical results: products and sums are rounded separately (no fused multiply-add)
+and conversions truncate toward zero and saturate to the range of short.
+*/
+
+#if !defined(NO_SIMD) && defined(__AVX2__)
+#define SIMD_MIU_AVX2
+#include <immintrin.h>
+#elif !defined(NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP>=2)))
+#define SIMD_MIU_SSE2
+#include <emmintrin.h>
+#endif
+
+/// Name of the instruction set used by the layer
+inline const char* simd_miu_name()
+{
+#if defined(SIMD_MIU_AVX2)
+	return "AVX2";
+#elif defined(SIMD_MIU_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+/// Returns (short)(int)(v*slope + intercept), saturated to the range of short
+inline short rescale_short(const short v, const float slope, const float intercept)
+{
+	// volatile keeps the compiler from contracting to a fused multiply-add, which the vector paths do not use
+	volatile float prod = (float)v*slope;
+	const float f = prod + intercept;
+	if (f>=32767.0f) return 32767;
+	if (f<=-32768.0f) return -32768;
+	return (short)(int)f;
+}
+
+#if defined(SIMD_MIU_SSE2) || defined(SIMD_MIU_AVX2)
+/// Rescales 4 values sign-extended to 32 bits, returns them truncated to 32-bit integers (before saturation)
+inline __m128i rescale_epi32_sse2(const __m128i v, const __m128 slope, const __m128 intercept)
+{
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), slope), intercept));
+}
+
+/// Rescales 8 shorts (see rescale_short)
+inline __m128i rescale_epi16_sse2(const __m128i v, const __m128 slope, const __m128 intercept)
+{
+	// Sign extension without SSE4.1: duplicate each value into both halves of a 32-bit lane and shift back
+	const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+	return _mm_packs_epi32(rescale_epi32_sse2(lo, slope, intercept), rescale_epi32_sse2(hi, slope, intercept));
+}
+#endif
+
+#if defined(SIMD_MIU_AVX2)
+/// Rescales 16 shorts (see rescale_short)
+inline __m256i rescale_epi16_avx2(const __m256i v, const __m256 slope, const __m256 intercept)
+{
+	const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+	const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+	const __m256i rlo = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), slope), intercept));
+	const __m256i rhi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), slope), intercept));
+	// packs works within 128-bit lanes, restore the order of the 64-bit blocks
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(rlo, rhi), 0xd8);
+}
+#endif
+
+/**
+Sets out[i] to rescale_short(in[i], slope, intercept) for 0<=i<n.
+in and out may be the same array.
+*/
+inline void rescale_short_array(const short* in, short* out, const long n, const float slope, const float intercept)
+{
+	long i=0;
+#if defined(SIMD_MIU_AVX2)
+	const __m256 s8 = _mm256_set1_ps(slope), i8 = _mm256_set1_ps(intercept);
+	for(; i+16<=n; i+=16)
+		_mm256_storeu_si256((__m256i*)(out+i), rescale_epi16_avx2(_mm256_loadu_si256((const __m256i*)(in+i)), s8, i8));
+#endif
+#if defined(SIMD_MIU_SSE2) || defined(SIMD_MIU_AVX2)
+	const __m128 s4 = _mm_set1_ps(slope), i4 = _mm_set1_ps(intercept);
+	for(; i+8<=n; i+=8)
+		_mm_storeu_si128((__m128i*)(out+i), rescale_epi16_sse2(_mm_loadu_si128((const __m128i*)(in+i)), s4, i4));
+#endif
+	for(; i<n; i++)
+		out[i] = rescale_short(in[i], slope, intercept);
+}
+
+#endif // !__simd_miu_h_
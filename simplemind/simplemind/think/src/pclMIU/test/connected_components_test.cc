@@ -0,0 +1,216 @@
+/**
+Tests of ROI::connected_components: the components and their order must be those extracted one at a time with add_contig_3d (26-connectivity)
+and add_contig (8-connectivity within each slice), and for every connectivity the labels must match a flood fill of the voxel grid.
+Components below min_num_vox are dropped without changing the order of the others, and an invalid connectivity is an error.
+*/
+#include "ROI.h"
+#include <gtest/gtest.h>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Size of the voxel grid of the random ROIs
+const int kSizeX = 16, kSizeY = 13, kSizeZ = 6;
+
+/// Text form of the ROI (operator<<), to compare ROIs
+std::string text(const ROI& r)
+{
+	std::ostringstream s;
+	s << r;
+	return s.str();
+}
+
+inline int voxel(const int x, const int y, const int z)
+{
+	return (z*kSizeY + y)*kSizeX + x;
+}
+
+/// Random voxels of the grid, sparse enough that many components only touch by an edge or a corner
+std::vector<char> random_grid(const unsigned int seed, const int percent)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> value(0, 99);
+	std::vector<char> grid(kSizeX*kSizeY*kSizeZ);
+	for(size_t i=0; i<grid.size(); i++) grid[i] = (value(rng)<percent);
+	return grid;
+}
+
+/// ROI of the voxels set in the grid, shifted so that coordinates are negative too
+ROI grid_roi(const std::vector<char>& grid)
+{
+	ROI r;
+	for(int z=0; z<kSizeZ; z++) {
+		for(int y=0; y<kSizeY; y++) {
+			for(int x=0; x<kSizeX; x++) {
+				if (!grid[voxel(x, y, z)]) continue;
+				const int x1 = x;
+				while ((x+1<kSizeX) && grid[voxel(x+1, y, z)]) x++;
+				r.append_interval(x1-5, x-5, y-4, z-2);
+			}
+		}
+	}
+	return r;
+}
+
+/**
+Labels of the grid voxels by a flood fill started at every unlabeled voxel in raster order, so that components are numbered by their first point.
+Background voxels are labeled -1.
+*/
+std::vector<int> flood_fill_labels(const std::vector<char>& grid, const int connectivity, std::vector<int>& num_vox)
+{
+	std::vector<int> label(grid.size(), -1);
+	num_vox.clear();
+	for(int z=0; z<kSizeZ; z++) {
+		for(int y=0; y<kSizeY; y++) {
+			for(int x=0; x<kSizeX; x++) {
+				if (!grid[voxel(x, y, z)] || (label[voxel(x, y, z)]>=0)) continue;
+				const int l = num_vox.size();
+				num_vox.push_back(0);
+				std::queue<int> q;
+				label[voxel(x, y, z)] = l;
+				q.push(voxel(x, y, z));
+				while (!q.empty()) {
+					const int v = q.front(), vx = v%kSizeX, vy = (v/kSizeX)%kSizeY, vz = v/(kSizeX*kSizeY);
+					q.pop();
+					num_vox[l]++;
+					const int dz_max = ((connectivity==4) || (connectivity==8)) ? 0 : 1;
+					for(int dz=-dz_max; dz<=dz_max; dz++) {
+						for(int dy=-1; dy<=1; dy++) {
+							for(int dx=-1; dx<=1; dx++) {
+								const int d = abs(dx)+abs(dy)+abs(dz);
+								if ((d==0) || ((connectivity==4 || connectivity==6) && (d>1)) || ((connectivity==18) && (d>2))) continue;
+								const int nx = vx+dx, ny = vy+dy, nz = vz+dz;
+								if ((nx<0) || (nx>=kSizeX) || (ny<0) || (ny>=kSizeY) || (nz<0) || (nz>=kSizeZ)) continue;
+								const int n = voxel(nx, ny, nz);
+								if (grid[n] && (label[n]<0)) {
+									label[n] = l;
+									q.push(n);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return label;
+}
+
+/// Labels of the grid voxels by the component of the array that contains them (-1 if none, -2 if several)
+std::vector<int> component_labels(const ROI* components, const int n)
+{
+	std::vector<int> label(kSizeX*kSizeY*kSizeZ, -1);
+	for(int z=0; z<kSizeZ; z++) {
+		for(int y=0; y<kSizeY; y++) {
+			for(int x=0; x<kSizeX; x++) {
+				for(int k=0; k<n; k++) {
+					if (components[k].in_roi(Point(x-5, y-4, z-2))) label[voxel(x, y, z)] = (label[voxel(x, y, z)]==-1) ? k : -2;
+				}
+			}
+		}
+	}
+	return label;
+}
+
+}
+
+TEST(ConnectedComponents, MatchesAddContig3d) {
+	for(unsigned int seed=1; seed<=10; seed++) {
+		const ROI r = grid_roi(random_grid(seed, 25+seed*2));
+		int n;
+		std::vector<int> num_vox;
+		ROI* components = r.connected_components(n, num_vox, 26);
+		ASSERT_EQ((int)num_vox.size(), n);
+		ROI remaining(r);
+		Point fp;
+		int k = 0;
+		while (remaining.first_point(fp)) {
+			ROI expected;
+			expected.add_contig_3d(remaining, fp, 1);
+			ASSERT_LT(k, n) << "seed " << seed;
+			EXPECT_EQ(text(components[k]), text(expected)) << "seed " << seed << ", component " << k;
+			EXPECT_EQ(num_vox[k], expected.num_pix()) << "seed " << seed << ", component " << k;
+			k++;
+		}
+		EXPECT_EQ(k, n) << "seed " << seed;
+		delete [] components;
+	}
+}
+
+TEST(ConnectedComponents, MatchesAddContig) {
+	for(unsigned int seed=11; seed<=20; seed++) {
+		const ROI r = grid_roi(random_grid(seed, 35));
+		int n;
+		std::vector<int> num_vox;
+		ROI* components = r.connected_components(n, num_vox, 8);
+		ROI remaining(r);
+		Point fp;
+		int k = 0;
+		while (remaining.first_point(fp)) {
+			ROI expected;
+			expected.add_contig(remaining, fp, 1);
+			ASSERT_LT(k, n) << "seed " << seed;
+			EXPECT_EQ(text(components[k]), text(expected)) << "seed " << seed << ", component " << k;
+			EXPECT_EQ(num_vox[k], expected.num_pix()) << "seed " << seed << ", component " << k;
+			k++;
+		}
+		EXPECT_EQ(k, n) << "seed " << seed;
+		delete [] components;
+	}
+}
+
+TEST(ConnectedComponents, MatchesFloodFill) {
+	const int connectivities[5] = {4, 8, 6, 18, 26};
+	for(unsigned int seed=21; seed<=26; seed++) {
+		const std::vector<char> grid = random_grid(seed, 30);
+		const ROI r = grid_roi(grid);
+		for(int c=0; c<5; c++) {
+			std::vector<int> expected_num_vox, num_vox;
+			const std::vector<int> expected = flood_fill_labels(grid, connectivities[c], expected_num_vox);
+			int n;
+			ROI* components = r.connected_components(n, num_vox, connectivities[c]);
+			EXPECT_EQ(component_labels(components, n), expected) << "seed " << seed << ", connectivity " << connectivities[c];
+			EXPECT_EQ(num_vox, expected_num_vox) << "seed " << seed << ", connectivity " << connectivities[c];
+			delete [] components;
+		}
+	}
+}
+
+TEST(ConnectedComponents, MinNumVoxKeepsOrder) {
+	const ROI r = grid_roi(random_grid(30, 30));
+	int n_all, n;
+	std::vector<int> num_vox_all, num_vox;
+	ROI* all = r.connected_components(n_all, num_vox_all, 18);
+	ROI* large = r.connected_components(n, num_vox, 18, 4);
+	int k = 0;
+	for(int i=0; i<n_all; i++) {
+		if (num_vox_all[i]<4) continue;
+		ASSERT_LT(k, n);
+		EXPECT_EQ(text(large[k]), text(all[i])) << "component " << i;
+		EXPECT_EQ(num_vox[k], num_vox_all[i]) << "component " << i;
+		k++;
+	}
+	EXPECT_EQ(k, n);
+	EXPECT_LT(n, n_all);
+	delete [] all;
+	delete [] large;
+
+	ROI empty;
+	std::vector<int> none;
+	ROI* c = empty.connected_components(n, none);
+	EXPECT_EQ(n, 0);
+	EXPECT_TRUE(none.empty());
+	delete [] c;
+}
+
+TEST(ConnectedComponentsDeathTest, InvalidConnectivity) {
+	const ROI r = grid_roi(random_grid(1, 30));
+	int n;
+	std::vector<int> num_vox;
+	EXPECT_EXIT(r.connected_components(n, num_vox, 10), ::testing::ExitedWithCode(1), "connectivity must be 4, 8, 6, 18 or 26");
+}
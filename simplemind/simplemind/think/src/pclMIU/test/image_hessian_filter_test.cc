@@ -0,0 +1,142 @@
+/**
+Tests of pcl::filter2::ImageHessianFilter and ImageHessianShapeFilter: finite differences at sigma 0, independence from the number of threads,
+closed-form eigenvalues, and the shape measures of a plate, a tube and a blob.
+*/
+#include <pcl/image.h>
+#include <pcl/iterator.h>
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/filter2/image/ImageHessianFilter.h>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <random>
+
+namespace {
+
+typedef pcl::Image<float> FloatImage;
+typedef pcl::filter2::ZeroFluxBoundary<FloatImage> BoundaryType;
+typedef pcl::filter2::ImageHessianFilter<BoundaryType, FloatImage> HessianFilterType;
+typedef pcl::filter2::ImageHessianShapeFilter<FloatImage, FloatImage> ShapeFilterType;
+
+long num_voxels(const FloatImage::Pointer& img)
+{
+	const pcl::Point3D<int>& size = img->getSize();
+	return (long)size.x()*size.y()*size.z();
+}
+
+FloatImage::Pointer random_image(const unsigned int seed)
+{
+	FloatImage::Pointer img = FloatImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(30, 25, 20), pcl::Point3D<double>(0.8, 0.8, 1.5), pcl::Point3D<double>(0, 0, 0));
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> value(0, 999);
+	for(long i=0; i<num_voxels(img); i++) img->set(i, value(rng));
+	return img;
+}
+
+void hessian(const FloatImage::Pointer& input, const double sigma, const bool use_image_spacing, const int num_threads, HessianFilterType& filter)
+{
+	filter.setInput(BoundaryType(input));
+	filter.setSigma(sigma);
+	filter.setUseImageSpacing(use_image_spacing);
+	filter.setNumberOfThreads(num_threads);
+	filter.update();
+}
+
+/// Plate (0), tube along z (1) or blob (2) of Gaussian profile centered in a 41^3 image
+FloatImage::Pointer shape_image(const int kind)
+{
+	FloatImage::Pointer img = FloatImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(40, 40, 40));
+	for(int z=0; z<=40; z++) {
+		for(int y=0; y<=40; y++) {
+			for(int x=0; x<=40; x++) {
+				const double dx = x-20, dy = y-20, dz = z-20;
+				const double r2 = (kind==0) ? dz*dz : (kind==1) ? dx*dx+dy*dy : dx*dx+dy*dy+dz*dz;
+				img->set(img->toIndex(x, y, z), 100*exp(-r2/8));
+			}
+		}
+	}
+	return img;
+}
+
+}
+
+TEST(ImageHessianFilter, SigmaZeroIsFiniteDifferences) {
+	FloatImage::Pointer input = random_image(2);
+	HessianFilterType filter;
+	hessian(input, 0, false, 3, filter);
+	BoundaryType b(input);
+	auto v = [&b](int x, int y, int z) { return (double)b.get(pcl::Point3D<int>(x, y, z)); };
+	const pcl::Point3D<int>& size = input->getSize();
+	for(int z=0; z<size.z(); z++) {
+		for(int y=0; y<size.y(); y++) {
+			for(int x=0; x<size.x(); x++) {
+				const double expected[6] = {
+					v(x+1,y,z) - 2*v(x,y,z) + v(x-1,y,z),
+					v(x,y+1,z) - 2*v(x,y,z) + v(x,y-1,z),
+					v(x,y,z+1) - 2*v(x,y,z) + v(x,y,z-1),
+					((v(x+1,y+1,z)-v(x-1,y+1,z)) - (v(x+1,y-1,z)-v(x-1,y-1,z)))/4,
+					((v(x+1,y,z+1)-v(x-1,y,z+1)) - (v(x+1,y,z-1)-v(x-1,y,z-1)))/4,
+					((v(x,y+1,z+1)-v(x,y-1,z+1)) - (v(x,y+1,z-1)-v(x,y-1,z-1)))/4};
+				for(int d=0; d<6; d++) ASSERT_NEAR(filter.getOutput(d)->get(x, y, z), expected[d], 1e-3) << "derivative " << d << " at " << x << " " << y << " " << z;
+			}
+		}
+	}
+}
+
+TEST(ImageHessianFilter, DoesNotDependOnThreads) {
+	FloatImage::Pointer input = random_image(3);
+	HessianFilterType filter1, filter3;
+	hessian(input, 1.2, true, 1, filter1);
+	hessian(input, 1.2, true, 3, filter3);
+	for(int d=0; d<6; d++) {
+		long differences = 0;
+		for(long i=0; i<num_voxels(input); i++) if (filter1.getOutput(d)->get(i)!=filter3.getOutput(d)->get(i)) differences++;
+		EXPECT_EQ(differences, 0) << "derivative " << d;
+	}
+}
+
+TEST(ImageHessianShapeFilter, EigenvaluesSolveTheCharacteristicEquation) {
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<int> value(-1000, 1000);
+	for(int k=0; k<20000; k++) {
+		double m[6];
+		for(int i=0; i<6; i++) m[i] = value(rng)/100.0;
+		if (k%3==0) m[3] = m[4] = m[5] = 0; // diagonal
+		if (k%7==0) m[1] = m[2] = m[0]; // repeated diagonal values
+		double l[3];
+		ShapeFilterType::ComputeEigenvalues(m[0], m[1], m[2], m[3], m[4], m[5], l[0], l[1], l[2]);
+		ASSERT_LE(fabs(l[0]), fabs(l[1]));
+		ASSERT_LE(fabs(l[1]), fabs(l[2]));
+		ASSERT_NEAR(l[0]+l[1]+l[2], m[0]+m[1]+m[2], 1e-9);
+		for(int e=0; e<3; e++) {
+			const double a = m[0]-l[e], b = m[1]-l[e], c = m[2]-l[e];
+			const double det = a*(b*c - m[5]*m[5]) - m[3]*(m[3]*c - m[5]*m[4]) + m[4]*(m[3]*m[5] - b*m[4]);
+			ASSERT_NEAR(det, 0, 1e-8) << "matrix " << k << ", eigenvalue " << e;
+		}
+	}
+}
+
+TEST(ImageHessianShapeFilter, MeasuresOfPlateTubeAndBlob) {
+	const pcl::Point3D<int> center(20, 20, 20);
+	float measure[3][4];
+	for(int kind=0; kind<3; kind++) {
+		HessianFilterType hessian_filter;
+		hessian(shape_image(kind), 1.5, true, 2, hessian_filter);
+		ShapeFilterType shape_filter;
+		for(int d=0; d<6; d++) shape_filter.setInput(d, hessian_filter.getOutput(d));
+		shape_filter.setMeasures(ShapeFilterType::Plateness | ShapeFilterType::Vesselness | ShapeFilterType::Blobness | ShapeFilterType::PlanePlateness);
+		shape_filter.setNumberOfThreads(2);
+		shape_filter.update();
+		measure[kind][0] = shape_filter.getPlateness()->get(center);
+		measure[kind][1] = shape_filter.getVesselness()->get(center);
+		measure[kind][2] = shape_filter.getBlobness()->get(center);
+		measure[kind][3] = shape_filter.getPlanePlateness()->get(center);
+	}
+	// Each shape has the largest value of its own measure
+	for(int kind=0; kind<3; kind++) {
+		EXPECT_GT(measure[kind][kind], 0.5) << "shape " << kind;
+		for(int other=0; other<3; other++) if (other!=kind) EXPECT_LT(measure[kind][other], 0.2) << "shape " << kind << ", measure " << other;
+	}
+	// The plate crosses the xz and yz planes as lines and is flat in the xy plane
+	EXPECT_GT(measure[0][3], 1.5);
+	EXPECT_LT(measure[0][3], 2);
+}
@@ -0,0 +1,130 @@
+/**
+Tests of the separable passes of pcl::filter2::ImageLineFilterHelper: kernel passes must be bit-identical to ImageConvolutionFilter for any number of threads,
+and the recursive Gaussian must stay within 0.05% of the peak of a sampled Gaussian.
+*/
+#include <pcl/image.h>
+#include <pcl/iterator.h>
+#include <pcl/filter2/boundary/ZeroFluxBoundary.h>
+#include <pcl/filter2/image/ImageConvolutionFilter.h>
+#include <pcl/filter2/image/ImageGaussianFilter.h>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <random>
+
+namespace {
+
+typedef pcl::Image<float> FloatImage;
+typedef pcl::Image<short> ShortImage;
+
+template <class ImagePointerType>
+long num_voxels(const ImagePointerType& img)
+{
+	const pcl::Point3D<int>& size = img->getSize();
+	return (long)size.x()*size.y()*size.z();
+}
+
+template <class ImageType>
+typename ImageType::Pointer random_image(const pcl::Point3D<int>& size, const pcl::Point3D<double>& spacing, const unsigned int seed)
+{
+	typename ImageType::Pointer img = ImageType::New(pcl::Point3D<int>(0, 0, 0), size-1, spacing, pcl::Point3D<double>(0, 0, 0));
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> value(-1000, 1000);
+	for(long i=0; i<num_voxels(img); i++) img->set(i, value(rng));
+	return img;
+}
+
+/// Gaussian smoothing as it was computed before the line passes: one ImageConvolutionFilter per axis
+template <class InputImageType>
+FloatImage::Pointer convolution_gaussian(const typename InputImageType::Pointer& input, const double sigma)
+{
+	typedef pcl::misc::GaussianKernel1DGenerator::KernelType KernelType;
+	pcl::misc::GaussianKernel1DGenerator kernel_gen;
+	FloatImage::Pointer result;
+	for(int axis=0; axis<3; axis++) {
+		KernelType::Pointer kernel = kernel_gen.getKernel((pcl::misc::GaussianKernel1DGenerator::Axis) axis, sigma/input->getSpacing()[axis], 0.0001, 16);
+		pcl::Region3D<int> region = input->getRegion();
+		if (axis==0) {
+			typedef pcl::filter2::ZeroFluxBoundary<InputImageType> BoundaryType;
+			result = pcl::filter2::ImageConvolutionFilter<BoundaryType, KernelType, FloatImage>::Compute(BoundaryType(input), kernel, region);
+		} else {
+			typedef pcl::filter2::ZeroFluxBoundary<FloatImage> BoundaryType;
+			result = pcl::filter2::ImageConvolutionFilter<BoundaryType, KernelType, FloatImage>::Compute(BoundaryType(result), kernel, region);
+		}
+	}
+	return result;
+}
+
+/// Number of voxels where the images are not bitwise equal
+long num_differences(const FloatImage::Pointer& a, const FloatImage::Pointer& b)
+{
+	long count = 0;
+	for(long i=0; i<num_voxels(a); i++) if (a->get(i)!=b->get(i)) count++;
+	return count;
+}
+
+FloatImage::Pointer recursive_gaussian(const FloatImage::Pointer& input, const double sigma, const int num_threads)
+{
+	typedef pcl::filter2::ZeroFluxBoundary<FloatImage> BoundaryType;
+	pcl::filter2::ImageGaussianFilter<BoundaryType, FloatImage> filter;
+	filter.setInput(BoundaryType(input));
+	filter.setSigma(sigma, sigma, sigma);
+	filter.setUseImageSpacing(false);
+	filter.setRecursiveMinimumSigma(1);
+	filter.setNumberOfThreads(num_threads);
+	filter.update();
+	return filter.getOutput();
+}
+
+}
+
+TEST(ImageLineFilterHelper, KernelPassesMatchConvolutionFilter) {
+	// Sizes that are not multiples of the tile width, anisotropic spacing
+	FloatImage::Pointer input = random_image<FloatImage>(pcl::Point3D<int>(38, 30, 24), pcl::Point3D<double>(0.7, 0.8, 1.5), 1);
+	FloatImage::Pointer expected = convolution_gaussian<FloatImage>(input, 1.3);
+	typedef pcl::filter2::ZeroFluxBoundary<FloatImage> BoundaryType;
+	for(int num_threads=1; num_threads<=3; num_threads+=2) {
+		FloatImage::Pointer result = pcl::filter2::ImageGaussianFilter<BoundaryType, FloatImage>::Compute(BoundaryType(input), 1.3, 1.3, 1.3, true, pcl::Region3D<int>().reset(), num_threads);
+		EXPECT_EQ(num_differences(result, expected), 0) << num_threads << " threads";
+	}
+}
+
+TEST(ImageLineFilterHelper, KernelPassesMatchConvolutionFilterFromShort) {
+	ShortImage::Pointer input = random_image<ShortImage>(pcl::Point3D<int>(21, 35, 17), pcl::Point3D<double>(1, 1, 2.5), 2);
+	FloatImage::Pointer expected = convolution_gaussian<ShortImage>(input, 2);
+	typedef pcl::filter2::ZeroFluxBoundary<ShortImage> BoundaryType;
+	for(int num_threads=1; num_threads<=3; num_threads+=2) {
+		FloatImage::Pointer result = pcl::filter2::ImageGaussianFilter<BoundaryType, FloatImage>::Compute(BoundaryType(input), 2, 2, 2, true, pcl::Region3D<int>().reset(), num_threads);
+		EXPECT_EQ(num_differences(result, expected), 0) << num_threads << " threads";
+	}
+}
+
+TEST(ImageLineFilterHelper, RecursiveGaussianMatchesSampledGaussian) {
+	// Impulse response along each axis, away from the borders
+	const int size = 101, c = 50;
+	for(int axis=0; axis<3; axis++) {
+		for(double sigma=2; sigma<=8; sigma*=2) {
+			pcl::Point3D<int> max_point(0, 0, 0);
+			max_point[axis] = size-1;
+			FloatImage::Pointer impulse = FloatImage::New(pcl::Point3D<int>(0, 0, 0), max_point);
+			pcl::ImageHelper::Fill(impulse, 0);
+			impulse->set(c, 1);
+			FloatImage::Pointer response = recursive_gaussian(impulse, sigma, 1);
+			const double peak = 1/(sqrt(2*M_PI)*sigma);
+			double max_error = 0;
+			for(int i=0; i<size; i++) max_error = std::max(max_error, fabs(response->get(i) - peak*exp(-(i-c)*(i-c)/(2*sigma*sigma))));
+			EXPECT_LT(max_error, 0.0005*peak) << "axis " << axis << ", sigma " << sigma;
+		}
+	}
+}
+
+TEST(ImageLineFilterHelper, RecursiveGaussianKeepsConstants) {
+	FloatImage::Pointer input = FloatImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(20, 17, 9));
+	pcl::ImageHelper::Fill(input, 7);
+	FloatImage::Pointer result = recursive_gaussian(input, 3, 2);
+	for(long i=0; i<num_voxels(result); i++) ASSERT_NEAR(result->get(i), 7, 1e-4);
+}
+
+TEST(ImageLineFilterHelper, RecursiveGaussianDoesNotDependOnThreads) {
+	FloatImage::Pointer input = random_image<FloatImage>(pcl::Point3D<int>(40, 33, 19), pcl::Point3D<double>(1, 1, 1), 3);
+	EXPECT_EQ(num_differences(recursive_gaussian(input, 4, 1), recursive_gaussian(input, 4, 3)), 0);
+}
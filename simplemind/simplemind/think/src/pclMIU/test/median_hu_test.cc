@@ -0,0 +1,73 @@
+/**
+Tests of the median HU of ImageRegion (cached per region, used by MedianHU for one primitive) against medianHU (used for several primitives):
+both must rescale the values of each slice with its own slope and intercept.
+*/
+#include "ImageRegion.h"
+#include "MedicalImageSequence.h"
+#include "tools_miu.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int kWidth = 12, kHeight = 10, kNumSlices = 5;
+
+/// Random stored values, with a rescale slope and intercept that differ between slices
+MedicalImageSequence* random_sequence(const unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> value(0, 400);
+	const float slope[kNumSlices] = {1, 2, 1, 0.5, 3};
+	const float intercept[kNumSlices] = {-1024, -1000, 0, 20, -2000};
+	Image** images = new Image* [kNumSlices];
+	std::vector<short> pixels(kWidth*kHeight);
+	for(int z=0; z<kNumSlices; z++) {
+		for(size_t i=0; i<pixels.size(); i++) pixels[i] = (short)value(rng);
+		images[z] = new Image(z+1, kWidth, kHeight, 12, &pixels[0], slope[z], intercept[z]);
+	}
+	return new MedicalImageSequence(kNumSlices, images);
+}
+
+ROI random_roi(std::mt19937& rng)
+{
+	std::uniform_int_distribution<int> x(0, kWidth-1), y(0, kHeight-1), z(0, kNumSlices-1);
+	ROI r;
+	for(int i=0; i<12; i++) {
+		const int x1 = x(rng), x2 = x(rng), yv = y(rng), zv = z(rng);
+		ROI line;
+		line.append_interval(std::min(x1, x2), std::max(x1, x2), yv, zv);
+		r.OR(line);
+	}
+	return r;
+}
+
+}
+
+TEST(ImageRegion, MedianHUMatchesMedianHUOfROI) {
+	MedicalImageSequence* mis = random_sequence(1);
+	std::mt19937 rng(2);
+	for(int trial=0; trial<50; trial++) {
+		const ROI r = random_roi(rng);
+		const ImageRegion region(r, *mis);
+		ROItraverser rt(r);
+		EXPECT_EQ(region.median_hu(*mis), medianHU(*mis, rt)) << "trial " << trial;
+		// Cached
+		EXPECT_EQ(region.median_hu(*mis), medianHU(*mis, rt)) << "trial " << trial;
+	}
+	delete mis;
+}
+
+TEST(ImageRegion, MedianHUUsesTheSlopeOfEachSlice) {
+	// One point in slice 0 (slope 1, intercept -1024) and two in slice 1 (slope 2, intercept -1000), all stored as 100
+	Image** images = new Image* [2];
+	std::vector<short> pixels(kWidth*kHeight, 100);
+	images[0] = new Image(1, kWidth, kHeight, 12, &pixels[0], 1, -1024);
+	images[1] = new Image(2, kWidth, kHeight, 12, &pixels[0], 2, -1000);
+	MedicalImageSequence mis(2, images);
+	ROI r;
+	r.append_interval(3, 3, 2, 0);
+	r.append_interval(4, 5, 2, 1);
+	const ImageRegion region(r, mis);
+	EXPECT_EQ(region.median_hu(mis), -800);
+}
@@ -0,0 +1,114 @@
+/**
+Tests of pcl::statistics::DenseHistogram (same results as PercentileCalculator, values at the limits of wide integral types)
+and pcl::statistics::TDigest (rank error of merged digests).
+*/
+#include <pcl/statistics/PercentileCalculator.h>
+#include <pcl/statistics/DenseHistogram.h>
+#include <pcl/statistics/TDigest.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+using pcl::statistics::DenseHistogram;
+using pcl::statistics::PercentileCalculator;
+using pcl::statistics::TDigest;
+
+TEST(DenseHistogram, MatchesPercentileCalculator) {
+	std::mt19937 rng(1);
+	std::normal_distribution<double> hu(40, 300);
+	for(int trial=0; trial<30; trial++) {
+		// Two histograms filled separately and merged, as by two threads
+		PercentileCalculator<short> expected;
+		DenseHistogram<short> even, odd;
+		const int n = 1 + rng()%5000;
+		for(int i=0; i<n; i++) {
+			const short v = (short)std::max(-32768.0, std::min(32767.0, hu(rng)*(trial%5+1)));
+			expected.addValue(v);
+			(i%2 ? odd : even).addValue(v);
+		}
+		even.merge(odd);
+		ASSERT_EQ(even.getNum(), expected.getNum());
+		EXPECT_EQ(even.getMin(), expected.getMin());
+		EXPECT_EQ(even.getMax(), expected.getMax());
+		EXPECT_NEAR(even.getEntropy(), expected.getEntropy(), 1e-9);
+		EXPECT_TRUE(even.getMap()==expected.getMap());
+		for(int q=0; q<=100; q++) EXPECT_EQ(even.getPercentile(q/100.0), expected.getPercentile(q/100.0)) << "trial " << trial << ", q " << q;
+		// Where the interpolation target is past the last count PercentileCalculator interpolates towards an unset key; DenseHistogram returns the max
+		for(int q=0; q<=100; q++) {
+			if (q/100.0*n+0.5<=n) EXPECT_EQ(even.getInterpolatedPercentile(q/100.0), expected.getInterpolatedPercentile(q/100.0)) << "trial " << trial << ", q " << q;
+			else EXPECT_EQ(even.getInterpolatedPercentile(q/100.0), expected.getMax()) << "trial " << trial << ", q " << q;
+		}
+	}
+}
+
+TEST(DenseHistogram, GrowsDownwardsAndUpwards) {
+	DenseHistogram<unsigned char> h;
+	for(int i=128; i<256; i++) h.addValue(i);
+	for(int i=127; i>=0; i--) h.addValue(i);
+	EXPECT_EQ(h.getNum(), 256);
+	EXPECT_EQ(h.getMin(), 0);
+	EXPECT_EQ(h.getMax(), 255);
+	EXPECT_EQ(h.getPercentile(0.5), 127);
+}
+
+TEST(DenseHistogram, ValuesAtTheLimitsOfWideTypes) {
+	// The offsets of these values overflow the value type if they are computed before widening
+	const int int_max = std::numeric_limits<int>::max(), int_min = std::numeric_limits<int>::min();
+	DenseHistogram<int> h;
+	h.addValue(int_max);
+	h.addValue(int_max-5);
+	h.addValue(int_max-5);
+	EXPECT_EQ(h.getNum(), 3);
+	EXPECT_EQ(h.getMin(), int_max-5);
+	EXPECT_EQ(h.getMax(), int_max);
+	EXPECT_EQ(h.getPercentile(0.5), int_max-5);
+
+	DenseHistogram<int> low;
+	low.reserve(int_min, int_min+10);
+	low.addValue(int_min+10);
+	low.addValue(int_min);
+	EXPECT_EQ(low.getMin(), int_min);
+	EXPECT_EQ(low.getMax(), int_min+10);
+
+	const long long ll_min = std::numeric_limits<long long>::min(), ll_max = std::numeric_limits<long long>::max();
+	DenseHistogram<long long> a, b;
+	a.addValue(ll_max-2);
+	b.addValue(ll_max);
+	a.merge(b);
+	EXPECT_EQ(a.getNum(), 2);
+	EXPECT_EQ(a.getMap().begin()->first, ll_max-2);
+	EXPECT_EQ(a.getMap().rbegin()->first, ll_max);
+	DenseHistogram<long long> c;
+	c.addValue(ll_min+3);
+	c.addValue(ll_min);
+	EXPECT_EQ(c.getMap().begin()->first, ll_min);
+	EXPECT_EQ(c.getMap().rbegin()->first, ll_min+3);
+}
+
+TEST(TDigest, RankErrorOfMergedDigests) {
+	std::mt19937 rng(1);
+	std::lognormal_distribution<double> skewed(0, 1);
+	std::vector<double> all;
+	TDigest parts[4];
+	for(int i=0; i<200000; i++) {
+		const double v = skewed(rng);
+		all.push_back(v);
+		parts[i%4].addValue(v);
+	}
+	parts[0].merge(parts[1]);
+	parts[2].merge(parts[3]);
+	parts[0].merge(parts[2]);
+	std::sort(all.begin(), all.end());
+	EXPECT_EQ(parts[0].getNum(), all.size());
+	EXPECT_EQ(parts[0].getMin(), all.front());
+	EXPECT_EQ(parts[0].getMax(), all.back());
+	const double quantiles[] = {0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999};
+	for(int k=0; k<9; k++) {
+		const double q = quantiles[k], estimate = parts[0].getPercentile(q);
+		const double rank = (std::lower_bound(all.begin(), all.end(), estimate)-all.begin())/(double)all.size();
+		// About 1/compression in the middle of the distribution, much less in the tails
+		EXPECT_NEAR(rank, q, std::min(0.005, 2*q*(1-q))) << "q " << q;
+	}
+}
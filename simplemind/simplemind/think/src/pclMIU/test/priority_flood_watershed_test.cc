@@ -0,0 +1,128 @@
+/**
+Tests of pcl::filter2::PriorityFloodWatershed: the labels must not depend on the number of threads for a given slab thickness,
+and must match a single slab where the flood has no ties (basins that only meet across the mask).
+*/
+#include <pcl/image.h>
+#include <pcl/filter2/image/PriorityFloodWatershed.h>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <random>
+
+namespace {
+
+typedef pcl::Image<int> IntImage;
+typedef pcl::Image<float> FloatImage;
+typedef pcl::Image<char> MaskImage;
+
+template <class InputImageType>
+IntImage::Pointer watershed(const typename InputImageType::Pointer& input, const MaskImage::Pointer& mask, const int num_threads, const int slab_thickness, int* num_basins=0)
+{
+	pcl::filter2::PriorityFloodWatershed<InputImageType, IntImage, MaskImage> filter;
+	filter.setInput(input);
+	if (mask) filter.setMask(mask);
+	filter.setNeighborhood(pcl::iterator::ImageNeighborIterator::CreateConnect26Offset());
+	filter.setNumberOfLevels(4096);
+	filter.setSlabThickness(slab_thickness);
+	filter.setNumberOfThreads(num_threads);
+	filter.update();
+	if (num_basins) *num_basins = filter.getNumberOfBasins();
+	return filter.getOutput();
+}
+
+/// Number of voxels where the labels differ
+long num_differences(const IntImage::Pointer& a, const IntImage::Pointer& b)
+{
+	long n = (long)a->getSize().x()*a->getSize().y()*a->getSize().z(), count = 0;
+	for(long i=0; i<n; i++) if (a->get(i)!=b->get(i)) count++;
+	return count;
+}
+
+/// Noise of a few levels: many plateaus, crossing the seams between slabs
+IntImage::Pointer noise_image(const int xdim, const int ydim, const int zdim, const unsigned int seed)
+{
+	IntImage::Pointer img = IntImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(xdim-1, ydim-1, zdim-1));
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> level(0, 5);
+	long n = (long)xdim*ydim*zdim;
+	for(long i=0; i<n; i++) img->set(i, level(rng));
+	return img;
+}
+
+}
+
+TEST(PriorityFloodWatershed, LabelsDoNotDependOnThreads) {
+	for(unsigned int seed=1; seed<=4; seed++) {
+		IntImage::Pointer input = noise_image(20, 18, 45, seed);
+		int num_basins1 = 0, num_basins4 = 0;
+		IntImage::Pointer labels1 = watershed<IntImage>(input, MaskImage::Pointer(), 1, 5, &num_basins1);
+		IntImage::Pointer labels4 = watershed<IntImage>(input, MaskImage::Pointer(), 4, 5, &num_basins4);
+		EXPECT_GT(num_basins1, 1);
+		EXPECT_EQ(num_basins1, num_basins4);
+		EXPECT_EQ(num_differences(labels1, labels4), 0) << "seed " << seed;
+		// Two threads take the slabs in another order
+		EXPECT_EQ(num_differences(labels1, watershed<IntImage>(input, MaskImage::Pointer(), 2, 5)), 0) << "seed " << seed;
+	}
+}
+
+TEST(PriorityFloodWatershed, SlabsMatchSingleSlab) {
+	// Four boxes separated by planes outside the mask, each holding a bowl whose flat bottom spans several slabs,
+	// so every voxel has a single basin that reaches it and the labels are those of the boxes in raster order of their minima
+	const int xdim = 24, ydim = 10, zdim = 40;
+	FloatImage::Pointer input = FloatImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(xdim-1, ydim-1, zdim-1));
+	MaskImage::Pointer mask = MaskImage::New(input);
+	IntImage::Pointer expected = IntImage::New(input);
+	for(int z=0; z<zdim; z++) {
+		for(int y=0; y<ydim; y++) {
+			for(int x=0; x<xdim; x++) {
+				const bool wall = (x==xdim/2) || (z==zdim/2);
+				const int box = (x>xdim/2 ? 1 : 0) + (z>zdim/2 ? 2 : 0);
+				const float xc = (box & 1) ? 18 : 6, zc = (box & 2) ? 30 : 10;
+				const float d = sqrt((x-xc)*(x-xc) + (y-4.5f)*(y-4.5f) + (z-zc)*(z-zc));
+				const long i = input->toIndex(x, y, z);
+				input->set(i, d<4 ? 0 : d);
+				mask->set(i, wall ? 0 : 1);
+				expected->set(i, wall ? 0 : box+1);
+			}
+		}
+	}
+
+	int num_basins_single = 0, num_basins_slabs = 0;
+	IntImage::Pointer single = watershed<FloatImage>(input, mask, 1, zdim, &num_basins_single);
+	IntImage::Pointer slabs = watershed<FloatImage>(input, mask, 3, 3, &num_basins_slabs);
+	EXPECT_EQ(num_basins_single, 4);
+	EXPECT_EQ(num_basins_slabs, 4);
+	EXPECT_EQ(num_differences(single, expected), 0);
+	EXPECT_EQ(num_differences(slabs, single), 0);
+}
+
+TEST(PriorityFloodWatershed, MarkersMatchSingleSlab) {
+	// Markers at the far ends of two halves separated by the mask: each flood crosses several seams, uphill, to reach the middle
+	const int xdim = 16, ydim = 12, zdim = 30;
+	FloatImage::Pointer input = FloatImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(xdim-1, ydim-1, zdim-1));
+	IntImage::Pointer markers = IntImage::New(input);
+	MaskImage::Pointer mask = MaskImage::New(input);
+	for(int z=0; z<zdim; z++) {
+		for(int y=0; y<ydim; y++) {
+			for(int x=0; x<xdim; x++) {
+				const long i = input->toIndex(x, y, z);
+				input->set(i, fabs(z-14.5f));
+				mask->set(i, (z==14 || z==15) ? 0 : 1);
+				markers->set(i, (x==8 && y==6 && (z==0 || z==29)) ? (z==0 ? 1 : 2) : 0);
+			}
+		}
+	}
+	typedef pcl::filter2::PriorityFloodWatershed<FloatImage, IntImage, MaskImage> WatershedType;
+	const pcl::iterator::ImageNeighborIterator::ConstantOffsetListPointer offsets = pcl::iterator::ImageNeighborIterator::CreateConnect26Offset();
+	IntImage::Pointer a = WatershedType::ComputeWithMarkers(input, markers, mask, offsets, 1);
+	WatershedType slabs;
+	slabs.setInput(input);
+	slabs.setMarkers(markers);
+	slabs.setMask(mask);
+	slabs.setNeighborhood(offsets);
+	slabs.setSlabThickness(4);
+	slabs.setNumberOfThreads(3);
+	slabs.update();
+	EXPECT_EQ(num_differences(a, slabs.getOutput()), 0);
+	EXPECT_EQ(a->get(a->toIndex(0, 0, 13)), 1);
+	EXPECT_EQ(a->get(a->toIndex(0, 0, 16)), 2);
+}
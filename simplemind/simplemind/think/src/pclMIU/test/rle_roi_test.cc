@@ -0,0 +1,198 @@
+/**
+Tests of RLEroi: conversions from and to ROI are exact, and the set operations, translation, morphology and queries
+give the same points as the ROI ones on random ROIs. Intervals appended out of raster order are an error.
+*/
+#include "RLEroi.h"
+#include "ROI.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// Text form of the ROI (operator<<), to compare ROIs
+std::string text(const ROI& r)
+{
+	std::ostringstream s;
+	s << r;
+	return s.str();
+}
+
+/// Text form of the points of an RLEroi
+std::string text(const RLEroi& r)
+{
+	ROI roi;
+	r.to_roi(roi);
+	return text(roi);
+}
+
+/// Boxes, circles and short intervals in a few planes, so that lines have several intervals and planes are not contiguous in z
+ROI random_roi(std::mt19937& rng)
+{
+	std::uniform_int_distribution<int> coord(-12, 30), plane(-3, 6), radius(1, 6), length(0, 5);
+	ROI r;
+	for(int i=0; i<3; i++) {
+		const int x = coord(rng), y = coord(rng), z = plane(rng);
+		r.add_box(Point(x, y, z), Point(x+length(rng)*2, y+length(rng), z+length(rng)%3));
+	}
+	for(int i=0; i<3; i++) r.add_circle(radius(rng), coord(rng), coord(rng), plane(rng));
+	for(int i=0; i<20; i++) {
+		ROI ivl;
+		const int x = coord(rng);
+		ivl.append_interval(x, x+length(rng), coord(rng), plane(rng));
+		r.OR(ivl);
+	}
+	return r;
+}
+
+/// Ball of radius 1, a box (split into lines by RLEroi::erode) and an asymmetric element
+ROI structuring_element(const int kind)
+{
+	ROI se;
+	if (kind==0) {
+		se.add_circle(1, 0, 0, 0);
+		se.append_interval(0, 0, 0, -1);
+		se.append_interval(0, 0, 0, 1);
+	}
+	else if (kind==1) se.add_box(Point(-1, -2, -1), Point(2, 1, 1));
+	else {
+		se.append_interval(-2, 0, -1, 0);
+		se.append_interval(1, 1, 0, 0);
+		se.append_interval(0, 3, 2, 1);
+	}
+	return se;
+}
+
+}
+
+TEST(RLEroi, ConversionIsExact) {
+	std::mt19937 rng(1);
+	for(int trial=0; trial<30; trial++) {
+		const ROI r = random_roi(rng);
+		const RLEroi rle(r);
+		EXPECT_EQ(text(rle), text(r)) << "trial " << trial;
+		EXPECT_EQ(rle.num_pix(), r.num_pix()) << "trial " << trial;
+	}
+	RLEroi empty;
+	EXPECT_TRUE(empty.empty());
+	EXPECT_EQ(empty.num_pix(), 0);
+	Point p;
+	EXPECT_EQ(empty.first_point(p), 0);
+	EXPECT_EQ(empty.last_point(p), 0);
+}
+
+TEST(RLEroi, SetOperationsMatchROI) {
+	std::mt19937 rng(2);
+	for(int trial=0; trial<50; trial++) {
+		const ROI a = random_roi(rng), b = random_roi(rng);
+		const RLEroi ra(a), rb(b);
+		const RLEop ops[3] = {RLE_OR, RLE_AND, RLE_SUBTRACT};
+		for(int k=0; k<3; k++) {
+			ROI expected(a);
+			if (ops[k]==RLE_OR) expected.OR(b);
+			else if (ops[k]==RLE_AND) expected.AND(b);
+			else expected.subtract(b);
+			RLEroi merged;
+			RLEroi::merge(ra, rb, ops[k], merged);
+			EXPECT_EQ(text(merged), text(expected)) << "trial " << trial << ", operation " << k;
+			RLEroi r(ra);
+			if (ops[k]==RLE_OR) r.OR(rb);
+			else if (ops[k]==RLE_AND) r.AND(rb);
+			else r.subtract(rb);
+			EXPECT_EQ(text(r), text(expected)) << "trial " << trial << ", operation " << k;
+		}
+	}
+}
+
+TEST(RLEroi, TranslateMatchesROI) {
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<int> shift(-7, 7);
+	for(int trial=0; trial<20; trial++) {
+		ROI r = random_roi(rng);
+		RLEroi rle(r);
+		const int dx = shift(rng), dy = shift(rng), dz = shift(rng);
+		r.translate(dx, dy, dz);
+		rle.translate(dx, dy, dz);
+		EXPECT_EQ(text(rle), text(r)) << "trial " << trial;
+	}
+}
+
+TEST(RLEroi, MorphologyMatchesROI) {
+	std::mt19937 rng(4);
+	for(int trial=0; trial<15; trial++) {
+		const ROI r = random_roi(rng);
+		for(int kind=0; kind<3; kind++) {
+			const ROI se = structuring_element(kind);
+			ROI eroded(r), dilated(r);
+			eroded.erode(se);
+			dilated.dilate(se);
+			RLEroi rle_eroded(r), rle_dilated(r);
+			rle_eroded.erode(RLEroi(se));
+			rle_dilated.dilate(RLEroi(se));
+			EXPECT_EQ(text(rle_eroded), text(eroded)) << "trial " << trial << ", element " << kind;
+			EXPECT_EQ(text(rle_dilated), text(dilated)) << "trial " << trial << ", element " << kind;
+		}
+	}
+	// An empty structuring element clears the RLEroi
+	std::mt19937 rng2(5);
+	RLEroi rle(random_roi(rng2));
+	rle.erode(RLEroi());
+	EXPECT_TRUE(rle.empty());
+}
+
+TEST(RLEroi, QueriesMatchROI) {
+	std::mt19937 rng(6);
+	for(int trial=0; trial<20; trial++) {
+		const ROI r = random_roi(rng);
+		const RLEroi rle(r);
+		Point tl, br, rle_tl, rle_br;
+		ASSERT_EQ(rle.bounding_cube(rle_tl, rle_br), r.bounding_cube(tl, br));
+		EXPECT_TRUE((rle_tl.x==tl.x) && (rle_tl.y==tl.y) && (rle_tl.z==tl.z)) << "trial " << trial;
+		EXPECT_TRUE((rle_br.x==br.x) && (rle_br.y==br.y) && (rle_br.z==br.z)) << "trial " << trial;
+		Point fp, lp, rle_fp, rle_lp;
+		ASSERT_EQ(rle.first_point(rle_fp), r.first_point(fp));
+		ASSERT_EQ(rle.last_point(rle_lp), r.last_point(lp));
+		EXPECT_TRUE((rle_fp.x==fp.x) && (rle_fp.y==fp.y) && (rle_fp.z==fp.z)) << "trial " << trial;
+		EXPECT_TRUE((rle_lp.x==lp.x) && (rle_lp.y==lp.y) && (rle_lp.z==lp.z)) << "trial " << trial;
+		long differences = 0;
+		for(int z=tl.z-1; z<=br.z+1; z++) {
+			for(int y=tl.y-1; y<=br.y+1; y++) {
+				for(int x=tl.x-1; x<=br.x+1; x++) {
+					const Point p(x, y, z);
+					if (rle.in_roi(p)!=r.in_roi(p)) differences++;
+				}
+			}
+		}
+		EXPECT_EQ(differences, 0) << "trial " << trial;
+	}
+}
+
+TEST(RLEroi, AppendJoinsOverlappingIntervals) {
+	RLEroi r;
+	r.append_interval(2, 5, 1, 0);
+	r.append_interval(4, 8, 1, 0);
+	r.append_interval(9, 9, 1, 0);
+	r.append_interval(12, 11, 1, 0);
+	r.append_interval(0, 1, 2, 0);
+	r.append_interval(-3, -3, 0, 2);
+	ROI expected;
+	expected.append_interval(2, 9, 1, 0);
+	expected.append_interval(0, 1, 2, 0);
+	expected.append_interval(-3, -3, 0, 2);
+	EXPECT_EQ(text(r), text(expected));
+	EXPECT_EQ(r.num_pix(), 11);
+}
+
+TEST(RLEroiDeathTest, AppendOutOfOrder) {
+	EXPECT_EXIT({
+		RLEroi r;
+		r.append_interval(5, 8, 3, 1);
+		r.append_interval(0, 2, 2, 1);
+	}, ::testing::ExitedWithCode(1), "not in raster order");
+	EXPECT_EXIT({
+		RLEroi r;
+		r.append_interval(5, 8, 3, 1);
+		r.append_interval(0, 2, 3, 0);
+	}, ::testing::ExitedWithCode(1), "not in raster order");
+}
@@ -0,0 +1,132 @@
+/**
+Tests of ROIfile: binary files read back the ROI written (compressed or not, whole or by plane), text files are read by the same call,
+and blocks whose lines or intervals are out of order are rejected as corrupt.
+*/
+#include "ROIfile.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+/// Text form of the ROI (operator<<), to compare ROIs
+std::string text(const ROI& r)
+{
+	std::ostringstream s;
+	s << r;
+	return s.str();
+}
+
+/// ROI of several planes, lines with several intervals, negative coordinates
+ROI test_roi()
+{
+	ROI r;
+	r.add_box(Point(-3, -2, 0), Point(5, 4, 2));
+	r.add_circle(6, 30, 20, 4);
+	r.append_interval(40, 45, 30, 7);
+	r.append_interval(50, 50, 30, 7);
+	r.append_interval(-8, 60, 31, 7);
+	return r;
+}
+
+std::string temp_file(const std::string& name)
+{
+	return ::testing::TempDir() + "/roi_file_test_" + name;
+}
+
+/// Writes a single-line plane at z 0, y 3 with intervals [2,4] and [8,9] uncompressed, with the bytes of the block changed by patch
+std::string write_patched(const std::string& name, const int index, const unsigned char value)
+{
+	ROI r;
+	r.append_interval(2, 4, 3, 0);
+	r.append_interval(8, 9, 3, 0);
+	std::ostringstream s;
+	ROIfile::write(s, r, false);
+	std::string bytes = s.str();
+	// 24 byte header and one 24 byte index entry, then the block: 1 line, y 3, 2 intervals, (2, 2), (4, 1)
+	const unsigned char block[] = {1, 6, 2, 4, 2, 8, 1};
+	EXPECT_EQ(bytes.size(), 48+sizeof(block));
+	EXPECT_EQ(0, memcmp(bytes.data()+48, block, sizeof(block)));
+	bytes[48+index] = (char)value;
+	const std::string path = temp_file(name);
+	std::ofstream(path.c_str(), std::ofstream::binary) << bytes;
+	return path;
+}
+
+}
+
+TEST(ROIfile, ReadsWhatItWrites) {
+	const ROI r = test_roi();
+	for(int compress=0; compress<2; compress++) {
+		const std::string path = temp_file(compress ? "compressed.roi" : "raw.roi");
+		ASSERT_TRUE(ROIfile::write(path, r, compress!=0));
+		EXPECT_TRUE(ROIfile::is_binary(path));
+		ROI back;
+		ASSERT_TRUE(ROIfile::read(path, back));
+		EXPECT_EQ(text(back), text(r)) << "compress " << compress;
+		EXPECT_EQ(back.num_pix(), r.num_pix());
+	}
+}
+
+TEST(ROIfile, ReadsSinglePlanes) {
+	const ROI r = test_roi();
+	const std::string path = temp_file("planes.roi");
+	ASSERT_TRUE(ROIfile::write(path, r));
+	ROIfile f;
+	ASSERT_TRUE(f.open(path));
+	ASSERT_EQ(f.num_planes(), 5);
+	EXPECT_EQ(f.plane_z(0), 0);
+	EXPECT_EQ(f.plane_z(4), 7);
+	EXPECT_EQ(f.find_plane(3), -1);
+	EXPECT_EQ(f.find_plane(4), 3);
+	for(int z=-1; z<=8; z++) {
+		ROI plane;
+		EXPECT_EQ(f.read_plane(z, plane), !r.empty(z)) << "z " << z;
+		EXPECT_EQ(text(plane), text(ROI(r, z))) << "z " << z;
+	}
+}
+
+TEST(ROIfile, ReadsTextFiles) {
+	const ROI r = test_roi();
+	const std::string path = temp_file("text.roi");
+	{
+		std::ofstream out(path.c_str());
+		out << r;
+	}
+	EXPECT_FALSE(ROIfile::is_binary(path));
+	ROIfile f;
+	EXPECT_FALSE(f.open(path));
+	ROI back;
+	ASSERT_TRUE(ROIfile::read(path, back));
+	EXPECT_EQ(text(back), text(r));
+	EXPECT_FALSE(ROIfile::read(temp_file("missing.roi"), back));
+}
+
+TEST(ROIfileDeathTest, RejectsIntervalsOutOfOrder) {
+	ROI r;
+	// Unchanged block
+	ASSERT_TRUE(ROIfile::read(write_patched("valid.roi", 5, 8), r));
+	EXPECT_EQ(r.num_pix(), 5);
+	// Second interval starting at 3, inside the first
+	EXPECT_EXIT(ROIfile::read(write_patched("overlap.roi", 5, 1), r), ::testing::ExitedWithCode(1), "is corrupt");
+	// Second interval starting at 4, at the end of the first
+	EXPECT_EXIT(ROIfile::read(write_patched("touch.roi", 5, 0), r), ::testing::ExitedWithCode(1), "is corrupt");
+}
+
+TEST(ROIfileDeathTest, RejectsLinesOutOfOrder) {
+	ROI r;
+	r.append_interval(2, 4, 3, 0);
+	r.append_interval(1, 1, 5, 0);
+	std::ostringstream s;
+	ROIfile::write(s, r, false);
+	std::string bytes = s.str();
+	// 2 lines: y 3 (zigzag 6) with 1 interval (2, 2), then y+2 (zigzag 4); make the second y step -2 (zigzag 3)
+	const unsigned char block[] = {2, 6, 1, 4, 2, 4, 1, 2, 0};
+	ASSERT_EQ(bytes.size(), 48+sizeof(block));
+	ASSERT_EQ(0, memcmp(bytes.data()+48, block, sizeof(block)));
+	bytes[48+5] = 3;
+	const std::string path = temp_file("lines.roi");
+	std::ofstream(path.c_str(), std::ofstream::binary) << bytes;
+	ROI back;
+	EXPECT_EXIT(ROIfile::read(path, back), ::testing::ExitedWithCode(1), "is corrupt");
+}
@@ -0,0 +1,73 @@
+/**
+Tests of SearchAreaCache: lookups are checked against the source ROIs (a colliding key is a miss), and the oldest entries are removed beyond the maximum number of intervals.
+*/
+#include "SearchAreaCache.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+/// Box of the given size at (x, y, 0): one interval per line
+ROI box(const int x, const int y, const int size)
+{
+	ROI r;
+	r.add_box(Point(x, y, 0), Point(x+size-1, y+size-1, 0));
+	return r;
+}
+
+}
+
+TEST(SearchAreaCache, HitsRequireTheSameSources) {
+	SearchAreaCache cache;
+	const ROI a = box(0, 0, 4), a_copy = box(0, 0, 4), b = box(1, 0, 4), result = box(10, 10, 2);
+	std::vector<const ROI*> sources(1, &a);
+	EXPECT_FALSE(cache.find("key", sources, 1));
+	std::shared_ptr<const ROI> stored = cache.store("key", sources, result, 1);
+	ASSERT_TRUE(stored);
+	EXPECT_EQ(stored->num_pix(), 4);
+
+	// Equal points in another ROI hit
+	sources[0] = &a_copy;
+	std::shared_ptr<const ROI> hit = cache.find("key", sources, 2);
+	ASSERT_TRUE(hit);
+	EXPECT_EQ(hit.get(), stored.get());
+
+	// Same key (as for a digest collision) with other points misses, and storing replaces the entry
+	sources[0] = &b;
+	EXPECT_FALSE(cache.find("key", sources, 2));
+	std::shared_ptr<const ROI> replaced = cache.store("key", sources, box(20, 20, 3), 2);
+	EXPECT_EQ(replaced->num_pix(), 9);
+	EXPECT_EQ(cache.num_entries(), 1);
+	EXPECT_EQ(cache.find("key", sources, 2).get(), replaced.get());
+	// The replaced ROI is still valid for those holding it
+	EXPECT_EQ(stored->num_pix(), 4);
+
+	long hits = 0, misses = 0;
+	ASSERT_TRUE(cache.stats(2, hits, misses));
+	EXPECT_EQ(hits, 2);
+	EXPECT_EQ(misses, 1);
+	EXPECT_EQ(cache.num_hits(), 2);
+	EXPECT_EQ(cache.num_misses(), 2);
+}
+
+TEST(SearchAreaCache, RemovesTheOldestEntriesBeyondTheMaximum) {
+	// Each entry holds 4+4 intervals
+	SearchAreaCache cache(20);
+	const ROI source = box(0, 0, 4);
+	const std::vector<const ROI*> sources(1, &source);
+	cache.store("first", sources, box(5, 5, 4), 1);
+	cache.store("second", sources, box(6, 6, 4), 1);
+	EXPECT_EQ(cache.num_entries(), 2);
+	cache.store("third", sources, box(7, 7, 4), 1);
+	EXPECT_EQ(cache.num_entries(), 2);
+	EXPECT_FALSE(cache.find("first", sources, 1));
+	EXPECT_TRUE(cache.find("second", sources, 1));
+	EXPECT_TRUE(cache.find("third", sources, 1));
+
+	// An entry larger than the maximum is kept until the next one is stored
+	cache.store("large", sources, box(0, 0, 30), 1);
+	EXPECT_EQ(cache.num_entries(), 1);
+	EXPECT_TRUE(cache.find("large", sources, 1));
+	cache.clear();
+	EXPECT_EQ(cache.num_entries(), 0);
+	EXPECT_EQ(cache.num_hits(), 0);
+}
@@ -0,0 +1,141 @@
+/**
+Tests of the incremental mode of the GLCM and RLM point filters (SlidingWindowGlcm, SlidingWindowRlm): applied in raster order, every feature
+must be the same as when the matrices are computed from the whole window, also for windows crossing the border of the image and for rows where
+the range of values of the window changes. PointGlcmRlmFilter::ComputeFeatureImages (rows on several threads) must match per-point filtering.
+*/
+#include <pcl/image.h>
+#include <pcl/filter/glcm/PointGlcmFilter.h>
+#include <pcl/filter/point/PointGlcmRlmFilter.h>
+#include <pcl/filter/rlm/PointRlmFilter.h>
+#include <gtest/gtest.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef pcl::Image<int, true> IntImage;
+typedef pcl::Image<float, true> FloatImage;
+typedef pcl::filter::PointGlcmFilter<IntImage> GlcmFilterType;
+typedef pcl::filter::PointRlmFilter<IntImage> RlmFilterType;
+typedef pcl::filter::PointGlcmRlmFilter<IntImage> GlcmRlmFilterType;
+
+/// A few levels, so that there are runs, with rare outliers that change the range of values of the windows along a row
+IntImage::Pointer texture_image(const unsigned int seed)
+{
+	IntImage::Pointer img = IntImage::New(pcl::Point3D<int>(0, 0, 0), pcl::Point3D<int>(15, 12, 8));
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<int> level(0, 5), outlier(0, 59);
+	for(int z=0; z<=8; z++) {
+		for(int y=0; y<=12; y++) {
+			for(int x=0; x<=15; x++) {
+				const int o = outlier(rng);
+				img->set(pcl::Point3D<int>(x, y, z), (o==0) ? 40 : (o==1) ? -25 : level(rng));
+			}
+		}
+	}
+	return img;
+}
+
+pcl::Region3D<int> window()
+{
+	return pcl::Region3D<int>(pcl::Point3D<int>(-2, -1, -1), pcl::Point3D<int>(2, 1, 1));
+}
+
+std::vector<pcl::Point3D<int>> offsets()
+{
+	std::vector<pcl::Point3D<int>> o;
+	o.push_back(pcl::Point3D<int>(1, 0, 0));
+	o.push_back(pcl::Point3D<int>(0, 1, 0));
+	o.push_back(pcl::Point3D<int>(0, 0, 1));
+	o.push_back(pcl::Point3D<int>(1, 1, 0));
+	o.push_back(pcl::Point3D<int>(-1, 1, 1));
+	o.push_back(pcl::Point3D<int>(0, 1, -1));
+	o.push_back(pcl::Point3D<int>(2, 0, 0));
+	return o;
+}
+
+/// Equal values, or both NaN (e.g. the correlation of a window with a single bin)
+bool same(const double a, const double b)
+{
+	return (a==b) || (isnan(a) && isnan(b));
+}
+
+/// Applies an incremental and a non-incremental filter at every point of the image in raster order and compares the numFeatures feature indexes
+template <class FilterPointerType>
+void expect_same_features(const IntImage::Pointer& img, FilterPointerType incremental, FilterPointerType full, const int numFeatures)
+{
+	incremental->setIncremental(true);
+	const pcl::Point3D<int> &minp = img->getMinPoint(), &maxp = img->getMaxPoint();
+	long differences = 0;
+	for(int z=minp.z(); z<=maxp.z(); z++) {
+		for(int y=minp.y(); y<=maxp.y(); y++) {
+			for(int x=minp.x(); x<=maxp.x(); x++) {
+				const pcl::Point3D<int> p(x, y, z);
+				incremental->apply(p);
+				full->apply(p);
+				for(int f=0; f<numFeatures; f++) {
+					if (!same(incremental->getResult(f), full->getResult(f))) {
+						if (differences==0) ADD_FAILURE() << "feature " << f << " at " << x << " " << y << " " << z << ": " << incremental->getResult(f) << " instead of " << full->getResult(f);
+						differences++;
+					}
+				}
+			}
+		}
+	}
+	EXPECT_EQ(differences, 0);
+}
+
+}
+
+TEST(SlidingWindowGlcm, IncrementalMatchesFullWindow) {
+	for(unsigned int seed=1; seed<=3; seed++) {
+		IntImage::Pointer img = texture_image(seed);
+		const int numFeatures = (GlcmFilterType::GlcmIndex::NUM_AGGREGATIONS + offsets().size())*GlcmFilterType::GlcmIndex::NUM_GLCM_FEATURES;
+		expect_same_features(img, GlcmFilterType::New(img, window(), offsets(), 4), GlcmFilterType::New(img, window(), offsets(), 4), numFeatures);
+	}
+}
+
+TEST(SlidingWindowRlm, IncrementalMatchesFullWindow) {
+	for(unsigned int seed=1; seed<=3; seed++) {
+		IntImage::Pointer img = texture_image(seed);
+		const int numFeatures = (RlmFilterType::RlmIndex::NUM_AGGREGATIONS + offsets().size())*RlmFilterType::RlmIndex::NUM_RLM_FEATURES;
+		expect_same_features(img, RlmFilterType::New(img, window(), offsets(), 4), RlmFilterType::New(img, window(), offsets(), 4), numFeatures);
+	}
+}
+
+TEST(PointGlcmRlmFilter, IncrementalMatchesFullWindow) {
+	for(unsigned int seed=1; seed<=3; seed++) {
+		IntImage::Pointer img = texture_image(seed);
+		const int numFeatures = (GlcmRlmFilterType::FeatureIndex::NUM_AGGREGATIONS + offsets().size())*GlcmRlmFilterType::FeatureIndex::NUM_FEATURES;
+		expect_same_features(img, GlcmRlmFilterType::New(img, window(), offsets(), 4), GlcmRlmFilterType::New(img, window(), offsets(), 4), numFeatures);
+	}
+}
+
+TEST(PointGlcmRlmFilter, FeatureImagesMatchPointFilter) {
+	typedef GlcmRlmFilterType::FeatureIndex FeatureIndex;
+	IntImage::Pointer img = texture_image(4);
+	std::vector<FeatureIndex> features;
+	features.push_back(FeatureIndex::encodeOffset(0, FeatureIndex::GLCM_CONTRAST));
+	features.push_back(FeatureIndex::encodeOffset(4, FeatureIndex::GLCM_ENTROPY));
+	features.push_back(FeatureIndex::encodeOffset(1, FeatureIndex::RLM_RUN_PERCENTAGE));
+	features.push_back(FeatureIndex::encodeAggregate(FeatureIndex::AGGREGATE_MEAN, FeatureIndex::GLCM_HOMOGENEITY));
+	features.push_back(FeatureIndex::encodeAggregate(FeatureIndex::AGGREGATE_RANGE, FeatureIndex::RLM_LONG_RUN_EMPHASIS));
+	// Rows that cross the border of the image, where the windows are computed as without the incremental mode
+	const pcl::Region3D<int> region(pcl::Point3D<int>(0, 1, 0), pcl::Point3D<int>(15, 11, 7));
+	std::vector<FloatImage::Pointer> images = GlcmRlmFilterType::ComputeFeatureImages<FloatImage>(img, window(), offsets(), 4, region, features, GlcmRlmFilterType::ImageMaskType::ConstantPointer(), 3);
+	ASSERT_EQ(images.size(), features.size());
+
+	GlcmRlmFilterType::Pointer filter = GlcmRlmFilterType::New(img, window(), offsets(), 4);
+	long differences = 0;
+	for(int z=region.getMinPoint().z(); z<=region.getMaxPoint().z(); z++) {
+		for(int y=region.getMinPoint().y(); y<=region.getMaxPoint().y(); y++) {
+			for(int x=region.getMinPoint().x(); x<=region.getMaxPoint().x(); x++) {
+				const pcl::Point3D<int> p(x, y, z);
+				filter->apply(p);
+				for(size_t f=0; f<features.size(); f++) if (!same(images[f]->get(p), (float)filter->getResult(features[f]))) differences++;
+			}
+		}
+	}
+	EXPECT_EQ(differences, 0);
+}
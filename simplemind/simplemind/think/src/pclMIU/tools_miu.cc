@@ -1,12 +1,14 @@
 #include "tools_miu.h"
-#include "PercentileCalculator.h"
+#include <pcl/statistics/DenseHistogram.h>
+#include "IntensityVolume.h"
+#include "DistanceMap.h"
 #include <math.h>
 
 /**
 Checks the points in the contour (c) with indices in the range [low_index, high_index). If the distance between the point in the contour and the given point p is > max_diameter_pix, then return the new value for max_diameter_pix and set mdist_pt1, and mdist_pt2.
 Otherwise return return the existing value of max_diameter_pix and do not modify mdist_pt1, and mdist_pt2.
 */
-float maxDist(Point p, Contour c, int low_index, int high_index, float mdist, Point& mdist_pt1, Point& mdist_pt2) {
+float maxDist(const Point& p, const Contour& c, int low_index, int high_index, float mdist, Point& mdist_pt1, Point& mdist_pt2) {
 	int i, dx, dy;
 	float d;
 	float newmdist = mdist;
@@ -33,7 +35,7 @@ float maxDist(Point p, Contour c, int low_index, int high_index, float mdist, Po
 	Returns true if mdist was changed.
 	Argument, perp_offset, indicates the offset from -1 that is allowable for gradients if lines are to be considered perpendicular.
 	*/
-bool maxDistConGrad(const Point& p, Contour c, int low_index, int high_index, const Point& ml_pt1, const Point& ml_pt2, float& mdist, Point& mdist_pt1, Point& mdist_pt2, float perp_offset) {
+bool maxDistConGrad(const Point& p, const Contour& c, int low_index, int high_index, const Point& ml_pt1, const Point& ml_pt2, float& mdist, Point& mdist_pt1, Point& mdist_pt2, float perp_offset) {
 		int i, dx, dy;
 		bool ml_vert=false, vert, found=false, ok;
 		float d=0, ml_g=0, g=0;
@@ -80,26 +82,14 @@ bool maxDistConGrad(const Point& p, Contour c, int low_index, int high_index, co
 		return found;
 	}
 
-void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, const float col_pixel_spacing, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2, double& max_diameter, double& perp_diameter) {
-		if (currentRoi.empty()) {
-            max_diameter=0;
-			perp_diameter=0;
-            return;
-        }
-
-        int ci, pn, pi;
+void compute_diameter_points(const Contour* const* contours, const int* num_contours, const int fz, const int lz, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2) {
+		int ci, pn, pi, z;
 		float max_diameter_pix = 0, perp_diameter_pix = 0;
-		Point fp, lp;
-		currentRoi.first_point(fp);
-		currentRoi.last_point(lp); 
 
-		Contour* contours;
-		int Ncontours;
 		//find and compute the maximium diameter
-		for(int z=fp.z; z<=lp.z; z++) {
-			contours = currentRoi.boundaries(Ncontours, z);
-			for(ci=0; ci<Ncontours; ci++) {
-				Contour& cont = contours[ci];
+		for(z=fz; z<=lz; z++) {
+			for(ci=0; ci<num_contours[z-fz]; ci++) {
+				const Contour& cont = contours[z-fz][ci];
 				pn = cont.n();
 				for(pi=0; pi<pn; pi++) {
 					max_diameter_pix = maxDist(cont[pi], cont, 0, pn, max_diameter_pix, mdist_pt1, mdist_pt2);
@@ -107,16 +97,14 @@ void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, con
 			}
 		}
 
-//cout << fp << lp << mdist_pt1 << mdist_pt2 << endl;
-
-		//find and compute the perpendicular maximium diameter
-		if (Ncontours>0) {
-			contours = currentRoi.boundaries(Ncontours, mdist_pt1.z);
+		//find and compute the perpendicular maximium diameter (on the slice of the maximum diameter)
+		z = mdist_pt1.z;
+		if ((z>=fz) && (z<=lz)) {
 			bool found = false;
 			float poffset = 0.25f;
 			for (int i=1; i<9 && !found; i=2*i ) {
-				for(ci=0; ci<Ncontours; ci++) {
-					Contour& cont = contours[ci];
+				for(ci=0; ci<num_contours[z-fz]; ci++) {
+					const Contour& cont = contours[z-fz][ci];
 					pn = cont.n();
 					for(pi=0; pi<pn ; pi++) {
 						bool f = maxDistConGrad(cont[pi], cont, 0, pn, mdist_pt1, mdist_pt2, perp_diameter_pix, mpdist_pt1, mpdist_pt2, poffset*i);
@@ -124,9 +112,10 @@ void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, con
 					}
 				}
 			}
-	  	}	// end of statement if (contours.size()>0)
-		//double[] pixel_spacing = new double[2];
+	  	}
+}
 
+void diameters_from_points(const float row_pixel_spacing, const float col_pixel_spacing, const Point& mdist_pt1, const Point& mdist_pt2, const Point& mpdist_pt1, const Point& mpdist_pt2, double& max_diameter, double& perp_diameter) {
 		max_diameter = sqrt(((mdist_pt1.x-mdist_pt2.x)*col_pixel_spacing)*((mdist_pt1.x-mdist_pt2.x)*col_pixel_spacing) + ((mdist_pt1.y-mdist_pt2.y)*row_pixel_spacing)*((mdist_pt1.y-mdist_pt2.y)*row_pixel_spacing));
 		perp_diameter = sqrt(((mpdist_pt1.x-mpdist_pt2.x)*col_pixel_spacing)*((mpdist_pt1.x-mpdist_pt2.x)*col_pixel_spacing) + ((mpdist_pt1.y-mpdist_pt2.y)*row_pixel_spacing)*((mpdist_pt1.y-mpdist_pt2.y)*row_pixel_spacing));
 
@@ -134,47 +123,74 @@ void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, con
             max_diameter = -max_diameter;
             perp_diameter = -perp_diameter;
         }
+}
+
+void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, const float col_pixel_spacing, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2, double& max_diameter, double& perp_diameter) {
+		if (currentRoi.empty()) {
+            max_diameter=0;
+			perp_diameter=0;
+            return;
+        }
+
+		Point fp, lp;
+		currentRoi.first_point(fp);
+		currentRoi.last_point(lp); 
+
+		const int nz = lp.z-fp.z+1;
+		Contour** contours = new Contour* [nz];
+		int* num_contours = new int [nz];
+		int z;
+		for(z=fp.z; z<=lp.z; z++)
+			contours[z-fp.z] = currentRoi.boundaries(num_contours[z-fp.z], z);
+
+		compute_diameter_points(contours, num_contours, fp.z, lp.z, mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2);
+		diameters_from_points(row_pixel_spacing, col_pixel_spacing, mdist_pt1, mdist_pt2, mpdist_pt1, mpdist_pt2, max_diameter, perp_diameter);
+
+		for(z=0; z<nz; z++)
+			delete [] contours[z];
+		delete [] contours;
+		delete [] num_contours;
 		//cout << "compute_diameters: " <<  mdist_pt1 << mdist_pt2 << max_diameter << mpdist_pt1 << mpdist_pt2 << perp_diameter << endl;
 }
 
 double meanHU(MedicalImageSequence& mis, ROItraverser& rt)
 { 
+  const IntensityVolume& vol = mis.hu_volume();
   double mean = 0.0;
-  register int sum=0;
-  register int n=0;
-  register Point p1;
+  long sum=0, n=0;
+  Point p1, p2;
   TravStatus s = rt.reset();
   while(s<END_ROI) {
-  	rt.current_point(p1);
-  	sum += mis.fast_pix_val(p1.x, p1.y, p1.z);
-  	n++;
-  	s = rt.next_point();
+  	rt.current_interval(p1, p2);
+  	const short* hu = vol.hu_row(p1.y, p1.z);
+  	for(int x=p1.x; x<=p2.x; x++)
+  		sum += hu[x];
+  	n += p2.x-p1.x+1;
+  	s = rt.next_interval();
   }  
-  if (n>0) {
-  	const Image& im = mis.image_const(p1.z);
- 	sum = sum*im.rescale_slope()+im.rescale_intercept(); 
+  if (n>0)
  	mean = (double)sum/(double)n;
- }
 
   return mean;
 }
 
 int medianHU(MedicalImageSequence& mis, ROItraverser& rt)
 { 
-  PercentileCalculator<int> pc;
-  register Point p1;
+  const IntensityVolume& vol = mis.hu_volume();
+  pcl::statistics::DenseHistogram<int> pc;
+  Point p1, p2;
   TravStatus s = rt.reset();
   while(s<END_ROI) {
-  	rt.current_point(p1);
-  	pc.addValue(mis.fast_pix_val(p1.x, p1.y, p1.z));
-  	s = rt.next_point();
+  	rt.current_interval(p1, p2);
+  	const short* hu = vol.hu_row(p1.y, p1.z);
+  	for(int x=p1.x; x<=p2.x; x++)
+  		pc.addValue(hu[x]);
+  	s = rt.next_interval();
   }  
-  int val = pc.getMedian();
-
-  const Image& im = mis.image_const(p1.z);
-  val = val*im.rescale_slope()+im.rescale_intercept();  
+  if (pc.getNum()==0)
+  	return 0;
 
-  return val;
+  return (int)pc.getMedian();
 }
 
 float sphericity(const ROI& r, const FPoint& cent, float volume, const MedicalImageSequence& mis)
@@ -211,104 +227,71 @@ float sphericity(const ROI& r, const FPoint& cent, float volume, const MedicalIm
   	return val;
 }
 
-float* distance_map_2d(const ROI& r, const int z, const MedicalImageSequence& mis) {
-	// Euclidean Distance Map algorithm from textbook by Russ
+// Copies plane z of the distance map into dm (size xdim*ydim); pixels outside the map are not modified
+static void copy_distance_plane(const EDMimage::Pointer& dm_image, const int z, float* dm, const int xdim, const int ydim)
+{
+	// The distance map covers the bounding box of the plane and may extend one pixel beyond the image
+	pcl::Point3D<int> minp = dm_image->getRegion().getMinPoint();
+	pcl::Point3D<int> maxp = dm_image->getRegion().getMaxPoint();
+	int x0 = (minp.x()<0) ? 0 : minp.x();
+	int x1 = (maxp.x()>=xdim) ? xdim-1 : maxp.x();
+	int y0 = (minp.y()<0) ? 0 : minp.y();
+	int y1 = (maxp.y()>=ydim) ? ydim-1 : maxp.y();
+	for(int y=y0; y<=y1; y++) {
+		long i = dm_image->toIndex(x0, y, z);
+		long j = (long)y*xdim + x0;
+		for(int x=x0; x<=x1; x++) {
+			dm[j] = dm_image->get(i);
+			i++;
+			j++;
+		}
+	}
+}
+
+float* distance_map_2d(const ROI& r, const int z, const MedicalImageSequence& mis, const int num_threads) {
 	int xdim = mis.xdim();
 	int ydim = mis.ydim();
-	int np = xdim*ydim;
+	long np = (long)xdim*ydim;
 	float* dm = new float [np];
+	memset(dm, 0, np*sizeof(float));
 
-	// Assign background to 0 and Roi to large +ve number in the distance map image
-	int i;
-	for(i=0; i<np; i++) {
-		dm[i] = 0;
-	}
+	EDMimage::Pointer dm_image = roi_distance_map_2d(r, z, mis, num_threads);
+	if (dm_image)
+		copy_distance_plane(dm_image, z, dm, xdim, ydim);
 
-	if (!r.empty(z)) {
-		int* inds = new int [np];
-		int ind_cnt=0;
-
-		ROItraverser rt(r, z);
-		TravStatus s = rt.valid();
-		Point p1, p2;
-		int j;
-		float x_spacing = mis.column_pixel_spacing(z);
-		float y_spacing = mis.row_pixel_spacing(z);
-		float diag_spacing = sqrt(x_spacing*x_spacing + y_spacing*y_spacing);
-		float min;
-//int jmark=-1;
-		// Assign pixels in the Roi to large +ve number in the distance map image
-		while(s<END_ROI) {
-			rt.current_interval(p1, p2);
-			// Since we are checking neighbors do not use pixels at the image border as central pixels
-			if ((p1.y>0) && (p1.y<(ydim-1))) {
-				if (p1.x<=0) p1.x=1;
-				if (p2.x>=(xdim-1)) p1.x=xdim-2;
-				if (p1.x<=p2.x) {
-					j=p1.y*xdim+p1.x;
-					for(; p1.x<=p2.x; ++p1.x) {
-//if ((p1.z==98)&&(p1.x>140)&&(p1.x<150)&&(p1.y>253)&&(p1.y<260)) {
-//cout << p1 << endl;
-//jmark=j;
-//}
-						dm[j]=(float)np;
-						inds[ind_cnt]=j;
-						++ind_cnt;
-						++j;
-					}
-				}
-				s = rt.next_interval();
-			}
-			else {
-				s = rt.next_line();
-			}
-		}
-//if (jmark>0)
-//cout << jmark << endl;
-
-		// Proceeding left to right, top to bottom, assign each pixel within the ROI a brightness value one greater than the smallest value of any of its neighbors
-		for(i=0; i<ind_cnt; i++) {
-			j=inds[i];
-
-			min = (dm[j-xdim-1]+diag_spacing);
-			if ((dm[j-xdim]+y_spacing)<min) min=(dm[j-xdim]+y_spacing);
-			if ((dm[j-xdim+1]+diag_spacing)<min) min=(dm[j-xdim+1]+diag_spacing);
-			if ((dm[j-1]+x_spacing)<min) min=(dm[j-1]+x_spacing);
-			if ((dm[j+1]+x_spacing)<min) min=(dm[j+1]+x_spacing);
-			if ((dm[j+xdim-1]+diag_spacing)<min) min=(dm[j+xdim-1]+diag_spacing);
-			if ((dm[j+xdim]+y_spacing)<min) min=(dm[j+xdim]+y_spacing);
-			if ((dm[j+xdim+1]+diag_spacing)<min) min=(dm[j+xdim+1]+diag_spacing);
-			dm[j]=min;
-		}
+	return dm;
+}
 
-		// Proceeding right to left, bottom to top, assign each pixel within the ROI a brightness value one greater than the smallest value of any of its neighbors
-		for(i=ind_cnt-1; i>=0; i--) {
-			j=inds[i];
-
-			min = (dm[j-xdim-1]+diag_spacing);
-			if ((dm[j-xdim]+y_spacing)<min) min=(dm[j-xdim]+y_spacing);
-			if ((dm[j-xdim+1]+diag_spacing)<min) min=(dm[j-xdim+1]+diag_spacing);
-			if ((dm[j-1]+x_spacing)<min) min=(dm[j-1]+x_spacing);
-			if ((dm[j+1]+x_spacing)<min) min=(dm[j+1]+x_spacing);
-			if ((dm[j+xdim-1]+diag_spacing)<min) min=(dm[j+xdim-1]+diag_spacing);
-			if ((dm[j+xdim]+y_spacing)<min) min=(dm[j+xdim]+y_spacing);
-			if ((dm[j+xdim+1]+diag_spacing)<min) min=(dm[j+xdim+1]+diag_spacing);
-			dm[j]=min;
-		}
-//if (jmark>0)
-//cout << dm[jmark] << endl;
 
-		delete [] inds;
+void distance_maps_2d(const ROI& r, float** dm, const MedicalImageSequence& mis, const int num_threads) {
+	Point fp, lp;
+	if (!r.first_point(fp))
+		return;
+	r.last_point(lp);
+
+	// One map for all planes needs the same pixel spacing in each of them
+	bool same_spacing = true;
+	for(int z=fp.z; same_spacing && (z<=lp.z); z++)
+		if (!r.empty(z) && ((mis.row_pixel_spacing(z)!=mis.row_pixel_spacing(fp.z)) || (mis.column_pixel_spacing(z)!=mis.column_pixel_spacing(fp.z))))
+			same_spacing = false;
+	if (!same_spacing) {
+		for(int z=fp.z; z<=lp.z; z++)
+			if (!r.empty(z))
+				dm[z] = distance_map_2d(r, z, mis, num_threads);
+		return;
 	}
 
-/*
-unsigned short* data = mis.pixel_data(z);
-for(i=0; i<np; i++) {
-dm[i] = dm[i]*((float)data[i]);
-}
-*/
-
-	return dm;
+	int xdim = mis.xdim();
+	int ydim = mis.ydim();
+	long np = (long)xdim*ydim;
+	EDMimage::Pointer dm_image = roi_distance_map_2d(r, mis, num_threads);
+	for(int z=fp.z; z<=lp.z; z++) {
+		if (!r.empty(z)) {
+			dm[z] = new float [np];
+			memset(dm[z], 0, np*sizeof(float));
+			copy_distance_plane(dm_image, z, dm[z], xdim, ydim);
+		}
+	}
 }
 
 
@@ -441,7 +424,7 @@ int read_roi_descr_genetic(const std::string& s, std::string& roi_descr, int& i,
 		roi_descr.append(se_type);
 		done = 0;
 
-		if ((se_type.compare("Circle")==0) || (se_type.compare("Line_X")==0) || (se_type.compare("Line_Y")==0) || (se_type.compare("Line_Z")==0)) {
+		if ((se_type.compare("Circle")==0) || (se_type.compare("Sphere")==0) || (se_type.compare("Line_X")==0) || (se_type.compare("Line_Y")==0) || (se_type.compare("Line_Z")==0)) {
 			float rad_mm;
 			if (read_float(s, rad_mm, i)) {
 				done = 1;
@@ -456,6 +439,21 @@ int read_roi_descr_genetic(const std::string& s, std::string& roi_descr, int& i,
 				roi_descr.append(ss.str());			
 			}
 		}
+		else if (se_type.compare("Cylinder")==0) {
+			float rad_mm, height_mm;
+			if (read_float(s, rad_mm, i) && advance_to(s, ' ', i) && read_gene_float(s, chromosome, bits_used, rad_mm, i)
+				&& skip_blanks(s, i) && read_float(s, height_mm, i)) {
+				done = 1;
+				int j = i;
+				if (advance_to(s, ' ', j)) {
+					i = j;
+					done = read_gene_float(s, chromosome, bits_used, height_mm, i);
+				}
+				std::ostringstream ss;
+				ss << " " << rad_mm << " " << height_mm;
+				roi_descr.append(ss.str());
+			}
+		}
 		else if (se_type.compare("Box")==0) {
 			FPoint tlf, brf;
 			//if (read_fpoint(_descr, tlf, i) && read_fpoint(_descr, brf, i)) {
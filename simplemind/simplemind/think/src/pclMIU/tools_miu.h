@@ -57,15 +57,16 @@
 #include "ROItraverser.h"
 
 /**
-Returns mean of the ROI given by rt.
+Returns mean HU of the ROI given by rt (read from MedicalImageSequence::hu_volume).
 Assumes image is a CT.
 Returns 0 if ROI is empty.
 */
 double meanHU(MedicalImageSequence& mis, ROItraverser& rt);
 
 /**
-Returns mean of the ROI given by rt.
+Returns median HU of the ROI given by rt (read from MedicalImageSequence::hu_volume).
 Assumes image is a CT.
+Returns 0 if ROI is empty.
 */
 int medianHU(MedicalImageSequence& mis, ROItraverser& rt);
 
@@ -80,9 +81,16 @@ float sphericity(const ROI& r, const FPoint& cent, float volume, const MedicalIm
 Returns a 2D Euclidean distance map for the given slice of the ROI.
 The distances in the image are in mm and therefore the MedicalImageSequence is required to provide the spacings.
 The dimensions of the resulting image are the same as the MedicalImageSequence.
-However, since the algorithm checks pixels in a neighborhood when computing the map, the outermost pixels at the edge of the image will always have value 0 in the resulting image.
+The distances are exact (see roi_distance_map_2d), and pixels beyond the edge of the image count as background.
+The caller must delete the returned array.
+*/
+float* distance_map_2d(const ROI& r, const int z, const MedicalImageSequence& mis, const int num_threads=1);
+
+/**
+Sets dm[z] to the 2D Euclidean distance map (as distance_map_2d) of each non-empty slice z of the ROI, computing the maps of all slices at once.
+Other elements of dm are not modified. The caller must delete the returned arrays.
 */
-float* distance_map_2d(const ROI& r, const int z, const MedicalImageSequence& mis);
+void distance_maps_2d(const ROI& r, float** dm, const MedicalImageSequence& mis, const int num_threads=1);
 
 /// Rounds a float to the nearest integer
 int round_float(float v);
@@ -130,6 +138,16 @@ The corresponding Points will also be set.
 */
 void compute_diameters(const ROI& currentRoi, const float row_pixel_spacing, const float col_pixel_spacing, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2, double& max_diameter, double& perp_diameter);
 
+/**
+Finds the end points (in pixel coordinates) of the maximium diameter and its perpendicular diameter, as in compute_diameters.
+The boundaries of slice z are given by contours[z-fz] (an array of num_contours[z-fz] contours), for z from fz to lz.
+End points that are not found are not modified.
+*/
+void compute_diameter_points(const Contour* const* contours, const int* num_contours, const int fz, const int lz, Point& mdist_pt1, Point& mdist_pt2, Point& mpdist_pt1, Point& mpdist_pt2);
+
+/// Computes the diameters from the end points found by compute_diameter_points, as in compute_diameters
+void diameters_from_points(const float row_pixel_spacing, const float col_pixel_spacing, const Point& mdist_pt1, const Point& mdist_pt2, const Point& mpdist_pt1, const Point& mpdist_pt2, double& max_diameter, double& perp_diameter);
+
 /**
 Starting from the index position, i, in the string, s, reads an ROIdescription string from s and appends it to roi_descr. It skips over characters up to '[', going to the end of the string if necessary and then reads the descriptor, leaving the index at the character past ']' or at the end of the string.
 If the string has parameters as genes and a chromosome is provided then they are reflected in the generated ROIdescription. If no chromosome is provided the default value is used.